@@ -0,0 +1,49 @@
+//
+// C:/workspace/RedTea/Engine/Common/ispc/fast_math_ispc.h
+// (Header automatically generated by the ispc compiler.)
+// DO NOT EDIT THIS FILE.
+//
+
+#pragma once
+#include <stdint.h>
+
+
+
+#ifdef __cplusplus
+namespace ispc { /* namespace */
+#endif // __cplusplus
+
+#ifndef __ISPC_ALIGN__
+#if defined(__clang__) || !defined(_MSC_VER)
+// Clang, GCC, ICC
+#define __ISPC_ALIGN__(s) __attribute__((aligned(s)))
+#define __ISPC_ALIGNED_STRUCT__(s) struct __ISPC_ALIGN__(s)
+#else
+// Visual Studio
+#define __ISPC_ALIGN__(s) __declspec(align(s))
+#define __ISPC_ALIGNED_STRUCT__(s) __ISPC_ALIGN__(s) struct
+#endif
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////
+// Functions exported from ispc code
+///////////////////////////////////////////////////////////////////////////
+#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )
+extern "C" {
+#endif // __cplusplus
+    extern void FastAtan2(const float * y, const float * x, float * result, const uint32_t count, const int32_t precision);
+    extern void FastCos(const float * a, float * result, const uint32_t count, const int32_t precision);
+    extern void FastExp(const float * a, float * result, const uint32_t count, const int32_t precision);
+    extern void FastLog(const float * a, float * result, const uint32_t count, const int32_t precision);
+    extern void FastNormalize3(float * x, float * y, float * z, const uint32_t count, const int32_t precision);
+    extern void FastRsqrt(const float * a, float * result, const uint32_t count, const int32_t precision);
+    extern void FastSin(const float * a, float * result, const uint32_t count, const int32_t precision);
+#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )
+} /* end extern C */
+#endif // __cplusplus
+
+
+#ifdef __cplusplus
+} /* namespace */
+#endif // __cplusplus
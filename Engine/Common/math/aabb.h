@@ -0,0 +1,126 @@
+#pragma once
+#include "vector.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+
+namespace redtea {
+namespace math {
+
+// Axis aligned box, empty while min > max on any axis
+struct Aabb
+{
+	Vector3f min;
+	Vector3f max;
+
+	constexpr Aabb() noexcept : min(1.0f), max(-1.0f) {}
+	constexpr Aabb(Vector3f const& min, Vector3f const& max) noexcept : min(min), max(max) {}
+
+	static Aabb FromCenterExtents(Vector3f const& center, Vector3f const& extents) noexcept
+	{
+		return { center - extents, center + extents };
+	}
+
+	bool IsEmpty() const noexcept
+	{
+		return min.x > max.x || min.y > max.y || min.z > max.z;
+	}
+
+	Vector3f Center() const noexcept { return (min + max) * 0.5f; }
+	Vector3f Extents() const noexcept { return (max - min) * 0.5f; }
+
+	// half the surface area, enough to compare boxes
+	float HalfArea() const noexcept
+	{
+		const Vector3f d = max - min;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	bool Contains(Aabb const& b) const noexcept
+	{
+		return min.x <= b.min.x && min.y <= b.min.y && min.z <= b.min.z
+			&& max.x >= b.max.x && max.y >= b.max.y && max.z >= b.max.z;
+	}
+
+	bool Overlaps(Aabb const& b) const noexcept
+	{
+		return min.x <= b.max.x && min.y <= b.max.y && min.z <= b.max.z
+			&& max.x >= b.min.x && max.y >= b.min.y && max.z >= b.min.z;
+	}
+
+	// squared distance from p to the box, 0 inside
+	float DistanceSquared(Vector3f const& p) const noexcept
+	{
+		const float dx = std::max(std::max(min.x - p.x, p.x - max.x), 0.0f);
+		const float dy = std::max(std::max(min.y - p.y, p.y - max.y), 0.0f);
+		const float dz = std::max(std::max(min.z - p.z, p.z - max.z), 0.0f);
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// slab test against origin + t * direction, invDirection is 1 / direction per axis.
+	// Returns the entry distance, or a negative value on a miss within [0, maxT].
+	float Intersect(Vector3f const& origin, Vector3f const& invDirection, float maxT) const noexcept
+	{
+		float t0 = 0.0f;
+		float t1 = maxT;
+		for (size_t a = 0; a < 3; a++)
+		{
+			float n = (min[a] - origin[a]) * invDirection[a];
+			float f = (max[a] - origin[a]) * invDirection[a];
+			if (n > f)
+			{
+				std::swap(n, f);
+			}
+			// NaN from 0 * inf on a slab boundary keeps the current interval
+			t0 = n > t0 ? n : t0;
+			t1 = f < t1 ? f : t1;
+			if (t0 > t1)
+			{
+				return -1.0f;
+			}
+		}
+		return t0;
+	}
+
+	Aabb& Extend(Aabb const& b) noexcept
+	{
+		min = Vector3f(std::min(min.x, b.min.x), std::min(min.y, b.min.y), std::min(min.z, b.min.z));
+		max = Vector3f(std::max(max.x, b.max.x), std::max(max.y, b.max.y), std::max(max.z, b.max.z));
+		return *this;
+	}
+
+	Aabb& Extend(Vector3f const& p) noexcept
+	{
+		return Extend(Aabb(p, p));
+	}
+
+	// grown by margin on every side
+	Aabb Inflated(float margin) const noexcept
+	{
+		return { min - Vector3f(margin), max + Vector3f(margin) };
+	}
+
+	// bounds of the box transformed by an affine matrix
+	Aabb Transformed(Mat4f const& m) const noexcept
+	{
+		const Vector3f c = Center();
+		const Vector3f e = Extents();
+		Vector3f center = m.data[3].xyz;
+		Vector3f extents(0.0f);
+		for (size_t col = 0; col < 3; col++)
+		{
+			center += m.data[col].xyz * c[col];
+			const Vector3f axis = m.data[col].xyz;
+			extents += Vector3f(std::abs(axis.x), std::abs(axis.y), std::abs(axis.z)) * e[col];
+		}
+		return FromCenterExtents(center, extents);
+	}
+};
+
+inline Aabb Union(Aabb a, Aabb const& b) noexcept
+{
+	return a.Extend(b);
+}
+
+}
+}
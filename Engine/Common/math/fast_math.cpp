@@ -0,0 +1,301 @@
+#include "fast_math.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FAST_MATH_SSE2 1
+#include <emmintrin.h>
+#else
+#define FAST_MATH_SSE2 0
+#endif
+
+namespace redtea {
+namespace math {
+namespace fast {
+
+namespace {
+
+#if FAST_MATH_SSE2
+	template<size_t N>
+	inline __m128 horner(__m128 x, const float (&c)[N]) noexcept
+	{
+		__m128 r = _mm_set1_ps(c[N - 1]);
+		for (size_t i = N - 1; i-- > 0;)
+		{
+			r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(c[i]));
+		}
+		return r;
+	}
+
+	inline __m128 select(__m128 mask, __m128 a, __m128 b) noexcept
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline __m128 signBit() noexcept
+	{
+		return _mm_castsi128_ps(_mm_set1_epi32(int32_t(0x80000000u)));
+	}
+
+	template<Precision P>
+	inline __m128 rsqrt4(__m128 x) noexcept
+	{
+		__m128 y = _mm_rsqrt_ps(x);
+		if (P == Precision::Medium)
+		{
+			// one Newton step on top of the 12 bit hardware estimate
+			const __m128 hx = _mm_mul_ps(_mm_set1_ps(0.5f), x);
+			y = _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(hx, _mm_mul_ps(y, y))));
+		}
+		return y;
+	}
+
+	// sin(x) when offset is 0, cos(x) when offset is 1
+	template<Precision P>
+	inline __m128 sincos4(__m128 x, int32_t offset) noexcept
+	{
+		using C = detail::Coefficients<P>;
+		const __m128i qi = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(detail::kTwoOverPi)));
+		const __m128 j = _mm_cvtepi32_ps(qi);
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(detail::kPio2A)));
+		r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(detail::kPio2B)));
+		r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(detail::kPio2C)));
+		const __m128 z = _mm_mul_ps(r, r);
+		const __m128 s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), horner(z, C::sin)));
+		const __m128 c = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(z, horner(z, C::cos)));
+
+		const __m128i q = _mm_add_epi32(qi, _mm_set1_epi32(offset));
+		const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		const __m128 sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+		return _mm_xor_ps(select(swap, c, s), sign);
+	}
+
+	template<Precision P>
+	inline __m128 atan2_4(__m128 y, __m128 x) noexcept
+	{
+		const __m128 sign = signBit();
+		const __m128 ax = _mm_andnot_ps(sign, x);
+		const __m128 ay = _mm_andnot_ps(sign, y);
+		const __m128 mx = _mm_max_ps(ax, ay);
+		const __m128 mn = _mm_min_ps(ax, ay);
+		// 0/0 turns into NaN, mask it back to 0 so atan2(0, 0) == 0
+		const __m128 t = _mm_and_ps(_mm_div_ps(mn, mx), _mm_cmpgt_ps(mx, _mm_setzero_ps()));
+		__m128 a = _mm_mul_ps(t, horner(_mm_mul_ps(t, t), detail::Coefficients<P>::atan));
+		a = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(detail::kHalfPi), a), a);
+		a = select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(detail::kPi), a), a);
+		return _mm_xor_ps(a, _mm_and_ps(y, sign));
+	}
+
+	template<Precision P>
+	inline __m128 exp4(__m128 x) noexcept
+	{
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(detail::kExpMin)), _mm_set1_ps(detail::kExpMax));
+		const __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(detail::kLog2e)));
+		const __m128 nf = _mm_cvtepi32_ps(n);
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(nf, _mm_set1_ps(detail::kLn2Hi)));
+		r = _mm_sub_ps(r, _mm_mul_ps(nf, _mm_set1_ps(detail::kLn2Lo)));
+		const __m128 p = horner(_mm_mul_ps(r, _mm_set1_ps(detail::kLog2e)), detail::Coefficients<P>::exp2);
+		const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+		return _mm_mul_ps(p, scale);
+	}
+
+	template<Precision P>
+	inline __m128 log4(__m128 x) noexcept
+	{
+		const __m128i u = _mm_castps_si128(x);
+		__m128i e = _mm_sub_epi32(_mm_srli_epi32(u, 23), _mm_set1_epi32(127));
+		__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+		const __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(detail::kSqrt2));
+		m = select(big, _mm_mul_ps(m, _mm_set1_ps(0.5f)), m);
+		// the mask is -1 where m was halved
+		e = _mm_sub_epi32(e, _mm_castps_si128(big));
+		m = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+		const __m128 ef = _mm_cvtepi32_ps(e);
+		__m128 p = _mm_mul_ps(_mm_mul_ps(m, m), horner(m, detail::Coefficients<P>::log));
+		p = _mm_add_ps(m, p);
+		p = _mm_add_ps(p, _mm_mul_ps(ef, _mm_set1_ps(detail::kLn2Lo)));
+		return _mm_add_ps(p, _mm_mul_ps(ef, _mm_set1_ps(detail::kLn2Hi)));
+	}
+
+	// applies a 4-wide kernel over the array, the tail goes through the scalar version
+	template<typename Kernel4, typename Kernel1>
+	inline void forEach4(float const* in, float* out, size_t count, Kernel4 k4, Kernel1 k1) noexcept
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(out + i, k4(_mm_loadu_ps(in + i)));
+		}
+		for (; i < count; i++)
+		{
+			out[i] = k1(in[i]);
+		}
+	}
+#endif
+
+	template<typename Kernel1>
+	inline void forEach1(float const* in, float* out, size_t count, Kernel1 k1) noexcept
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = k1(in[i]);
+		}
+	}
+}
+
+template<Precision P>
+void rsqrt(float const* in, float* out, size_t count) noexcept
+{
+	auto k1 = [](float v) { return rsqrt<P>(v); };
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		forEach4(in, out, count, [](__m128 v) { return rsqrt4<P>(v); }, k1);
+		return;
+	}
+#endif
+	forEach1(in, out, count, k1);
+}
+
+template<Precision P>
+void sin(float const* in, float* out, size_t count) noexcept
+{
+	auto k1 = [](float v) { return sin<P>(v); };
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		forEach4(in, out, count, [](__m128 v) { return sincos4<P>(v, 0); }, k1);
+		return;
+	}
+#endif
+	forEach1(in, out, count, k1);
+}
+
+template<Precision P>
+void cos(float const* in, float* out, size_t count) noexcept
+{
+	auto k1 = [](float v) { return cos<P>(v); };
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		forEach4(in, out, count, [](__m128 v) { return sincos4<P>(v, 1); }, k1);
+		return;
+	}
+#endif
+	forEach1(in, out, count, k1);
+}
+
+template<Precision P>
+void sincos(float const* in, float* outSin, float* outCos, size_t count) noexcept
+{
+	size_t i = 0;
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 v = _mm_loadu_ps(in + i);
+			_mm_storeu_ps(outSin + i, sincos4<P>(v, 0));
+			_mm_storeu_ps(outCos + i, sincos4<P>(v, 1));
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		sincos<P>(in[i], outSin[i], outCos[i]);
+	}
+}
+
+template<Precision P>
+void atan2(float const* y, float const* x, float* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(out + i, atan2_4<P>(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = atan2<P>(y[i], x[i]);
+	}
+}
+
+template<Precision P>
+void exp(float const* in, float* out, size_t count) noexcept
+{
+	auto k1 = [](float v) { return exp<P>(v); };
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		forEach4(in, out, count, [](__m128 v) { return exp4<P>(v); }, k1);
+		return;
+	}
+#endif
+	forEach1(in, out, count, k1);
+}
+
+template<Precision P>
+void log(float const* in, float* out, size_t count) noexcept
+{
+	auto k1 = [](float v) { return log<P>(v); };
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		forEach4(in, out, count, [](__m128 v) { return log4<P>(v); }, k1);
+		return;
+	}
+#endif
+	forEach1(in, out, count, k1);
+}
+
+template<Precision P>
+void normalize(float* x, float* y, float* z, size_t count) noexcept
+{
+	size_t i = 0;
+#if FAST_MATH_SSE2
+	if (P != Precision::Exact)
+	{
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 vx = _mm_loadu_ps(x + i);
+			const __m128 vy = _mm_loadu_ps(y + i);
+			const __m128 vz = _mm_loadu_ps(z + i);
+			const __m128 l2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+			const __m128 s = rsqrt4<P>(l2);
+			_mm_storeu_ps(x + i, _mm_mul_ps(vx, s));
+			_mm_storeu_ps(y + i, _mm_mul_ps(vy, s));
+			_mm_storeu_ps(z + i, _mm_mul_ps(vz, s));
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const float s = rsqrt<P>(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		x[i] *= s;
+		y[i] *= s;
+		z[i] *= s;
+	}
+}
+
+#define INSTANTIATE_FAST_MATH(P) \
+template void rsqrt<P>(float const*, float*, size_t) noexcept; \
+template void sin<P>(float const*, float*, size_t) noexcept; \
+template void cos<P>(float const*, float*, size_t) noexcept; \
+template void sincos<P>(float const*, float*, float*, size_t) noexcept; \
+template void atan2<P>(float const*, float const*, float*, size_t) noexcept; \
+template void exp<P>(float const*, float*, size_t) noexcept; \
+template void log<P>(float const*, float*, size_t) noexcept; \
+template void normalize<P>(float*, float*, float*, size_t) noexcept;
+
+INSTANTIATE_FAST_MATH(Precision::Exact)
+INSTANTIATE_FAST_MATH(Precision::Medium)
+INSTANTIATE_FAST_MATH(Precision::Fast)
+
+#undef INSTANTIATE_FAST_MATH
+
+}
+}
+}
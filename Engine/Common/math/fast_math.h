@@ -0,0 +1,308 @@
+#pragma once
+#include "../common.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+namespace redtea {
+namespace math {
+
+/*
+ * Accuracy tier of the math::fast functions.
+ *
+ * Exact  : forwards to <cmath>, use it to A/B a hot loop against the approximations.
+ * Medium : minimax polynomials accurate to a few float ulps, safe default for gameplay code.
+ * Fast   : shorter polynomials and a single Newton step, for particles, animation blending
+ *          and anything else that ends up on screen without feeding back into simulation.
+ *
+ * Max errors measured over the documented domain (abs = absolute, rel = relative):
+ *
+ *              Medium            Fast
+ *   rsqrt      rel 4.8e-6        rel 1.8e-3        x > 0 and normal
+ *   sin/cos    abs 1.0e-7        abs 1.1e-6        |x| <= 8192
+ *   atan2      abs 3.1e-7 rad    abs 1.2e-5 rad
+ *   exp        rel 2.7e-7        rel 7.5e-5        input clamped to [-87.3, 88]
+ *   log        abs 5.1e-7        abs 1.5e-5        x > 0 and normal
+ *
+ * The batched versions take plain SoA arrays and use SSE2 when it is available. They keep the
+ * same bounds, rsqrt maps to the hardware estimate instead (Medium rel 2.3e-7, Fast rel 3.7e-4).
+ */
+enum class Precision : uint8_t
+{
+	Exact,
+	Medium,
+	Fast
+};
+
+namespace fast {
+namespace detail {
+
+	inline uint32_t asUint(float f) noexcept
+	{
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	inline float asFloat(uint32_t u) noexcept
+	{
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	// round half away from zero, good enough for range reduction
+	inline int32_t roundToInt(float x) noexcept
+	{
+		return int32_t(x + (x < 0 ? -0.5f : 0.5f));
+	}
+
+	template<size_t N>
+	inline float horner(float x, const float (&c)[N]) noexcept
+	{
+		float r = c[N - 1];
+		for (size_t i = N - 1; i-- > 0;)
+		{
+			r = r * x + c[i];
+		}
+		return r;
+	}
+
+	static constexpr float kPi = 3.14159265358979f;
+	static constexpr float kHalfPi = 1.57079632679490f;
+	static constexpr float kTwoOverPi = 0.636619772367581f;
+	// pi/2 split in three parts so that j * kPio2A is exact for |j| < 2^15 (Cody-Waite)
+	static constexpr float kPio2A = 1.5703125f;
+	static constexpr float kPio2B = 4.837512969970703125e-4f;
+	static constexpr float kPio2C = 7.54978995489188216e-8f;
+	static constexpr float kLog2e = 1.44269504088896f;
+	static constexpr float kLn2Hi = 0.693359375f;
+	static constexpr float kLn2Lo = -2.12194440e-4f;
+	static constexpr float kSqrt2 = 1.41421356237310f;
+	static constexpr float kExpMin = -87.3f;
+	static constexpr float kExpMax = 88.0f;
+
+	// polynomial coefficients, lowest order first
+	//   sin(r)   = r + r * z * P(z)      z = r^2, |r| <= pi/4
+	//   cos(r)   = 1 + z * P(z)
+	//   atan(t)  = t * P(t^2)            0 <= t <= 1
+	//   2^f      = P(f)                  |f| <= 0.5
+	//   log1p(m) = m + m^2 * P(m)        sqrt(0.5) - 1 <= m < sqrt(2) - 1
+	template<Precision P> struct Coefficients;
+
+	template<> struct Coefficients<Precision::Medium>
+	{
+		static constexpr float sin[] = { -1.666665067e-01f, 8.331978663e-03f, -1.949563623e-04f };
+		static constexpr float cos[] = { -0.5f, 4.166664687e-02f, -1.388736752e-03f, 2.443845156e-05f };
+		static constexpr float atan[] = {
+			9.999993356e-01f, -3.332986079e-01f, 1.994656568e-01f, -1.390862963e-01f,
+			9.642197481e-02f, -5.591232824e-02f, 2.186295859e-02f, -4.054567345e-03f };
+		static constexpr float exp2[] = {
+			1.000000072e+00f, 6.931469671e-01f, 2.402211972e-01f,
+			5.550713274e-02f, 9.675541333e-03f, 1.327647178e-03f };
+		static constexpr float log[] = {
+			-4.999998198e-01f, 3.333422544e-01f, -2.500249103e-01f, 1.995361342e-01f,
+			-1.655233518e-01f, 1.497928645e-01f, -1.444187232e-01f, 8.733625183e-02f };
+		static constexpr int rsqrtSteps = 2;
+	};
+
+	template<> struct Coefficients<Precision::Fast>
+	{
+		static constexpr float sin[] = { -1.666283381e-01f, 8.152992326e-03f };
+		static constexpr float cos[] = { -4.999989478e-01f, 4.165629458e-02f, -1.359782313e-03f };
+		static constexpr float atan[] = {
+			9.998663296e-01f, -3.303047860e-01f, 1.801592948e-01f, -8.515634987e-02f, 2.084511338e-02f };
+		static constexpr float exp2[] = { 9.999280736e-01f, 6.932609858e-01f, 2.426111221e-01f, 5.517166722e-02f };
+		static constexpr float log[] = { -4.993323529e-01f, 3.358730198e-01f, -2.722598232e-01f, 1.796863198e-01f };
+		static constexpr int rsqrtSteps = 1;
+	};
+
+	// Exact never evaluates the polynomials, this only keeps the dead branches compiling
+	template<> struct Coefficients<Precision::Exact> : Coefficients<Precision::Medium> {};
+
+	// sin and cos of the reduced argument, quadrant in q
+	template<Precision P>
+	inline void sincosReduced(float x, float& s, float& c, int32_t& q) noexcept
+	{
+		using C = Coefficients<P>;
+		q = roundToInt(x * kTwoOverPi);
+		const float j = float(q);
+		const float r = ((x - j * kPio2A) - j * kPio2B) - j * kPio2C;
+		const float z = r * r;
+		s = r + r * z * horner(z, C::sin);
+		c = 1.0f + z * horner(z, C::cos);
+	}
+}
+
+template<Precision P = Precision::Medium>
+inline float rsqrt(float x) noexcept
+{
+	if (P == Precision::Exact)
+	{
+		return 1.0f / std::sqrt(x);
+	}
+	float y = detail::asFloat(0x5f375a86u - (detail::asUint(x) >> 1));
+	const float hx = 0.5f * x;
+	for (int i = 0; i < detail::Coefficients<P>::rsqrtSteps; i++)
+	{
+		y = y * (1.5f - hx * y * y);
+	}
+	return y;
+}
+
+template<Precision P = Precision::Medium>
+inline float sin(float x) noexcept
+{
+	if (P == Precision::Exact)
+	{
+		return std::sin(x);
+	}
+	float s, c;
+	int32_t q;
+	detail::sincosReduced<P>(x, s, c, q);
+	const float r = (q & 1) ? c : s;
+	return (q & 2) ? -r : r;
+}
+
+template<Precision P = Precision::Medium>
+inline float cos(float x) noexcept
+{
+	if (P == Precision::Exact)
+	{
+		return std::cos(x);
+	}
+	float s, c;
+	int32_t q;
+	detail::sincosReduced<P>(x, s, c, q);
+	const float r = (q & 1) ? s : c;
+	return ((q + 1) & 2) ? -r : r;
+}
+
+template<Precision P = Precision::Medium>
+inline void sincos(float x, float& outSin, float& outCos) noexcept
+{
+	if (P == Precision::Exact)
+	{
+		outSin = std::sin(x);
+		outCos = std::cos(x);
+		return;
+	}
+	float s, c;
+	int32_t q;
+	detail::sincosReduced<P>(x, s, c, q);
+	const float rs = (q & 1) ? c : s;
+	const float rc = (q & 1) ? s : c;
+	outSin = (q & 2) ? -rs : rs;
+	outCos = ((q + 1) & 2) ? -rc : rc;
+}
+
+template<Precision P = Precision::Medium>
+inline float atan2(float y, float x) noexcept
+{
+	if (P == Precision::Exact)
+	{
+		return std::atan2(y, x);
+	}
+	const float ax = std::fabs(x);
+	const float ay = std::fabs(y);
+	const float mx = ax > ay ? ax : ay;
+	const float mn = ax > ay ? ay : ax;
+	const float t = mx > 0 ? mn / mx : 0.0f;
+	float a = t * detail::horner(t * t, detail::Coefficients<P>::atan);
+	if (ay > ax) a = detail::kHalfPi - a;
+	if (x < 0) a = detail::kPi - a;
+	return std::signbit(y) ? -a : a;
+}
+
+template<Precision P = Precision::Medium>
+inline float atan(float x) noexcept
+{
+	return P == Precision::Exact ? std::atan(x) : atan2<P>(x, 1.0f);
+}
+
+template<Precision P = Precision::Medium>
+inline float exp(float x) noexcept
+{
+	if (P == Precision::Exact)
+	{
+		return std::exp(x);
+	}
+	x = x < detail::kExpMin ? detail::kExpMin : (x > detail::kExpMax ? detail::kExpMax : x);
+	const int32_t n = detail::roundToInt(x * detail::kLog2e);
+	const float nf = float(n);
+	const float r = (x - nf * detail::kLn2Hi) - nf * detail::kLn2Lo;
+	const float p = detail::horner(r * detail::kLog2e, detail::Coefficients<P>::exp2);
+	return p * detail::asFloat(uint32_t(n + 127) << 23);
+}
+
+template<Precision P = Precision::Medium>
+inline float log(float x) noexcept
+{
+	if (P == Precision::Exact)
+	{
+		return std::log(x);
+	}
+	const uint32_t u = detail::asUint(x);
+	int32_t e = int32_t(u >> 23) - 127;
+	float m = detail::asFloat((u & 0x007fffffu) | 0x3f800000u);
+	if (m > detail::kSqrt2)
+	{
+		m *= 0.5f;
+		e++;
+	}
+	m -= 1.0f;
+	const float ef = float(e);
+	const float p = m + m * m * detail::horner(m, detail::Coefficients<P>::log);
+	return (p + ef * detail::kLn2Lo) + ef * detail::kLn2Hi;
+}
+
+// normalizes any Vector2/3/4 or Quaternion through rsqrt, the input must not be zero
+template<Precision P = Precision::Medium, template<typename> class VECTOR, typename T>
+inline VECTOR<T> normalize(VECTOR<T> v) noexcept
+{
+	T l2 = T(0);
+	for (size_t i = 0; i < v.size(); i++)
+	{
+		l2 += v[i] * v[i];
+	}
+	ASSERT(l2 != 0);
+	const T s = T(rsqrt<P>(float(l2)));
+	for (size_t i = 0; i < v.size(); i++)
+	{
+		v[i] *= s;
+	}
+	return v;
+}
+
+// --------------------------Batched (SoA)------------------------------------------------
+// All arrays hold count floats. In-place calls (in == out) are allowed, other aliasing is not.
+
+template<Precision P = Precision::Medium>
+void rsqrt(float const* in, float* out, size_t count) noexcept;
+
+template<Precision P = Precision::Medium>
+void sin(float const* in, float* out, size_t count) noexcept;
+
+template<Precision P = Precision::Medium>
+void cos(float const* in, float* out, size_t count) noexcept;
+
+template<Precision P = Precision::Medium>
+void sincos(float const* in, float* outSin, float* outCos, size_t count) noexcept;
+
+template<Precision P = Precision::Medium>
+void atan2(float const* y, float const* x, float* out, size_t count) noexcept;
+
+template<Precision P = Precision::Medium>
+void exp(float const* in, float* out, size_t count) noexcept;
+
+template<Precision P = Precision::Medium>
+void log(float const* in, float* out, size_t count) noexcept;
+
+// normalizes count 3d vectors stored as separate x, y, z arrays in place
+template<Precision P = Precision::Medium>
+void normalize(float* x, float* y, float* z, size_t count) noexcept;
+
+}
+}
+}
@@ -0,0 +1,562 @@
+#include "packing.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PACKING_SSE2 1
+#include <emmintrin.h>
+#else
+#define PACKING_SSE2 0
+#endif
+
+namespace redtea {
+namespace math {
+namespace packing {
+
+namespace {
+
+	static constexpr float kSqrt2 = 1.41421356237310f;
+	static constexpr float kSqrtHalf = 0.70710678118655f;
+
+	inline float clampf(float v, float lo, float hi) noexcept
+	{
+		return v < lo ? lo : (v > hi ? hi : v);
+	}
+
+	inline float signNotZero(float v) noexcept
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+#if PACKING_SSE2
+	inline __m128 select(__m128 mask, __m128 a, __m128 b) noexcept
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline __m128i select(__m128i mask, __m128i a, __m128i b) noexcept
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	inline __m128 signBit() noexcept
+	{
+		return _mm_castsi128_ps(_mm_set1_epi32(int32_t(0x80000000u)));
+	}
+
+	// clamp to [lo, hi], scale and round to nearest even
+	inline __m128i quantize(__m128 v, float lo, float hi, float scale) noexcept
+	{
+		v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+		return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(scale)));
+	}
+
+	// packs four 32 bit lanes holding 16 bit patterns, sse2 only has the signed saturating pack
+	inline __m128i pack16(__m128i v) noexcept
+	{
+		v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+		return _mm_packs_epi32(v, v);
+	}
+
+	inline void store4x16(void* out, __m128i packed) noexcept
+	{
+		_mm_storel_epi64(static_cast<__m128i*>(out), packed);
+	}
+
+	inline void store4x8(void* out, __m128i packed) noexcept
+	{
+		const int32_t bits = _mm_cvtsi128_si32(packed);
+		memcpy(out, &bits, sizeof(bits));
+	}
+
+	inline __m128i load4x16(void const* in) noexcept
+	{
+		return _mm_loadl_epi64(static_cast<__m128i const*>(in));
+	}
+
+	inline __m128i load4x8(void const* in) noexcept
+	{
+		int32_t bits;
+		memcpy(&bits, in, sizeof(bits));
+		return _mm_cvtsi32_si128(bits);
+	}
+
+	// round to nearest even, see floatToHalf(float) for the scalar version of each path
+	inline __m128i floatToHalf4(__m128 f) noexcept
+	{
+		const __m128 justSign = _mm_and_ps(f, signBit());
+		const __m128 absf = _mm_xor_ps(f, justSign);
+		const __m128i absi = _mm_castps_si128(absf);
+
+		const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absf, absf));
+		const __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32(143 << 23), absi);
+		const __m128i infOrNan = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x0200)), _mm_set1_epi32(0x7c00));
+
+		const __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32(113 << 23), absi);
+		const __m128i magic = _mm_set1_epi32(126 << 23);
+		const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absf, _mm_castsi128_ps(magic))), magic);
+
+		// mantOdd is -1 when the lowest kept mantissa bit is set
+		const __m128i mantOdd = _mm_srai_epi32(_mm_slli_epi32(absi, 31 - 13), 31);
+		const __m128i rounded = _mm_sub_epi32(_mm_add_epi32(absi, _mm_set1_epi32(int32_t(0xc8000fffu))), mantOdd);
+		const __m128i normal = _mm_srli_epi32(rounded, 13);
+
+		const __m128i finite = select(isSubnormal, subnormal, normal);
+		const __m128i joined = select(isRegular, finite, infOrNan);
+		return _mm_or_si128(joined, _mm_srli_epi32(_mm_castps_si128(justSign), 16));
+	}
+
+	// h holds one half per 32 bit lane, upper bits cleared
+	inline __m128 halfToFloat4(__m128i h) noexcept
+	{
+		const __m128i expMant = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+		const __m128i justSign = _mm_xor_si128(h, expMant);
+		const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+		const __m128i wasInfNan = _mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7bff));
+		const __m128i infNanExp = _mm_and_si128(wasInfNan, _mm_set1_epi32(255 << 23));
+		const __m128i signInf = _mm_or_si128(_mm_slli_epi32(justSign, 16), infNanExp);
+		return _mm_or_ps(scaled, _mm_castsi128_ps(signInf));
+	}
+
+	inline __m128i widenSigned16(__m128i v) noexcept
+	{
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	}
+
+	inline __m128i widenUnsigned16(__m128i v) noexcept
+	{
+		return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+	}
+
+	inline __m128i widenSigned8(__m128i v) noexcept
+	{
+		v = _mm_unpacklo_epi8(v, v);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+	}
+
+	inline __m128i widenUnsigned8(__m128i v) noexcept
+	{
+		const __m128i zero = _mm_setzero_si128();
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+	}
+
+	inline __m128 snormToFloat4(__m128i v, float scale) noexcept
+	{
+		return _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(scale)), _mm_set1_ps(-1.0f));
+	}
+
+	inline __m128 unormToFloat4(__m128i v, float scale) noexcept
+	{
+		return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(scale));
+	}
+#endif
+}
+
+void floatToHalf(float const* in, uint16_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		store4x16(out + i, pack16(floatToHalf4(_mm_loadu_ps(in + i))));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = floatToHalf(in[i]);
+	}
+}
+
+void halfToFloat(uint16_t const* in, float* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(out + i, halfToFloat4(widenUnsigned16(load4x16(in + i))));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = halfToFloat(in[i]);
+	}
+}
+
+void floatToSnorm16(float const* in, int16_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i q = quantize(_mm_loadu_ps(in + i), -1.0f, 1.0f, 32767.0f);
+		store4x16(out + i, _mm_packs_epi32(q, q));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = floatToSnorm16(in[i]);
+	}
+}
+
+void snorm16ToFloat(int16_t const* in, float* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(out + i, snormToFloat4(widenSigned16(load4x16(in + i)), 1.0f / 32767.0f));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = snorm16ToFloat(in[i]);
+	}
+}
+
+void floatToUnorm16(float const* in, uint16_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		store4x16(out + i, pack16(quantize(_mm_loadu_ps(in + i), 0.0f, 1.0f, 65535.0f)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = floatToUnorm16(in[i]);
+	}
+}
+
+void unorm16ToFloat(uint16_t const* in, float* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(out + i, unormToFloat4(widenUnsigned16(load4x16(in + i)), 1.0f / 65535.0f));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = unorm16ToFloat(in[i]);
+	}
+}
+
+void floatToSnorm8(float const* in, int8_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i q = quantize(_mm_loadu_ps(in + i), -1.0f, 1.0f, 127.0f);
+		const __m128i q16 = _mm_packs_epi32(q, q);
+		store4x8(out + i, _mm_packs_epi16(q16, q16));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = floatToSnorm8(in[i]);
+	}
+}
+
+void snorm8ToFloat(int8_t const* in, float* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(out + i, snormToFloat4(widenSigned8(load4x8(in + i)), 1.0f / 127.0f));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = snorm8ToFloat(in[i]);
+	}
+}
+
+void floatToUnorm8(float const* in, uint8_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i q = quantize(_mm_loadu_ps(in + i), 0.0f, 1.0f, 255.0f);
+		const __m128i q16 = _mm_packs_epi32(q, q);
+		store4x8(out + i, _mm_packus_epi16(q16, q16));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = floatToUnorm8(in[i]);
+	}
+}
+
+void unorm8ToFloat(uint8_t const* in, float* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(out + i, unormToFloat4(widenUnsigned8(load4x8(in + i)), 1.0f / 255.0f));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = unorm8ToFloat(in[i]);
+	}
+}
+
+void encodeOctahedral(float const* x, float const* y, float const* z, int16_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	const __m128 sign = signBit();
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 vx = _mm_loadu_ps(x + i);
+		const __m128 vy = _mm_loadu_ps(y + i);
+		const __m128 vz = _mm_loadu_ps(z + i);
+		const __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign, vx), _mm_andnot_ps(sign, vy)), _mm_andnot_ps(sign, vz));
+		const __m128 inv = _mm_div_ps(one, l1);
+		const __m128 px = _mm_mul_ps(vx, inv);
+		const __m128 py = _mm_mul_ps(vy, inv);
+
+		// fold the lower hemisphere over the diagonals
+		const __m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, py)), _mm_or_ps(_mm_and_ps(px, sign), one));
+		const __m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, px)), _mm_or_ps(_mm_and_ps(py, sign), one));
+		const __m128 lower = _mm_cmplt_ps(vz, _mm_setzero_ps());
+		const __m128i u = quantize(select(lower, fx, px), -1.0f, 1.0f, 32767.0f);
+		const __m128i v = quantize(select(lower, fy, py), -1.0f, 1.0f, 32767.0f);
+
+		// u0 v0 u1 v1 u2 v2 u3 v3
+		const __m128i packed = _mm_packs_epi32(_mm_unpacklo_epi32(u, v), _mm_unpackhi_epi32(u, v));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), packed);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const float inv = 1.0f / (std::fabs(x[i]) + std::fabs(y[i]) + std::fabs(z[i]));
+		float px = x[i] * inv;
+		float py = y[i] * inv;
+		if (z[i] < 0.0f)
+		{
+			const float fx = (1.0f - std::fabs(py)) * std::copysign(1.0f, px);
+			py = (1.0f - std::fabs(px)) * std::copysign(1.0f, py);
+			px = fx;
+		}
+		out[2 * i] = floatToSnorm16(px);
+		out[2 * i + 1] = floatToSnorm16(py);
+	}
+}
+
+void decodeOctahedral(int16_t const* in, float* x, float* y, float* z, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	const __m128 sign = signBit();
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i packed = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + 2 * i));
+		const __m128 u = snormToFloat4(_mm_srai_epi32(_mm_slli_epi32(packed, 16), 16), 1.0f / 32767.0f);
+		const __m128 v = snormToFloat4(_mm_srai_epi32(packed, 16), 1.0f / 32767.0f);
+		const __m128 vz = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, u)), _mm_andnot_ps(sign, v));
+
+		// unfold, t is the overshoot below the equator moved back towards the axes
+		const __m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), vz), _mm_setzero_ps());
+		const __m128 vx = _mm_sub_ps(u, _mm_or_ps(t, _mm_and_ps(u, sign)));
+		const __m128 vy = _mm_sub_ps(v, _mm_or_ps(t, _mm_and_ps(v, sign)));
+
+		const __m128 l2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		const __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(l2));
+		_mm_storeu_ps(x + i, _mm_mul_ps(vx, inv));
+		_mm_storeu_ps(y + i, _mm_mul_ps(vy, inv));
+		_mm_storeu_ps(z + i, _mm_mul_ps(vz, inv));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float vx = snorm16ToFloat(in[2 * i]);
+		float vy = snorm16ToFloat(in[2 * i + 1]);
+		const float vz = 1.0f - std::fabs(vx) - std::fabs(vy);
+		const float t = vz < 0.0f ? -vz : 0.0f;
+		vx -= std::copysign(t, vx);
+		vy -= std::copysign(t, vy);
+		const float inv = 1.0f / std::sqrt(vx * vx + vy * vy + vz * vz);
+		x[i] = vx * inv;
+		y[i] = vy * inv;
+		z[i] = vz * inv;
+	}
+}
+
+/*
+ * Layout: bits 30-31 index of the dropped (largest) component, then the three others in
+ * rotating order (index + 1, + 2, + 3) & 3 at bits 20, 10 and 0. They are bounded by
+ * sqrt(0.5) once the largest one is made positive, which gives 10 bits over [-0.707, 0.707].
+ */
+void packQuaternion(float const* x, float const* y, float const* z, float const* w, uint32_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	const __m128 sign = signBit();
+	const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2), three = _mm_set1_epi32(3);
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 vx = _mm_loadu_ps(x + i);
+		const __m128 vy = _mm_loadu_ps(y + i);
+		const __m128 vz = _mm_loadu_ps(z + i);
+		const __m128 vw = _mm_loadu_ps(w + i);
+
+		// first index of the largest magnitude, same tie breaking as the scalar loop
+		__m128 maxAbs = _mm_andnot_ps(sign, vx);
+		__m128i largest = _mm_setzero_si128();
+		__m128 gt = _mm_cmpgt_ps(_mm_andnot_ps(sign, vy), maxAbs);
+		largest = select(_mm_castps_si128(gt), one, largest);
+		maxAbs = _mm_max_ps(maxAbs, _mm_andnot_ps(sign, vy));
+		gt = _mm_cmpgt_ps(_mm_andnot_ps(sign, vz), maxAbs);
+		largest = select(_mm_castps_si128(gt), two, largest);
+		maxAbs = _mm_max_ps(maxAbs, _mm_andnot_ps(sign, vz));
+		gt = _mm_cmpgt_ps(_mm_andnot_ps(sign, vw), maxAbs);
+		largest = select(_mm_castps_si128(gt), three, largest);
+
+		const __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+		const __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, one));
+		const __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, two));
+		const __m128 dropped = select(is0, vx, select(is1, vy, select(is2, vz, vw)));
+		const __m128 v1 = select(is0, vy, select(is1, vz, select(is2, vw, vx)));
+		const __m128 v2 = select(is0, vz, select(is1, vw, select(is2, vx, vy)));
+		const __m128 v3 = select(is0, vw, select(is1, vx, select(is2, vy, vz)));
+
+		// flip the sign so the dropped component is positive, then map [-0.707, 0.707] to [0, 1023]
+		const __m128 s = _mm_or_ps(_mm_and_ps(dropped, sign), _mm_set1_ps(kSqrtHalf * 1023.0f));
+		const __m128 bias = _mm_set1_ps(511.5f);
+		const __m128 hi = _mm_set1_ps(1023.0f);
+		const __m128i q1 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v1, s), bias), _mm_setzero_ps()), hi));
+		const __m128i q2 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v2, s), bias), _mm_setzero_ps()), hi));
+		const __m128i q3 = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v3, s), bias), _mm_setzero_ps()), hi));
+		const __m128i packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(largest, 30), _mm_slli_epi32(q1, 20)), _mm_or_si128(_mm_slli_epi32(q2, 10), q3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const float q[4] = { x[i], y[i], z[i], w[i] };
+		uint32_t largest = 0;
+		float maxAbs = std::fabs(q[0]);
+		for (uint32_t c = 1; c < 4; c++)
+		{
+			const float a = std::fabs(q[c]);
+			largest = a > maxAbs ? c : largest;
+			maxAbs = a > maxAbs ? a : maxAbs;
+		}
+		const float s = signNotZero(q[largest]) * kSqrtHalf * 1023.0f;
+
+		uint32_t bits = largest << 30;
+		for (uint32_t c = 1; c < 4; c++)
+		{
+			const float v = clampf(q[(largest + c) & 3] * s + 511.5f, 0.0f, 1023.0f);
+			bits |= uint32_t(std::lrint(v)) << (30 - 10 * c);
+		}
+		out[i] = bits;
+	}
+}
+
+void unpackQuaternion(uint32_t const* in, float* x, float* y, float* z, float* w, size_t count) noexcept
+{
+	const float scale = kSqrt2 / 1023.0f;
+	size_t i = 0;
+#if PACKING_SSE2
+	const __m128i mask = _mm_set1_epi32(0x3ff);
+	const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2), three = _mm_set1_epi32(3);
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i packed = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i));
+		const __m128i largest = _mm_srli_epi32(packed, 30);
+		const __m128 v1 = _mm_sub_ps(unormToFloat4(_mm_and_si128(_mm_srli_epi32(packed, 20), mask), scale), _mm_set1_ps(kSqrtHalf));
+		const __m128 v2 = _mm_sub_ps(unormToFloat4(_mm_and_si128(_mm_srli_epi32(packed, 10), mask), scale), _mm_set1_ps(kSqrtHalf));
+		const __m128 v3 = _mm_sub_ps(unormToFloat4(_mm_and_si128(packed, mask), scale), _mm_set1_ps(kSqrtHalf));
+		const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v1, v1), _mm_mul_ps(v2, v2)), _mm_mul_ps(v3, v3));
+		const __m128 dropped = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), sum), _mm_setzero_ps()));
+
+		// component k holds the dropped one when k == largest, otherwise v[(k - largest) & 3]
+		const __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+		const __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, one));
+		const __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, two));
+		const __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, three));
+		_mm_storeu_ps(x + i, select(is0, dropped, select(is1, v3, select(is2, v2, v1))));
+		_mm_storeu_ps(y + i, select(is1, dropped, select(is2, v3, select(is3, v2, v1))));
+		_mm_storeu_ps(z + i, select(is2, dropped, select(is3, v3, select(is0, v2, v1))));
+		_mm_storeu_ps(w + i, select(is3, dropped, select(is0, v3, select(is1, v2, v1))));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const uint32_t bits = in[i];
+		const uint32_t largest = bits >> 30;
+		float q[4];
+		float sum = 0.0f;
+		for (uint32_t c = 1; c < 4; c++)
+		{
+			const float v = float((bits >> (30 - 10 * c)) & 0x3ffu) * scale - kSqrtHalf;
+			q[(largest + c) & 3] = v;
+			sum += v * v;
+		}
+		q[largest] = std::sqrt(std::fmax(1.0f - sum, 0.0f));
+		x[i] = q[0];
+		y[i] = q[1];
+		z[i] = q[2];
+		w[i] = q[3];
+	}
+}
+
+void packUnorm1010102(float const* r, float const* g, float const* b, float const* a, uint32_t* out, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i qr = quantize(_mm_loadu_ps(r + i), 0.0f, 1.0f, 1023.0f);
+		const __m128i qg = quantize(_mm_loadu_ps(g + i), 0.0f, 1.0f, 1023.0f);
+		const __m128i qb = quantize(_mm_loadu_ps(b + i), 0.0f, 1.0f, 1023.0f);
+		const __m128i qa = quantize(_mm_loadu_ps(a + i), 0.0f, 1.0f, 3.0f);
+		const __m128i packed = _mm_or_si128(_mm_or_si128(qr, _mm_slli_epi32(qg, 10)), _mm_or_si128(_mm_slli_epi32(qb, 20), _mm_slli_epi32(qa, 30)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const uint32_t qr = uint32_t(std::lrint(clampf(r[i], 0.0f, 1.0f) * 1023.0f));
+		const uint32_t qg = uint32_t(std::lrint(clampf(g[i], 0.0f, 1.0f) * 1023.0f));
+		const uint32_t qb = uint32_t(std::lrint(clampf(b[i], 0.0f, 1.0f) * 1023.0f));
+		const uint32_t qa = uint32_t(std::lrint(clampf(a[i], 0.0f, 1.0f) * 3.0f));
+		out[i] = qr | (qg << 10) | (qb << 20) | (qa << 30);
+	}
+}
+
+void unpackUnorm1010102(uint32_t const* in, float* r, float* g, float* b, float* a, size_t count) noexcept
+{
+	size_t i = 0;
+#if PACKING_SSE2
+	const __m128i mask = _mm_set1_epi32(0x3ff);
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i packed = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i));
+		_mm_storeu_ps(r + i, unormToFloat4(_mm_and_si128(packed, mask), 1.0f / 1023.0f));
+		_mm_storeu_ps(g + i, unormToFloat4(_mm_and_si128(_mm_srli_epi32(packed, 10), mask), 1.0f / 1023.0f));
+		_mm_storeu_ps(b + i, unormToFloat4(_mm_and_si128(_mm_srli_epi32(packed, 20), mask), 1.0f / 1023.0f));
+		_mm_storeu_ps(a + i, unormToFloat4(_mm_srli_epi32(packed, 30), 1.0f / 3.0f));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const uint32_t bits = in[i];
+		r[i] = float(bits & 0x3ffu) * (1.0f / 1023.0f);
+		g[i] = float((bits >> 10) & 0x3ffu) * (1.0f / 1023.0f);
+		b[i] = float((bits >> 20) & 0x3ffu) * (1.0f / 1023.0f);
+		a[i] = float(bits >> 30) * (1.0f / 3.0f);
+	}
+}
+
+}
+}
+}
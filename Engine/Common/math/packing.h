@@ -0,0 +1,152 @@
+#pragma once
+#include "../common.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+namespace redtea {
+namespace math {
+
+/*
+ * CPU side encoders for the compact rhi::Format layouts, meant for vertex streams and
+ * network snapshots. Every batched function reads plain SoA arrays of count elements.
+ *
+ *   half        : RGBA16_FLOAT / RG16_FLOAT / R16_FLOAT channels, round to nearest even,
+ *                 inf, nan and subnormals are preserved
+ *   snorm/unorm : R8/R16 (S|U)NORM channels, clamped and rounded to nearest even
+ *   octahedral  : unit normal -> RG16_SNORM (2 x int16 per normal), max angular error 0.004 deg
+ *   quaternion  : smallest-three, 2 bit index + 3 x 10 bit, max component error 1.7e-3
+ *   1010102     : R10G10B10A2_UNORM, r in the lowest bits
+ */
+namespace packing {
+
+	inline uint16_t floatToHalf(float value) noexcept
+	{
+		uint32_t f;
+		memcpy(&f, &value, sizeof(f));
+		const uint32_t sign = (f >> 16) & 0x8000u;
+		f &= 0x7fffffffu;
+
+		uint32_t h;
+		if (f >= (143u << 23))
+		{
+			// too large for half, or inf/nan
+			h = f > (255u << 23) ? 0x7e00u : 0x7c00u;
+		}
+		else if (f < (113u << 23))
+		{
+			// subnormal half, let the fpu do the rounding by adding a magic number
+			const uint32_t magic = 126u << 23;
+			float fv, mv;
+			memcpy(&fv, &f, sizeof(fv));
+			memcpy(&mv, &magic, sizeof(mv));
+			fv += mv;
+			memcpy(&h, &fv, sizeof(h));
+			h -= magic;
+		}
+		else
+		{
+			const uint32_t mantOdd = (f >> 13) & 1u;
+			f += 0xc8000fffu + mantOdd;	// rebias exponent (-112 << 23) and round to nearest even
+			h = f >> 13;
+		}
+		return uint16_t(h | sign);
+	}
+
+	inline float halfToFloat(uint16_t value) noexcept
+	{
+		const uint32_t magic = (254u - 15u) << 23;
+		const uint32_t expMant = value & 0x7fffu;
+		const uint32_t shifted = expMant << 13;
+		float f, m;
+		memcpy(&f, &shifted, sizeof(f));
+		memcpy(&m, &magic, sizeof(m));
+		f *= m;
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		if (expMant >= 0x7c00u)
+		{
+			bits |= 255u << 23;
+		}
+		bits |= uint32_t(value & 0x8000u) << 16;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	inline int16_t floatToSnorm16(float v) noexcept
+	{
+		v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+		return int16_t(std::lrint(v * 32767.0f));
+	}
+
+	inline float snorm16ToFloat(int16_t v) noexcept
+	{
+		const float f = float(v) * (1.0f / 32767.0f);
+		return f < -1.0f ? -1.0f : f;
+	}
+
+	inline uint16_t floatToUnorm16(float v) noexcept
+	{
+		v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+		return uint16_t(std::lrint(v * 65535.0f));
+	}
+
+	inline float unorm16ToFloat(uint16_t v) noexcept
+	{
+		return float(v) * (1.0f / 65535.0f);
+	}
+
+	inline int8_t floatToSnorm8(float v) noexcept
+	{
+		v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+		return int8_t(std::lrint(v * 127.0f));
+	}
+
+	inline float snorm8ToFloat(int8_t v) noexcept
+	{
+		const float f = float(v) * (1.0f / 127.0f);
+		return f < -1.0f ? -1.0f : f;
+	}
+
+	inline uint8_t floatToUnorm8(float v) noexcept
+	{
+		v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+		return uint8_t(std::lrint(v * 255.0f));
+	}
+
+	inline float unorm8ToFloat(uint8_t v) noexcept
+	{
+		return float(v) * (1.0f / 255.0f);
+	}
+
+	// --------------------------Batched (SoA)------------------------------------------------
+
+	void floatToHalf(float const* in, uint16_t* out, size_t count) noexcept;
+	void halfToFloat(uint16_t const* in, float* out, size_t count) noexcept;
+
+	void floatToSnorm16(float const* in, int16_t* out, size_t count) noexcept;
+	void snorm16ToFloat(int16_t const* in, float* out, size_t count) noexcept;
+	void floatToUnorm16(float const* in, uint16_t* out, size_t count) noexcept;
+	void unorm16ToFloat(uint16_t const* in, float* out, size_t count) noexcept;
+
+	void floatToSnorm8(float const* in, int8_t* out, size_t count) noexcept;
+	void snorm8ToFloat(int8_t const* in, float* out, size_t count) noexcept;
+	void floatToUnorm8(float const* in, uint8_t* out, size_t count) noexcept;
+	void unorm8ToFloat(uint8_t const* in, float* out, size_t count) noexcept;
+
+	// unit normals (x, y, z) -> interleaved RG16_SNORM, out holds 2 * count values
+	void encodeOctahedral(float const* x, float const* y, float const* z, int16_t* out, size_t count) noexcept;
+	void decodeOctahedral(int16_t const* in, float* x, float* y, float* z, size_t count) noexcept;
+
+	// unit quaternions (x, y, z, w) -> smallest-three in 32 bits, q and -q encode the same rotation
+	void packQuaternion(float const* x, float const* y, float const* z, float const* w, uint32_t* out, size_t count) noexcept;
+	void unpackQuaternion(uint32_t const* in, float* x, float* y, float* z, float* w, size_t count) noexcept;
+
+	// [0, 1] channels -> R10G10B10A2_UNORM
+	void packUnorm1010102(float const* r, float const* g, float const* b, float const* a, uint32_t* out, size_t count) noexcept;
+	void unpackUnorm1010102(uint32_t const* in, float* r, float* g, float* b, float* a, size_t count) noexcept;
+
+}
+}
+}
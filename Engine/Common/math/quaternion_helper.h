@@ -1,5 +1,7 @@
 #pragma once
 #include "vector.h"
+#include <algorithm>
+#include <limits>
 
 namespace redtea {
 namespace math {
@@ -210,7 +212,7 @@ namespace math {
 				return normalize(lerp(d < 0 ? -p : p, q, t));
 			}
 			const T npq = std::sqrt(dot(p, p) * dot(q, q));  // ||p|| * ||q||
-			const T a = std::acos(filament::math::clamp(absd / npq, T(-1), T(1)));
+			const T a = std::acos(std::min(absd / npq, T(1)));
 			const T a0 = a * (1 - t);
 			const T a1 = a * t;
 			const T sina = sin(a);
@@ -0,0 +1,110 @@
+#include "arena.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace redtea
+{
+namespace common
+{
+	namespace
+	{
+		// blocks start with their link, padded so allocations stay aligned
+		static constexpr size_t kBlockHeader = alignof(std::max_align_t);
+
+		uint32_t SizeClass(size_t size) noexcept
+		{
+			uint32_t c = 0;
+			while ((size_t(1) << c) < size)
+			{
+				c++;
+			}
+			return c;
+		}
+	}
+
+	void* Arena::alloc(size_t size, size_t alignment)
+	{
+		assert(alignment <= kHeader);
+		const uint32_t c = std::max(SizeClass(size + kHeader), kMinClass);
+		assert(c < kClassCount);
+		const size_t slotSize = size_t(1) << c;
+
+		std::lock_guard<std::mutex> lock(mLock);
+		char* slot = static_cast<char*>(mFree[c]);
+		if (slot)
+		{
+			mFree[c] = *reinterpret_cast<void**>(slot);
+		}
+		else if (slotSize > mBlockSize / 4)
+		{
+			// large ones get a block of their own
+			slot = static_cast<char*>(newBlock(slotSize));
+		}
+		else
+		{
+			if (size_t(mEnd - mCursor) < slotSize)
+			{
+				// the rest of the current block is left unused
+				mCursor = static_cast<char*>(newBlock(mBlockSize));
+				mEnd = mCursor + mBlockSize;
+			}
+			slot = mCursor;
+			mCursor += slotSize;
+		}
+		*reinterpret_cast<uint32_t*>(slot) = c;
+		return slot + kHeader;
+	}
+
+	void Arena::free(void* p) noexcept
+	{
+		if (!p)
+		{
+			return;
+		}
+		char* slot = static_cast<char*>(p) - kHeader;
+		const uint32_t c = *reinterpret_cast<uint32_t*>(slot);
+		std::lock_guard<std::mutex> lock(mLock);
+		*reinterpret_cast<void**>(slot) = mFree[c];
+		mFree[c] = slot;
+	}
+
+	void Arena::release() noexcept
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		while (mBlocks)
+		{
+			Block* next = mBlocks->next;
+			GlobalAllocator::Instancing()->free(mBlocks);
+			mBlocks = next;
+		}
+		mCursor = mEnd = nullptr;
+		std::fill(std::begin(mFree), std::end(mFree), nullptr);
+		mReserved = 0;
+		mBlockCount = 0;
+	}
+
+	size_t Arena::getReservedSize() const noexcept
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		return mReserved;
+	}
+
+	size_t Arena::getBlockCount() const noexcept
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		return mBlockCount;
+	}
+
+	void* Arena::newBlock(size_t size)
+	{
+		char* memory = static_cast<char*>(GlobalAllocator::Instancing()->alloc(kBlockHeader + size));
+		Block* block = reinterpret_cast<Block*>(memory);
+		block->next = mBlocks;
+		mBlocks = block;
+		mReserved += kBlockHeader + size;
+		mBlockCount++;
+		return memory + kBlockHeader;
+	}
+}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "memory.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+
+namespace redtea
+{
+namespace common
+{
+	// Memory of one owner, such as a World. Allocations are carved out of large blocks, a
+	// freed one goes on a free list per power of two size and serves the next allocation
+	// of that size. Nothing goes back to the heap before release or destruction, which
+	// hand back whole blocks without visiting the allocations in them.
+	class Arena
+	{
+	public:
+		explicit Arena(size_t blockSize = size_t(1) << 18) noexcept : mBlockSize(blockSize) {}
+		~Arena() { release(); }
+
+		Arena(Arena const&) = delete;
+		Arena& operator=(Arena const&) = delete;
+
+		// alignment up to alignof(std::max_align_t)
+		void* alloc(size_t size, size_t alignment = alignof(std::max_align_t));
+		void free(void* p) noexcept;
+
+		// every allocation is gone at once, costs one heap free per block
+		void release() noexcept;
+
+		// bytes taken from the heap
+		size_t getReservedSize() const noexcept;
+		size_t getBlockCount() const noexcept;
+
+	private:
+		struct Block
+		{
+			Block* next;
+		};
+
+		// in front of every allocation, holding its size class
+		static constexpr size_t kHeader = alignof(std::max_align_t);
+		// 64 bytes
+		static constexpr uint32_t kMinClass = 6;
+		static constexpr uint32_t kClassCount = 64;
+
+		void* newBlock(size_t size);
+
+		mutable std::mutex mLock;
+		Block* mBlocks = nullptr;
+		char* mCursor = nullptr;
+		char* mEnd = nullptr;
+		void* mFree[kClassCount] = {};
+		size_t mBlockSize;
+		size_t mReserved = 0;
+		size_t mBlockCount = 0;
+	};
+
+	// allocator policy of StructureOfArraysBase, from an arena when one is set and from the
+	// heap otherwise
+	class ArenaAllocator
+	{
+	public:
+		ArenaAllocator(Arena* arena = nullptr) noexcept : mArena(arena) {}
+
+		void* alloc(size_t size, size_t alignment = alignof(std::max_align_t), size_t extra = 0)
+		{
+			return mArena ? mArena->alloc(size, alignment) : GlobalAllocator::Instancing()->alloc(size, alignment, extra);
+		}
+
+		void free(void* p) noexcept
+		{
+			if (mArena)
+			{
+				mArena->free(p);
+			}
+			else
+			{
+				GlobalAllocator::Instancing()->free(p);
+			}
+		}
+
+		Arena* getArena() const noexcept { return mArena; }
+
+	private:
+		Arena* mArena;
+	};
+
+	// the same for standard containers. The arena follows the contents on move and swap.
+	template<typename T>
+	class ArenaStlAllocator
+	{
+	public:
+		using value_type = T;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		ArenaStlAllocator(Arena* arena = nullptr) noexcept : mArena(arena) {}
+		template<typename U>
+		ArenaStlAllocator(ArenaStlAllocator<U> const& rhs) noexcept : mArena(rhs.getArena()) {}
+
+		T* allocate(size_t n)
+		{
+			static_assert(alignof(T) <= alignof(std::max_align_t), "over aligned");
+			return static_cast<T*>(ArenaAllocator(mArena).alloc(n * sizeof(T)));
+		}
+
+		void deallocate(T* p, size_t) noexcept
+		{
+			ArenaAllocator(mArena).free(p);
+		}
+
+		Arena* getArena() const noexcept { return mArena; }
+
+		template<typename U>
+		bool operator==(ArenaStlAllocator<U> const& rhs) const noexcept { return mArena == rhs.getArena(); }
+		template<typename U>
+		bool operator!=(ArenaStlAllocator<U> const& rhs) const noexcept { return mArena != rhs.getArena(); }
+
+	private:
+		Arena* mArena;
+	};
+}
+}
@@ -0,0 +1,105 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace redtea
+{
+namespace common
+{
+#if defined(_WIN32)
+	bool MappedFile::open(const char* path) noexcept
+	{
+		close();
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void const* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (!view)
+		{
+			if (mapping)
+			{
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			return false;
+		}
+		mFile = file;
+		mMapping = mapping;
+		mData = view;
+		mSize = size_t(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::close() noexcept
+	{
+		if (mData)
+		{
+			UnmapViewOfFile(mData);
+			CloseHandle(mMapping);
+			CloseHandle(mFile);
+		}
+		mData = nullptr;
+		mMapping = nullptr;
+		mFile = nullptr;
+		mSize = 0;
+	}
+#else
+	bool MappedFile::open(const char* path) noexcept
+	{
+		close();
+		const int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+		void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		// the mapping keeps the file alive
+		::close(fd);
+		if (view == MAP_FAILED)
+		{
+			return false;
+		}
+		madvise(view, size_t(info.st_size), MADV_SEQUENTIAL);
+		mData = view;
+		mSize = size_t(info.st_size);
+		return true;
+	}
+
+	void MappedFile::close() noexcept
+	{
+		if (mData)
+		{
+			munmap(const_cast<void*>(mData), mSize);
+		}
+		mData = nullptr;
+		mSize = 0;
+	}
+#endif
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "../common.h"
+#include <cstddef>
+
+namespace redtea
+{
+namespace common
+{
+	// Read only memory mapping of a whole file
+	class MappedFile
+	{
+	public:
+		MappedFile() noexcept = default;
+		~MappedFile() noexcept { close(); }
+
+		MappedFile(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+
+		// false when the file is missing, empty or cannot be mapped
+		bool open(const char* path) noexcept;
+		void close() noexcept;
+
+		void const* data() const noexcept { return mData; }
+		size_t size() const noexcept { return mSize; }
+
+	private:
+		void const* mData = nullptr;
+		size_t mSize = 0;
+#if defined(_WIN32)
+		void* mFile = nullptr;
+		void* mMapping = nullptr;
+#endif
+	};
+}
+}
@@ -21,18 +21,12 @@ namespace common
 	class GlobalAllocator : public AllocatorBase
 	{
 	public:
+		// worlds on different threads may get here first at once, a function local static
+		// is initialized exactly once
 		static inline GlobalAllocator* Instancing()
 		{
-			static GlobalAllocator* sharedAllocator = nullptr;
-			if (LIKELY(sharedAllocator))
-			{
-				return sharedAllocator;
-			}
-			else
-			{
-				sharedAllocator = new GlobalAllocator();
-				return sharedAllocator;
-			}
+			static GlobalAllocator sharedAllocator;
+			return &sharedAllocator;
 		}
 	};
 
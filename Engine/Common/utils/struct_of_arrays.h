@@ -260,6 +260,24 @@ public:
 		}
 	}
 
+	Allocator const& getAllocator() const noexcept
+	{
+		return mAllocator;
+	}
+
+	// moves the elements into a buffer of their size from allocator, which serves the
+	// array from then on
+	void setAllocator(Allocator const& allocator)
+	{
+		Allocator previous = mAllocator;
+		mAllocator = allocator;
+		void* buffer = mSize ? mAllocator.alloc(getNeededSize(mSize)) : nullptr;
+		move_each(buffer, mSize);
+		std::swap(buffer, mArrayOffset[0]);
+		previous.free(buffer);
+		mCapacity = mSize;
+	}
+
 	void resize(size_t needed)
 	{
 		ensureCapacity(needed);
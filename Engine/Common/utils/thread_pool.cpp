@@ -0,0 +1,69 @@
+#include "thread_pool.h"
+
+namespace redtea
+{
+namespace common
+{
+	ThreadPool::ThreadPool(uint32_t workerCount)
+	{
+		mWorkers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			mWorkers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mExit = true;
+		}
+		mCondition.notify_all();
+		for (auto& worker : mWorkers)
+		{
+			worker.join();
+		}
+	}
+
+	uint32_t ThreadPool::defaultWorkerCount() noexcept
+	{
+		const uint32_t cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 0;
+	}
+
+	void ThreadPool::submit(std::function<void()> task)
+	{
+		if (mWorkers.empty())
+		{
+			task();
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mTasks.emplace_back(std::move(task));
+		}
+		mCondition.notify_one();
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mLock);
+				mCondition.wait(lock, [this]() { return mExit || !mTasks.empty(); });
+				// drain the queue before leaving so submitted work is never dropped
+				if (mTasks.empty())
+				{
+					return;
+				}
+				task = std::move(mTasks.front());
+				mTasks.pop_front();
+			}
+			task();
+		}
+	}
+}
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "../common.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace redtea
+{
+namespace common
+{
+	// Fixed set of worker threads fed from one FIFO queue. The calling thread always takes
+	// part in parallelFor, so a pool with zero workers simply runs everything inline and
+	// parallelFor can be nested from inside a task.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(uint32_t workerCount = defaultWorkerCount());
+		~ThreadPool();
+
+		ThreadPool(ThreadPool const&) = delete;
+		ThreadPool& operator=(ThreadPool const&) = delete;
+
+		// one thread per core, minus the caller
+		static uint32_t defaultWorkerCount() noexcept;
+
+		uint32_t getWorkerCount() const noexcept { return uint32_t(mWorkers.size()); }
+
+		// fire and forget
+		void submit(std::function<void()> task);
+
+		// runs f(chunkBegin, chunkEnd) over [begin, end) in chunks of grain elements and
+		// returns once every chunk is done
+		template<typename F>
+		void parallelFor(size_t begin, size_t end, size_t grain, F&& f);
+
+	private:
+		struct ParallelForState
+		{
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> done{ 0 };
+			size_t chunkCount = 0;
+		};
+
+		void workerLoop();
+
+		std::vector<std::thread> mWorkers;
+		std::deque<std::function<void()>> mTasks;
+		std::mutex mLock;
+		std::condition_variable mCondition;
+		bool mExit = false;
+	};
+
+	template<typename F>
+	void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, F&& f)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+		grain = grain ? grain : 1;
+		const size_t chunkCount = (end - begin + grain - 1) / grain;
+		if (chunkCount == 1 || mWorkers.empty())
+		{
+			f(begin, end);
+			return;
+		}
+
+		// helpers that start after the last chunk was taken only touch the shared state,
+		// which keeps it alive, and never call f
+		auto state = std::make_shared<ParallelForState>();
+		state->chunkCount = chunkCount;
+		auto* fn = &f;
+		auto run = [state, fn, begin, end, grain]()
+		{
+			for (;;)
+			{
+				const size_t chunk = state->next.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= state->chunkCount)
+				{
+					return;
+				}
+				const size_t chunkBegin = begin + chunk * grain;
+				const size_t chunkEnd = chunkBegin + grain < end ? chunkBegin + grain : end;
+				(*fn)(chunkBegin, chunkEnd);
+				state->done.fetch_add(1, std::memory_order_release);
+			}
+		};
+
+		const size_t helpers = chunkCount - 1 < mWorkers.size() ? chunkCount - 1 : mWorkers.size();
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			for (size_t i = 0; i < helpers; i++)
+			{
+				mTasks.emplace_back(run);
+			}
+		}
+		mCondition.notify_all();
+
+		run();
+		while (state->done.load(std::memory_order_acquire) != chunkCount)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+}
@@ -0,0 +1,340 @@
+#include "broadphase.h"
+#include "spatial_index.h"
+#include "utils/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BROADPHASE_SSE2 1
+#include <emmintrin.h>
+#else
+#define BROADPHASE_SSE2 0
+#endif
+
+namespace redtea {
+namespace core {
+
+namespace {
+
+	// sentinels past the last box of a cell, enough for one 4 wide load from any box
+	static constexpr size_t kPadding = 4;
+	// a new sweep axis has to spread this much more than the current one, so a scene
+	// spread evenly does not flip between axes and lose its order every frame
+	static constexpr float kAxisHysteresis = 1.5f;
+	// cells are this many average boxes wide, most boxes land in one or two cells
+	static constexpr float kCellScale = 4.0f;
+	static constexpr uint32_t kMaxCellsPerAxis = 64;
+}
+
+void Broadphase::Update(BoundsManager const& bounds, common::ThreadPool* pool)
+{
+	const size_t count = bounds.GetComponentCount();
+	math::Aabb const* boxes = bounds.GetRawArray<BoundsManager::Bounds>();
+
+	// last order first, dropping the entities that lost their bounds, then the new ones
+	mSeen.assign(count + 1, 0);
+	mScratchEntities.clear();
+	mScratchRows.clear();
+	for (Entity e : mEntities)
+	{
+		const auto row = bounds.GetInstance(e);
+		if (row && !mSeen[row])
+		{
+			mSeen[row] = 1;
+			mScratchEntities.push_back(e);
+			mScratchRows.push_back(row);
+		}
+	}
+	const size_t kept = mScratchRows.size();
+	for (size_t r = 1; r <= count; r++)
+	{
+		if (!mSeen[r])
+		{
+			mScratchEntities.push_back(bounds.GetEntity(ComponentInstance::Type(r)));
+			mScratchRows.push_back(uint32_t(r));
+		}
+	}
+
+	// sweep along the axis the centers spread most along
+	double sum[3] = {};
+	double squares[3] = {};
+	for (size_t r = 1; r <= count; r++)
+	{
+		for (size_t a = 0; a < 3; a++)
+		{
+			const double c = 0.5 * (double(boxes[r].min[a]) + double(boxes[r].max[a]));
+			sum[a] += c;
+			squares[a] += c * c;
+		}
+	}
+	double variance[3];
+	for (size_t a = 0; a < 3; a++)
+	{
+		variance[a] = count ? squares[a] / double(count) - (sum[a] / double(count)) * (sum[a] / double(count)) : 0.0;
+	}
+	const uint32_t widest = variance[0] >= variance[1] && variance[0] >= variance[2] ? 0 : (variance[1] >= variance[2] ? 1 : 2);
+	const bool newAxis = variance[widest] > kAxisHysteresis * variance[mAxis];
+	if (newAxis)
+	{
+		mAxis = widest;
+	}
+
+	mItems.resize(count);
+	for (size_t k = 0; k < count; k++)
+	{
+		mItems[k] = { boxes[mScratchRows[k]].min[mAxis], uint32_t(k) };
+	}
+	Sort(kept, newAxis);
+
+	mEntities.resize(count);
+	mRows.resize(count);
+	for (size_t k = 0; k < count; k++)
+	{
+		mEntities[k] = mScratchEntities[mItems[k].slot];
+		mRows[k] = mScratchRows[mItems[k].slot];
+	}
+
+	BuildCells(bounds);
+
+	const uint32_t cells = GetCellCount();
+	size_t partitions = 1;
+	if (pool && count)
+	{
+		partitions = mPartitions ? mPartitions : 4 * (pool->getWorkerCount() + 1);
+		partitions = std::min<size_t>(partitions, cells);
+	}
+	mPartitionPairs.resize(std::max(partitions, mPartitionPairs.size()));
+	auto sweep = [&](size_t p)
+	{
+		mPartitionPairs[p].clear();
+		for (size_t c = cells * p / partitions; c < cells * (p + 1) / partitions; c++)
+		{
+			SweepCell(uint32_t(c), mPartitionPairs[p]);
+		}
+	};
+	if (partitions > 1)
+	{
+		pool->parallelFor(0, partitions, 1, [&](size_t first, size_t last)
+		{
+			for (size_t p = first; p < last; p++)
+			{
+				sweep(p);
+			}
+		});
+	}
+	else
+	{
+		sweep(0);
+	}
+
+	mPairs.clear();
+	for (size_t p = 0; p < partitions; p++)
+	{
+		mPairs.insert(mPairs.end(), mPartitionPairs[p].begin(), mPartitionPairs[p].end());
+	}
+}
+
+void Broadphase::Sort(size_t kept, bool newAxis)
+{
+	auto byKey = [](Item const& a, Item const& b) { return a.key < b.key; };
+	mSortMoves = 0;
+	if (newAxis)
+	{
+		std::sort(mItems.begin(), mItems.end(), byKey);
+		mSortMoves = mItems.size();
+		return;
+	}
+	// the old order is nearly sorted, each box moves past the few it overtook
+	for (size_t i = 1; i < kept; i++)
+	{
+		if (!(mItems[i].key < mItems[i - 1].key))
+		{
+			continue;
+		}
+		const Item item = mItems[i];
+		size_t j = i;
+		for (; j > 0 && item.key < mItems[j - 1].key; j--)
+		{
+			mItems[j] = mItems[j - 1];
+		}
+		mItems[j] = item;
+		mSortMoves += i - j;
+	}
+	// new boxes are sorted on their own and merged in
+	std::sort(mItems.begin() + kept, mItems.end(), byKey);
+	std::inplace_merge(mItems.begin(), mItems.begin() + kept, mItems.end(), byKey);
+	mSortMoves += mItems.size() - kept;
+}
+
+void Broadphase::BuildCells(BoundsManager const& bounds)
+{
+	const size_t count = mRows.size();
+	math::Aabb const* boxes = bounds.GetRawArray<BoundsManager::Bounds>();
+	const size_t axes[3] = { mAxis, (mAxis + 1) % 3, (mAxis + 2) % 3 };
+
+	// the grid spans the boxes on the two other axes, cells a few average boxes wide
+	for (size_t g = 0; g < 2; g++)
+	{
+		const size_t a = axes[g + 1];
+		float low = std::numeric_limits<float>::infinity();
+		float high = -std::numeric_limits<float>::infinity();
+		double size = 0.0;
+		for (size_t k = 0; k < count; k++)
+		{
+			math::Aabb const& box = boxes[mRows[k]];
+			low = std::min(low, box.min[a]);
+			high = std::max(high, box.max[a]);
+			size += double(box.max[a]) - double(box.min[a]);
+		}
+		const float span = high - low;
+		const float cellSize = count ? kCellScale * float(size / double(count)) : 0.0f;
+		uint32_t cells = 1;
+		if (span > 0.0f && cellSize > 0.0f && std::isfinite(span))
+		{
+			cells = uint32_t(std::min(std::ceil(span / cellSize), float(kMaxCellsPerAxis)));
+		}
+		mCells[g] = std::max(cells, 1u);
+		mCellOrigin[g] = count ? low : 0.0f;
+		mCellSize[g] = span > 0.0f && std::isfinite(span) ? span / float(mCells[g]) : 1.0f;
+	}
+
+	auto cellOf = [this](size_t g, float v)
+	{
+		const float c = (v - mCellOrigin[g]) / mCellSize[g];
+		return c <= 0.0f ? 0u : std::min(uint32_t(c), mCells[g] - 1);
+	};
+
+	// count the boxes of each cell, then deal them out in sweep order
+	const uint32_t cells = GetCellCount();
+	mCellStart.assign(cells + 1, 0);
+	for (size_t k = 0; k < count; k++)
+	{
+		math::Aabb const& box = boxes[mRows[k]];
+		const uint32_t u0 = cellOf(0, box.min[axes[1]]), u1 = cellOf(0, box.max[axes[1]]);
+		const uint32_t v0 = cellOf(1, box.min[axes[2]]), v1 = cellOf(1, box.max[axes[2]]);
+		for (uint32_t v = v0; v <= v1; v++)
+		{
+			for (uint32_t u = u0; u <= u1; u++)
+			{
+				mCellStart[v * mCells[0] + u + 1]++;
+			}
+		}
+	}
+	for (uint32_t c = 0; c < cells; c++)
+	{
+		mCellStart[c + 1] += mCellStart[c] + uint32_t(kPadding);
+	}
+	const size_t total = mCellStart[cells];
+	for (size_t a = 0; a < 3; a++)
+	{
+		mMin[a].resize(total);
+		mMax[a].resize(total);
+	}
+	mEntry.resize(total);
+
+	// the start of each cell walks forward as it fills, it ends on the padding
+	std::vector<uint32_t>& fill = mScratchRows;
+	fill.assign(mCellStart.begin(), mCellStart.end() - 1);
+	for (size_t k = 0; k < count; k++)
+	{
+		math::Aabb const& box = boxes[mRows[k]];
+		const uint32_t u0 = cellOf(0, box.min[axes[1]]), u1 = cellOf(0, box.max[axes[1]]);
+		const uint32_t v0 = cellOf(1, box.min[axes[2]]), v1 = cellOf(1, box.max[axes[2]]);
+		for (uint32_t v = v0; v <= v1; v++)
+		{
+			for (uint32_t u = u0; u <= u1; u++)
+			{
+				const uint32_t slot = fill[v * mCells[0] + u]++;
+				for (size_t a = 0; a < 3; a++)
+				{
+					mMin[a][slot] = box.min[axes[a]];
+					mMax[a][slot] = box.max[axes[a]];
+				}
+				mEntry[slot] = uint32_t(k);
+			}
+		}
+	}
+	for (uint32_t c = 0; c < cells; c++)
+	{
+		for (size_t a = 0; a < 3; a++)
+		{
+			std::fill(mMin[a].begin() + fill[c], mMin[a].begin() + fill[c] + kPadding, std::numeric_limits<float>::infinity());
+			std::fill(mMax[a].begin() + fill[c], mMax[a].begin() + fill[c] + kPadding, -std::numeric_limits<float>::infinity());
+		}
+	}
+}
+
+void Broadphase::SweepCell(uint32_t cell, std::vector<Pair>& pairs) const
+{
+	const size_t first = mCellStart[cell];
+	const size_t last = mCellStart[cell + 1] - kPadding;
+	float const* minX = mMin[0].data();
+	float const* maxX = mMax[0].data();
+	float const* minY = mMin[1].data();
+	float const* maxY = mMax[1].data();
+	float const* minZ = mMin[2].data();
+	float const* maxZ = mMax[2].data();
+
+	// a pair found in several cells is reported by the one holding the low corner of its
+	// overlap, which is in both boxes so every cell holding it holds both
+	const uint32_t cellU = cell % mCells[0];
+	const uint32_t cellV = cell / mCells[0];
+	auto report = [&](size_t i, size_t j)
+	{
+		const float u = (std::max(minY[i], minY[j]) - mCellOrigin[0]) / mCellSize[0];
+		const float v = (std::max(minZ[i], minZ[j]) - mCellOrigin[1]) / mCellSize[1];
+		if ((u <= 0.0f ? 0u : std::min(uint32_t(u), mCells[0] - 1)) == cellU
+			&& (v <= 0.0f ? 0u : std::min(uint32_t(v), mCells[1] - 1)) == cellV)
+		{
+			pairs.push_back({ mEntities[mEntry[i]], mEntities[mEntry[j]] });
+		}
+	};
+
+	for (size_t i = first; i < last; i++)
+	{
+		// candidates start at or after the minimum of i, they overlap on the sweep axis
+		// while they start before its maximum
+#if BROADPHASE_SSE2
+		const __m128 endX = _mm_set1_ps(maxX[i]);
+		const __m128 lowY = _mm_set1_ps(minY[i]);
+		const __m128 highY = _mm_set1_ps(maxY[i]);
+		const __m128 lowZ = _mm_set1_ps(minZ[i]);
+		const __m128 highZ = _mm_set1_ps(maxZ[i]);
+		for (size_t j = i + 1;; j += 4)
+		{
+			const __m128 inX = _mm_cmple_ps(_mm_loadu_ps(minX + j), endX);
+			const int inRange = _mm_movemask_ps(inX);
+			if (!inRange)
+			{
+				break;
+			}
+			const __m128 inY = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minY + j), highY), _mm_cmpge_ps(_mm_loadu_ps(maxY + j), lowY));
+			const __m128 inZ = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minZ + j), highZ), _mm_cmpge_ps(_mm_loadu_ps(maxZ + j), lowZ));
+			const int overlap = _mm_movemask_ps(_mm_and_ps(inX, _mm_and_ps(inY, inZ)));
+			for (size_t b = 0; overlap >> b; b++)
+			{
+				if ((overlap >> b) & 1)
+				{
+					report(i, j + b);
+				}
+			}
+			if (inRange != 0xF)
+			{
+				break;
+			}
+		}
+#else
+		for (size_t j = i + 1; minX[j] <= maxX[i]; j++)
+		{
+			if (minY[j] <= maxY[i] && maxY[j] >= minY[i] && minZ[j] <= maxZ[i] && maxZ[j] >= minZ[i])
+			{
+				report(i, j);
+			}
+		}
+#endif
+	}
+}
+
+}
+}
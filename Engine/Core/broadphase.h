@@ -0,0 +1,85 @@
+#pragma once
+#include "entity.h"
+#include <cstdint>
+#include <vector>
+
+namespace redtea {
+namespace common {
+	class ThreadPool;
+}
+namespace core {
+
+	class BoundsManager;
+
+	// Sweep and prune over the rows of a BoundsManager. The boxes are kept sorted by their
+	// minimum on the axis their centers spread most along; the order of the last update
+	// is the starting point of the next, so an insertion sort only pays for the boxes that
+	// passed each other.
+	//
+	// The other two axes are cut into a grid of cells a few boxes wide. Boxes are dealt
+	// into every cell they touch in sweep order, which leaves each cell sorted, and each
+	// cell is swept on its own testing four candidates at a time. A pair is reported by
+	// the cell holding the low corner of its overlap only. Cells are independent, with a
+	// pool they are swept in parallel.
+	class Broadphase
+	{
+	public:
+		struct Pair
+		{
+			Entity a;
+			Entity b;
+		};
+
+		// all overlapping pairs, each once. Same input, same order.
+		void Update(BoundsManager const& bounds, common::ThreadPool* pool = nullptr);
+
+		std::vector<Pair> const& GetPairs() const noexcept { return mPairs; }
+
+		// groups of cells per update when a pool is given, 0 picks a few per thread
+		void SetPartitionCount(uint32_t count) noexcept { mPartitions = count; }
+
+		// 0 for x, of the last update
+		uint32_t GetAxis() const noexcept { return mAxis; }
+		// of the last update
+		uint32_t GetCellCount() const noexcept { return mCells[0] * mCells[1]; }
+		// moves made by the last sort, near zero for a scene at rest
+		size_t GetSortMoves() const noexcept { return mSortMoves; }
+
+	private:
+		struct Item
+		{
+			float key;
+			uint32_t slot;
+		};
+
+		void Sort(size_t kept, bool newAxis);
+		void BuildCells(BoundsManager const& bounds);
+		void SweepCell(uint32_t cell, std::vector<Pair>& pairs) const;
+
+		// sweep order as of the last update
+		std::vector<Entity> mEntities;
+		std::vector<uint32_t> mRows;
+		std::vector<Entity> mScratchEntities;
+		std::vector<uint32_t> mScratchRows;
+		std::vector<Item> mItems;
+		std::vector<uint8_t> mSeen;
+
+		// the boxes of each cell in sweep order, the sweep axis first, followed by
+		// sentinels for 4 wide loads. Entries point back into the sweep order.
+		std::vector<uint32_t> mCellStart;
+		std::vector<float> mMin[3];
+		std::vector<float> mMax[3];
+		std::vector<uint32_t> mEntry;
+		uint32_t mCells[2] = { 1, 1 };
+		float mCellOrigin[2] = {};
+		float mCellSize[2] = { 1.0f, 1.0f };
+
+		std::vector<std::vector<Pair>> mPartitionPairs;
+		std::vector<Pair> mPairs;
+		uint32_t mAxis = 0;
+		uint32_t mPartitions = 0;
+		size_t mSortMoves = 0;
+	};
+
+}
+}
@@ -1,22 +1,123 @@
 #pragma once
+#include "utils/arena.h"
 #include "utils/struct_of_arrays.h"
 #include "entity.h"
+#include "entity_events.h"
 #include "component.h"
-#include <unordered_map>
+#include "entity_manager.h"
+#include "entity_mask.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 
 namespace redtea {
 namespace core {
 
+// one component column as stored in a snapshot
+struct SnapshotColumn
+{
+	uint32_t elementSize;
+	uint32_t alignment;
+};
+
+// Type erased view of a manager for code that deals with all of them at once, such as
+// entity destruction and command buffer playback. A registered manager unregisters itself
+// from its EntityManager when destroyed.
+class IComponentManager
+{
+public:
+	using Instance = ComponentInstance::Type;
+
+	virtual ~IComponentManager()
+	{
+		if (mEntityManager)
+		{
+			mEntityManager->ForgetComponentManager(this);
+		}
+	}
+
+	// entities that already have the component are skipped
+	virtual void AddComponents(Entity const* entities, size_t count) = 0;
+
+	// entities without the component are skipped
+	virtual void RemoveComponents(Entity const* entities, size_t count) = 0;
+
+	// removes every component whose entity is in dying, meant for large groups such as a
+	// whole section, costs one pass over all rows
+	virtual void RemoveComponents(EntityMask const& dying) = 0;
+
+	virtual size_t GetComponentCount() const noexcept = 0;
+
+	// drops every row at once, the version counter keeps going. Reported as removals.
+	virtual void ClearComponents() = 0;
+
+	// moves the rows and their index into storage from arena, or from the heap when null.
+	// The EntityManager of a World sets its arena on registration and resets it on removal.
+	virtual void SetArena(common::Arena* arena) = 0;
+
+	// moves every row of source, a manager of the same type, to the end of this one and
+	// leaves source empty
+	virtual void AppendComponents(IComponentManager& source) = 0;
+
+	virtual Instance GetInstance(Entity e) const noexcept = 0;
+	virtual Entity GetEntity(Instance i) const noexcept = 0;
+
+	// snapshot support, see snapshot.h. The layout covers the component columns only and
+	// is false when some component cannot be copied as raw bytes.
+	virtual bool GetSnapshotLayout(std::vector<SnapshotColumn>& columns) const = 0;
+	// raw bytes of one column for the given rows, or for every row in order when rows is null
+	virtual void SaveColumn(size_t column, Instance const* rows, size_t count, void* out) const = 0;
+	// checks rows read from a file before they are loaded, such as links between them
+	virtual bool CheckRows(size_t count, void const* const* columns) const = 0;
+	// fills an empty manager with count rows, one raw block per column. False, leaving the
+	// manager empty, when CheckRows fails.
+	virtual bool LoadRows(Entity const* entities, size_t count, void const* const* columns) = 0;
+	// appends copies of rowCount template rows, one raw block per column as written by
+	// SaveColumn. Row t of copy k belongs to entities[k * rowCount + t].
+	virtual void InstantiateRows(Entity const* entities, size_t copies, size_t rowCount, void const* const* columns) = 0;
+
+protected:
+	// somebody listens to the lifecycle events of this manager
+	bool IsObserved() const noexcept
+	{
+		return mEntityManager && mEntityManager->GetEventBus();
+	}
+
+	void Emit(EntityEvent type, Entity const* entities, size_t count)
+	{
+		if (IsObserved())
+		{
+			mEntityManager->GetEventBus()->Record(type, this, entities, count);
+		}
+	}
+
+private:
+	friend class EntityManager;
+	EntityManager* mEntityManager = nullptr;
+};
+
 template <typename ... Elements>
-class  ComponentManagerBase
+class  ComponentManagerBase : public IComponentManager
 {
 protected:
 	static constexpr size_t ENTITY_INDEX = sizeof ... (Elements);	
+	static constexpr size_t VERSION_INDEX = ENTITY_INDEX + 1;
+	// rows sharing one chunk version, 64
+	static constexpr size_t CHUNK_SHIFT = 6;
 protected:
-	using SoA = common::StructureOfArrays<Elements ..., Entity>;
+	using SoA = common::StructureOfArraysBase<common::ArenaAllocator, Elements ..., Entity, uint32_t>;
 	using Instance = ComponentInstance::Type;
 	SoA mData;
-	std::unordered_map<Entity, Instance> mInstanceMap;
+	// row of every entity indexed by entity id, 0 when it has no component. Ids are dense
+	// since the EntityManager recycles them, and a flat table lets bulk operations rewrite
+	// the index with plain sequential stores.
+	std::vector<Instance, common::ArenaStlAllocator<Instance>> mInstanceMap;
+	// highest version written to each chunk of rows
+	std::vector<uint32_t, common::ArenaStlAllocator<uint32_t>> mChunkVersions;
+	uint32_t mVersion = 1;
 
 public:
 	ComponentManagerBase() noexcept
@@ -33,11 +134,10 @@ public:
 	ComponentManagerBase(ComponentManagerBase const& rhs) = delete;
 	ComponentManagerBase& operator=(ComponentManagerBase const& rhs) = delete;
 
-	Instance GetInstance(Entity e) const noexcept
+	Instance GetInstance(Entity e) const noexcept override
 	{
-		auto const& map = mInstanceMap;
-		auto pos = map.find(e);
-		return pos != map.end() ? pos->second : 0;
+		const size_t id = e.GetId();
+		return id < mInstanceMap.size() ? mInstanceMap[id] : 0;
 	}
 
 	bool HasComponent(Entity e) const noexcept
@@ -45,7 +145,7 @@ public:
 		return GetInstance(e) != 0;
 	}
 
-	size_t GetComponentCount() const noexcept
+	size_t GetComponentCount() const noexcept override
 	{
 		// 1..size - 1
 		return mData.size() - 1;
@@ -55,16 +155,97 @@ public:
 
 	inline Instance RemoveComponent(Entity e);
 
+	void AddComponents(Entity const* entities, size_t count) override;
+
+	// one pass over the dying rows, each hole is filled with the last live row
+	void RemoveComponents(Entity const* entities, size_t count) override;
+
+	// survivors keep their order
+	void RemoveComponents(EntityMask const& dying) override;
+
+	// one move per column, then the index and versions of the new rows
+	void AppendComponents(IComponentManager& source) override;
+
+	void ClearComponents() override
+	{
+		Emit(EntityEvent::ComponentRemoved, data<ENTITY_INDEX>() + 1, GetComponentCount());
+		ClearRows();
+	}
+
+	void SetArena(common::Arena* arena) override
+	{
+		mData.setAllocator(common::ArenaAllocator(arena));
+		mInstanceMap = decltype(mInstanceMap)(mInstanceMap.begin(), mInstanceMap.end(), arena);
+		mChunkVersions = decltype(mChunkVersions)(mChunkVersions.begin(), mChunkVersions.end(), arena);
+	}
+
+	bool GetSnapshotLayout(std::vector<SnapshotColumn>& columns) const override
+	{
+		columns = { SnapshotColumn{ uint32_t(sizeof(Elements)), uint32_t(alignof(Elements)) }... };
+		return (std::is_trivially_copyable<Elements>::value && ...);
+	}
+
+	void SaveColumn(size_t column, Instance const* rows, size_t count, void* out) const override
+	{
+		SaveColumnAt(column, rows, count, out, std::index_sequence_for<Elements...>());
+	}
+
+	// raw bytes of trivially copyable columns are always valid rows
+	bool CheckRows(size_t, void const* const*) const override
+	{
+		return true;
+	}
+
+	bool LoadRows(Entity const* entities, size_t count, void const* const* columns) override;
+
+	// reserves once and fills every column in bulk, the index grows at most once
+	void InstantiateRows(Entity const* entities, size_t copies, size_t rowCount, void const* const* columns) override;
+
 	bool Empty() const noexcept
 	{
 		return GetComponentCount() == 0;
 	}
 
-	Entity GetEntity(Instance i) const noexcept 
+	Entity GetEntity(Instance i) const noexcept override
 	{
 		return GetElement<ENTITY_INDEX>(i);
 	}
 
+	// Change versions. Writes through a Field and MarkChanged stamp the row and its chunk
+	// with the current version, raw access through GetElement does not. A consumer closes
+	// the current version with NewVersion() and passes the returned value to ForEachChanged
+	// next time to visit only the rows written since:
+	//
+	//     uint32_t since = mSeen;
+	//     mSeen = manager.NewVersion();
+	//     manager.ForEachChanged(since, [](Instance i) { ... });
+	uint32_t GetVersion() const noexcept
+	{
+		return mVersion;
+	}
+
+	uint32_t NewVersion() noexcept
+	{
+		return mVersion++;
+	}
+
+	uint32_t GetChangeVersion(Instance i) const noexcept
+	{
+		return GetElement<VERSION_INDEX>(i);
+	}
+
+	// rows of different threads may be marked concurrently, they only ever store mVersion
+	void MarkChanged(Instance i) noexcept
+	{
+		assert(i);
+		data<VERSION_INDEX>()[i] = mVersion;
+		mChunkVersions[i >> CHUNK_SHIFT] = mVersion;
+	}
+
+	// calls f(Instance) for every row written after since, skipping unchanged chunks
+	template<typename F>
+	void ForEachChanged(uint32_t since, F&& f) const;
+
 
 	// InstanceSOAõNԪ
 	template<size_t ElementIndex>
@@ -87,12 +268,76 @@ public:
 		return data<ElementIndex>();
 	}
 
+	// Same layout as ProxyBase so both can share the proxy union. Non-const access counts
+	// as a write and stamps the row, const access does not.
 	template<size_t E>
-	struct Field : public SoA::template Field<E, Instance> 
+	struct Field
 	{
-		Field(ComponentManagerBase& soa, Instance i) noexcept
-			: SoA::template Field<E, Instance>{ soa.mData, i } {}
-		using SoA::template Field<E, Instance>::operator =;
+		using Type = typename SoA::template TypeAt<E>;
+		ComponentManagerBase& manager;
+		Instance i;
+
+		Field(ComponentManagerBase& m, Instance index) noexcept
+			: manager(m), i(index) {}
+
+		inline Field& operator = (Field&& rhs) noexcept {
+			Write() = rhs.Read();
+			return *this;
+		}
+
+		// auto-conversion to the field's type
+		inline operator Type&() noexcept {
+			return Write();
+		}
+		inline operator Type const&() const noexcept {
+			return Read();
+		}
+		// dereferencing the selected field
+		inline Type& operator ->() noexcept {
+			return Write();
+		}
+		inline Type const& operator ->() const noexcept {
+			return Read();
+		}
+		// address-of the selected field
+		inline Type* operator &() noexcept {
+			return &Write();
+		}
+		inline Type const* operator &() const noexcept {
+			return &Read();
+		}
+		// assignment to the field
+		inline Type const& operator = (Type const& other) noexcept {
+			return (Write() = other);
+		}
+		inline Type const& operator = (Type&& other) noexcept {
+			return (Write() = std::move(other));
+		}
+		// comparisons
+		inline bool operator==(Type const& other) const {
+			return (Read() == other);
+		}
+		inline bool operator!=(Type const& other) const {
+			return (Read() != other);
+		}
+		// calling the field
+		template <typename ... ARGS>
+		inline decltype(auto) operator()(ARGS&& ... args) noexcept {
+			return Write()(std::forward<ARGS>(args)...);
+		}
+		template <typename ... ARGS>
+		inline decltype(auto) operator()(ARGS&& ... args) const noexcept {
+			return Read()(std::forward<ARGS>(args)...);
+		}
+
+	private:
+		inline Type& Write() noexcept {
+			manager.MarkChanged(i);
+			return manager.template data<E>()[i];
+		}
+		inline Type const& Read() const noexcept {
+			return manager.template data<E>()[i];
+		}
 	};
 
 	struct ProxyBase
@@ -117,6 +362,126 @@ protected:
 		return mData.template data<ElementIndex>();
 	}
 
+	// stable compaction dropping the rows of dying entities, survivors are marked changed
+	// when they move. remap receives the new row of every old row, 0 for a removed one.
+	// Returns the number of rows removed.
+	size_t CompactRows(EntityMask const& dying, std::vector<Instance>& remap);
+
+	// moves count rows of from, starting at row first, over the rows of this manager
+	// starting at row to, entities and versions included
+	void MoveRows(ComponentManagerBase& from, size_t first, size_t to, size_t count)
+	{
+		MoveColumns(from, first, to, count, std::make_index_sequence<VERSION_INDEX + 1>());
+	}
+
+	// grows or shrinks mData, keeping one chunk version per CHUNK_SHIFT rows
+	void ResizeRows(size_t size)
+	{
+		mData.resize(size);
+		mChunkVersions.resize((size + (size_t(1) << CHUNK_SHIFT) - 1) >> CHUNK_SHIFT);
+	}
+
+	// back to the state of a new manager, the version counter keeps going
+	void ClearRows()
+	{
+		ResizeRows(1);
+		mInstanceMap.clear();
+	}
+
+	void SetInstance(Entity e, Instance i)
+	{
+		const size_t id = e.GetId();
+		if (id >= mInstanceMap.size())
+		{
+			mInstanceMap.resize(std::max(id + 1, mInstanceMap.size() * 2), 0);
+		}
+		mInstanceMap[id] = i;
+	}
+
+	template<size_t ... Is>
+	void SaveColumnAt(size_t column, Instance const* rows, size_t count, void* out, std::index_sequence<Is...>) const
+	{
+		((column == Is ? CopyColumnOut<Is>(rows, count, out) : void()), ...);
+	}
+
+	template<size_t I>
+	void CopyColumnOut(Instance const* rows, size_t count, void* out) const
+	{
+		using T = typename SoA::template TypeAt<I>;
+		if constexpr (std::is_trivially_copyable<T>::value)
+		{
+			T const* src = data<I>();
+			if (!rows)
+			{
+				std::memcpy(out, src + 1, count * sizeof(T));
+				return;
+			}
+			char* dst = static_cast<char*>(out);
+			for (size_t n = 0; n < count; n++)
+			{
+				std::memcpy(dst + n * sizeof(T), src + rows[n], sizeof(T));
+			}
+		}
+	}
+
+	template<size_t ... Is>
+	void FillColumns(void const* const* columns, size_t first, size_t copies, size_t rowCount, std::index_sequence<Is...>)
+	{
+		(FillColumn<Is>(columns[Is], first, copies, rowCount), ...);
+	}
+
+	template<size_t I>
+	void FillColumn(void const* in, size_t first, size_t copies, size_t rowCount)
+	{
+		using T = typename SoA::template TypeAt<I>;
+		if constexpr (std::is_trivially_copyable<T>::value)
+		{
+			T* dst = data<I>() + first;
+			if (rowCount == 1 && copies > 1)
+			{
+				T value;
+				std::memcpy(&value, in, sizeof(T));
+				std::fill_n(dst, copies, value);
+				return;
+			}
+			for (size_t k = 0; k < copies; k++)
+			{
+				std::memcpy(dst + k * rowCount, in, rowCount * sizeof(T));
+			}
+		}
+	}
+
+	// untyped access to a column for code that works with the snapshot layout
+	void* ColumnData(size_t column) noexcept
+	{
+		return ColumnDataAt(column, std::make_index_sequence<VERSION_INDEX + 1>());
+	}
+
+	template<size_t ... Is>
+	void* ColumnDataAt(size_t column, std::index_sequence<Is...>) noexcept
+	{
+		void* p = nullptr;
+		((p = column == Is ? static_cast<void*>(data<Is>()) : p), ...);
+		return p;
+	}
+
+	template<size_t ... Is>
+	void MoveColumns(ComponentManagerBase& from, size_t first, size_t to, size_t count, std::index_sequence<Is...>)
+	{
+		(std::move(from.template data<Is>() + first, from.template data<Is>() + first + count, data<Is>() + to), ...);
+	}
+
+	// appends a row for e and marks it changed
+	Instance PushRow(Entity e)
+	{
+		mData.push_back().template back<ENTITY_INDEX>() = e;
+		const Instance ci = Instance(mData.size() - 1);
+		SetInstance(e, ci);
+		mChunkVersions.resize((mData.size() + (size_t(1) << CHUNK_SHIFT) - 1) >> CHUNK_SHIFT);
+		MarkChanged(ci);
+		return ci;
+	}
+
 };
 
 template<typename ... Elements>
@@ -126,13 +491,12 @@ ComponentManagerBase<Elements ...>::AddComponent(Entity e)
 	Instance ci = 0;
 	if (!HasComponent(e)) {
 		// һ
-		mData.push_back().template back<ENTITY_INDEX>() = e;
-		ci = Instance(mData.size() - 1);
-		mInstanceMap[e] = ci;
+		ci = PushRow(e);
+		Emit(EntityEvent::ComponentAdded, &e, 1);
 	}
 	else {
 		// ֧EntityӦComponent
-		ci = mInstanceMap[e];
+		ci = GetInstance(e);
 	}
 	assert(ci != 0);
 	return ci;
@@ -142,12 +506,9 @@ template <typename ... Elements>
 typename ComponentManagerBase<Elements ...>::Instance
 ComponentManagerBase<Elements ... >::RemoveComponent(Entity e)
 {
-	auto& map = mInstanceMap;
-	auto pos = map.find(e);
-	if (LIKELY(pos != map.end()))
+	const size_t index = GetInstance(e);
+	if (LIKELY(index != 0))
 	{
-		size_t index = pos->second;
-		assert(index != 0);
 		size_t last = mData.size() - 1;
 		if (last != index) {
 			// ƶһEntity䱻ɾ
@@ -158,15 +519,252 @@ ComponentManagerBase<Elements ... >::RemoveComponent(Entity e)
 
 			Entity lastEntity = mData.template elementAt<ENTITY_INDEX>(index);
 			// Instance
-			map[lastEntity] = index;
+			mInstanceMap[lastEntity.GetId()] = Instance(index);
+			MarkChanged(Instance(index));
 		}
 		mData.pop_back();
-		map.erase(pos);
+		mInstanceMap[e.GetId()] = 0;
+		Emit(EntityEvent::ComponentRemoved, &e, 1);
 		return last;
 	}
 	return 0;
 }
 
+template<typename ... Elements>
+void ComponentManagerBase<Elements ...>::AddComponents(Entity const* entities, size_t count)
+{
+	mData.ensureCapacity(mData.size() + count);
+	const size_t first = mData.size();
+	for (size_t n = 0; n < count; n++)
+	{
+		if (!HasComponent(entities[n]))
+		{
+			PushRow(entities[n]);
+		}
+	}
+	// the new rows are the last ones, reported as one block
+	Emit(EntityEvent::ComponentAdded, data<ENTITY_INDEX>() + first, mData.size() - first);
+}
+
+template<typename ... Elements>
+void ComponentManagerBase<Elements ...>::RemoveComponents(Entity const* entities, size_t count)
+{
+	std::vector<Instance> rows;
+	rows.reserve(count);
+	for (size_t n = 0; n < count; n++)
+	{
+		const Instance i = GetInstance(entities[n]);
+		if (i)
+		{
+			rows.push_back(i);
+			mInstanceMap[entities[n].GetId()] = 0;
+		}
+	}
+	if (IsObserved())
+	{
+		std::vector<Entity> removed;
+		removed.reserve(rows.size());
+		for (Instance i : rows)
+		{
+			removed.push_back(GetEntity(i));
+		}
+		Emit(EntityEvent::ComponentRemoved, removed.data(), removed.size());
+	}
+	std::sort(rows.begin(), rows.end());
+
+	// walk the holes upwards while taking live rows from the end, dying rows already at the
+	// end are simply dropped
+	size_t end = mData.size();
+	size_t hi = rows.size();
+	for (size_t lo = 0; lo < hi; lo++)
+	{
+		while (hi > lo && rows[hi - 1] == end - 1)
+		{
+			hi--;
+			end--;
+		}
+		if (lo == hi)
+		{
+			break;
+		}
+		const size_t hole = rows[lo];
+		const size_t last = --end;
+		mData.forEach([hole, last](auto* p)
+		{
+			p[hole] = std::move(p[last]);
+		});
+		mInstanceMap[mData.template elementAt<ENTITY_INDEX>(hole).GetId()] = Instance(hole);
+		MarkChanged(Instance(hole));
+	}
+	mData.resize(end);
+}
+
+template<typename ... Elements>
+void ComponentManagerBase<Elements ...>::RemoveComponents(EntityMask const& dying)
+{
+	std::vector<Instance> remap;
+	CompactRows(dying, remap);
+}
+
+template<typename ... Elements>
+void ComponentManagerBase<Elements ...>::AppendComponents(IComponentManager& source)
+{
+	assert(typeid(*this) == typeid(source));
+	auto& from = static_cast<ComponentManagerBase&>(source);
+	const size_t count = from.GetComponentCount();
+	if (!count)
+	{
+		return;
+	}
+	const size_t first = mData.size();
+	ResizeRows(first + count);
+	MoveRows(from, 1, first, count);
+
+	// the index of source already covers every staged id, so this one grows at most once.
+	// Live rows are not touched, the new ones are stamped in bulk.
+	if (from.mInstanceMap.size() > mInstanceMap.size())
+	{
+		mInstanceMap.resize(from.mInstanceMap.size(), 0);
+	}
+	from.ClearComponents();
+	Entity const* entities = data<ENTITY_INDEX>();
+	for (size_t r = first; r < first + count; r++)
+	{
+		mInstanceMap[entities[r].GetId()] = Instance(r);
+	}
+	std::fill_n(data<VERSION_INDEX>() + first, count, mVersion);
+	std::fill(mChunkVersions.begin() + (first >> CHUNK_SHIFT), mChunkVersions.end(), mVersion);
+	Emit(EntityEvent::ComponentAdded, entities + first, count);
+}
+
+template<typename ... Elements>
+bool ComponentManagerBase<Elements ...>::LoadRows(Entity const* entities, size_t count, void const* const* columns)
+{
+	assert(GetComponentCount() == 0);
+	if (!CheckRows(count, columns))
+	{
+		return false;
+	}
+	ComponentManagerBase::InstantiateRows(entities, 1, count, columns);
+	return true;
+}
+
+template<typename ... Elements>
+void ComponentManagerBase<Elements ...>::InstantiateRows(Entity const* entities, size_t copies, size_t rowCount, void const* const* columns)
+{
+	const size_t first = mData.size();
+	const size_t count = copies * rowCount;
+	ResizeRows(first + count);
+	FillColumns(columns, first, copies, rowCount, std::index_sequence_for<Elements...>());
+
+	size_t maxId = 0;
+	for (size_t n = 0; n < count; n++)
+	{
+		maxId = std::max<size_t>(maxId, entities[n].GetId());
+	}
+	if (count && maxId >= mInstanceMap.size())
+	{
+		mInstanceMap.resize(maxId + 1, 0);
+	}
+	Entity* rows = data<ENTITY_INDEX>();
+	uint32_t* versions = data<VERSION_INDEX>();
+	for (size_t n = 0; n < count; n++)
+	{
+		const size_t r = first + n;
+		rows[r] = entities[n];
+		mInstanceMap[entities[n].GetId()] = Instance(r);
+		// every row is new
+		versions[r] = mVersion;
+		mChunkVersions[r >> CHUNK_SHIFT] = mVersion;
+	}
+	Emit(EntityEvent::ComponentAdded, entities, count);
+}
+
+template<typename ... Elements>
+size_t ComponentManagerBase<Elements ...>::CompactRows(EntityMask const& dying, std::vector<Instance>& remap)
+{
+	const size_t size = mData.size();
+	Entity const* entities = data<ENTITY_INDEX>();
+	remap.assign(size, 0);
+
+	size_t removed = 0;
+	size_t firstHole = 0;
+	size_t live = 1;
+	for (size_t r = 1; r < size; r++)
+	{
+		if (dying.Test(entities[r]))
+		{
+			mInstanceMap[entities[r].GetId()] = 0;
+			firstHole = removed++ ? firstHole : r;
+			continue;
+		}
+		remap[r] = Instance(live++);
+	}
+	if (!removed)
+	{
+		return 0;
+	}
+	if (IsObserved())
+	{
+		std::vector<Entity> gone;
+		gone.reserve(removed);
+		for (size_t r = firstHole; r < size; r++)
+		{
+			if (!remap[r])
+			{
+				gone.push_back(entities[r]);
+			}
+		}
+		Emit(EntityEvent::ComponentRemoved, gone.data(), gone.size());
+	}
+
+	// one sweep per array keeps every pass sequential
+	mData.forEach([&remap, firstHole, size](auto* p)
+	{
+		for (size_t r = firstHole; r < size; r++)
+		{
+			if (remap[r] && remap[r] != r)
+			{
+				p[remap[r]] = std::move(p[r]);
+			}
+		}
+	});
+	mData.resize(live);
+
+	// only rows from the first hole on have moved
+	Entity const* survivors = data<ENTITY_INDEX>();
+	for (size_t r = firstHole; r < live; r++)
+	{
+		mInstanceMap[survivors[r].GetId()] = Instance(r);
+		MarkChanged(Instance(r));
+	}
+	return removed;
+}
+
+template<typename ... Elements>
+template<typename F>
+void ComponentManagerBase<Elements ...>::ForEachChanged(uint32_t since, F&& f) const
+{
+	const uint32_t* versions = data<VERSION_INDEX>();
+	const size_t size = mData.size();
+	for (size_t chunk = 0; chunk < mChunkVersions.size(); chunk++)
+	{
+		if (mChunkVersions[chunk] <= since)
+		{
+			continue;
+		}
+		const size_t first = chunk ? chunk << CHUNK_SHIFT : 1;
+		const size_t last = std::min(size, (chunk + 1) << CHUNK_SHIFT);
+		for (size_t i = first; i < last; i++)
+		{
+			if (versions[i] > since)
+			{
+				f(Instance(i));
+			}
+		}
+	}
+}
+
 #define PROXY_DEFINE(ClassName) \
 using ProxyInstance = redtea::core::ComponentInstance; \
 struct ClassName##Proxy;\
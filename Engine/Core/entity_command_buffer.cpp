@@ -0,0 +1,162 @@
+#include "entity_command_buffer.h"
+#include "component_manager.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace redtea {
+namespace core {
+
+namespace {
+
+	std::atomic<uint64_t> sNextBufferId{ 1 };
+
+	// a thread seldom records into more than a few buffers, older entries are dropped and
+	// a thread whose entry was dropped just links a second segment into the same buffer
+	static constexpr size_t kSegmentCacheSize = 8;
+}
+
+EntityCommandBuffer::EntityCommandBuffer(EntityManager* entityManager)
+	: mEntityManager(entityManager)
+	, mId(sNextBufferId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+EntityCommandBuffer::~EntityCommandBuffer()
+{
+	Segment* segment = mSegments.load(std::memory_order_acquire);
+	while (segment)
+	{
+		Segment* next = segment->next;
+		delete segment;
+		segment = next;
+	}
+}
+
+void EntityCommandBuffer::AddComponent(IComponentManager* manager, Entity e)
+{
+	Record(manager, e, CommandType::Add);
+}
+
+void EntityCommandBuffer::RemoveComponent(IComponentManager* manager, Entity e)
+{
+	Record(manager, e, CommandType::Remove);
+}
+
+void EntityCommandBuffer::DestroyEntity(Entity e)
+{
+	Record(nullptr, e, CommandType::Destroy);
+}
+
+EntityCommandBuffer::Segment* EntityCommandBuffer::GetSegment()
+{
+	thread_local std::vector<std::pair<uint64_t, Segment*>> cache;
+	for (auto const& entry : cache)
+	{
+		if (entry.first == mId)
+		{
+			return entry.second;
+		}
+	}
+
+	Segment* segment = new Segment();
+	segment->next = mSegments.load(std::memory_order_relaxed);
+	while (!mSegments.compare_exchange_weak(segment->next, segment,
+		std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+
+	if (cache.size() == kSegmentCacheSize)
+	{
+		cache.erase(cache.begin());
+	}
+	cache.emplace_back(mId, segment);
+	return segment;
+}
+
+size_t EntityCommandBuffer::GetCommandCount() const noexcept
+{
+	size_t count = 0;
+	for (Segment* s = mSegments.load(std::memory_order_acquire); s; s = s->next)
+	{
+		count += s->commands.size();
+	}
+	return count;
+}
+
+void EntityCommandBuffer::Playback()
+{
+	// segments stay linked, their storage is reused by the next frame
+	mCommands.clear();
+	for (Segment* s = mSegments.load(std::memory_order_acquire); s; s = s->next)
+	{
+		mCommands.insert(mCommands.end(), s->commands.begin(), s->commands.end());
+		s->commands.clear();
+	}
+	if (mCommands.empty())
+	{
+		return;
+	}
+
+	// destroys last, the rest grouped by manager then entity, a stable sort keeps the
+	// recording order of one thread inside every group
+	std::stable_sort(mCommands.begin(), mCommands.end(), [](Command const& a, Command const& b)
+	{
+		const bool aDestroy = a.type == CommandType::Destroy;
+		const bool bDestroy = b.type == CommandType::Destroy;
+		if (aDestroy != bDestroy)
+		{
+			return bDestroy;
+		}
+		if (a.manager != b.manager)
+		{
+			return std::less<IComponentManager*>()(a.manager, b.manager);
+		}
+		return a.entity.GetId() < b.entity.GetId();
+	});
+
+	const size_t count = mCommands.size();
+	size_t n = 0;
+	while (n < count && mCommands[n].type != CommandType::Destroy)
+	{
+		IComponentManager* manager = mCommands[n].manager;
+		mAdds.clear();
+		mRemoves.clear();
+		for (; n < count && mCommands[n].manager == manager && mCommands[n].type != CommandType::Destroy; n++)
+		{
+			Command const& command = mCommands[n];
+			// only the last command of an entity counts
+			if (n + 1 < count && mCommands[n + 1].manager == manager
+				&& mCommands[n + 1].type != CommandType::Destroy
+				&& mCommands[n + 1].entity == command.entity)
+			{
+				continue;
+			}
+			(command.type == CommandType::Add ? mAdds : mRemoves).push_back(command.entity);
+		}
+		if (!mRemoves.empty())
+		{
+			manager->RemoveComponents(mRemoves.data(), mRemoves.size());
+		}
+		if (!mAdds.empty())
+		{
+			manager->AddComponents(mAdds.data(), mAdds.size());
+		}
+	}
+
+	mRemoves.clear();
+	for (; n < count; n++)
+	{
+		if (mRemoves.empty() || mRemoves.back() != mCommands[n].entity)
+		{
+			mRemoves.push_back(mCommands[n].entity);
+		}
+	}
+	if (!mRemoves.empty())
+	{
+		mEntityManager->DestroyEntitys(int(mRemoves.size()), mRemoves.data());
+	}
+}
+
+}
+}
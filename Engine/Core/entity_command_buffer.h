@@ -0,0 +1,81 @@
+#pragma once
+#include "entity.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace redtea {
+namespace core {
+
+class EntityManager;
+class IComponentManager;
+
+// Structural changes recorded while systems run and applied later at a sync point.
+// Every thread records into its own segment, found through a thread local cache, so
+// recording never takes a lock; only the first command of a thread allocates its segment
+// and links it with a CAS. Playback sorts the commands by manager and hands each manager
+// one batch of adds and one batch of removals.
+class EntityCommandBuffer
+{
+public:
+	explicit EntityCommandBuffer(EntityManager* entityManager);
+	~EntityCommandBuffer();
+
+	EntityCommandBuffer(EntityCommandBuffer const&) = delete;
+	EntityCommandBuffer& operator=(EntityCommandBuffer const&) = delete;
+
+	// any thread, as long as Playback is not running
+	void AddComponent(IComponentManager* manager, Entity e);
+	void RemoveComponent(IComponentManager* manager, Entity e);
+	// removes the entity from every registered manager and frees its id
+	void DestroyEntity(Entity e);
+
+	// sync point, no thread may record meanwhile. For the same manager and entity the last
+	// command recorded wins, commands from different threads have no defined order.
+	// Destroys are applied last.
+	void Playback();
+
+	// pending commands, only meaningful at a sync point
+	size_t GetCommandCount() const noexcept;
+
+private:
+	enum class CommandType : uint8_t
+	{
+		Add,
+		Remove,
+		Destroy
+	};
+
+	struct Command
+	{
+		IComponentManager* manager;
+		Entity entity;
+		CommandType type;
+	};
+
+	struct Segment
+	{
+		std::vector<Command> commands;
+		Segment* next = nullptr;
+	};
+
+	Segment* GetSegment();
+
+	void Record(IComponentManager* manager, Entity e, CommandType type)
+	{
+		GetSegment()->commands.push_back({ manager, e, type });
+	}
+
+	EntityManager* mEntityManager;
+	// identifies this buffer in the thread local caches, never reused
+	const uint64_t mId;
+	std::atomic<Segment*> mSegments{ nullptr };
+
+	// playback scratch
+	std::vector<Command> mCommands;
+	std::vector<Entity> mAdds;
+	std::vector<Entity> mRemoves;
+};
+
+}
+}
@@ -0,0 +1,169 @@
+#include "entity_events.h"
+#include <algorithm>
+#include <utility>
+
+namespace redtea {
+namespace core {
+
+namespace {
+
+	std::atomic<uint64_t> sNextBusId{ 1 };
+
+	// as for command buffers, a thread whose entry was dropped links a second segment
+	static constexpr size_t kSegmentCacheSize = 8;
+}
+
+EntityEventBus::EntityEventBus()
+	: mId(sNextBusId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+EntityEventBus::~EntityEventBus()
+{
+	Segment* segment = mSegments.load(std::memory_order_acquire);
+	while (segment)
+	{
+		Segment* next = segment->next;
+		delete segment;
+		segment = next;
+	}
+}
+
+EntityEventBus::SubscriptionId EntityEventBus::Subscribe(EntityEvent type, IComponentManager const* manager, Subscriber subscriber)
+{
+	const SubscriptionId id = mNextSubscription++;
+	mSubscriptions.push_back({ id, type, manager, std::move(subscriber) });
+	return id;
+}
+
+void EntityEventBus::Unsubscribe(SubscriptionId id)
+{
+	mSubscriptions.erase(std::remove_if(mSubscriptions.begin(), mSubscriptions.end(),
+		[id](Subscription const& s) { return s.id == id; }), mSubscriptions.end());
+}
+
+void EntityEventBus::Record(EntityEvent type, IComponentManager* manager, Entity const* entities, size_t count)
+{
+	if (!count)
+	{
+		return;
+	}
+	Segment* segment = GetSegment();
+	// the last run goes on as long as no run was started since, anything recorded after a
+	// record of another thread that this one has synchronized with is seen to be later
+	Run* run = segment->runs.empty() ? nullptr : &segment->runs.back();
+	if (!run || run->type != type || run->manager != manager
+		|| mSequence.load(std::memory_order_relaxed) != run->sequence + 1)
+	{
+		const uint64_t sequence = mSequence.fetch_add(1, std::memory_order_relaxed);
+		segment->runs.push_back({ sequence, type, manager, segment->entities.size(), 0 });
+		run = &segment->runs.back();
+	}
+	segment->entities.insert(segment->entities.end(), entities, entities + count);
+	run->count += count;
+}
+
+EntityEventBus::Segment* EntityEventBus::GetSegment()
+{
+	thread_local std::vector<std::pair<uint64_t, Segment*>> cache;
+	for (auto const& entry : cache)
+	{
+		if (entry.first == mId)
+		{
+			return entry.second;
+		}
+	}
+
+	Segment* segment = new Segment();
+	segment->next = mSegments.load(std::memory_order_relaxed);
+	while (!mSegments.compare_exchange_weak(segment->next, segment,
+		std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+
+	if (cache.size() == kSegmentCacheSize)
+	{
+		cache.erase(cache.begin());
+	}
+	cache.emplace_back(mId, segment);
+	return segment;
+}
+
+size_t EntityEventBus::GetPendingCount() const noexcept
+{
+	size_t count = 0;
+	for (Segment* s = mSegments.load(std::memory_order_acquire); s; s = s->next)
+	{
+		count += s->entities.size();
+	}
+	return count;
+}
+
+void EntityEventBus::Dispatch()
+{
+	// segments are drained before any subscriber runs, what those record stays there
+	mRuns.clear();
+	mGathered.clear();
+	for (Segment* s = mSegments.load(std::memory_order_acquire); s; s = s->next)
+	{
+		for (Run run : s->runs)
+		{
+			run.first += mGathered.size();
+			mRuns.push_back(run);
+		}
+		mGathered.insert(mGathered.end(), s->entities.begin(), s->entities.end());
+		s->runs.clear();
+		s->entities.clear();
+	}
+	std::sort(mRuns.begin(), mRuns.end(), [](Run const& a, Run const& b) { return a.sequence < b.sequence; });
+
+	// the entities of a batch have to be contiguous, so they are laid out again in run order
+	// unless they already are, as with a single recording thread
+	bool inOrder = true;
+	size_t size = 0;
+	for (Run const& run : mRuns)
+	{
+		inOrder = inOrder && run.first == size;
+		size += run.count;
+	}
+	if (inOrder)
+	{
+		mEntities.swap(mGathered);
+	}
+	mEntities.resize(size);
+	mIds.resize(size);
+	mBatches.clear();
+	size = 0;
+	for (Run const& run : mRuns)
+	{
+		if (mBatches.empty() || mBatches.back().type != run.type || mBatches.back().manager != run.manager)
+		{
+			mBatches.push_back({ run.sequence, run.type, run.manager, size, 0 });
+		}
+		if (!inOrder)
+		{
+			std::copy(mGathered.begin() + run.first, mGathered.begin() + run.first + run.count, mEntities.begin() + size);
+		}
+		mBatches.back().count += run.count;
+		size += run.count;
+	}
+	for (size_t n = 0; n < mEntities.size(); n++)
+	{
+		mIds[n] = mEntities[n].GetId();
+	}
+
+	for (Run const& run : mBatches)
+	{
+		const EntityEventBatch batch{ run.type, run.manager, mIds.data() + run.first, mEntities.data() + run.first, run.count };
+		for (Subscription const& s : mSubscriptions)
+		{
+			if (s.type == run.type && (!s.manager || s.manager == run.manager))
+			{
+				s.subscriber(batch);
+			}
+		}
+	}
+}
+
+}
+}
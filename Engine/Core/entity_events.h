@@ -0,0 +1,120 @@
+#pragma once
+#include "entity.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace redtea {
+namespace core {
+
+class IComponentManager;
+
+enum class EntityEvent : uint8_t
+{
+	EntityCreated,
+	ComponentAdded,
+	ComponentRemoved,
+	EntityDestroyed,
+	Count
+};
+
+// consecutive events of one kind, and for component events of one manager, in the order
+// they were recorded. The entities come twice: ids for passes that want plain integers, entities
+// for calls into the manager API.
+struct EntityEventBatch
+{
+	EntityEvent type;
+	// null for entity events
+	IComponentManager* manager;
+	Entity::Type const* ids;
+	Entity const* entities;
+	size_t count;
+};
+
+// Lifecycle events of the entities of an EntityManager and the components of its
+// managers. Changes are recorded in bulk by the code making them, every thread into its
+// own segment found through a thread local cache like EntityCommandBuffer does, so
+// recording never takes a lock. Every run of records of one kind and manager takes a
+// number from a shared counter, and Dispatch, at a sync point, hands the runs of all
+// segments to the subscribers in that order, merging neighbours of the same kind and
+// manager into one batch.
+//
+// So batches go out in record order: a component removed and added again, or an id
+// destroyed and created again, reaches subscribers in that order. Records of threads that
+// don't synchronize with each other are ordered arbitrarily, as they happened.
+class EntityEventBus
+{
+public:
+	using Subscriber = std::function<void(EntityEventBatch const&)>;
+	using SubscriptionId = uint32_t;
+
+	EntityEventBus();
+	~EntityEventBus();
+
+	EntityEventBus(EntityEventBus const&) = delete;
+	EntityEventBus& operator=(EntityEventBus const&) = delete;
+
+	// batches of type, for component events only those of manager unless it is null. Not
+	// from a subscriber.
+	SubscriptionId Subscribe(EntityEvent type, IComponentManager const* manager, Subscriber subscriber);
+	void Unsubscribe(SubscriptionId id);
+
+	// any thread, as long as Dispatch is not gathering
+	void Record(EntityEvent type, IComponentManager* manager, Entity const* entities, size_t count);
+
+	// sync point, no other thread may record meanwhile. Batches go out in record order,
+	// events recorded by subscribers wait for the next Dispatch.
+	void Dispatch();
+
+	// recorded and not dispatched yet, only meaningful at a sync point
+	size_t GetPendingCount() const noexcept;
+
+private:
+	// records of one kind and manager in a row, [first, first + count) of the entities of
+	// a segment or, once gathered, of the bus
+	struct Run
+	{
+		uint64_t sequence;
+		EntityEvent type;
+		IComponentManager* manager;
+		size_t first;
+		size_t count;
+	};
+
+	struct Segment
+	{
+		std::vector<Entity> entities;
+		std::vector<Run> runs;
+		Segment* next = nullptr;
+	};
+
+	struct Subscription
+	{
+		SubscriptionId id;
+		EntityEvent type;
+		IComponentManager const* manager;
+		Subscriber subscriber;
+	};
+
+	Segment* GetSegment();
+
+	// identifies this bus in the thread local caches, never reused
+	const uint64_t mId;
+	std::atomic<Segment*> mSegments{ nullptr };
+	// number of the next run
+	std::atomic<uint64_t> mSequence{ 0 };
+
+	// the runs of all segments and their entities as gathered, then the batches laid out in
+	// record order. The storage is kept from one dispatch to the next.
+	std::vector<Run> mRuns;
+	std::vector<Entity> mGathered;
+	std::vector<Run> mBatches;
+	std::vector<Entity> mEntities;
+	std::vector<Entity::Type> mIds;
+	std::vector<Subscription> mSubscriptions;
+	SubscriptionId mNextSubscription = 0;
+};
+
+}
+}
@@ -1,10 +1,17 @@
 #include "entity_manager.h"
+#include "component_manager.h"
+#include "entity_events.h"
+#include <algorithm>
 #include <mutex>
 #include "common.h"
 
 namespace redtea {
 namespace core {
 
+namespace {
+	static constexpr size_t kBulkRemoveRatio = 8;
+}
+
 Entity EntityManager::CreateEntity() {
     Entity e;
     InitEntity(1, &e);
@@ -12,6 +19,15 @@ Entity EntityManager::CreateEntity() {
 }
 
 void EntityManager::InitEntity(int n, redtea::core::Entity *e) {
+	(mIdSource ? mIdSource : this)->TakeIds(n, e);
+	if (mEventBus)
+	{
+		mEventBus->Record(EntityEvent::EntityCreated, nullptr, e, size_t(n));
+	}
+}
+
+void EntityManager::TakeIds(int n, Entity* e)
+{
     // make thread safe
     std::lock_guard<std::mutex> lock(mFreeListLock);
     for(int i = 0; i < n; i++)
@@ -35,16 +51,41 @@ void EntityManager::InitEntity(int n, redtea::core::Entity *e) {
 
 void EntityManager::DestroyEntitys(int n, Entity* e)
 {
-	auto& freeList = mFreeList;
-	std::unique_lock<std::mutex> lock(mFreeListLock);
+	// a large batch is tested against every row in one pass, which beats a hash lookup and
+	// a swap per entity once it is a sizable part of the manager
+	EntityMask dying;
+	bool masked = false;
+	for (IComponentManager* manager : mComponentManagers)
+	{
+		if (size_t(n) * kBulkRemoveRatio >= manager->GetComponentCount())
+		{
+			if (!masked)
+			{
+				dying = EntityMask(e, size_t(n));
+				masked = true;
+			}
+			manager->RemoveComponents(dying);
+		}
+		else
+		{
+			manager->RemoveComponents(e, size_t(n));
+		}
+	}
+
+	// before the ids are free again, so a creation reusing one is recorded after it
+	if (mEventBus)
+	{
+		mEventBus->Record(EntityEvent::EntityDestroyed, nullptr, e, size_t(n));
+	}
+
+	EntityManager* owner = mIdSource ? mIdSource : this;
+	auto& freeList = owner->mFreeList;
+	std::unique_lock<std::mutex> lock(owner->mFreeListLock);
 	for (int i = 0; i < n; i++)
 	{
 		freeList.push_back(e[i].GetId());
 	}
 	lock.unlock();
-
-	// broadcast entity destroy
-	// todo:event listener
 }
 
 
@@ -54,9 +95,47 @@ void EntityManager::DestroyEntity(Entity e)
 }
 
 
-EntityManager::~EntityManager()
+void EntityManager::RegisterComponentManager(IComponentManager* manager)
 {
+	assert(manager->mEntityManager == nullptr);
+	manager->mEntityManager = this;
+	mComponentManagers.push_back(manager);
+	if (mArena)
+	{
+		manager->SetArena(mArena);
+	}
+}
+
+
+void EntityManager::UnregisterComponentManager(IComponentManager* manager)
+{
+	if (mArena)
+	{
+		manager->SetArena(nullptr);
+	}
+	ForgetComponentManager(manager);
+}
+
 
+void EntityManager::ForgetComponentManager(IComponentManager* manager)
+{
+	assert(manager->mEntityManager == this);
+	manager->mEntityManager = nullptr;
+	mComponentManagers.erase(std::find(mComponentManagers.begin(), mComponentManagers.end(), manager));
+}
+
+
+EntityManager::~EntityManager()
+{
+	// managers outliving the arena move back to the heap
+	for (IComponentManager* manager : mComponentManagers)
+	{
+		if (mArena)
+		{
+			manager->SetArena(nullptr);
+		}
+		manager->mEntityManager = nullptr;
+	}
 }
 
 }
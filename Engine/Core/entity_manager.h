@@ -2,23 +2,57 @@
 #include <vector>
 #include <deque>
 #include "entity.h"
+#include "utils/arena.h"
 #include <mutex>
 
 namespace redtea {
 namespace core {
 
+class IComponentManager;
+class EntityEventBus;
+
 class EntityManager
 {
 public:
+	// with an id source, ids are taken from and given back to it, which keeps the ids of
+	// a staging world unique in the world it is merged into. With an arena, the free ids
+	// and the rows of every registered manager are kept in it.
+	explicit EntityManager(EntityManager* idSource = nullptr, common::Arena* arena = nullptr)
+		: mIdSource(idSource), mArena(arena), mFreeList(common::ArenaStlAllocator<Entity::Type>(arena)) {}
+
     Entity CreateEntity();
     void InitEntity(int n, Entity* e);
+	// also removes the components of every registered manager, one batch per manager
     void DestroyEntitys(int n, Entity* e);
 	void DestroyEntity(Entity e);
 	~EntityManager();
-    
+
+	// a manager belongs to at most one EntityManager, not thread safe
+	void RegisterComponentManager(IComponentManager* manager);
+	void UnregisterComponentManager(IComponentManager* manager);
+	std::vector<IComponentManager*> const& GetComponentManagers() const noexcept { return mComponentManagers; }
+	common::Arena* GetArena() const noexcept { return mArena; }
+
+	// lifecycle events of the entities and of the components of every registered manager
+	// are recorded into bus, null for none
+	void SetEventBus(EntityEventBus* bus) noexcept { mEventBus = bus; }
+	EntityEventBus* GetEventBus() const noexcept { return mEventBus; }
+
+private:
+	friend class IComponentManager;
+	// a manager being destroyed, its storage is gone already
+	void ForgetComponentManager(IComponentManager* manager);
+	// ids without events, a staging world reports its entities on its own bus
+	void TakeIds(int n, Entity* e);
+
 public:
-    std::deque<Entity::Type> mFreeList;
-	Entity::Type mCurrentID;
+	std::vector<IComponentManager*> mComponentManagers;
+	EntityManager* mIdSource;
+	common::Arena* mArena;
+	EntityEventBus* mEventBus = nullptr;
+	// taken from by staging worlds on other threads, under mFreeListLock
+	std::deque<Entity::Type, common::ArenaStlAllocator<Entity::Type>> mFreeList;
+	Entity::Type mCurrentID = 0;
     mutable std::mutex mFreeListLock;
 };
 
@@ -0,0 +1,50 @@
+#pragma once
+#include "entity.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace redtea {
+namespace core {
+
+// Set of entities as one bit per id, for bulk operations that test every row of a
+// manager against a large group of entities
+class EntityMask
+{
+public:
+	EntityMask() = default;
+	EntityMask(Entity const* entities, size_t count)
+	{
+		for (size_t n = 0; n < count; n++)
+		{
+			Set(entities[n]);
+		}
+	}
+
+	void Set(Entity e)
+	{
+		const size_t word = e.GetId() >> 6;
+		if (word >= mWords.size())
+		{
+			mWords.resize(word + 1, 0);
+		}
+		mWords[word] |= uint64_t(1) << (e.GetId() & 63);
+	}
+
+	bool Test(Entity e) const noexcept
+	{
+		const size_t word = e.GetId() >> 6;
+		return word < mWords.size() && (mWords[word] >> (e.GetId() & 63)) & 1;
+	}
+
+	void Clear() noexcept
+	{
+		std::fill(mWords.begin(), mWords.end(), 0);
+	}
+
+private:
+	std::vector<uint64_t> mWords;
+};
+
+}
+}
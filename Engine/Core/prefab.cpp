@@ -0,0 +1,114 @@
+#include "prefab.h"
+#include "world.h"
+#include "component_manager.h"
+#include <algorithm>
+#include <cassert>
+
+namespace redtea {
+namespace core {
+
+bool Prefab::Capture(World& world, Entity const* entities, size_t count)
+{
+	mManagers.clear();
+	mEntityCount = 0;
+
+	auto const& managers = world.GetEntityManager()->GetComponentManagers();
+	std::vector<SnapshotColumn> layout;
+	std::vector<std::pair<IComponentManager::Instance, uint32_t>> rows;
+	std::vector<IComponentManager::Instance> selected;
+	std::vector<void const*> columns;
+	mManagers.resize(managers.size());
+	for (size_t m = 0; m < managers.size(); m++)
+	{
+		IComponentManager* manager = managers[m];
+		if (!manager->GetSnapshotLayout(layout))
+		{
+			mManagers.clear();
+			return false;
+		}
+
+		// row order keeps the order a manager may rely on, such as transform levels
+		rows.clear();
+		for (size_t n = 0; n < count; n++)
+		{
+			if (auto i = manager->GetInstance(entities[n]))
+			{
+				rows.emplace_back(i, uint32_t(n));
+			}
+		}
+		std::sort(rows.begin(), rows.end());
+		selected.clear();
+		Rows& captured = mManagers[m];
+		for (auto const& row : rows)
+		{
+			selected.push_back(row.first);
+			captured.owners.push_back(row.second);
+		}
+
+		captured.columns.resize(layout.size());
+		columns.clear();
+		for (size_t c = 0; c < layout.size(); c++)
+		{
+			captured.columns[c].resize(selected.size() * layout[c].elementSize);
+			manager->SaveColumn(c, selected.data(), selected.size(), captured.columns[c].data());
+			columns.push_back(captured.columns[c].data());
+		}
+
+		// Instantiate trusts the rows, so they are checked here the way a snapshot loader
+		// checks them, which catches a transform captured without its parent
+		if (!manager->CheckRows(selected.size(), columns.data()))
+		{
+			mManagers.clear();
+			return false;
+		}
+	}
+	mEntityCount = count;
+	return true;
+}
+
+size_t Prefab::Instantiate(Section& section, size_t count) const
+{
+	const size_t first = section.mEntities.size();
+	const size_t total = count * mEntityCount;
+	if (total == 0)
+	{
+		return first;
+	}
+
+	EntityManager* entityManager = section.mWorld->GetEntityManager();
+	section.mEntities.resize(first + total);
+	Entity* created = section.mEntities.data() + first;
+	entityManager->InitEntity(int(total), created);
+
+	auto const& managers = entityManager->GetComponentManagers();
+	assert(managers.size() == mManagers.size());
+	std::vector<Entity> owners;
+	std::vector<void const*> columns;
+	for (size_t m = 0; m < managers.size(); m++)
+	{
+		Rows const& captured = mManagers[m];
+		const size_t rowCount = captured.owners.size();
+		if (rowCount == 0)
+		{
+			continue;
+		}
+		owners.resize(count * rowCount);
+		for (size_t k = 0; k < count; k++)
+		{
+			for (size_t t = 0; t < rowCount; t++)
+			{
+				owners[k * rowCount + t] = created[k * mEntityCount + captured.owners[t]];
+			}
+		}
+		columns.clear();
+		for (auto const& column : captured.columns)
+		{
+			columns.push_back(column.data());
+		}
+		managers[m]->InstantiateRows(owners.data(), count, rowCount, columns.data());
+	}
+	return first;
+}
+
+}
+}
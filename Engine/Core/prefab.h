@@ -0,0 +1,45 @@
+#pragma once
+#include "entity.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace redtea {
+namespace core {
+
+class World;
+class Section;
+
+// Template of one or more entities captured as raw component rows of every manager of a
+// world. Instantiate allocates the ids of all copies in one batch and hands every manager
+// its template rows once, which then copies them into its SoA in bulk.
+//
+// Like snapshots, components must be trivially copyable and managers are matched by
+// registration order. Capture fails when a transform's ancestors are not part of it.
+class Prefab
+{
+public:
+	// false when a manager cannot be captured or rejects the captured rows, the prefab is
+	// left empty then
+	bool Capture(World& world, Entity const* entities, size_t count);
+
+	size_t GetEntityCount() const noexcept { return mEntityCount; }
+
+	// appends count copies to section, copy k of captured entity t is
+	// section.GetEntities()[first + k * GetEntityCount() + t]. Returns first.
+	size_t Instantiate(Section& section, size_t count) const;
+
+private:
+	struct Rows
+	{
+		// per template row, which captured entity it belongs to
+		std::vector<uint32_t> owners;
+		std::vector<std::vector<uint8_t>> columns;
+	};
+
+	std::vector<Rows> mManagers;
+	size_t mEntityCount = 0;
+};
+
+}
+}
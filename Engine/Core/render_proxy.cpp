@@ -0,0 +1,116 @@
+#include "render_proxy.h"
+#include "transform_manager.h"
+#include "utils/thread_pool.h"
+#include <algorithm>
+#include <cassert>
+
+namespace redtea {
+namespace core {
+
+namespace {
+
+	// proxies per task when the copy goes wide
+	static constexpr size_t kExtractGrain = 2048;
+}
+
+RenderExtractor::RenderExtractor(RenderProxyManager* proxies, TransformManager* transforms)
+	: mProxies(proxies),
+	mTransforms(transforms)
+{
+}
+
+size_t RenderExtractor::Extract(common::ThreadPool* pool)
+{
+	using Instance = ComponentInstance::Type;
+
+	// the frame published last is the one the render thread may be reading
+	const int target = mPublished == 0 ? 1 : 0;
+	Buffer& buffer = mBuffers[target];
+	{
+		std::unique_lock<std::mutex> guard(mLock);
+		mReleased.wait(guard, [&buffer]() { return buffer.readers == 0; });
+	}
+
+	// rows written since this buffer was filled, either directly or through their transform
+	const uint32_t proxySince = buffer.proxyVersion;
+	const uint32_t transformSince = buffer.transformVersion;
+	buffer.proxyVersion = mProxies->NewVersion();
+	buffer.transformVersion = mTransforms->NewVersion();
+	mRows.clear();
+	mProxies->ForEachChanged(proxySince, [this](Instance i) { mRows.push_back(i); });
+	mTransforms->ForEachChanged(transformSince, [this](Instance i)
+	{
+		if (Instance p = mProxies->GetInstance(mTransforms->GetEntity(i)))
+		{
+			mRows.push_back(p);
+		}
+	});
+	std::sort(mRows.begin(), mRows.end());
+	mRows.erase(std::unique(mRows.begin(), mRows.end()), mRows.end());
+
+	// rows are compact, so the frame shrinks and grows with the manager
+	std::vector<RenderProxy>& proxies = buffer.frame.proxies;
+	proxies.resize(mProxies->GetComponentCount());
+	RenderProxyManager const& source = *mProxies;
+	TransformManager const& transforms = *mTransforms;
+	auto copy = [&](size_t first, size_t last)
+	{
+		for (size_t n = first; n < last; n++)
+		{
+			const Instance r = mRows[n];
+			RenderProxy& proxy = proxies[r - 1];
+			proxy.entity = source.GetEntity(r);
+			const Instance t = transforms.GetInstance(proxy.entity);
+			// without a transform the proxy sits at the origin
+			proxy.world = t ? transforms.GetWorldTransform(t) : math::Mat4f();
+			proxy.boundsCenter = source.GetElement<RenderProxyManager::BoundsCenter>(r);
+			proxy.boundsExtents = source.GetElement<RenderProxyManager::BoundsExtents>(r);
+			proxy.material = source.GetElement<RenderProxyManager::Material>(r);
+			proxy.mesh = source.GetElement<RenderProxyManager::Mesh>(r);
+		}
+	};
+	if (pool && mRows.size() > kExtractGrain)
+	{
+		pool->parallelFor(0, mRows.size(), kExtractGrain, copy);
+	}
+	else
+	{
+		copy(0, mRows.size());
+	}
+	buffer.frame.frame = ++mFrame;
+
+	std::lock_guard<std::mutex> guard(mLock);
+	mPublished = target;
+	return mRows.size();
+}
+
+RenderFrame const* RenderExtractor::Acquire()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	if (mPublished < 0)
+	{
+		return nullptr;
+	}
+	Buffer& buffer = mBuffers[mPublished];
+	buffer.readers++;
+	return &buffer.frame;
+}
+
+void RenderExtractor::Release(RenderFrame const* frame)
+{
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		for (Buffer& buffer : mBuffers)
+		{
+			if (&buffer.frame == frame)
+			{
+				assert(buffer.readers);
+				buffer.readers--;
+			}
+		}
+	}
+	mReleased.notify_all();
+}
+
+}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "component_manager.h"
+#include "math/vector.h"
+#include "math/matrix.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace redtea {
+namespace common {
+	class ThreadPool;
+}
+namespace core {
+
+	class TransformManager;
+
+	// What the renderer needs of an entity besides its world matrix, which comes from the
+	// entity's transform.
+	class RenderProxyManager : public ComponentManagerBase<
+		math::Vector3f,		// bounds center, local space
+		math::Vector3f,		// bounds half extents, local space
+		uint32_t,			// material
+		uint32_t>			// mesh
+	{
+	public:
+		enum
+		{
+			BoundsCenter,
+			BoundsExtents,
+			Material,
+			Mesh
+		};
+
+		PROXY_DEFINE(RenderProxyManager)
+			DEFINE_FEILD(BoundsCenter, boundsCenter)
+			DEFINE_FEILD(BoundsExtents, boundsExtents)
+			DEFINE_FEILD(Material, material)
+			DEFINE_FEILD(Mesh, mesh)
+		PROXY_END()
+	};
+
+	struct RenderProxy
+	{
+		math::Mat4f world;
+		math::Vector3f boundsCenter;
+		math::Vector3f boundsExtents;
+		uint32_t material;
+		uint32_t mesh;
+		Entity entity;
+	};
+
+	// One extracted frame, proxies[i] is row i + 1 of the RenderProxyManager at extraction
+	struct RenderFrame
+	{
+		uint64_t frame = 0;
+		std::vector<RenderProxy> proxies;
+	};
+
+	// Copies the render proxies out of the ECS so the render thread can draw frame N while
+	// the game thread simulates N + 1. Two frames are kept; each remembers the change
+	// versions of both managers as of its last fill, so refilling it only copies the rows
+	// written since, two extractions ago.
+	class RenderExtractor
+	{
+	public:
+		RenderExtractor(RenderProxyManager* proxies, TransformManager* transforms);
+
+		RenderExtractor(RenderExtractor const&) = delete;
+		RenderExtractor& operator=(RenderExtractor const&) = delete;
+
+		// game thread, after the transforms were updated. Waits while the render thread
+		// still holds the frame to be filled, then publishes it. Returns the proxies copied.
+		size_t Extract(common::ThreadPool* pool = nullptr);
+
+		// render side, the latest published frame or null before the first Extract. The
+		// frame is not touched until every acquire of it was released.
+		RenderFrame const* Acquire();
+		void Release(RenderFrame const* frame);
+
+	private:
+		struct Buffer
+		{
+			RenderFrame frame;
+			uint32_t proxyVersion = 0;
+			uint32_t transformVersion = 0;
+			// acquires not yet released
+			uint32_t readers = 0;
+		};
+
+		RenderProxyManager* mProxies;
+		TransformManager* mTransforms;
+		Buffer mBuffers[2];
+		// buffer the render thread acquires, -1 before the first Extract
+		int mPublished = -1;
+		uint64_t mFrame = 0;
+		std::mutex mLock;
+		std::condition_variable mReleased;
+
+		// scratch
+		std::vector<ComponentInstance::Type> mRows;
+		std::vector<uint8_t> mMarked;
+	};
+
+}
+}
@@ -0,0 +1,501 @@
+#include "snapshot.h"
+#include "world.h"
+#include "component_manager.h"
+#include "utils/mapped_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace redtea {
+namespace core {
+
+namespace {
+
+	static constexpr uint64_t kBlockAlignment = 64;
+
+	// all offsets are from the start of the file
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t fileSize;
+		uint32_t nextEntityId;		// every saved id is below it
+		uint32_t freeCount;			// uint32_t ids at freeListOffset
+		uint32_t sectionCount;		// SectionRecord at sectionsOffset
+		uint32_t managerCount;		// ManagerRecord at managersOffset
+		uint64_t freeListOffset;
+		uint64_t sectionsOffset;
+		uint64_t managersOffset;
+	};
+
+	struct SectionRecord
+	{
+		uint32_t id;
+		uint32_t entityCount;		// uint32_t ids at entitiesOffset
+		uint64_t entitiesOffset;
+	};
+
+	struct ManagerRecord
+	{
+		uint32_t rowCount;
+		uint32_t columnCount;		// ColumnRecord at columnsOffset
+		uint64_t entitiesOffset;	// uint32_t id of every row
+		uint64_t columnsOffset;
+	};
+
+	struct ColumnRecord
+	{
+		uint32_t elementSize;
+		uint32_t alignment;
+		uint64_t offset;			// rowCount elements
+	};
+
+	class FileWriter
+	{
+	public:
+		explicit FileWriter(const char* path) : mFile(std::fopen(path, "wb")) {}
+		~FileWriter()
+		{
+			if (mFile)
+			{
+				std::fclose(mFile);
+			}
+		}
+
+		bool IsOpen() const noexcept { return mFile != nullptr; }
+
+		// appends a block at the next aligned offset and returns that offset
+		uint64_t Write(void const* p, size_t size)
+		{
+			static const char zeros[kBlockAlignment] = {};
+			const uint64_t offset = (mSize + kBlockAlignment - 1) & ~(kBlockAlignment - 1);
+			const size_t padding = size_t(offset - mSize);
+			mOk &= std::fwrite(zeros, 1, padding, mFile) == padding;
+			mOk &= size == 0 || std::fwrite(p, 1, size, mFile) == size;
+			mSize = offset + size;
+			return offset;
+		}
+
+		// the header sits at offset 0 and is rewritten once every offset is known
+		bool Finish(FileHeader header)
+		{
+			header.fileSize = mSize;
+			mOk &= std::fseek(mFile, 0, SEEK_SET) == 0;
+			mOk &= std::fwrite(&header, sizeof(header), 1, mFile) == 1;
+			mOk &= std::fclose(mFile) == 0;
+			mFile = nullptr;
+			return mOk;
+		}
+
+	private:
+		std::FILE* mFile;
+		uint64_t mSize = 0;
+		bool mOk = true;
+	};
+
+	// bounds checked typed views into the mapping
+	class FileReader
+	{
+	public:
+		explicit FileReader(common::MappedFile const& file) noexcept
+			: mData(static_cast<uint8_t const*>(file.data())), mSize(file.size()) {}
+
+		template<typename T>
+		T const* Get(uint64_t offset, uint64_t count) const noexcept
+		{
+			if (offset > mSize || offset % alignof(T) != 0 || count > (mSize - offset) / sizeof(T))
+			{
+				return nullptr;
+			}
+			return reinterpret_cast<T const*>(mData + offset);
+		}
+
+		FileHeader const* GetHeader() const noexcept
+		{
+			FileHeader const* header = Get<FileHeader>(0, 1);
+			if (!header || header->magic != Snapshot::kMagic || header->version != Snapshot::kVersion
+				|| header->fileSize != mSize)
+			{
+				return nullptr;
+			}
+			return header;
+		}
+
+	private:
+		uint8_t const* mData;
+		uint64_t mSize;
+	};
+
+	// the blocks of one manager, checked against its layout
+	struct ManagerView
+	{
+		uint32_t rowCount = 0;
+		uint32_t const* entities = nullptr;
+		std::vector<void const*> columns;
+	};
+
+	bool GetManagerViews(FileReader const& reader, FileHeader const& header,
+		std::vector<IComponentManager*> const& managers, std::vector<ManagerView>& views)
+	{
+		ManagerRecord const* records = reader.Get<ManagerRecord>(header.managersOffset, header.managerCount);
+		if (!records || header.managerCount != managers.size())
+		{
+			return false;
+		}
+		views.resize(managers.size());
+		std::vector<SnapshotColumn> layout;
+		for (size_t m = 0; m < managers.size(); m++)
+		{
+			ManagerRecord const& record = records[m];
+			ManagerView& view = views[m];
+			ColumnRecord const* columns = reader.Get<ColumnRecord>(record.columnsOffset, record.columnCount);
+			view.rowCount = record.rowCount;
+			view.entities = reader.Get<uint32_t>(record.entitiesOffset, record.rowCount);
+			if (!managers[m]->GetSnapshotLayout(layout) || managers[m]->GetComponentCount() != 0
+				|| !columns || !view.entities || record.columnCount != layout.size())
+			{
+				return false;
+			}
+			view.columns.resize(layout.size());
+			for (size_t c = 0; c < layout.size(); c++)
+			{
+				if (columns[c].elementSize != layout[c].elementSize || columns[c].alignment != layout[c].alignment)
+				{
+					return false;
+				}
+				view.columns[c] = reader.Get<uint8_t>(columns[c].offset, uint64_t(record.rowCount) * columns[c].elementSize);
+				if (!view.columns[c])
+				{
+					return false;
+				}
+			}
+			if (!managers[m]->CheckRows(view.rowCount, view.columns.data()))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// every id is below limit and none comes twice, sorted receives the ids in order
+	bool CheckIds(uint32_t const* ids, size_t count, uint32_t limit, std::vector<uint32_t>& sorted)
+	{
+		sorted.assign(ids, ids + count);
+		std::sort(sorted.begin(), sorted.end());
+		return (sorted.empty() || sorted.back() < limit) && std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+	}
+
+	inline Entity MakeEntity(Entity::Type id, EntityManager* manager) noexcept
+	{
+		Entity e;
+		e.SetId(id);
+		e.SetManager(manager);
+		return e;
+	}
+}
+
+bool Snapshot::Save(World& world, Section* const* sections, size_t sectionCount, bool wholeWorld, const char* path)
+{
+	EntityManager* em = world.GetEntityManager();
+	auto const& managers = em->GetComponentManagers();
+	std::vector<std::vector<SnapshotColumn>> layouts(managers.size());
+	for (size_t m = 0; m < managers.size(); m++)
+	{
+		if (!managers[m]->GetSnapshotLayout(layouts[m]))
+		{
+			return false;
+		}
+	}
+
+	FileWriter writer(path);
+	if (!writer.IsOpen())
+	{
+		return false;
+	}
+	FileHeader header = {};
+	header.magic = Snapshot::kMagic;
+	header.version = Snapshot::kVersion;
+	writer.Write(&header, sizeof(header));
+
+	if (wholeWorld)
+	{
+		std::vector<uint32_t> freeList;
+		{
+			std::lock_guard<std::mutex> lock(em->mFreeListLock);
+			header.nextEntityId = em->mCurrentID;
+			freeList.assign(em->mFreeList.begin(), em->mFreeList.end());
+		}
+		header.freeCount = uint32_t(freeList.size());
+		header.freeListOffset = writer.Write(freeList.data(), freeList.size() * sizeof(uint32_t));
+	}
+	else
+	{
+		// the ids of a section may come from the id source of a staging world
+		for (Entity e : sections[0]->mEntities)
+		{
+			header.nextEntityId = std::max(header.nextEntityId, e.GetId() + 1);
+		}
+	}
+
+	std::vector<SectionRecord> sectionRecords;
+	std::vector<uint32_t> ids;
+	for (size_t s = 0; s < sectionCount; s++)
+	{
+		Section* section = sections[s];
+		ids.clear();
+		for (Entity e : section->mEntities)
+		{
+			ids.push_back(e.GetId());
+		}
+		SectionRecord record = {};
+		record.id = section->GetId();
+		record.entityCount = uint32_t(ids.size());
+		record.entitiesOffset = writer.Write(ids.data(), ids.size() * sizeof(uint32_t));
+		sectionRecords.push_back(record);
+	}
+	header.sectionCount = uint32_t(sectionRecords.size());
+	header.sectionsOffset = writer.Write(sectionRecords.data(), sectionRecords.size() * sizeof(SectionRecord));
+
+	std::vector<ManagerRecord> managerRecords;
+	std::vector<ColumnRecord> columnRecords;
+	std::vector<IComponentManager::Instance> rows;
+	std::vector<uint8_t> block;
+	for (size_t m = 0; m < managers.size(); m++)
+	{
+		IComponentManager* manager = managers[m];
+		size_t count = manager->GetComponentCount();
+		rows.clear();
+		if (!wholeWorld)
+		{
+			// row order keeps the order a manager may rely on, such as transform levels
+			for (Entity e : sections[0]->mEntities)
+			{
+				if (auto i = manager->GetInstance(e))
+				{
+					rows.push_back(i);
+				}
+			}
+			std::sort(rows.begin(), rows.end());
+			count = rows.size();
+		}
+		auto const* selected = wholeWorld ? nullptr : rows.data();
+
+		ids.resize(count);
+		for (size_t n = 0; n < count; n++)
+		{
+			ids[n] = manager->GetEntity(selected ? selected[n] : IComponentManager::Instance(n + 1)).GetId();
+		}
+		ManagerRecord record = {};
+		record.rowCount = uint32_t(count);
+		record.entitiesOffset = writer.Write(ids.data(), ids.size() * sizeof(uint32_t));
+
+		columnRecords.clear();
+		for (size_t c = 0; c < layouts[m].size(); c++)
+		{
+			block.resize(count * layouts[m][c].elementSize);
+			manager->SaveColumn(c, selected, count, block.data());
+			ColumnRecord column = {};
+			column.elementSize = layouts[m][c].elementSize;
+			column.alignment = layouts[m][c].alignment;
+			column.offset = writer.Write(block.data(), block.size());
+			columnRecords.push_back(column);
+		}
+		record.columnCount = uint32_t(columnRecords.size());
+		record.columnsOffset = writer.Write(columnRecords.data(), columnRecords.size() * sizeof(ColumnRecord));
+		managerRecords.push_back(record);
+	}
+	header.managerCount = uint32_t(managerRecords.size());
+	header.managersOffset = writer.Write(managerRecords.data(), managerRecords.size() * sizeof(ManagerRecord));
+	return writer.Finish(header);
+}
+
+bool Snapshot::SaveWorld(World& world, const char* path)
+{
+	return Save(world, world.mSections.data(), world.mSections.size(), true, path);
+}
+
+bool Snapshot::SaveSection(Section& section, const char* path)
+{
+	Section* sections[] = { &section };
+	return Save(*section.mWorld, sections, 1, false, path);
+}
+
+bool Snapshot::LoadWorld(World& world, const char* path)
+{
+	common::MappedFile file;
+	if (!file.open(path))
+	{
+		return false;
+	}
+	FileReader reader(file);
+	FileHeader const* header = reader.GetHeader();
+	EntityManager* em = world.GetEntityManager();
+	if (!header || em->mCurrentID != 0 || !em->mFreeList.empty() || !world.mSections.empty())
+	{
+		return false;
+	}
+
+	// validate everything before touching the world
+	uint32_t const* freeList = reader.Get<uint32_t>(header->freeListOffset, header->freeCount);
+	SectionRecord const* sections = reader.Get<SectionRecord>(header->sectionsOffset, header->sectionCount);
+	std::vector<ManagerView> views;
+	if (!freeList || !sections || !GetManagerViews(reader, *header, em->GetComponentManagers(), views))
+	{
+		return false;
+	}
+	// ids index the entity tables of the managers, an entity is free or in at most one section
+	std::vector<uint32_t> ids(freeList, freeList + header->freeCount);
+	std::vector<uint32_t const*> sectionIds(header->sectionCount);
+	for (size_t s = 0; s < sectionIds.size(); s++)
+	{
+		sectionIds[s] = reader.Get<uint32_t>(sections[s].entitiesOffset, sections[s].entityCount);
+		if (!sectionIds[s])
+		{
+			return false;
+		}
+		ids.insert(ids.end(), sectionIds[s], sectionIds[s] + sections[s].entityCount);
+	}
+	std::vector<uint32_t> sorted;
+	std::vector<uint32_t> freeIds;
+	if (!CheckIds(ids.data(), ids.size(), header->nextEntityId, sorted)
+		|| !CheckIds(freeList, header->freeCount, header->nextEntityId, freeIds))
+	{
+		return false;
+	}
+	for (ManagerView const& view : views)
+	{
+		if (!CheckIds(view.entities, view.rowCount, header->nextEntityId, sorted))
+		{
+			return false;
+		}
+		for (uint32_t id : sorted)
+		{
+			if (std::binary_search(freeIds.begin(), freeIds.end(), id))
+			{
+				return false;
+			}
+		}
+	}
+
+	em->mCurrentID = header->nextEntityId;
+	em->mFreeList.assign(freeList, freeList + header->freeCount);
+	for (size_t s = 0; s < sectionIds.size(); s++)
+	{
+		Section* section = world.CreateSection();
+		section->mEntities.resize(sections[s].entityCount);
+		for (size_t n = 0; n < section->mEntities.size(); n++)
+		{
+			section->mEntities[n] = MakeEntity(sectionIds[s][n], em);
+		}
+		if (EntityEventBus* bus = em->GetEventBus())
+		{
+			bus->Record(EntityEvent::EntityCreated, nullptr, section->mEntities.data(), section->mEntities.size());
+		}
+	}
+
+	std::vector<Entity> entities;
+	auto const& managers = em->GetComponentManagers();
+	for (size_t m = 0; m < managers.size(); m++)
+	{
+		ManagerView const& view = views[m];
+		entities.resize(view.rowCount);
+		for (size_t n = 0; n < view.rowCount; n++)
+		{
+			entities[n] = MakeEntity(view.entities[n], em);
+		}
+		// checked by GetManagerViews already
+		if (!managers[m]->LoadRows(entities.data(), view.rowCount, view.columns.data()))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+Section* Snapshot::LoadSection(World& world, const char* path)
+{
+	common::MappedFile file;
+	if (!file.open(path))
+	{
+		return nullptr;
+	}
+	FileReader reader(file);
+	FileHeader const* header = reader.GetHeader();
+	if (!header || header->sectionCount == 0)
+	{
+		return nullptr;
+	}
+	EntityManager* em = world.GetEntityManager();
+	SectionRecord const* section = reader.Get<SectionRecord>(header->sectionsOffset, 1);
+	uint32_t const* ids = section ? reader.Get<uint32_t>(section->entitiesOffset, section->entityCount) : nullptr;
+	std::vector<ManagerView> views;
+	if (!ids || !GetManagerViews(reader, *header, em->GetComponentManagers(), views))
+	{
+		return nullptr;
+	}
+
+	// saved id -> position in the section, sorted by id. Ids come from the file, so they
+	// are looked up rather than used as indices.
+	std::vector<uint32_t> sorted;
+	if (!CheckIds(ids, section->entityCount, header->nextEntityId, sorted))
+	{
+		return nullptr;
+	}
+	std::vector<std::pair<uint32_t, uint32_t>> position(section->entityCount);
+	for (uint32_t n = 0; n < section->entityCount; n++)
+	{
+		position[n] = { ids[n], n };
+	}
+	std::sort(position.begin(), position.end());
+	auto find = [&position](uint32_t id)
+	{
+		auto it = std::lower_bound(position.begin(), position.end(), std::make_pair(id, 0u));
+		return it != position.end() && it->first == id ? it->second : std::numeric_limits<uint32_t>::max();
+	};
+
+	// every row belongs to the section, once
+	std::vector<std::vector<uint32_t>> rowPositions(views.size());
+	for (size_t m = 0; m < views.size(); m++)
+	{
+		ManagerView const& view = views[m];
+		if (!CheckIds(view.entities, view.rowCount, header->nextEntityId, sorted))
+		{
+			return nullptr;
+		}
+		rowPositions[m].resize(view.rowCount);
+		for (size_t n = 0; n < view.rowCount; n++)
+		{
+			rowPositions[m][n] = find(view.entities[n]);
+			if (rowPositions[m][n] == std::numeric_limits<uint32_t>::max())
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	Section* loaded = world.CreateSection();
+	loaded->mEntities.resize(section->entityCount);
+	em->InitEntity(int(section->entityCount), loaded->mEntities.data());
+
+	std::vector<Entity> entities;
+	auto const& managers = em->GetComponentManagers();
+	for (size_t m = 0; m < managers.size(); m++)
+	{
+		ManagerView const& view = views[m];
+		entities.resize(view.rowCount);
+		for (size_t n = 0; n < view.rowCount; n++)
+		{
+			entities[n] = loaded->mEntities[rowPositions[m][n]];
+		}
+		if (!managers[m]->LoadRows(entities.data(), view.rowCount, view.columns.data()))
+		{
+			return nullptr;
+		}
+	}
+	return loaded;
+}
+
+}
+}
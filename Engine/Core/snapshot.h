@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace redtea {
+namespace core {
+
+class World;
+class Section;
+
+// Versioned binary image of a World or of a single Section. Every component column is one
+// contiguous block aligned to 64 bytes, so loading maps the file and copies each block
+// straight into the SoA of its manager, then rebuilds the entity indices.
+//
+// Managers are matched by registration order and their column layouts must be the same
+// as when the file was written, component types must be trivially copyable.
+class Snapshot
+{
+public:
+	static constexpr uint32_t kMagic = 0x53535452;	// "RTSS"
+	static constexpr uint32_t kVersion = 1;
+
+	// every section, the entity id allocator and every row of every registered manager
+	static bool SaveWorld(World& world, const char* path);
+
+	// the entities of section and their rows. Transforms must not have an ancestor outside
+	// of the section.
+	static bool SaveSection(Section& section, const char* path);
+
+	// world must not have created any entity or section yet, entities keep their ids
+	static bool LoadWorld(World& world, const char* path);
+
+	// loads the first section of a file into its own new section of world with fresh entity
+	// ids, the managers of world must be empty. Meant for a staging world that is merged
+	// into the live one afterwards. Returns null when the file does not match.
+	static Section* LoadSection(World& world, const char* path);
+
+private:
+	// a whole world with its id allocator, or the rows of the entities of sections[0]
+	static bool Save(World& world, Section* const* sections, size_t sectionCount, bool wholeWorld, const char* path);
+};
+
+}
+}
@@ -0,0 +1,491 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace redtea {
+namespace core {
+
+int32_t SpatialIndex::AllocateNode()
+{
+	int32_t index;
+	if (mFree != kNull)
+	{
+		// free nodes are chained through their parent
+		index = mFree;
+		mFree = mNodes[index].parent;
+	}
+	else
+	{
+		index = int32_t(mNodes.size());
+		mNodes.emplace_back();
+	}
+	Node& node = mNodes[index];
+	node.parent = kNull;
+	node.left = kNull;
+	node.right = kNull;
+	node.height = 0;
+	return index;
+}
+
+void SpatialIndex::FreeNode(int32_t node)
+{
+	mNodes[node].parent = mFree;
+	mNodes[node].height = -1;
+	mFree = node;
+}
+
+void SpatialIndex::SetLeaf(Entity e, int32_t leaf)
+{
+	if (e.GetId() >= mLeaves.size())
+	{
+		mLeaves.resize(std::max<size_t>(e.GetId() + 1, mLeaves.size() * 2), kNull);
+	}
+	mLeaves[e.GetId()] = leaf;
+}
+
+void SpatialIndex::Build(BoundsManager& bounds)
+{
+	mNodes.clear();
+	mLeaves.clear();
+	mRoot = kNull;
+	mFree = kNull;
+	mCount = bounds.GetComponentCount();
+	mSeen = bounds.NewVersion();
+	if (!mCount)
+	{
+		return;
+	}
+
+	// every node is allocated here, references stay valid while the tree is built
+	mNodes.reserve(2 * mCount - 1);
+	std::vector<BuildItem> items(mCount);
+	for (size_t n = 0; n < mCount; n++)
+	{
+		const auto i = ComponentInstance::Type(n + 1);
+		const int32_t leaf = AllocateNode();
+		Node& node = mNodes[leaf];
+		node.bounds = bounds.GetElement<BoundsManager::Bounds>(i);
+		node.box = node.bounds.Inflated(mMargin);
+		node.entity = bounds.GetEntity(i);
+		SetLeaf(node.entity, leaf);
+		items[n] = { node.box.Center(), leaf };
+	}
+	mRoot = BuildRange(items.data(), mCount, kNull);
+}
+
+int32_t SpatialIndex::BuildRange(BuildItem* items, size_t count, int32_t parent)
+{
+	if (count == 1)
+	{
+		mNodes[items[0].leaf].parent = parent;
+		return items[0].leaf;
+	}
+
+	// median split of the centers along their longest axis
+	math::Aabb centers;
+	for (size_t n = 0; n < count; n++)
+	{
+		centers.Extend(items[n].center);
+	}
+	const math::Vector3f size = centers.max - centers.min;
+	const size_t axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+	const size_t half = count / 2;
+	std::nth_element(items, items + half, items + count, [axis](BuildItem const& a, BuildItem const& b)
+	{
+		return a.center[axis] < b.center[axis];
+	});
+
+	const int32_t index = AllocateNode();
+	const int32_t left = BuildRange(items, half, index);
+	const int32_t right = BuildRange(items + half, count - half, index);
+	Node& node = mNodes[index];
+	node.parent = parent;
+	node.left = left;
+	node.right = right;
+	node.box = math::Union(mNodes[left].box, mNodes[right].box);
+	node.height = 1 + std::max(mNodes[left].height, mNodes[right].height);
+	return index;
+}
+
+void SpatialIndex::Sync(BoundsManager& bounds)
+{
+	const uint32_t since = mSeen;
+	mSeen = bounds.NewVersion();
+	bounds.ForEachChanged(since, [&](ComponentInstance::Type i)
+	{
+		const Entity e = bounds.GetEntity(i);
+		math::Aabb const& box = bounds.GetElement<BoundsManager::Bounds>(i);
+		if (Contains(e))
+		{
+			Move(e, box);
+		}
+		else
+		{
+			Insert(e, box);
+		}
+	});
+
+	// removals leave no trace in the change versions, but they leave more leaves than rows
+	if (mCount > bounds.GetComponentCount())
+	{
+		std::vector<Entity> gone;
+		for (int32_t leaf : mLeaves)
+		{
+			if (leaf != kNull && !bounds.GetInstance(mNodes[leaf].entity))
+			{
+				gone.push_back(mNodes[leaf].entity);
+			}
+		}
+		for (Entity e : gone)
+		{
+			Remove(e);
+		}
+	}
+}
+
+void SpatialIndex::Insert(Entity e, math::Aabb const& box)
+{
+	assert(!Contains(e));
+	const int32_t leaf = AllocateNode();
+	Node& node = mNodes[leaf];
+	node.bounds = box;
+	node.box = box.Inflated(mMargin);
+	node.entity = e;
+	SetLeaf(e, leaf);
+	InsertLeaf(leaf);
+	mCount++;
+}
+
+void SpatialIndex::Remove(Entity e)
+{
+	assert(Contains(e));
+	const int32_t leaf = mLeaves[e.GetId()];
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	mLeaves[e.GetId()] = kNull;
+	mCount--;
+}
+
+void SpatialIndex::Move(Entity e, math::Aabb const& box)
+{
+	assert(Contains(e));
+	const int32_t leaf = mLeaves[e.GetId()];
+	Node& node = mNodes[leaf];
+	node.bounds = box;
+	if (node.box.Contains(box))
+	{
+		return;
+	}
+	RemoveLeaf(leaf);
+	mNodes[leaf].box = box.Inflated(mMargin);
+	InsertLeaf(leaf);
+}
+
+void SpatialIndex::InsertLeaf(int32_t leaf)
+{
+	if (mRoot == kNull)
+	{
+		mRoot = leaf;
+		mNodes[leaf].parent = kNull;
+		return;
+	}
+
+	// walk down while pairing the leaf with a child is cheaper than with the node itself,
+	// by the surface area the tree grows
+	const math::Aabb box = mNodes[leaf].box;
+	int32_t index = mRoot;
+	while (!mNodes[index].IsLeaf())
+	{
+		Node const& node = mNodes[index];
+		const float area = node.box.HalfArea();
+		const float combined = math::Union(node.box, box).HalfArea();
+		const float cost = 2.0f * combined;
+		const float inherited = 2.0f * (combined - area);
+		auto descend = [&](int32_t child)
+		{
+			Node const& c = mNodes[child];
+			const float grown = math::Union(c.box, box).HalfArea();
+			return (c.IsLeaf() ? grown : grown - c.box.HalfArea()) + inherited;
+		};
+		const float left = descend(node.left);
+		const float right = descend(node.right);
+		if (cost < left && cost < right)
+		{
+			break;
+		}
+		index = left < right ? node.left : node.right;
+	}
+
+	const int32_t sibling = index;
+	const int32_t oldParent = mNodes[sibling].parent;
+	const int32_t parent = AllocateNode();
+	Node& node = mNodes[parent];
+	node.parent = oldParent;
+	node.left = sibling;
+	node.right = leaf;
+	node.box = math::Union(mNodes[sibling].box, box);
+	node.height = mNodes[sibling].height + 1;
+	if (oldParent == kNull)
+	{
+		mRoot = parent;
+	}
+	else if (mNodes[oldParent].left == sibling)
+	{
+		mNodes[oldParent].left = parent;
+	}
+	else
+	{
+		mNodes[oldParent].right = parent;
+	}
+	mNodes[sibling].parent = parent;
+	mNodes[leaf].parent = parent;
+	FixUpwards(oldParent);
+}
+
+void SpatialIndex::RemoveLeaf(int32_t leaf)
+{
+	if (leaf == mRoot)
+	{
+		mRoot = kNull;
+		return;
+	}
+
+	// the sibling takes the place of the parent
+	const int32_t parent = mNodes[leaf].parent;
+	const int32_t grandParent = mNodes[parent].parent;
+	const int32_t sibling = mNodes[parent].left == leaf ? mNodes[parent].right : mNodes[parent].left;
+	mNodes[sibling].parent = grandParent;
+	FreeNode(parent);
+	if (grandParent == kNull)
+	{
+		mRoot = sibling;
+		return;
+	}
+	if (mNodes[grandParent].left == parent)
+	{
+		mNodes[grandParent].left = sibling;
+	}
+	else
+	{
+		mNodes[grandParent].right = sibling;
+	}
+	FixUpwards(grandParent);
+}
+
+void SpatialIndex::FixUpwards(int32_t index)
+{
+	while (index != kNull)
+	{
+		index = Balance(index);
+		Node& node = mNodes[index];
+		Node const& left = mNodes[node.left];
+		Node const& right = mNodes[node.right];
+		node.height = 1 + std::max(left.height, right.height);
+		node.box = math::Union(left.box, right.box);
+		index = node.parent;
+	}
+}
+
+int32_t SpatialIndex::Balance(int32_t iA)
+{
+	Node& a = mNodes[iA];
+	if (a.IsLeaf() || a.height < 2)
+	{
+		return iA;
+	}
+
+	const int32_t iB = a.left;
+	const int32_t iC = a.right;
+	Node& b = mNodes[iB];
+	Node& c = mNodes[iC];
+	const int32_t balance = c.height - b.height;
+
+	// the taller child becomes the parent of a, a keeps the shorter grandchild
+	auto replaceChild = [this](int32_t parent, int32_t from, int32_t to)
+	{
+		if (parent == kNull)
+		{
+			mRoot = to;
+		}
+		else if (mNodes[parent].left == from)
+		{
+			mNodes[parent].left = to;
+		}
+		else
+		{
+			mNodes[parent].right = to;
+		}
+	};
+
+	if (balance > 1)
+	{
+		const int32_t iF = c.left;
+		const int32_t iG = c.right;
+		Node& f = mNodes[iF];
+		Node& g = mNodes[iG];
+		c.left = iA;
+		c.parent = a.parent;
+		a.parent = iC;
+		replaceChild(c.parent, iA, iC);
+		if (f.height > g.height)
+		{
+			c.right = iF;
+			a.right = iG;
+			g.parent = iA;
+			a.box = math::Union(b.box, g.box);
+			c.box = math::Union(a.box, f.box);
+			a.height = 1 + std::max(b.height, g.height);
+			c.height = 1 + std::max(a.height, f.height);
+		}
+		else
+		{
+			c.right = iG;
+			a.right = iF;
+			f.parent = iA;
+			a.box = math::Union(b.box, f.box);
+			c.box = math::Union(a.box, g.box);
+			a.height = 1 + std::max(b.height, f.height);
+			c.height = 1 + std::max(a.height, g.height);
+		}
+		return iC;
+	}
+
+	if (balance < -1)
+	{
+		const int32_t iD = b.left;
+		const int32_t iE = b.right;
+		Node& d = mNodes[iD];
+		Node& e = mNodes[iE];
+		b.left = iA;
+		b.parent = a.parent;
+		a.parent = iB;
+		replaceChild(b.parent, iA, iB);
+		if (d.height > e.height)
+		{
+			b.right = iD;
+			a.left = iE;
+			e.parent = iA;
+			a.box = math::Union(c.box, e.box);
+			b.box = math::Union(a.box, d.box);
+			a.height = 1 + std::max(c.height, e.height);
+			b.height = 1 + std::max(a.height, d.height);
+		}
+		else
+		{
+			b.right = iE;
+			a.left = iD;
+			d.parent = iA;
+			a.box = math::Union(c.box, d.box);
+			b.box = math::Union(a.box, e.box);
+			a.height = 1 + std::max(c.height, d.height);
+			b.height = 1 + std::max(a.height, e.height);
+		}
+		return iB;
+	}
+	return iA;
+}
+
+bool SpatialIndex::Raycast(math::Vector3f const& origin, math::Vector3f const& direction, float maxDistance, RayHit& hit) const
+{
+	if (mRoot == kNull)
+	{
+		return false;
+	}
+	const math::Vector3f inv(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float best = maxDistance;
+	bool found = false;
+
+	int32_t stack[kMaxDepth];
+	size_t size = 0;
+	stack[size++] = mRoot;
+	while (size)
+	{
+		Node const& node = mNodes[stack[--size]];
+		if (node.IsLeaf())
+		{
+			const float t = node.bounds.Intersect(origin, inv, best);
+			if (t >= 0.0f && (!found || t < best))
+			{
+				best = t;
+				hit = { node.entity, t };
+				found = true;
+			}
+			continue;
+		}
+		const float tl = mNodes[node.left].box.Intersect(origin, inv, best);
+		const float tr = mNodes[node.right].box.Intersect(origin, inv, best);
+		// the nearer child is popped first and shortens the ray for the other
+		assert(size + 2 <= kMaxDepth);
+		if (tl >= 0.0f && tr >= 0.0f)
+		{
+			stack[size++] = tl < tr ? node.right : node.left;
+			stack[size++] = tl < tr ? node.left : node.right;
+		}
+		else if (tl >= 0.0f)
+		{
+			stack[size++] = node.left;
+		}
+		else if (tr >= 0.0f)
+		{
+			stack[size++] = node.right;
+		}
+	}
+	return found;
+}
+
+void SpatialIndex::QueryNearest(math::Vector3f const& point, size_t k, std::vector<Entity>& out) const
+{
+	out.clear();
+	if (mRoot == kNull || k == 0)
+	{
+		return;
+	}
+
+	// best first over the nodes by their distance, which never exceeds that of a leaf
+	// below them; stops once no node can beat the k-th result
+	using Item = std::pair<float, int32_t>;
+	std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+	std::vector<Item> results;
+	auto worse = [](Item const& a, Item const& b) { return a.first < b.first; };
+	open.emplace(mNodes[mRoot].box.DistanceSquared(point), mRoot);
+	while (!open.empty())
+	{
+		const Item item = open.top();
+		open.pop();
+		if (results.size() == k && item.first >= results.front().first)
+		{
+			break;
+		}
+		Node const& node = mNodes[item.second];
+		if (node.IsLeaf())
+		{
+			results.emplace_back(node.bounds.DistanceSquared(point), item.second);
+			std::push_heap(results.begin(), results.end(), worse);
+			if (results.size() > k)
+			{
+				std::pop_heap(results.begin(), results.end(), worse);
+				results.pop_back();
+			}
+			continue;
+		}
+		for (int32_t child : { node.left, node.right })
+		{
+			const float d = mNodes[child].box.DistanceSquared(point);
+			if (results.size() < k || d < results.front().first)
+			{
+				open.emplace(d, child);
+			}
+		}
+	}
+
+	std::sort_heap(results.begin(), results.end(), worse);
+	for (Item const& result : results)
+	{
+		out.push_back(mNodes[result.second].entity);
+	}
+}
+
+}
+}
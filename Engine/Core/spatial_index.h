@@ -0,0 +1,259 @@
+#pragma once
+#include "component_manager.h"
+#include "math/aabb.h"
+#include "math/vector.h"
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace redtea {
+namespace core {
+
+	// World space bounds of an entity, the input of SpatialIndex
+	class BoundsManager : public ComponentManagerBase<math::Aabb>
+	{
+	public:
+		enum
+		{
+			Bounds
+		};
+
+		PROXY_DEFINE(BoundsManager)
+			DEFINE_FEILD(Bounds, bounds)
+		PROXY_END()
+	};
+
+	// Dynamic AABB tree keyed by Entity. Leaves hold a box fattened by a margin, so a move
+	// that stays inside it costs nothing; a move out of it reinserts the leaf and refits its
+	// ancestors, with AVL style rotations keeping the tree balanced. Build makes a tree top
+	// down in one pass, Sync catches up with a BoundsManager through its change versions.
+	//
+	// Queries are const and keep their state on the stack, any number of threads may query
+	// at once as long as nobody changes the index meanwhile.
+	class SpatialIndex
+	{
+	public:
+		// a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all planes
+		struct Frustum
+		{
+			math::Vector4f planes[6];
+		};
+
+		struct RayHit
+		{
+			Entity entity;
+			float distance;
+		};
+
+		explicit SpatialIndex(float margin = 0.1f) : mMargin(margin) {}
+
+		// replaces the contents with every row of bounds
+		void Build(BoundsManager& bounds);
+		// rows of bounds written since the last Build or Sync are inserted or moved, entities
+		// that lost their bounds are removed
+		void Sync(BoundsManager& bounds);
+
+		void Insert(Entity e, math::Aabb const& box);
+		void Remove(Entity e);
+		void Move(Entity e, math::Aabb const& box);
+
+		bool Contains(Entity e) const noexcept
+		{
+			return e.GetId() < mLeaves.size() && mLeaves[e.GetId()] != kNull;
+		}
+		size_t GetCount() const noexcept { return mCount; }
+		// 0 when empty, 1 for a single leaf
+		uint32_t GetHeight() const noexcept { return mRoot == kNull ? 0 : mNodes[mRoot].height + 1; }
+
+		// f(Entity) for every entity whose bounds overlap
+		template<typename F>
+		void QueryAabb(math::Aabb const& box, F&& f) const;
+		template<typename F>
+		void QuerySphere(math::Vector3f const& center, float radius, F&& f) const;
+		// subtrees entirely inside are reported without testing their leaves
+		template<typename F>
+		void QueryFrustum(Frustum const& frustum, F&& f) const;
+
+		// closest bounds hit along direction, which need not be normalized, distances are
+		// in units of its length
+		bool Raycast(math::Vector3f const& origin, math::Vector3f const& direction, float maxDistance, RayHit& hit) const;
+
+		// the k entities with bounds closest to point, nearest first
+		void QueryNearest(math::Vector3f const& point, size_t k, std::vector<Entity>& out) const;
+
+	private:
+		static constexpr int32_t kNull = -1;
+		// a balanced tree of 2^32 leaves is far less deep
+		static constexpr size_t kMaxDepth = 128;
+
+		struct Node
+		{
+			// fattened for leaves
+			math::Aabb box;
+			// the exact bounds, leaves only
+			math::Aabb bounds;
+			int32_t parent;
+			int32_t left;
+			int32_t right;
+			int32_t height;
+			Entity entity;
+
+			bool IsLeaf() const noexcept { return left == kNull; }
+		};
+
+		// top down builds partition these instead of the nodes
+		struct BuildItem
+		{
+			math::Vector3f center;
+			int32_t leaf;
+		};
+
+		int32_t AllocateNode();
+		void FreeNode(int32_t node);
+		void InsertLeaf(int32_t leaf);
+		void RemoveLeaf(int32_t leaf);
+		// refits and rebalances from node up to the root
+		void FixUpwards(int32_t node);
+		int32_t Balance(int32_t node);
+		int32_t BuildRange(BuildItem* items, size_t count, int32_t parent);
+		void SetLeaf(Entity e, int32_t leaf);
+
+		template<typename Overlap, typename F>
+		void Traverse(Overlap&& overlap, F&& f) const;
+		template<typename F>
+		void ReportSubtree(int32_t node, F&& f) const;
+
+		std::vector<Node> mNodes;
+		// leaf per entity id, kNull for none
+		std::vector<int32_t> mLeaves;
+		int32_t mRoot = kNull;
+		int32_t mFree = kNull;
+		size_t mCount = 0;
+		float mMargin;
+		uint32_t mSeen = 0;
+	};
+
+	template<typename Overlap, typename F>
+	void SpatialIndex::Traverse(Overlap&& overlap, F&& f) const
+	{
+		if (mRoot == kNull)
+		{
+			return;
+		}
+		int32_t stack[kMaxDepth];
+		size_t size = 0;
+		stack[size++] = mRoot;
+		while (size)
+		{
+			Node const& node = mNodes[stack[--size]];
+			if (node.IsLeaf())
+			{
+				if (overlap(node.bounds))
+				{
+					f(node.entity);
+				}
+			}
+			else if (overlap(node.box))
+			{
+				assert(size + 2 <= kMaxDepth);
+				stack[size++] = node.right;
+				stack[size++] = node.left;
+			}
+		}
+	}
+
+	template<typename F>
+	void SpatialIndex::ReportSubtree(int32_t root, F&& f) const
+	{
+		int32_t stack[kMaxDepth];
+		size_t size = 0;
+		stack[size++] = root;
+		while (size)
+		{
+			Node const& node = mNodes[stack[--size]];
+			if (node.IsLeaf())
+			{
+				f(node.entity);
+			}
+			else
+			{
+				assert(size + 2 <= kMaxDepth);
+				stack[size++] = node.right;
+				stack[size++] = node.left;
+			}
+		}
+	}
+
+	template<typename F>
+	void SpatialIndex::QueryAabb(math::Aabb const& box, F&& f) const
+	{
+		Traverse([&box](math::Aabb const& b) { return box.Overlaps(b); }, f);
+	}
+
+	template<typename F>
+	void SpatialIndex::QuerySphere(math::Vector3f const& center, float radius, F&& f) const
+	{
+		const float r2 = radius * radius;
+		Traverse([&center, r2](math::Aabb const& b) { return b.DistanceSquared(center) <= r2; }, f);
+	}
+
+	template<typename F>
+	void SpatialIndex::QueryFrustum(Frustum const& frustum, F&& f) const
+	{
+		if (mRoot == kNull)
+		{
+			return;
+		}
+		// per plane the corner furthest along the normal decides outside, the nearest one
+		// decides inside
+		enum { Outside, Partial, Inside };
+		auto classify = [&frustum](math::Aabb const& b)
+		{
+			int result = Inside;
+			for (auto const& plane : frustum.planes)
+			{
+				const math::Vector3f far(plane.x >= 0 ? b.max.x : b.min.x, plane.y >= 0 ? b.max.y : b.min.y, plane.z >= 0 ? b.max.z : b.min.z);
+				if (dot(plane.xyz, far) + plane.w < 0)
+				{
+					return int(Outside);
+				}
+				const math::Vector3f near(plane.x >= 0 ? b.min.x : b.max.x, plane.y >= 0 ? b.min.y : b.max.y, plane.z >= 0 ? b.min.z : b.max.z);
+				if (dot(plane.xyz, near) + plane.w < 0)
+				{
+					result = Partial;
+				}
+			}
+			return result;
+		};
+
+		int32_t stack[kMaxDepth];
+		size_t size = 0;
+		stack[size++] = mRoot;
+		while (size)
+		{
+			const int32_t index = stack[--size];
+			Node const& node = mNodes[index];
+			const int side = classify(node.IsLeaf() ? node.bounds : node.box);
+			if (side == Outside)
+			{
+				continue;
+			}
+			if (node.IsLeaf())
+			{
+				f(node.entity);
+			}
+			else if (side == Inside)
+			{
+				ReportSubtree(index, f);
+			}
+			else
+			{
+				assert(size + 2 <= kMaxDepth);
+				stack[size++] = node.right;
+				stack[size++] = node.left;
+			}
+		}
+	}
+
+}
+}
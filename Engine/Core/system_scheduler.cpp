@@ -0,0 +1,260 @@
+#include "system_scheduler.h"
+#include "utils/thread_pool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
+namespace redtea {
+namespace core {
+
+namespace {
+
+	using Clock = std::chrono::steady_clock;
+
+	inline double Milliseconds(Clock::time_point from, Clock::time_point to) noexcept
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+}
+
+// systems are coarse, one lock around the bookkeeping costs nothing next to them
+struct SystemScheduler::FrameState
+{
+	std::mutex lock;
+	std::condition_variable done;
+	std::vector<uint32_t> pending;
+	std::vector<SystemId> ready;
+	size_t remaining = 0;
+	Clock::time_point start;
+};
+
+SystemScheduler::SystemId SystemScheduler::AddSystem(std::string name,
+	std::vector<IComponentManager const*> reads,
+	std::vector<IComponentManager const*> writes,
+	Function function)
+{
+	System system;
+	system.name = std::move(name);
+	system.reads = std::move(reads);
+	system.writes = std::move(writes);
+	system.function = std::move(function);
+	mSystems.push_back(std::move(system));
+	return SystemId(mSystems.size() - 1);
+}
+
+void SystemScheduler::SetEnabled(SystemId id, bool enabled)
+{
+	mSystems[id].enabled = enabled;
+}
+
+void SystemScheduler::BuildGraph()
+{
+	// per manager the last writer and the readers since then, which is enough to order
+	// every conflicting pair without listing each transitive edge
+	struct Access
+	{
+		SystemId writer = ~SystemId(0);
+		std::vector<SystemId> readers;
+	};
+	std::unordered_map<IComponentManager const*, Access> accesses;
+
+	for (auto& system : mSystems)
+	{
+		system.dependencies.clear();
+		system.successors.clear();
+	}
+	for (SystemId id = 0; id < mSystems.size(); id++)
+	{
+		System& system = mSystems[id];
+		if (!system.enabled)
+		{
+			continue;
+		}
+		auto& deps = system.dependencies;
+		for (auto manager : system.reads)
+		{
+			Access& access = accesses[manager];
+			if (access.writer != ~SystemId(0))
+			{
+				deps.push_back(access.writer);
+			}
+		}
+		for (auto manager : system.writes)
+		{
+			Access& access = accesses[manager];
+			if (access.writer != ~SystemId(0))
+			{
+				deps.push_back(access.writer);
+			}
+			deps.insert(deps.end(), access.readers.begin(), access.readers.end());
+		}
+		std::sort(deps.begin(), deps.end());
+		deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+		for (SystemId dep : deps)
+		{
+			mSystems[dep].successors.push_back(id);
+		}
+
+		for (auto manager : system.reads)
+		{
+			accesses[manager].readers.push_back(id);
+		}
+		for (auto manager : system.writes)
+		{
+			Access& access = accesses[manager];
+			access.writer = id;
+			access.readers.clear();
+		}
+	}
+
+	// edges always point forward, so a backward sweep sees every successor first
+	for (size_t n = mSystems.size(); n-- > 0;)
+	{
+		System& system = mSystems[n];
+		double tail = 0.0;
+		for (SystemId next : system.successors)
+		{
+			tail = std::max(tail, mSystems[next].priority);
+		}
+		// before the first frame every system weighs the same
+		system.priority = tail + std::max(system.timing.duration, 1e-3);
+	}
+}
+
+void SystemScheduler::Run(common::ThreadPool* pool)
+{
+	BuildGraph();
+
+	auto frame = std::make_shared<FrameState>();
+	frame->pending.resize(mSystems.size());
+	for (SystemId id = 0; id < mSystems.size(); id++)
+	{
+		System& system = mSystems[id];
+		system.timing = Timing();
+		if (!system.enabled)
+		{
+			continue;
+		}
+		frame->remaining++;
+		frame->pending[id] = uint32_t(system.dependencies.size());
+		if (frame->pending[id] == 0)
+		{
+			frame->ready.push_back(id);
+		}
+	}
+	frame->start = Clock::now();
+
+	if (pool && pool->getWorkerCount() > 0)
+	{
+		// one task per ready system, the caller only waits
+		for (size_t n = frame->ready.size(); n > 0; n--)
+		{
+			pool->submit([this, frame, pool]() { RunReady(frame, pool); });
+		}
+		std::unique_lock<std::mutex> guard(frame->lock);
+		frame->done.wait(guard, [&]() { return frame->remaining == 0; });
+	}
+	else
+	{
+		// every system releases its successors before the next one is taken
+		while (frame->remaining)
+		{
+			RunReady(frame, pool);
+		}
+	}
+
+	mFrameTime = Milliseconds(frame->start, Clock::now());
+	UpdateCriticalPath();
+}
+
+void SystemScheduler::RunReady(std::shared_ptr<FrameState> frame, common::ThreadPool* pool)
+{
+	// there are as many tasks as systems, so every task finds one, but not necessarily the
+	// one whose release submitted it
+	std::unique_lock<std::mutex> guard(frame->lock);
+	auto best = std::max_element(frame->ready.begin(), frame->ready.end(), [this](SystemId a, SystemId b)
+	{
+		// equal priorities keep registration order
+		return mSystems[a].priority < mSystems[b].priority
+			|| (mSystems[a].priority == mSystems[b].priority && a > b);
+	});
+	const SystemId id = *best;
+	frame->ready.erase(best);
+	guard.unlock();
+
+	System& system = mSystems[id];
+	const Clock::time_point start = Clock::now();
+	system.function(pool);
+	const Clock::time_point end = Clock::now();
+
+	guard.lock();
+	system.timing.start = Milliseconds(frame->start, start);
+	system.timing.duration = Milliseconds(start, end);
+	size_t released = 0;
+	for (SystemId next : system.successors)
+	{
+		if (--frame->pending[next] == 0)
+		{
+			frame->ready.push_back(next);
+			released++;
+		}
+	}
+	const bool finished = --frame->remaining == 0;
+	guard.unlock();
+
+	if (pool && pool->getWorkerCount() > 0)
+	{
+		for (; released > 0; released--)
+		{
+			pool->submit([this, frame, pool]() { RunReady(frame, pool); });
+		}
+	}
+	// Run may return as soon as it wakes up, the scheduler is not touched after this
+	if (finished)
+	{
+		frame->done.notify_all();
+	}
+}
+
+void SystemScheduler::UpdateCriticalPath()
+{
+	// registration order is a topological order
+	std::vector<double> finish(mSystems.size(), 0.0);
+	std::vector<SystemId> previous(mSystems.size(), ~SystemId(0));
+	SystemId last = ~SystemId(0);
+	mCriticalPathTime = 0.0;
+	for (SystemId id = 0; id < mSystems.size(); id++)
+	{
+		System const& system = mSystems[id];
+		if (!system.enabled)
+		{
+			continue;
+		}
+		double start = 0.0;
+		for (SystemId dep : system.dependencies)
+		{
+			if (previous[id] == ~SystemId(0) || finish[dep] > start)
+			{
+				start = finish[dep];
+				previous[id] = dep;
+			}
+		}
+		finish[id] = start + system.timing.duration;
+		if (last == ~SystemId(0) || finish[id] > mCriticalPathTime)
+		{
+			mCriticalPathTime = finish[id];
+			last = id;
+		}
+	}
+
+	mCriticalPath.clear();
+	for (SystemId id = last; id != ~SystemId(0); id = previous[id])
+	{
+		mCriticalPath.push_back(id);
+	}
+	std::reverse(mCriticalPath.begin(), mCriticalPath.end());
+}
+
+}
+}
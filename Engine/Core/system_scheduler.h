@@ -0,0 +1,92 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace redtea {
+namespace common {
+	class ThreadPool;
+}
+namespace core {
+
+class IComponentManager;
+
+// Registry of the systems making up a frame. Every system names the component managers it
+// reads and writes; two systems conflict when one writes a manager the other touches, and
+// a conflicting pair runs in registration order. Everything else may overlap on the pool.
+class SystemScheduler
+{
+public:
+	using SystemId = uint32_t;
+	// the pool is passed on so a system can go wide itself
+	using Function = std::function<void(common::ThreadPool*)>;
+
+	struct Timing
+	{
+		// milliseconds, start is relative to the beginning of the frame
+		double start = 0.0;
+		double duration = 0.0;
+	};
+
+	SystemId AddSystem(std::string name,
+		std::vector<IComponentManager const*> reads,
+		std::vector<IComponentManager const*> writes,
+		Function function);
+
+	// a disabled system is left out of the graph, nothing waits for it
+	void SetEnabled(SystemId id, bool enabled);
+	bool IsEnabled(SystemId id) const noexcept { return mSystems[id].enabled; }
+
+	size_t GetSystemCount() const noexcept { return mSystems.size(); }
+	std::string const& GetName(SystemId id) const noexcept { return mSystems[id].name; }
+
+	// systems that finish before id starts, as of the last Run
+	std::vector<SystemId> const& GetDependencies(SystemId id) const noexcept { return mSystems[id].dependencies; }
+
+	// runs one frame and returns when every enabled system is done. A system is handed to
+	// the pool as a task of its own once its dependencies are done, no worker waits on the
+	// graph. Without a pool everything runs on the caller. Must not be called from a pool task.
+	void Run(common::ThreadPool* pool = nullptr);
+
+	// statistics of the last Run
+	Timing const& GetTiming(SystemId id) const noexcept { return mSystems[id].timing; }
+	double GetFrameTime() const noexcept { return mFrameTime; }
+	// longest chain of dependent systems, weighted by their durations
+	std::vector<SystemId> const& GetCriticalPath() const noexcept { return mCriticalPath; }
+	double GetCriticalPathTime() const noexcept { return mCriticalPathTime; }
+
+private:
+	struct System
+	{
+		std::string name;
+		std::vector<IComponentManager const*> reads;
+		std::vector<IComponentManager const*> writes;
+		Function function;
+		bool enabled = true;
+		std::vector<SystemId> dependencies;
+		std::vector<SystemId> successors;
+		Timing timing;
+		// longest path to the end of the frame by the previous timings, ready systems
+		// with the longest tail start first
+		double priority = 0.0;
+	};
+
+	// bookkeeping of one Run, shared with its pool tasks
+	struct FrameState;
+
+	void BuildGraph();
+	// runs the most urgent ready system and hands the systems it releases to the pool
+	void RunReady(std::shared_ptr<FrameState> frame, common::ThreadPool* pool);
+	void UpdateCriticalPath();
+
+	std::vector<System> mSystems;
+	std::vector<SystemId> mCriticalPath;
+	double mCriticalPathTime = 0.0;
+	double mFrameTime = 0.0;
+};
+
+}
+}
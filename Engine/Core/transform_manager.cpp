@@ -0,0 +1,820 @@
+#include "transform_manager.h"
+#include "utils/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <typeinfo>
+
+namespace redtea {
+namespace core {
+
+namespace {
+
+	// rows per task when a level goes wide
+	static constexpr size_t kUpdateGrain = 4096;
+
+	// T * R * S, column major
+	inline void Compose(math::Vector3f const& t, math::Quaternion<float> const& q, math::Vector3f const& s, math::Mat4f& out) noexcept
+	{
+		const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+		out.data[0] = math::Vector4f((1 - 2 * (yy + zz)) * s.x, 2 * (xy + wz) * s.x, 2 * (xz - wy) * s.x, 0.0f);
+		out.data[1] = math::Vector4f(2 * (xy - wz) * s.y, (1 - 2 * (xx + zz)) * s.y, 2 * (yz + wx) * s.y, 0.0f);
+		out.data[2] = math::Vector4f(2 * (xz + wy) * s.z, 2 * (yz - wx) * s.z, (1 - 2 * (xx + yy)) * s.z, 0.0f);
+		out.data[3] = math::Vector4f(t.x, t.y, t.z, 1.0f);
+	}
+
+	// parent * local for affine matrices, the last row is known to be (0, 0, 0, 1)
+	inline void MultiplyAffine(math::Mat4f const& p, math::Mat4f const& l, math::Mat4f& out) noexcept
+	{
+		for (size_t c = 0; c < 4; c++)
+		{
+			const math::Vector4f& lc = l.data[c];
+			out.data[c] = math::Vector4f(
+				p.data[0].x * lc.x + p.data[1].x * lc.y + p.data[2].x * lc.z + p.data[3].x * lc.w,
+				p.data[0].y * lc.x + p.data[1].y * lc.y + p.data[2].y * lc.z + p.data[3].y * lc.w,
+				p.data[0].z * lc.x + p.data[1].z * lc.y + p.data[2].z * lc.z + p.data[3].z * lc.w,
+				lc.w);
+		}
+	}
+}
+
+TransformManager::Instance TransformManager::AddComponent(Entity e, Instance parent)
+{
+	if (HasComponent(e))
+	{
+		// one transform per entity
+		return GetInstance(e);
+	}
+
+	Instance i = PushRow(e);
+	Emit(EntityEvent::ComponentAdded, &e, 1);
+	GetElement<Position>(i) = math::Vector3f(0.0f);
+	GetElement<Rotation>(i) = math::Quaternion<float>(1.0f);
+	GetElement<Scale>(i) = math::Vector3f(1.0f);
+	GetElement<World>(i) = math::Mat4f();
+	GetElement<Parent>(i) = 0;
+	GetElement<FirstChild>(i) = 0;
+	GetElement<NextSibling>(i) = 0;
+	GetElement<PrevSibling>(i) = 0;
+	GetElement<UpdateStamp>(i) = 0;
+
+	// the new row sits at the end of the deepest level
+	if (mLevels.empty())
+	{
+		mLevels.push_back(i);
+	}
+	GetElement<Depth>(i) = uint32_t(mLevels.size() - 1);
+
+	Link(i, parent);
+	i = MoveToLevel(i, parent ? GetDepth(parent) + 1 : 0);
+	MarkDirty(i);
+	return i;
+}
+
+TransformManager::Instance TransformManager::RemoveComponent(Entity e)
+{
+	Instance i = GetInstance(e);
+	if (!i)
+	{
+		return 0;
+	}
+
+	// orphan the children first, this moves rows around so work with entities
+	mSubtree.clear();
+	for (Instance c = GetFirstChild(i); c; c = GetNextSibling(c))
+	{
+		mSubtree.push_back(GetEntity(c));
+	}
+	std::vector<Entity> children;
+	children.swap(mSubtree);
+	for (Entity child : children)
+	{
+		SetParent(GetInstance(child), 0);
+	}
+
+	i = GetInstance(e);
+	Unlink(i);
+	// a leaf can go to the deepest level, whose last row is the last row of mData
+	i = MoveToLevel(i, uint32_t(mLevels.size() - 1));
+	const Instance last = Instance(mData.size() - 1);
+	SwapNodes(i, last);
+	mData.pop_back();
+	SetInstance(e, 0);
+	TrimLevels();
+	Emit(EntityEvent::ComponentRemoved, &e, 1);
+	return last;
+}
+
+void TransformManager::AddComponents(Entity const* entities, size_t count)
+{
+	mData.ensureCapacity(mData.size() + count);
+	for (size_t n = 0; n < count; n++)
+	{
+		AddComponent(entities[n]);
+	}
+}
+
+void TransformManager::RemoveComponents(Entity const* entities, size_t count)
+{
+	for (size_t n = 0; n < count; n++)
+	{
+		RemoveComponent(entities[n]);
+	}
+}
+
+void TransformManager::RemoveComponents(EntityMask const& dying)
+{
+	// every link left must point at a survivor: orphans become roots, and dying nodes
+	// leave the child lists of surviving parents. Links inside dying subtrees go with them.
+	std::vector<Entity> orphans;
+	{
+		Entity const* entity = data<ENTITY_INDEX>();
+		Instance const* parent = data<Parent>();
+		for (size_t r = 1; r < mData.size(); r++)
+		{
+			if (parent[r] && !dying.Test(entity[r]) && dying.Test(entity[parent[r]]))
+			{
+				orphans.push_back(entity[r]);
+			}
+		}
+	}
+	for (Entity e : orphans)
+	{
+		SetParent(GetInstance(e), 0);
+	}
+	for (size_t r = 1; r < mData.size(); r++)
+	{
+		const Instance p = GetParent(Instance(r));
+		if (p && dying.Test(GetEntity(Instance(r))) && !dying.Test(GetEntity(p)))
+		{
+			Unlink(Instance(r));
+		}
+	}
+
+	const size_t size = mData.size();
+	auto& remap = mScratch;
+	if (!CompactRows(dying, remap))
+	{
+		return;
+	}
+
+	Instance* parent = data<Parent>();
+	Instance* firstChild = data<FirstChild>();
+	Instance* nextSibling = data<NextSibling>();
+	Instance* prevSibling = data<PrevSibling>();
+	for (size_t r = 1; r < mData.size(); r++)
+	{
+		parent[r] = remap[parent[r]];
+		firstChild[r] = remap[firstChild[r]];
+		nextSibling[r] = remap[nextSibling[r]];
+		prevSibling[r] = remap[prevSibling[r]];
+	}
+
+	// a level now starts after the survivors of the levels above it
+	size_t level = 0;
+	size_t live = 0;
+	for (size_t r = 1; r <= size; r++)
+	{
+		while (level < mLevels.size() && mLevels[level] == r)
+		{
+			mLevels[level++] = Instance(live + 1);
+		}
+		live += r < size && remap[r];
+	}
+	TrimLevels();
+#ifndef NDEBUG
+	for (size_t l = 1; l < mLevels.size(); l++)
+	{
+		assert(mLevels[l - 1] < mLevels[l]);
+	}
+#endif
+}
+
+std::vector<TransformManager::Instance> TransformManager::OpenLevels(std::vector<Instance> const& inserted)
+{
+	// level l keeps its place shifted by the rows inserted above it. Its live rows past the
+	// shift stay put, the first ones, now covered by the level above, go to the end of the
+	// level, so no more rows move than were inserted above each level
+	const size_t levels = std::max(mLevels.size(), inserted.size());
+	std::vector<Instance> liveFirst(levels), moved(levels), merged(levels), gaps(levels);
+	size_t shift = 0;
+	for (size_t l = 0; l < levels; l++)
+	{
+		liveFirst[l] = l < mLevels.size() ? mLevels[l] : Instance(mData.size());
+		const size_t liveEnd = l < mLevels.size() ? LevelEnd(l) : mData.size();
+		moved[l] = Instance(std::min(shift, liveEnd - liveFirst[l]));
+		merged[l] = Instance(liveFirst[l] + shift);
+		gaps[l] = Instance(liveEnd + shift);
+		shift += l < inserted.size() ? inserted[l] : 0;
+	}
+
+	// the rows moving out of a level land where the deeper levels moved out of before
+	ResizeRows(mData.size() + shift);
+	for (size_t l = levels; l-- > 0;)
+	{
+		const size_t first = liveFirst[l];
+		const size_t to = gaps[l] - moved[l];
+		const size_t count = moved[l];
+		if (count)
+		{
+			mData.forEach([first, to, count](auto* p)
+			{
+				std::move(p + first, p + first + count, p + to);
+			});
+		}
+	}
+
+	// links point one level up for the parent, one down for the first child and to the
+	// same level for siblings. The moved rows renumber their own links first, then their
+	// neighbours are pointed at them: siblings and parents before the children, whose
+	// sibling lists have to be right to be walked.
+	auto live = [&](Instance v, size_t l)
+	{
+		return v && v >= liveFirst[l] && v < liveFirst[l] + moved[l] ? Instance(v - liveFirst[l] + gaps[l] - moved[l]) : v;
+	};
+	Instance* parent = data<Parent>();
+	Instance* firstChild = data<FirstChild>();
+	Instance* nextSibling = data<NextSibling>();
+	Instance* prevSibling = data<PrevSibling>();
+	for (size_t l = 0; l < levels; l++)
+	{
+		for (size_t r = gaps[l] - moved[l]; r < gaps[l]; r++)
+		{
+			parent[r] = live(parent[r], l - 1);
+			firstChild[r] = live(firstChild[r], l + 1);
+			nextSibling[r] = live(nextSibling[r], l);
+			prevSibling[r] = live(prevSibling[r], l);
+		}
+	}
+	for (size_t l = 0; l < levels; l++)
+	{
+		for (size_t r = gaps[l] - moved[l]; r < gaps[l]; r++)
+		{
+			if (prevSibling[r])
+			{
+				nextSibling[prevSibling[r]] = Instance(r);
+			}
+			else if (parent[r])
+			{
+				firstChild[parent[r]] = Instance(r);
+			}
+			if (nextSibling[r])
+			{
+				prevSibling[nextSibling[r]] = Instance(r);
+			}
+		}
+	}
+	for (size_t l = 0; l < levels; l++)
+	{
+		for (size_t r = gaps[l] - moved[l]; r < gaps[l]; r++)
+		{
+			for (Instance c = firstChild[r]; c; c = nextSibling[c])
+			{
+				parent[c] = Instance(r);
+			}
+		}
+		Reindex(gaps[l] - moved[l], moved[l]);
+	}
+	mLevels = merged;
+	return gaps;
+}
+
+void TransformManager::Reindex(Instance first, size_t count)
+{
+	Entity const* entities = data<ENTITY_INDEX>();
+	for (size_t r = first; r < first + count; r++)
+	{
+		SetInstance(entities[r], Instance(r));
+		MarkChanged(Instance(r));
+	}
+}
+
+void TransformManager::AppendComponents(IComponentManager& source)
+{
+	assert(typeid(*this) == typeid(source));
+	auto& from = static_cast<TransformManager&>(source);
+	if (!from.GetComponentCount())
+	{
+		return;
+	}
+
+	std::vector<Instance> stagedFirst(from.mLevels.size()), stagedCount(from.mLevels.size());
+	for (size_t l = 0; l < from.mLevels.size(); l++)
+	{
+		stagedFirst[l] = from.mLevels[l];
+		stagedCount[l] = from.LevelEnd(l) - from.mLevels[l];
+	}
+	std::vector<Instance> gaps = OpenLevels(stagedCount);
+
+	auto staged = [&](Instance v, size_t l) { return v ? Instance(v - stagedFirst[l] + gaps[l]) : 0; };
+	Instance* parent = data<Parent>();
+	Instance* firstChild = data<FirstChild>();
+	Instance* nextSibling = data<NextSibling>();
+	Instance* prevSibling = data<PrevSibling>();
+	uint32_t* stamp = data<UpdateStamp>();
+	for (size_t l = 0; l < stagedCount.size(); l++)
+	{
+		MoveRows(from, stagedFirst[l], gaps[l], stagedCount[l]);
+		for (size_t r = gaps[l]; r < gaps[l] + stagedCount[l]; r++)
+		{
+			parent[r] = staged(parent[r], l - 1);
+			firstChild[r] = staged(firstChild[r], l + 1);
+			nextSibling[r] = staged(nextSibling[r], l);
+			prevSibling[r] = staged(prevSibling[r], l);
+			// stamps of the other manager mean nothing here
+			stamp[r] = 0;
+		}
+	}
+
+	for (size_t l = 0; l < stagedCount.size(); l++)
+	{
+		Reindex(gaps[l], stagedCount[l]);
+	}
+	mDirty |= from.mDirty;
+
+	Emit(EntityEvent::ComponentAdded, from.data<ENTITY_INDEX>() + 1, from.GetComponentCount());
+	from.ClearComponents();
+}
+
+void TransformManager::ClearComponents()
+{
+	ComponentManagerBase::ClearComponents();
+	mLevels.clear();
+	mDirty = false;
+}
+
+void TransformManager::SaveColumn(size_t column, Instance const* rows, size_t count, void* out) const
+{
+	ComponentManagerBase::SaveColumn(column, rows, count, out);
+	const bool link = column == Parent || column == FirstChild || column == NextSibling || column == PrevSibling;
+	if (!rows || !link)
+	{
+		return;
+	}
+
+	std::vector<Instance> saved(mData.size(), 0);
+	for (size_t n = 0; n < count; n++)
+	{
+		assert(n == 0 || rows[n - 1] < rows[n]);
+		saved[rows[n]] = Instance(n + 1);
+	}
+
+	// children and siblings that are not saved are skipped along the sibling list
+	Instance* links = static_cast<Instance*>(out);
+	for (size_t n = 0; n < count; n++)
+	{
+		Instance v = links[n];
+		if (column == PrevSibling)
+		{
+			while (v && !saved[v])
+			{
+				v = GetElement<PrevSibling>(v);
+			}
+		}
+		else if (column != Parent)
+		{
+			while (v && !saved[v])
+			{
+				v = GetNextSibling(v);
+			}
+		}
+		// a parent that is not saved leaves 0 behind a nonzero depth, which CheckRows rejects
+		links[n] = saved[v];
+	}
+}
+
+bool TransformManager::CheckRows(size_t count, void const* const* columns) const
+{
+	// row r of the file is at index r - 1, links are rows and 0 is none
+	Instance const* parents = static_cast<Instance const*>(columns[Parent]);
+	Instance const* firstChildren = static_cast<Instance const*>(columns[FirstChild]);
+	Instance const* nextSiblings = static_cast<Instance const*>(columns[NextSibling]);
+	Instance const* prevSiblings = static_cast<Instance const*>(columns[PrevSibling]);
+	uint32_t const* depths = static_cast<uint32_t const*>(columns[Depth]);
+
+	std::vector<uint32_t> childCounts(count + 1, 0);
+	for (size_t r = 1; r <= count; r++)
+	{
+		const uint32_t depth = depths[r - 1];
+		const uint32_t previous = r > 1 ? depths[r - 2] : 0;
+		if ((r == 1 ? depth != 0 : depth < previous || depth > previous + 1)
+			|| firstChildren[r - 1] > count || nextSiblings[r - 1] > count || prevSiblings[r - 1] > count)
+		{
+			return false;
+		}
+		const Instance parent = parents[r - 1];
+		if (parent >= r || (parent ? depths[parent - 1] + 1 != depth : depth != 0))
+		{
+			return false;
+		}
+		if (parent)
+		{
+			childCounts[parent]++;
+		}
+		else if (nextSiblings[r - 1] || prevSiblings[r - 1])
+		{
+			return false;
+		}
+	}
+
+	// a list longer than the children of its node has a cycle
+	for (size_t p = 1; p <= count; p++)
+	{
+		uint32_t children = 0;
+		Instance previous = 0;
+		for (Instance c = firstChildren[p - 1]; c; c = nextSiblings[c - 1])
+		{
+			if (children++ == childCounts[p] || parents[c - 1] != p || prevSiblings[c - 1] != previous)
+			{
+				return false;
+			}
+			previous = c;
+		}
+		if (children != childCounts[p])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TransformManager::LoadRows(Entity const* entities, size_t count, void const* const* columns)
+{
+	if (!ComponentManagerBase::LoadRows(entities, count, columns))
+	{
+		return false;
+	}
+	mLevels.clear();
+	mFrame = 0;
+	mDirty = false;
+	uint32_t const* depth = data<Depth>();
+	uint32_t* stamp = data<UpdateStamp>();
+	uint8_t const* dirty = data<Dirty>();
+	for (size_t r = 1; r <= count; r++)
+	{
+		if (depth[r] == mLevels.size())
+		{
+			mLevels.push_back(Instance(r));
+		}
+		stamp[r] = 0;
+		mDirty |= dirty[r] != 0;
+	}
+	return true;
+}
+
+void TransformManager::SetParent(Instance i, Instance parent)
+{
+	assert(i && i != parent);
+	if (GetParent(i) == parent)
+	{
+		return;
+	}
+#ifndef NDEBUG
+	// i must not become its own ancestor
+	for (Instance p = parent; p; p = GetParent(p))
+	{
+		assert(p != i);
+	}
+#endif
+
+	Unlink(i);
+	Link(i, parent);
+	MarkDirty(i);
+
+	const int32_t delta = int32_t(parent ? GetDepth(parent) + 1 : 0) - int32_t(GetDepth(i));
+	if (delta == 0)
+	{
+		return;
+	}
+
+	// every node of the subtree changes level by the same amount, rows move while doing it
+	mSubtree.clear();
+	mSubtree.push_back(GetEntity(i));
+	for (size_t n = 0; n < mSubtree.size(); n++)
+	{
+		for (Instance c = GetFirstChild(GetInstance(mSubtree[n])); c; c = GetNextSibling(c))
+		{
+			mSubtree.push_back(GetEntity(c));
+		}
+	}
+	for (Entity node : mSubtree)
+	{
+		const Instance current = GetInstance(node);
+		MoveToLevel(current, uint32_t(int32_t(GetDepth(current)) + delta));
+	}
+	TrimLevels();
+}
+
+void TransformManager::SetLocalTransform(Instance i, math::Vector3f const& position,
+	math::Quaternion<float> const& rotation, math::Vector3f const& scale) noexcept
+{
+	GetElement<Position>(i) = position;
+	GetElement<Rotation>(i) = rotation;
+	GetElement<Scale>(i) = scale;
+	MarkDirty(i);
+}
+
+void TransformManager::SetPosition(Instance i, math::Vector3f const& position) noexcept
+{
+	GetElement<Position>(i) = position;
+	MarkDirty(i);
+}
+
+void TransformManager::SetRotation(Instance i, math::Quaternion<float> const& rotation) noexcept
+{
+	GetElement<Rotation>(i) = rotation;
+	MarkDirty(i);
+}
+
+void TransformManager::SetScale(Instance i, math::Vector3f const& scale) noexcept
+{
+	GetElement<Scale>(i) = scale;
+	MarkDirty(i);
+}
+
+size_t TransformManager::Update(common::ThreadPool* pool)
+{
+	if (!mDirty)
+	{
+		return 0;
+	}
+	const uint32_t frame = ++mFrame;
+	std::atomic<size_t> updated{ 0 };
+
+	auto const* RESTRICT position = data<Position>();
+	auto const* RESTRICT rotation = data<Rotation>();
+	auto const* RESTRICT scale = data<Scale>();
+	auto const* RESTRICT parent = data<Parent>();
+	auto* RESTRICT world = data<World>();
+	auto* RESTRICT stamp = data<UpdateStamp>();
+	auto* RESTRICT dirty = data<Dirty>();
+	auto* RESTRICT version = data<VERSION_INDEX>();
+	uint32_t* RESTRICT chunkVersion = mChunkVersions.data();
+	const uint32_t current = mVersion;
+
+	// a node is rewritten when it changed itself or its parent was rewritten this frame,
+	// the parent sits on the previous level so its stamp is final
+	auto updateRange = [&](size_t first, size_t last)
+	{
+		size_t count = 0;
+		math::Mat4f local;
+		for (size_t k = first; k < last; k++)
+		{
+			const Instance p = parent[k];
+			if (!dirty[k] && !(p && stamp[p] == frame))
+			{
+				continue;
+			}
+			if (p)
+			{
+				Compose(position[k], rotation[k], scale[k], local);
+				MultiplyAffine(world[p], local, world[k]);
+			}
+			else
+			{
+				Compose(position[k], rotation[k], scale[k], world[k]);
+			}
+			stamp[k] = frame;
+			dirty[k] = 0;
+			version[k] = current;
+			chunkVersion[k >> CHUNK_SHIFT] = current;
+			count++;
+		}
+		updated.fetch_add(count, std::memory_order_relaxed);
+	};
+
+	for (size_t level = 0; level < mLevels.size(); level++)
+	{
+		const auto range = GetLevelRange(level);
+		if (pool)
+		{
+			pool->parallelFor(range.first, range.second, kUpdateGrain, updateRange);
+		}
+		else
+		{
+			updateRange(range.first, range.second);
+		}
+	}
+	mDirty = false;
+	return updated.load(std::memory_order_relaxed);
+}
+
+void TransformManager::MarkDirty(Instance i) noexcept
+{
+	GetElement<Dirty>(i) = 1;
+	mDirty = true;
+	MarkChanged(i);
+}
+
+void TransformManager::Link(Instance i, Instance parent) noexcept
+{
+	GetElement<Parent>(i) = parent;
+	GetElement<PrevSibling>(i) = 0;
+	GetElement<NextSibling>(i) = 0;
+	if (parent)
+	{
+		const Instance next = GetFirstChild(parent);
+		GetElement<NextSibling>(i) = next;
+		if (next)
+		{
+			GetElement<PrevSibling>(next) = i;
+		}
+		GetElement<FirstChild>(parent) = i;
+	}
+}
+
+void TransformManager::Unlink(Instance i) noexcept
+{
+	const Instance parent = GetParent(i);
+	const Instance prev = GetElement<PrevSibling>(i);
+	const Instance next = GetElement<NextSibling>(i);
+	if (prev)
+	{
+		GetElement<NextSibling>(prev) = next;
+	}
+	else if (parent)
+	{
+		GetElement<FirstChild>(parent) = next;
+	}
+	if (next)
+	{
+		GetElement<PrevSibling>(next) = prev;
+	}
+	GetElement<Parent>(i) = 0;
+	GetElement<PrevSibling>(i) = 0;
+	GetElement<NextSibling>(i) = 0;
+}
+
+void TransformManager::SwapNodes(Instance i, Instance j)
+{
+	if (i == j)
+	{
+		return;
+	}
+
+	// every row holding a link to i or j, each one must be patched exactly once
+	auto& touched = mScratch;
+	touched.clear();
+	auto gather = [this, &touched](Instance n)
+	{
+		touched.push_back(n);
+		touched.push_back(GetParent(n));
+		touched.push_back(GetElement<PrevSibling>(n));
+		touched.push_back(GetNextSibling(n));
+		for (Instance c = GetFirstChild(n); c; c = GetNextSibling(c))
+		{
+			touched.push_back(c);
+		}
+	};
+	gather(i);
+	gather(j);
+	std::sort(touched.begin(), touched.end());
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+	mData.swap(i, j);
+	SetInstance(GetEntity(i), i);
+	SetInstance(GetEntity(j), j);
+	MarkChanged(i);
+	MarkChanged(j);
+
+	auto remap = [i, j](Instance v) { return v == i ? j : (v == j ? i : v); };
+	for (Instance n : touched)
+	{
+		if (!n)
+		{
+			continue;
+		}
+		const Instance row = remap(n);
+		GetElement<Parent>(row) = remap(GetElement<Parent>(row));
+		GetElement<FirstChild>(row) = remap(GetElement<FirstChild>(row));
+		GetElement<NextSibling>(row) = remap(GetElement<NextSibling>(row));
+		GetElement<PrevSibling>(row) = remap(GetElement<PrevSibling>(row));
+	}
+}
+
+TransformManager::Instance TransformManager::MoveToLevel(Instance i, uint32_t level)
+{
+	while (level >= mLevels.size())
+	{
+		mLevels.push_back(Instance(mData.size()));
+	}
+
+	// walk through the levels in between, swapping with the boundary row and moving the
+	// boundary over it, which costs one swap per level crossed
+	uint32_t current = GetDepth(i);
+	while (current < level)
+	{
+		const Instance last = LevelEnd(current) - 1;
+		SwapNodes(i, last);
+		i = last;
+		mLevels[++current]--;
+	}
+	while (current > level)
+	{
+		const Instance first = mLevels[current];
+		SwapNodes(i, first);
+		i = first;
+		mLevels[current--]++;
+	}
+	GetElement<Depth>(i) = level;
+	return i;
+}
+
+void TransformManager::TrimLevels() noexcept
+{
+	while (!mLevels.empty() && mLevels.back() == mData.size())
+	{
+		mLevels.pop_back();
+	}
+}
+
+void TransformManager::InstantiateRows(Entity const* entities, size_t copies, size_t rowCount, void const* const* columns)
+{
+	if (!copies || !rowCount)
+	{
+		return;
+	}
+
+	// template rows are in level order, each level of the template gets a gap holding
+	// that level of every copy
+	uint32_t const* depth = static_cast<uint32_t const*>(columns[Depth]);
+	std::vector<size_t> levelFirst;
+	for (size_t t = 0; t < rowCount; t++)
+	{
+		assert(depth[t] + 1 >= levelFirst.size() && depth[t] <= levelFirst.size());
+		if (depth[t] == levelFirst.size())
+		{
+			levelFirst.push_back(t);
+		}
+	}
+	const size_t levels = levelFirst.size();
+	levelFirst.push_back(rowCount);
+	std::vector<Instance> inserted(levels);
+	for (size_t l = 0; l < levels; l++)
+	{
+		inserted[l] = Instance(copies * (levelFirst[l + 1] - levelFirst[l]));
+	}
+	std::vector<Instance> gaps = OpenLevels(inserted);
+	auto rowOf = [&](size_t k, size_t t)
+	{
+		const size_t l = depth[t];
+		return Instance(gaps[l] + k * (levelFirst[l + 1] - levelFirst[l]) + (t - levelFirst[l]));
+	};
+
+	std::vector<SnapshotColumn> layout;
+	GetSnapshotLayout(layout);
+	for (size_t c = 0; c < layout.size(); c++)
+	{
+		const size_t size = layout[c].elementSize;
+		uint8_t* dst = static_cast<uint8_t*>(ColumnData(c));
+		uint8_t const* src = static_cast<uint8_t const*>(columns[c]);
+		for (size_t l = 0; l < levels; l++)
+		{
+			// the copies of a level are back to back
+			const size_t n = levelFirst[l + 1] - levelFirst[l];
+			uint8_t* block = dst + gaps[l] * size;
+			for (size_t k = 0; k < copies; k++)
+			{
+				std::memcpy(block + k * n * size, src + levelFirst[l] * size, n * size);
+			}
+		}
+	}
+
+	// template links are 1 based rows of the template, 0 for none
+	Instance* parent = data<Parent>();
+	Instance* firstChild = data<FirstChild>();
+	Instance* nextSibling = data<NextSibling>();
+	Instance* prevSibling = data<PrevSibling>();
+	uint32_t* stamp = data<UpdateStamp>();
+	uint8_t const* dirty = data<Dirty>();
+	Entity* rows = data<ENTITY_INDEX>();
+	for (size_t k = 0; k < copies; k++)
+	{
+		auto link = [&](Instance v) { return v ? rowOf(k, v - 1) : Instance(0); };
+		for (size_t t = 0; t < rowCount; t++)
+		{
+			const Instance r = rowOf(k, t);
+			parent[r] = link(parent[r]);
+			firstChild[r] = link(firstChild[r]);
+			nextSibling[r] = link(nextSibling[r]);
+			prevSibling[r] = link(prevSibling[r]);
+			stamp[r] = 0;
+			rows[r] = entities[k * rowCount + t];
+		}
+	}
+	for (size_t t = 0; t < rowCount; t++)
+	{
+		mDirty |= dirty[rowOf(0, t)] != 0;
+	}
+
+	for (size_t l = 0; l < levels; l++)
+	{
+		Reindex(gaps[l], inserted[l]);
+	}
+	Emit(EntityEvent::ComponentAdded, entities, copies * rowCount);
+}
+
+}
+}
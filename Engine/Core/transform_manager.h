@@ -0,0 +1,145 @@
+#pragma once
+#include "component_manager.h"
+#include "math/vector.h"
+#include "math/quaternion.h"
+#include "math/matrix.h"
+#include <utility>
+#include <vector>
+
+namespace redtea {
+namespace common {
+	class ThreadPool;
+}
+namespace core {
+
+	// Scene graph built on ComponentManagerBase. Rows are kept in level order, all roots
+	// first, then every node of depth 1 and so on, so a parent always precedes its children
+	// and each level is a contiguous range that can be updated in parallel once the level
+	// above it is done. Instances move on AddComponent, RemoveComponent and SetParent.
+	class TransformManager : public ComponentManagerBase<
+		math::Vector3f,				// local position
+		math::Quaternion<float>,	// local rotation
+		math::Vector3f,				// local scale
+		math::Mat4f,				// world
+		ComponentInstance::Type,	// parent
+		ComponentInstance::Type,	// first child
+		ComponentInstance::Type,	// next sibling
+		ComponentInstance::Type,	// previous sibling
+		uint32_t,					// depth
+		uint32_t,					// last Update that rewrote the world matrix
+		uint8_t>					// local transform changed since the last Update
+	{
+	public:
+		using Instance = ComponentInstance::Type;
+
+		enum
+		{
+			Position,
+			Rotation,
+			Scale,
+			World,
+			Parent,
+			FirstChild,
+			NextSibling,
+			PrevSibling,
+			Depth,
+			UpdateStamp,
+			Dirty
+		};
+
+		// local transform starts as identity, parent 0 makes a root
+		Instance AddComponent(Entity e, Instance parent = 0);
+
+		// children of e become roots and keep their local transform
+		Instance RemoveComponent(Entity e);
+
+		// batches add roots and cost one AddComponent / RemoveComponent per entity, rows
+		// cannot be swapped around without breaking the level order
+		void AddComponents(Entity const* entities, size_t count) override;
+		void RemoveComponents(Entity const* entities, size_t count) override;
+
+		// a stable compaction keeps the level order, only surviving children of dying nodes
+		// are moved one by one as they become roots
+		void RemoveComponents(EntityMask const& dying) override;
+
+		// merges level by level, the rows of source land at the end of each level. Live
+		// roots stay put, and a deeper level moves no more of its rows than were inserted
+		// above it, so the cost follows the source rather than this manager.
+		void AppendComponents(IComponentManager& source) override;
+
+		void ClearComponents() override;
+
+		// links are renumbered to the saved rows, which come in row order. Rows saved without
+		// every ancestor fail CheckRows.
+		void SaveColumn(size_t column, Instance const* rows, size_t count, void* out) const override;
+		// rows come in level order, every parent is a row of the level above and the child
+		// lists hold exactly the children of each node
+		bool CheckRows(size_t count, void const* const* columns) const override;
+		// levels are rebuilt from the depths
+		bool LoadRows(Entity const* entities, size_t count, void const* const* columns) override;
+		// every level of the template gets one gap holding that level of all copies, filled
+		// a block per column. Template rows come from SaveColumn.
+		void InstantiateRows(Entity const* entities, size_t copies, size_t rowCount, void const* const* columns) override;
+
+		void SetParent(Instance i, Instance parent);
+
+		Instance GetParent(Instance i) const noexcept { return GetElement<Parent>(i); }
+		Instance GetFirstChild(Instance i) const noexcept { return GetElement<FirstChild>(i); }
+		Instance GetNextSibling(Instance i) const noexcept { return GetElement<NextSibling>(i); }
+		uint32_t GetDepth(Instance i) const noexcept { return GetElement<Depth>(i); }
+
+		size_t GetLevelCount() const noexcept { return mLevels.size(); }
+
+		// [first, last) rows of a level
+		std::pair<Instance, Instance> GetLevelRange(size_t level) const noexcept
+		{
+			return { mLevels[level], LevelEnd(level) };
+		}
+
+		void SetLocalTransform(Instance i, math::Vector3f const& position,
+			math::Quaternion<float> const& rotation, math::Vector3f const& scale) noexcept;
+		void SetPosition(Instance i, math::Vector3f const& position) noexcept;
+		void SetRotation(Instance i, math::Quaternion<float> const& rotation) noexcept;
+		void SetScale(Instance i, math::Vector3f const& scale) noexcept;
+
+		math::Vector3f const& GetPosition(Instance i) const noexcept { return GetElement<Position>(i); }
+		math::Quaternion<float> const& GetRotation(Instance i) const noexcept { return GetElement<Rotation>(i); }
+		math::Vector3f const& GetScale(Instance i) const noexcept { return GetElement<Scale>(i); }
+
+		// valid after the Update following the last change
+		math::Mat4f const& GetWorldTransform(Instance i) const noexcept { return GetElement<World>(i); }
+
+		// recomputes the world matrix of every dirty node and all of its descendants, level by
+		// level, going wide on pool when one is given. Rewritten rows are marked changed.
+		// Returns the number of nodes rewritten.
+		size_t Update(common::ThreadPool* pool = nullptr);
+
+	private:
+		Instance LevelEnd(size_t level) const noexcept
+		{
+			return level + 1 < mLevels.size() ? mLevels[level + 1] : Instance(mData.size());
+		}
+
+		void MarkDirty(Instance i) noexcept;
+		void Link(Instance i, Instance parent) noexcept;
+		void Unlink(Instance i) noexcept;
+		void SwapNodes(Instance i, Instance j);
+		Instance MoveToLevel(Instance i, uint32_t level);
+		void TrimLevels() noexcept;
+		// makes room for inserted[l] rows at the end of every level l. Per level only as many
+		// live rows move as were inserted above it, they are renumbered and reindexed along
+		// with their neighbours' links. Returns the first row of each gap.
+		std::vector<Instance> OpenLevels(std::vector<Instance> const& inserted);
+		// rows [first, first + count) moved or are new
+		void Reindex(Instance first, size_t count);
+
+		// first row of every level
+		std::vector<Instance> mLevels;
+		std::vector<Instance> mScratch;
+		std::vector<Entity> mSubtree;
+		uint32_t mFrame = 0;
+		bool mDirty = false;
+	};
+
+}
+}
@@ -1,11 +1,15 @@
 #include "world.h"
+#include "component_manager.h"
 #include "common.h"
+#include "utils/thread_pool.h"
+#include <new>
 
 namespace redtea {
 namespace core {
 
 	Section::Section(uint32_t id, World* world)
-	: mId(id),
+	: mEntities(world->mSectionArena),
+	mId(id),
 	mWorld(world)
 	{
 
@@ -23,6 +27,7 @@ namespace core {
 		// batch delete entity
 		int size = mEntities.size();
 		mWorld->GetEntityManager()->DestroyEntitys(size, mEntities.data());
+		mEntities.clear();
 	}
 
 	void Section::SetActive()
@@ -31,28 +36,89 @@ namespace core {
 	}
 
 	World::World()
+	: mSectionArena(&mArena)
 	{
-		mEntityManger = new EntityManager();
+		mEntityManger = new (mArena.alloc(sizeof(EntityManager))) EntityManager(nullptr, &mArena);
+	}
+
+	World::World(World* live)
+	: mSectionArena(live->mSectionArena)
+	{
+		mEntityManger = new (mArena.alloc(sizeof(EntityManager))) EntityManager(live->GetEntityManager(), &mArena);
 	}
 
 	World::~World()
 	{
+		// rows are dropped wholesale instead of entity by entity, only the ids a staging
+		// world took from live are given back. A world going away reports nothing.
+		mEntityManger->SetEventBus(nullptr);
+		for (IComponentManager* manager : mEntityManger->GetComponentManagers())
+		{
+			manager->ClearComponents();
+		}
 		for (auto section : mSections)
 		{
-			section->Destroy();
-			delete section;
+			if (mEntityManger->mIdSource)
+			{
+				section->Destroy();
+			}
+			DeleteSection(section);
 		}
 
-		delete mEntityManger;
+		mEntityManger->~EntityManager();
+		mArena.free(mEntityManger);
 	}
 
 	Section* World::CreateSection()
 	{
-		Section* section = new Section(mSectionIndex++, this);
+		Section* section = new (mSectionArena->alloc(sizeof(Section))) Section(mSectionIndex++, this);
 		mSections.emplace_back(section);
 		return section;
 	}
 
+	void World::DeleteSection(Section* section)
+	{
+		section->~Section();
+		mSectionArena->free(section);
+	}
+
+	void World::Merge(World& staging, common::ThreadPool* pool)
+	{
+		auto const& targets = mEntityManger->GetComponentManagers();
+		auto const& sources = staging.mEntityManger->GetComponentManagers();
+		assert(targets.size() == sources.size());
+		// managers share nothing, one task each
+		auto append = [&targets, &sources](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				targets[i]->AppendComponents(*sources[i]);
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(0, targets.size(), 1, append);
+		}
+		else
+		{
+			append(0, targets.size());
+		}
+
+		// the entities of staging are new to this world
+		EntityEventBus* bus = mEntityManger->GetEventBus();
+		for (Section* section : staging.mSections)
+		{
+			section->mId = mSectionIndex++;
+			section->mWorld = this;
+			mSections.emplace_back(section);
+			if (bus)
+			{
+				bus->Record(EntityEvent::EntityCreated, nullptr, section->mEntities.data(), section->mEntities.size());
+			}
+		}
+		staging.mSections.clear();
+	}
+
 	Section* World::GetActiveSection()
 	{
 		Section* p = GetSectionById(curActiveSection);
@@ -62,14 +128,7 @@ namespace core {
 
 	Section* World::GetSectionById(uint32_t id)
 	{
-		for (auto const section : mSections)
-		{
-			if (section->mId == id)
-			{
-				return section;
-			}
-		}
-		return nullptr;
+		return id < mSections.size() ? mSections[id] : nullptr;
 	}
 
 	void World::SetActiveSection(uint32_t id)
@@ -1,43 +1,80 @@
 #pragma once
 #include "entity.h"
 #include "entity_manager.h"
+#include "utils/arena.h"
+#include <string>
 #include <vector>
 
 namespace redtea {
+namespace common {
+	class ThreadPool;
+}
 namespace core {
 
 	class World;
 	class Section
 	{
 	public:
+		using EntityList = std::vector<Entity, common::ArenaStlAllocator<Entity>>;
+
 		Section() = delete;
 		Section(uint32_t id, World* world);
 		Entity CreateEntity();
 		void Destroy();
 		void SetActive();
 		inline uint32_t GetId() { return mId; }
+		EntityList const& GetEntities() const noexcept { return mEntities; }
 	private:
 		friend class World;
-		std::vector<Entity> mEntities;
+		friend class Snapshot;
+		friend class Prefab;
+		EntityList mEntities;
 		std::string mName;
 		uint32_t mId;
 		World* mWorld;
 	};
 
+	// A World keeps its entity manager, sections and the rows of its registered managers
+	// in an arena of its own, worlds share no memory and may tick on different threads at
+	// once. Destroying one drops every row without visiting it and hands the arena back to
+	// the heap a block at a time; managers outliving it are left empty.
 	class World
 	{
 	public:
 		World();
+		// staging world to build sections on another thread, entity ids come from live so
+		// the result can be merged into it. Register managers of the same types, in the
+		// same order, as live. Its sections are kept in the arena of live, so they survive
+		// the merge, and it must not outlive live.
+		explicit World(World* live);
 		~World();
+
+		// moves the sections of staging into this world and appends its component rows to
+		// the matching managers, one bulk append per manager. The appends leave the rows
+		// already there in place and only touch the new ones, and with a pool they run as
+		// tasks side by side. Owning thread only, not from a pool task, with nobody touching
+		// staging meanwhile.
+		void Merge(World& staging, common::ThreadPool* pool = nullptr);
+
 		Section* CreateSection();
 		inline EntityManager* GetEntityManager() { return mEntityManger; }
+		common::Arena* GetArena() noexcept { return &mArena; }
 		Section* GetActiveSection();
 		Section* GetSectionById(uint32_t id);
 		void SetActiveSection(uint32_t id);
 	private:
+		friend class Snapshot;
+		friend class Section;
+		void DeleteSection(Section* section);
+
+		// first, so it goes last
+		common::Arena mArena;
+		// the arena sections are made in, that of live for a staging world
+		common::Arena* mSectionArena;
+		// indexed by section id, ids are handed out in order and never reused
 		std::vector<Section*> mSections;
 		EntityManager* mEntityManger;
-		uint32_t mSectionIndex;
+		uint32_t mSectionIndex = 0;
 		uint32_t curActiveSection;
 	};
 }
@@ -139,8 +139,7 @@ namespace device {
         D3D12_GPU_DESCRIPTOR_HANDLE m_StartGpuHandleShaderVisible = { 0 };
         uint32_t m_Stride = 0;
         uint32_t m_NumDescriptors = 0;
-        std::vector<bool> m_AllocatedDescriptors;
-        DescriptorIndex m_SearchStart = 0;
+        BitmapAllocator m_AllocatedDescriptors;
         uint32_t m_NumAllocatedDescriptors = 0;
         std::mutex m_Mutex;
 
@@ -870,6 +869,9 @@ namespace device {
         void setTextureState(ITexture* texture, TextureSubresourceSet subresources, ResourceStates stateBits) override;
         void setBufferState(IBuffer* buffer, ResourceStates stateBits) override;
         void setAccelStructState(rt::IAccelStruct* as, ResourceStates stateBits) override;
+
+        void beginTextureStateTransition(ITexture* texture, ResourceStates stateBits) override;
+        void beginBufferStateTransition(IBuffer* buffer, ResourceStates stateBits) override;
         
         void setPermanentTextureState(ITexture* texture, ResourceStates stateBits) override;
         void setPermanentBufferState(IBuffer* buffer, ResourceStates stateBits) override;
@@ -1049,6 +1051,11 @@ namespace device {
 
         MeshletPipelineHandle createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb) override;
 
+        GraphicsPipelineHandle createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize) override;
+        ComputePipelineHandle createComputePipeline(const ComputePipelineDesc& desc, const void* binary, size_t binarySize) override;
+        MeshletPipelineHandle createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize) override;
+        bool getPipelineBinary(IResource* pipeline, std::vector<uint8_t>& binary) override;
+
         rt::PipelineHandle createRayTracingPipeline(const rt::PipelineDesc& desc) override;
 
         BindingLayoutHandle createBindingLayout(const BindingLayoutDesc& desc) override;
@@ -1108,9 +1115,10 @@ namespace device {
         D3D12_FEATURE_DATA_D3D12_OPTIONS7 m_Options7 = {};
 
         RefCountPtr<RootSignature> getRootSignature(const static_vector<BindingLayoutHandle, c_MaxBindingLayouts>& pipelineLayouts, bool allowInputLayout);
-        RefCountPtr<ID3D12PipelineState> createPipelineState(const GraphicsPipelineDesc& desc, RootSignature* pRS, const FramebufferInfo& fbinfo) const;
-        RefCountPtr<ID3D12PipelineState> createPipelineState(const ComputePipelineDesc& desc, RootSignature* pRS) const;
-        RefCountPtr<ID3D12PipelineState> createPipelineState(const MeshletPipelineDesc& desc, RootSignature* pRS, const FramebufferInfo& fbinfo) const;
+        // cachedBlob comes from GetCachedBlob, the pipeline is compiled without it when the driver rejects it
+        RefCountPtr<ID3D12PipelineState> createPipelineState(const GraphicsPipelineDesc& desc, RootSignature* pRS, const FramebufferInfo& fbinfo, const void* cachedBlob = nullptr, size_t cachedBlobSize = 0) const;
+        RefCountPtr<ID3D12PipelineState> createPipelineState(const ComputePipelineDesc& desc, RootSignature* pRS, const void* cachedBlob = nullptr, size_t cachedBlobSize = 0) const;
+        RefCountPtr<ID3D12PipelineState> createPipelineState(const MeshletPipelineDesc& desc, RootSignature* pRS, const FramebufferInfo& fbinfo, const void* cachedBlob = nullptr, size_t cachedBlobSize = 0) const;
     };
 
     D3D12_SHADER_VISIBILITY convertShaderStage(ShaderType s);
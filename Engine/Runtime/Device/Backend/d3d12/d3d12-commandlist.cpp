@@ -232,6 +232,7 @@ namespace device
 
 	void CommandList::close()
 	{
+		m_StateTracker.endSplitTransitions();
 		m_StateTracker.keepBufferInitialStates();
 		m_StateTracker.keepTextureInitialStates();
 		commitBarriers();
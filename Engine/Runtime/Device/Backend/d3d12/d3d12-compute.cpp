@@ -22,7 +22,7 @@ namespace device
     }
 
 
-    RefCountPtr<ID3D12PipelineState> Device::createPipelineState(const ComputePipelineDesc& state, RootSignature* pRS) const
+    RefCountPtr<ID3D12PipelineState> Device::createPipelineState(const ComputePipelineDesc& state, RootSignature* pRS, const void* cachedBlob, size_t cachedBlobSize) const
     {
         RefCountPtr<ID3D12PipelineState> pipelineState;
 
@@ -31,8 +31,16 @@ namespace device
         desc.pRootSignature = pRS->handle;
         Shader* shader = CHECKED_CAST<Shader*>(state.CS.Get());
         desc.CS = { &shader->bytecode[0], shader->bytecode.size() };
+        desc.CachedPSO = { cachedBlob, cachedBlobSize };
 
-        const HRESULT hr = m_Context.device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+        HRESULT hr = m_Context.device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+
+        // blobs from another driver or adapter are rejected
+        if (FAILED(hr) && cachedBlob)
+        {
+            desc.CachedPSO = {};
+            hr = m_Context.device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+        }
 
         if (FAILED(hr))
         {
@@ -44,9 +52,14 @@ namespace device
     }
 
     ComputePipelineHandle Device::createComputePipeline(const ComputePipelineDesc& desc)
+    {
+        return createComputePipeline(desc, nullptr, 0);
+    }
+
+    ComputePipelineHandle Device::createComputePipeline(const ComputePipelineDesc& desc, const void* binary, size_t binarySize)
     {
         RefCountPtr<RootSignature> pRS = getRootSignature(desc.bindingLayouts, false);
-        RefCountPtr<ID3D12PipelineState> pPSO = createPipelineState(desc, pRS);
+        RefCountPtr<ID3D12PipelineState> pPSO = createPipelineState(desc, pRS, binary, binarySize);
 
         if (pPSO == nullptr)
             return nullptr;
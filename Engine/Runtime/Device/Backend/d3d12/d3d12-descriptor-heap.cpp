@@ -42,7 +42,7 @@ namespace device
         m_HeapType = heapDesc.Type;
         m_StartCpuHandle = m_Heap->GetCPUDescriptorHandleForHeapStart();
         m_Stride = m_Context.device->GetDescriptorHandleIncrementSize(heapDesc.Type);
-        m_AllocatedDescriptors.resize(m_NumDescriptors);
+        m_AllocatedDescriptors.grow(m_NumDescriptors);
 
         return S_OK;
     }
@@ -62,10 +62,9 @@ namespace device
         return v;
     }
 
+    // called with m_Mutex locked
     HRESULT StaticDescriptorHeap::Grow(uint32_t minRequiredSize)
     {
-        std::lock_guard lockGuard(m_Mutex);
-
         uint32_t oldSize = m_NumDescriptors;
         uint32_t newSize = nextPowerOf2(minRequiredSize);
 
@@ -90,46 +89,21 @@ namespace device
     {
         std::lock_guard lockGuard(m_Mutex);
 
-        DescriptorIndex foundIndex = 0;
-        uint32_t freeCount = 0;
-        bool found = false;
-
-        // Find a contiguous range of 'count' indices for which m_AllocatedDescriptors[index] is false
-
-        for (DescriptorIndex index = m_SearchStart; index < m_NumDescriptors; index++)
-        {
-            if (m_AllocatedDescriptors[index])
-                freeCount = 0;
-            else
-                freeCount += 1;
-
-            if (freeCount >= count)
-            {
-                foundIndex = index - count + 1;
-                found = true;
-                break;
-            }
-        }
+        DescriptorIndex foundIndex = m_AllocatedDescriptors.allocateRange(count);
 
-        if (!found)
+        if (foundIndex == BitmapAllocator::c_InvalidIndex)
         {
-            foundIndex = m_NumDescriptors;
-
             if (FAILED(Grow(m_NumDescriptors + count)))
             {
                 m_Context.error("Failed to grow a descriptor heap!");
                 return c_InvalidDescriptorIndex;
             }
-        }
 
-        for (DescriptorIndex index = foundIndex; index < foundIndex + count; index++)
-        {
-            m_AllocatedDescriptors[index] = true;
+            foundIndex = m_AllocatedDescriptors.allocateRange(count);
         }
 
         m_NumAllocatedDescriptors += count;
 
-        m_SearchStart = foundIndex + count;
         return foundIndex;
     }
 
@@ -145,22 +119,17 @@ namespace device
         if (count == 0)
             return;
 
-        for (DescriptorIndex index = baseIndex; index < baseIndex + count; index++)
-        {
+        const bool allocated = m_AllocatedDescriptors.releaseRange(baseIndex, count);
 #ifdef _DEBUG
-            if (!m_AllocatedDescriptors[index])
-            {
-                m_Context.error("Attempted to release an un-allocated descriptor");
-            }
-#endif
-
-            m_AllocatedDescriptors[index] = false;
+        if (!allocated)
+        {
+            m_Context.error("Attempted to release an un-allocated descriptor");
         }
+#else
+        (void)allocated;
+#endif
 
         m_NumAllocatedDescriptors -= count;
-
-        if (m_SearchStart > baseIndex)
-            m_SearchStart = baseIndex;
     }
 
     void StaticDescriptorHeap::releaseDescriptor(DescriptorIndex index)
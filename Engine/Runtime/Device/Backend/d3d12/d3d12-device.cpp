@@ -219,6 +219,25 @@ namespace device
         return GraphicsAPI::D3D12;
     }
 
+    bool Device::getPipelineBinary(IResource* pipeline, std::vector<uint8_t>& binary)
+    {
+        ID3D12PipelineState* pipelineState = nullptr;
+        if (auto graphics = dynamic_cast<GraphicsPipeline*>(pipeline))
+            pipelineState = graphics->pipelineState;
+        else if (auto compute = dynamic_cast<ComputePipeline*>(pipeline))
+            pipelineState = compute->pipelineState;
+        else if (auto meshlet = dynamic_cast<MeshletPipeline*>(pipeline))
+            pipelineState = meshlet->pipelineState;
+
+        RefCountPtr<ID3DBlob> blob;
+        if (!pipelineState || FAILED(pipelineState->GetCachedBlob(&blob)))
+            return false;
+
+        const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+        binary.assign(data, data + blob->GetBufferSize());
+        return !binary.empty();
+    }
+
 
     Object Device::getNativeObject(ObjectType objectType)
     {
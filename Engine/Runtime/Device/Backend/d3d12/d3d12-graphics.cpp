@@ -21,7 +21,7 @@ namespace device
 		}
 	}
 
-	RefCountPtr<ID3D12PipelineState> Device::createPipelineState(const GraphicsPipelineDesc & state, RootSignature* pRS, const FramebufferInfo& fbinfo) const
+	RefCountPtr<ID3D12PipelineState> Device::createPipelineState(const GraphicsPipelineDesc & state, RootSignature* pRS, const FramebufferInfo& fbinfo, const void* cachedBlob, size_t cachedBlobSize) const
 	{
 		if (state.renderState.singlePassStereo.enabled && !m_SinglePassStereoSupported)
 		{
@@ -101,10 +101,18 @@ namespace device
 
 		desc.NumRenderTargets = uint32_t(fbinfo.colorFormats.size());
 		desc.SampleMask = ~0u;
+		desc.CachedPSO = { cachedBlob, cachedBlobSize };
 
 		RefCountPtr<ID3D12PipelineState> pipelineState;
 
-		const HRESULT hr = m_Context.device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+		HRESULT hr = m_Context.device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+
+		// blobs from another driver or adapter are rejected
+		if (FAILED(hr) && cachedBlob)
+		{
+			desc.CachedPSO = {};
+			hr = m_Context.device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+		}
 
 		if (FAILED(hr))
 		{
@@ -117,10 +125,15 @@ namespace device
 
 
 	GraphicsPipelineHandle Device::createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb)
+	{
+		return createGraphicsPipeline(desc, fb, nullptr, 0);
+	}
+
+	GraphicsPipelineHandle Device::createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize)
 	{
 		RefCountPtr<RootSignature> pRS = getRootSignature(desc.bindingLayouts, desc.inputLayout != nullptr);
 
-		RefCountPtr<ID3D12PipelineState> pPSO = createPipelineState(desc, pRS, fb->getFramebufferInfo());
+		RefCountPtr<ID3D12PipelineState> pPSO = createPipelineState(desc, pRS, fb->getFramebufferInfo(), binary, binarySize);
 
 		return createHandleForNativeGraphicsPipeline(pRS, pPSO, desc, fb->getFramebufferInfo());
 	}
@@ -20,7 +20,7 @@ namespace device
 		}
 	}
 
-	RefCountPtr<ID3D12PipelineState> Device::createPipelineState(const MeshletPipelineDesc& state, RootSignature* pRS, const FramebufferInfo& fbinfo) const
+	RefCountPtr<ID3D12PipelineState> Device::createPipelineState(const MeshletPipelineDesc& state, RootSignature* pRS, const FramebufferInfo& fbinfo, const void* cachedBlob, size_t cachedBlobSize) const
 	{
 		RefCountPtr<ID3D12PipelineState> pipelineState;
 
@@ -42,6 +42,7 @@ namespace device
 			ALIGNED_TYPE SampleMask_Type;           UINT SampleMask;
 			ALIGNED_TYPE RenderTargets_Type;        D3D12_RT_FORMAT_ARRAY RenderTargets;
 			ALIGNED_TYPE DSVFormat_Type;            DXGI_FORMAT DSVFormat;
+			ALIGNED_TYPE CachedPSO_Type;            D3D12_CACHED_PIPELINE_STATE CachedPSO;
 		} psoDesc = { };
 #pragma warning(pop)
 
@@ -57,6 +58,8 @@ namespace device
 		psoDesc.SampleMask_Type = D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK;
 		psoDesc.RenderTargets_Type = D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS;
 		psoDesc.DSVFormat_Type = D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT;
+		psoDesc.CachedPSO_Type = D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO;
+		psoDesc.CachedPSO = { cachedBlob, cachedBlobSize };
 
 		psoDesc.RootSignature = pRS->handle;
 
@@ -126,6 +129,14 @@ namespace device
 		streamDesc.SizeInBytes = sizeof(psoDesc);
 
 		HRESULT hr = m_Context.device2->CreatePipelineState(&streamDesc, IID_PPV_ARGS(&pipelineState));
+
+		// blobs from another driver or adapter are rejected
+		if (FAILED(hr) && cachedBlob)
+		{
+			psoDesc.CachedPSO = {};
+			hr = m_Context.device2->CreatePipelineState(&streamDesc, IID_PPV_ARGS(&pipelineState));
+		}
+
 		if (FAILED(hr))
 		{
 			m_Context.error("Failed to create a meshlet pipeline state object");
@@ -136,10 +147,15 @@ namespace device
 	}
 
 	MeshletPipelineHandle Device::createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb)
+	{
+		return createMeshletPipeline(desc, fb, nullptr, 0);
+	}
+
+	MeshletPipelineHandle Device::createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize)
 	{
 		RefCountPtr<RootSignature> pRS = getRootSignature(desc.bindingLayouts, false);
 
-		RefCountPtr<ID3D12PipelineState> pPSO = createPipelineState(desc, pRS, fb->getFramebufferInfo());
+		RefCountPtr<ID3D12PipelineState> pPSO = createPipelineState(desc, pRS, fb->getFramebufferInfo(), binary, binarySize);
 
 		return createHandleForNativeMeshletPipeline(pRS, pPSO, desc, fb->getFramebufferInfo());
 	}
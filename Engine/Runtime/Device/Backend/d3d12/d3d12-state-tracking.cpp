@@ -67,8 +67,23 @@ namespace device
 		m_StateTracker.requireBufferState(buffer, state);
 	}
 
+	static D3D12_RESOURCE_BARRIER_FLAGS convertBarrierSplit(BarrierSplit split)
+	{
+		switch (split)  // NOLINT(clang-diagnostic-switch-enum)
+		{
+		case BarrierSplit::Begin:
+			return D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+		case BarrierSplit::End:
+			return D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+		default:
+			return D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		}
+	}
+
 	void CommandList::commitBarriers()
 	{
+		m_StateTracker.optimizeBarriers();
+
 		const auto& textureBarriers = m_StateTracker.getTextureBarriers();
 		const auto& bufferBarriers = m_StateTracker.getBufferBarriers();
 		const size_t barrierCount = textureBarriers.size() + bufferBarriers.size();
@@ -92,6 +107,7 @@ namespace device
 			if (stateBefore != stateAfter)
 			{
 				d3dbarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+				d3dbarrier.Flags = convertBarrierSplit(barrier.split);
 				d3dbarrier.Transition.StateBefore = stateBefore;
 				d3dbarrier.Transition.StateAfter = stateAfter;
 				d3dbarrier.Transition.pResource = texture->resource;
@@ -130,6 +146,7 @@ namespace device
 				(stateAfter & D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE) == 0)
 			{
 				d3dbarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+				d3dbarrier.Flags = convertBarrierSplit(barrier.split);
 				d3dbarrier.Transition.StateBefore = stateBefore;
 				d3dbarrier.Transition.StateAfter = stateAfter;
 				d3dbarrier.Transition.pResource = buffer->resource;
@@ -217,6 +234,20 @@ namespace device
 		m_StateTracker.endTrackingBufferState(buffer, stateBits, false);
 	}
 
+	void CommandList::beginTextureStateTransition(ITexture* _texture, ResourceStates stateBits)
+	{
+		Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+		m_StateTracker.beginTextureStateTransition(texture, stateBits);
+	}
+
+	void CommandList::beginBufferStateTransition(IBuffer* _buffer, ResourceStates stateBits)
+	{
+		Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+		m_StateTracker.beginBufferStateTransition(buffer, stateBits);
+	}
+
 	void CommandList::setAccelStructState(rt::IAccelStruct* _as, ResourceStates stateBits)
 	{
 		AccelStruct* as = CHECKED_CAST<AccelStruct*>(_as);
@@ -0,0 +1,610 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../../RHI/rhi.h"
+#include "../../RHI/pipeline_cache.h"
+#include "../../RHI/rhi_utils.h"
+#include "../../RHI/state-tracking.h"
+#include "null-rasterizer.h"
+
+// Headless backend: resources live in CPU memory, copies, writes and clears are carried out
+// when the command list is executed, draws with CPU shaders are rasterized (see null-rasterizer.h)
+// and the other draws and dispatches only go through state tracking.
+// Every queue completes its work inside executeCommandLists.
+
+namespace redtea {
+namespace device {
+namespace null {
+
+    static constexpr uint64_t c_ResourceAlignment = 256;
+
+    struct DeviceDesc
+    {
+        // messages go to the logger when null
+        IMessageCallback* errorCB = nullptr;
+        bool enableComputeQueue = true;
+        bool enableCopyQueue = true;
+        // threads helping the rasterizer, -1 for one per core
+        int32_t rasterizerWorkerCount = -1;
+        // time it takes to compile a pipeline, pipelines created from their binary take none
+        uint32_t pipelineCompileMicroseconds = 0;
+    };
+
+    DeviceHandle createDevice(const DeviceDesc& desc);
+
+    class Device;
+
+    // counted while recording, reset by open
+    struct CommandListStatistics
+    {
+        uint32_t draws = 0;
+        uint32_t dispatches = 0;
+        // writes, copies and clears
+        uint32_t transfers = 0;
+        uint32_t textureBarriers = 0;
+        uint32_t bufferBarriers = 0;
+        uint32_t uavBarriers = 0;
+        // split transitions begun, their ends count as texture and buffer barriers
+        uint32_t splitBarriers = 0;
+        // barriers put in the pending list, before commitBarriers optimizes them
+        uint32_t requestedBarriers = 0;
+    };
+
+    class Heap : public RefCounter<IHeap>
+    {
+    public:
+        HeapDesc desc;
+        std::vector<uint8_t> memory;
+
+        const HeapDesc& getDesc() override { return desc; }
+    };
+
+    struct SubresourceFootprint
+    {
+        uint64_t offset = 0;
+        uint64_t rowPitch = 0;
+        uint64_t depthPitch = 0;
+        uint32_t rowCount = 0;
+        uint32_t depth = 0;
+    };
+
+    // tightly packed subresources of a texture or staging texture, ordered like
+    // the subresource indices of the state tracker: mip levels of a slice side by side
+    class TextureMemory
+    {
+    public:
+        std::vector<SubresourceFootprint> footprints;
+        uint64_t byteSize = 0;
+        uint8_t* data = nullptr;
+        std::vector<uint8_t> memory;
+        HeapHandle heap;
+        uint32_t bytesPerBlock = 0;
+        uint32_t blockSize = 1;
+        uint32_t mipLevels = 1;
+
+        void computeLayout(const TextureDesc& desc);
+        const SubresourceFootprint& getFootprint(MipLevel mipLevel, ArraySlice arraySlice) const { return footprints[mipLevel + arraySlice * mipLevels]; }
+        uint8_t* getTexel(const TextureSlice& slice) const;
+    };
+
+    class Texture : public RefCounter<ITexture>, public TextureStateExtension, public TextureMemory
+    {
+    public:
+        const TextureDesc desc;
+
+        explicit Texture(const TextureDesc& desc)
+            : TextureStateExtension(this->desc)
+            , desc(desc)
+        {
+            TextureStateExtension::stateInitialized = true;
+        }
+
+        const TextureDesc& getDesc() const override { return desc; }
+        Object getNativeView(ObjectType objectType, Format format, TextureSubresourceSet subresources, TextureDimension dimension, bool isReadOnlyDSV = false) override;
+    };
+
+    class StagingTexture : public RefCounter<IStagingTexture>, public TextureMemory
+    {
+    public:
+        TextureDesc desc;
+        CpuAccessMode cpuAccess = CpuAccessMode::None;
+
+        const TextureDesc& getDesc() const override { return desc; }
+    };
+
+    class Buffer : public RefCounter<IBuffer>, public BufferStateExtension
+    {
+    public:
+        const BufferDesc desc;
+        uint8_t* data = nullptr;
+        std::vector<uint8_t> memory;
+        HeapHandle heap;
+
+        explicit Buffer(const BufferDesc& desc)
+            : BufferStateExtension(this->desc)
+            , desc(desc)
+        { }
+
+        const BufferDesc& getDesc() const override { return desc; }
+    };
+
+    class Shader : public RefCounter<IShader>
+    {
+    public:
+        ShaderDesc desc;
+        std::vector<char> bytecode;
+        std::vector<ShaderSpecialization> specializationConstants;
+        // set for shaders made by Device::createVertexShader and createPixelShader
+        VertexShaderFunction vertexFunction;
+        PixelShaderFunction pixelFunction;
+        uint32_t varyingCount = 0;
+
+        const ShaderDesc& getDesc() const override { return desc; }
+        void getBytecode(const void** ppBytecode, size_t* pSize) const override;
+    };
+
+    class ShaderLibrary : public RefCounter<IShaderLibrary>
+    {
+    public:
+        std::vector<char> bytecode;
+
+        void getBytecode(const void** ppBytecode, size_t* pSize) const override;
+        ShaderHandle getShader(const char* entryName, ShaderType shaderType) override;
+    };
+
+    class Sampler : public RefCounter<ISampler>
+    {
+    public:
+        SamplerDesc desc;
+
+        const SamplerDesc& getDesc() const override { return desc; }
+    };
+
+    class InputLayout : public RefCounter<IInputLayout>
+    {
+    public:
+        std::vector<VertexAttributeDesc> attributes;
+
+        uint32_t getNumAttributes() const override { return uint32_t(attributes.size()); }
+        const VertexAttributeDesc* getAttributeDesc(uint32_t index) const override;
+    };
+
+    class EventQuery : public RefCounter<IEventQuery>
+    {
+    public:
+        CommandQueue queue = CommandQueue::Graphics;
+        uint64_t instance = 0;
+        bool started = false;
+    };
+
+    class TimerQuery : public RefCounter<ITimerQuery>
+    {
+    public:
+        bool started = false;
+        bool resolved = false;
+        float time = 0.f;
+    };
+
+    class Framebuffer : public RefCounter<IFramebuffer>
+    {
+    public:
+        FramebufferDesc desc;
+        FramebufferInfo framebufferInfo;
+        static_vector<TextureHandle, c_MaxRenderTargets + 2> resources;
+
+        const FramebufferDesc& getDesc() const override { return desc; }
+        const FramebufferInfo& getFramebufferInfo() const override { return framebufferInfo; }
+    };
+
+    class GraphicsPipeline : public RefCounter<IGraphicsPipeline>
+    {
+    public:
+        GraphicsPipelineDesc desc;
+        FramebufferInfo framebufferInfo;
+        std::vector<uint8_t> binary;
+
+        const GraphicsPipelineDesc& getDesc() const override { return desc; }
+        const FramebufferInfo& getFramebufferInfo() const override { return framebufferInfo; }
+    };
+
+    class ComputePipeline : public RefCounter<IComputePipeline>
+    {
+    public:
+        ComputePipelineDesc desc;
+        std::vector<uint8_t> binary;
+
+        const ComputePipelineDesc& getDesc() const override { return desc; }
+    };
+
+    class MeshletPipeline : public RefCounter<IMeshletPipeline>
+    {
+    public:
+        MeshletPipelineDesc desc;
+        FramebufferInfo framebufferInfo;
+        std::vector<uint8_t> binary;
+
+        const MeshletPipelineDesc& getDesc() const override { return desc; }
+        const FramebufferInfo& getFramebufferInfo() const override { return framebufferInfo; }
+    };
+
+    class BindingLayout : public RefCounter<IBindingLayout>
+    {
+    public:
+        BindingLayoutDesc desc;
+
+        const BindingLayoutDesc* getDesc() const override { return &desc; }
+        const BindlessLayoutDesc* getBindlessDesc() const override { return nullptr; }
+    };
+
+    class BindlessLayout : public RefCounter<IBindingLayout>
+    {
+    public:
+        BindlessLayoutDesc desc;
+
+        const BindingLayoutDesc* getDesc() const override { return nullptr; }
+        const BindlessLayoutDesc* getBindlessDesc() const override { return &desc; }
+    };
+
+    class BindingSet : public RefCounter<IBindingSet>
+    {
+    public:
+        BindingSetDesc desc;
+        BindingLayoutHandle layout;
+        std::vector<RefCountPtr<IResource>> resources;
+        std::vector<uint16_t> bindingsThatNeedTransitions;
+        bool hasUavBindings = false;
+
+        const BindingSetDesc* getDesc() const override { return &desc; }
+        IBindingLayout* getLayout() const override { return layout; }
+    };
+
+    class DescriptorTable : public RefCounter<IDescriptorTable>
+    {
+    public:
+        std::vector<BindingSetItem> descriptors;
+
+        const BindingSetDesc* getDesc() const override { return nullptr; }
+        IBindingLayout* getLayout() const override { return nullptr; }
+        uint32_t getCapacity() const override { return uint32_t(descriptors.size()); }
+    };
+
+    class AccelStruct : public RefCounter<rt::IAccelStruct>
+    {
+    public:
+        rt::AccelStructDesc desc;
+        RefCountPtr<Buffer> dataBuffer;
+        std::vector<rt::AccelStructHandle> bottomLevelASes;
+        bool compacted = false;
+
+        const rt::AccelStructDesc& getDesc() const override { return desc; }
+        bool isCompacted() const override { return compacted; }
+    };
+
+    class RayTracingPipeline;
+
+    class ShaderTable : public RefCounter<rt::IShaderTable>
+    {
+    public:
+        struct Entry
+        {
+            std::string exportName;
+            BindingSetHandle localBindings;
+        };
+
+        RefCountPtr<RayTracingPipeline> pipeline;
+        Entry rayGenerationShader;
+        std::vector<Entry> missShaders;
+        std::vector<Entry> hitGroups;
+        std::vector<Entry> callableShaders;
+
+        void setRayGenerationShader(const char* exportName, IBindingSet* bindings = nullptr) override;
+        int addMissShader(const char* exportName, IBindingSet* bindings = nullptr) override;
+        int addHitGroup(const char* exportName, IBindingSet* bindings = nullptr) override;
+        int addCallableShader(const char* exportName, IBindingSet* bindings = nullptr) override;
+        void clearMissShaders() override { missShaders.clear(); }
+        void clearHitShaders() override { hitGroups.clear(); }
+        void clearCallableShaders() override { callableShaders.clear(); }
+        rt::IPipeline* getPipeline() override;
+    };
+
+    class RayTracingPipeline : public RefCounter<rt::IPipeline>
+    {
+    public:
+        rt::PipelineDesc desc;
+
+        const rt::PipelineDesc& getDesc() const override { return desc; }
+        rt::ShaderTableHandle createShaderTable() override;
+    };
+
+    // transfers carried out when the command list is executed, data written from the CPU is
+    // kept in the upload memory of the instance. A texture fill is a texel pattern followed
+    // by a byte mask of the same size, which lets a clear keep the depth or stencil part
+    enum class CommandType : uint8_t
+    {
+        WriteBuffer,
+        CopyBuffer,
+        FillBuffer,
+        WriteTexture,
+        CopyTexture,
+        FillTexture,
+        // srcOffset is the index of the draw in the instance
+        Draw
+    };
+
+    struct Command
+    {
+        CommandType type;
+        // Buffer* for buffer commands, TextureMemory* for texture ones
+        void* dest = nullptr;
+        void* src = nullptr;
+        uint64_t destOffset = 0;
+        uint64_t srcOffset = 0;
+        uint64_t size = 0;
+        TextureSlice destSlice;
+        TextureSlice srcSlice;
+        TextureSubresourceSet subresources;
+    };
+
+    class CommandListInstance
+    {
+    public:
+        uint64_t submittedInstance = 0;
+        CommandQueue commandQueue = CommandQueue::Graphics;
+        std::vector<Command> commands;
+        std::vector<uint8_t> uploadMemory;
+        std::vector<DrawCommand> draws;
+        std::vector<RefCountPtr<IResource>> referencedResources;
+        std::vector<RefCountPtr<TimerQuery>> referencedTimerQueries;
+    };
+
+    class Queue
+    {
+    public:
+        uint64_t lastSubmittedInstance = 0;
+        uint64_t lastCompletedInstance = 0;
+        std::atomic<uint64_t> recordingInstance = 1;
+        std::deque<std::shared_ptr<CommandListInstance>> commandListsInFlight;
+    };
+
+    class CommandList final : public RefCounter<ICommandList>
+    {
+    public:
+
+        // Internal interface functions
+
+        CommandList(Device* device, IMessageCallback* messageCallback, const CommandListParameters& params);
+        std::shared_ptr<CommandListInstance> executed(Queue* pQueue);
+        void requireTextureState(ITexture* texture, TextureSubresourceSet subresources, ResourceStates state);
+        void requireBufferState(IBuffer* buffer, ResourceStates state);
+        const CommandListStatistics& getStatistics() const { return m_Statistics; }
+
+        // ICommandList implementation
+
+        void open() override;
+        void close() override;
+        void clearState() override;
+
+        void clearTextureFloat(ITexture* t, TextureSubresourceSet subresources, const Color& clearColor) override;
+        void clearDepthStencilTexture(ITexture* t, TextureSubresourceSet subresources, bool clearDepth, float depth, bool clearStencil, uint8_t stencil) override;
+        void clearTextureUInt(ITexture* t, TextureSubresourceSet subresources, uint32_t clearColor) override;
+
+        void copyTexture(ITexture* dest, const TextureSlice& destSlice, ITexture* src, const TextureSlice& srcSlice) override;
+        void copyTexture(IStagingTexture* dest, const TextureSlice& destSlice, ITexture* src, const TextureSlice& srcSlice) override;
+        void copyTexture(ITexture* dest, const TextureSlice& destSlice, IStagingTexture* src, const TextureSlice& srcSlice) override;
+        void writeTexture(ITexture* dest, uint32_t arraySlice, uint32_t mipLevel, const void* data, size_t rowPitch, size_t depthPitch) override;
+        void resolveTexture(ITexture* dest, const TextureSubresourceSet& dstSubresources, ITexture* src, const TextureSubresourceSet& srcSubresources) override;
+
+        void writeBuffer(IBuffer* b, const void* data, size_t dataSize, uint64_t destOffsetBytes = 0) override;
+        void clearBufferUInt(IBuffer* b, uint32_t clearValue) override;
+        void copyBuffer(IBuffer* dest, uint64_t destOffsetBytes, IBuffer* src, uint64_t srcOffsetBytes, uint64_t dataSizeBytes) override;
+
+        void setPushConstants(const void* data, size_t byteSize) override;
+
+        void setGraphicsState(const GraphicsState& state) override;
+        void draw(const DrawArguments& args) override;
+        void drawIndexed(const DrawArguments& args) override;
+        void drawIndirect(uint32_t offsetBytes) override;
+
+        void setComputeState(const ComputeState& state) override;
+        void dispatch(uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1) override;
+        void dispatchIndirect(uint32_t offsetBytes) override;
+
+        void setMeshletState(const MeshletState& state) override;
+        void dispatchMesh(uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1) override;
+
+        void setRayTracingState(const rt::State& state) override;
+        void dispatchRays(const rt::DispatchRaysArguments& args) override;
+
+        void buildBottomLevelAccelStruct(rt::IAccelStruct* as, const rt::GeometryDesc* pGeometries, size_t numGeometries, rt::AccelStructBuildFlags buildFlags) override;
+        void compactBottomLevelAccelStructs() override;
+        void buildTopLevelAccelStruct(rt::IAccelStruct* as, const rt::InstanceDesc* pInstances, size_t numInstances, rt::AccelStructBuildFlags buildFlags) override;
+
+        void beginTimerQuery(ITimerQuery* query) override;
+        void endTimerQuery(ITimerQuery* query) override;
+
+        void beginMarker(const char* name) override;
+        void endMarker() override;
+
+        void setEnableAutomaticBarriers(bool enable) override;
+        void setResourceStatesForBindingSet(IBindingSet* bindingSet) override;
+
+        void setEnableUavBarriersForTexture(ITexture* texture, bool enableBarriers) override;
+        void setEnableUavBarriersForBuffer(IBuffer* buffer, bool enableBarriers) override;
+
+        void beginTrackingTextureState(ITexture* texture, TextureSubresourceSet subresources, ResourceStates stateBits) override;
+        void beginTrackingBufferState(IBuffer* buffer, ResourceStates stateBits) override;
+
+        void setTextureState(ITexture* texture, TextureSubresourceSet subresources, ResourceStates stateBits) override;
+        void setBufferState(IBuffer* buffer, ResourceStates stateBits) override;
+        void setAccelStructState(rt::IAccelStruct* as, ResourceStates stateBits) override;
+
+        void beginTextureStateTransition(ITexture* texture, ResourceStates stateBits) override;
+        void beginBufferStateTransition(IBuffer* buffer, ResourceStates stateBits) override;
+
+        void setPermanentTextureState(ITexture* texture, ResourceStates stateBits) override;
+        void setPermanentBufferState(IBuffer* buffer, ResourceStates stateBits) override;
+
+        void commitBarriers() override;
+
+        ResourceStates getTextureSubresourceState(ITexture* texture, ArraySlice arraySlice, MipLevel mipLevel) override;
+        ResourceStates getBufferState(IBuffer* buffer) override;
+
+        IDevice* getDevice() override;
+        const CommandListParameters& getDesc() override { return m_Desc; }
+
+    private:
+        Device* m_Device;
+        Queue* m_Queue;
+        IMessageCallback* m_MessageCallback;
+        CommandListResourceStateTracker m_StateTracker;
+        bool m_EnableAutomaticBarriers = true;
+
+        CommandListParameters m_Desc;
+
+        std::shared_ptr<CommandListInstance> m_Instance;
+        uint64_t m_RecordingVersion = 0;
+        CommandListStatistics m_Statistics;
+
+        // Cache for user-provided state
+
+        GraphicsState m_CurrentGraphicsState;
+        ComputeState m_CurrentComputeState;
+        MeshletState m_CurrentMeshletState;
+        rt::State m_CurrentRayTracingState;
+        bool m_CurrentGraphicsStateValid = false;
+        bool m_CurrentComputeStateValid = false;
+        bool m_CurrentMeshletStateValid = false;
+        bool m_CurrentRayTracingStateValid = false;
+        std::vector<uint8_t> m_PushConstants;
+
+        void clearStateCache();
+        void setBindings(const BindingSetVector& bindings, uint32_t bindingUpdateMask);
+        void setIndirectParams(IBuffer* indirectParams);
+        Command& addCommand(CommandType type, void* dest, void* src);
+        uint64_t upload(const void* data, size_t size);
+        // indirectOffset is ~0u for draws with their arguments in args
+        void recordDraw(const DrawArguments& args, bool indexed, uint32_t indirectOffset);
+        void fillTexture(Texture* t, TextureSubresourceSet subresources, const uint8_t* texel, const uint8_t* mask, size_t texelSize);
+    };
+
+    class Device final : public RefCounter<IDevice>
+    {
+    public:
+        explicit Device(const DeviceDesc& desc);
+        ~Device() override;
+
+        // IDevice implementation
+
+        HeapHandle createHeap(const HeapDesc& d) override;
+        TextureHandle createTexture(const TextureDesc& d) override;
+        MemoryRequirements getTextureMemoryRequirements(ITexture* texture) override;
+        bool bindTextureMemory(ITexture* texture, IHeap* heap, uint64_t offset) override;
+
+        TextureHandle createHandleForNativeTexture(ObjectType objectType, Object texture, const TextureDesc& desc) override;
+
+        StagingTextureHandle createStagingTexture(const TextureDesc& d, CpuAccessMode cpuAccess) override;
+        void* mapStagingTexture(IStagingTexture* tex, const TextureSlice& slice, CpuAccessMode cpuAccess, size_t* outRowPitch) override;
+        void unmapStagingTexture(IStagingTexture* tex) override;
+
+        BufferHandle createBuffer(const BufferDesc& d) override;
+        void* mapBuffer(IBuffer* b, CpuAccessMode mapFlags) override;
+        void unmapBuffer(IBuffer* b) override;
+        MemoryRequirements getBufferMemoryRequirements(IBuffer* buffer) override;
+        bool bindBufferMemory(IBuffer* buffer, IHeap* heap, uint64_t offset) override;
+
+        BufferHandle createHandleForNativeBuffer(ObjectType objectType, Object buffer, const BufferDesc& desc) override;
+
+        ShaderHandle createShader(const ShaderDesc& d, const void* binary, size_t binarySize) override;
+        ShaderHandle createShaderSpecialization(IShader* baseShader, const ShaderSpecialization* constants, uint32_t numConstants) override;
+        ShaderLibraryHandle createShaderLibrary(const void* binary, size_t binarySize) override;
+
+        SamplerHandle createSampler(const SamplerDesc& d) override;
+
+        InputLayoutHandle createInputLayout(const VertexAttributeDesc* d, uint32_t attributeCount, IShader* vertexShader) override;
+
+        EventQueryHandle createEventQuery() override;
+        void setEventQuery(IEventQuery* query, CommandQueue queue) override;
+        bool pollEventQuery(IEventQuery* query) override;
+        void waitEventQuery(IEventQuery* query) override;
+        void resetEventQuery(IEventQuery* query) override;
+
+        TimerQueryHandle createTimerQuery() override;
+        bool pollTimerQuery(ITimerQuery* query) override;
+        float getTimerQueryTime(ITimerQuery* query) override;
+        void resetTimerQuery(ITimerQuery* query) override;
+
+        GraphicsAPI getGraphicsAPI() override;
+
+        FramebufferHandle createFramebuffer(const FramebufferDesc& desc) override;
+
+        GraphicsPipelineHandle createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb) override;
+
+        ComputePipelineHandle createComputePipeline(const ComputePipelineDesc& desc) override;
+
+        MeshletPipelineHandle createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb) override;
+
+        GraphicsPipelineHandle createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize) override;
+        ComputePipelineHandle createComputePipeline(const ComputePipelineDesc& desc, const void* binary, size_t binarySize) override;
+        MeshletPipelineHandle createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize) override;
+        bool getPipelineBinary(IResource* pipeline, std::vector<uint8_t>& binary) override;
+
+        rt::PipelineHandle createRayTracingPipeline(const rt::PipelineDesc& desc) override;
+
+        BindingLayoutHandle createBindingLayout(const BindingLayoutDesc& desc) override;
+        BindingLayoutHandle createBindlessLayout(const BindlessLayoutDesc& desc) override;
+
+        BindingSetHandle createBindingSet(const BindingSetDesc& desc, IBindingLayout* layout) override;
+        DescriptorTableHandle createDescriptorTable(IBindingLayout* layout) override;
+
+        void resizeDescriptorTable(IDescriptorTable* descriptorTable, uint32_t newSize, bool keepContents = true) override;
+        bool writeDescriptorTable(IDescriptorTable* descriptorTable, const BindingSetItem& item) override;
+
+        rt::AccelStructHandle createAccelStruct(const rt::AccelStructDesc& desc) override;
+        MemoryRequirements getAccelStructMemoryRequirements(rt::IAccelStruct* as) override;
+        bool bindAccelStructMemory(rt::IAccelStruct* as, IHeap* heap, uint64_t offset) override;
+
+        CommandListHandle createCommandList(const CommandListParameters& params = CommandListParameters()) override;
+        uint64_t executeCommandLists(ICommandList* const* pCommandLists, size_t numCommandLists, CommandQueue executionQueue = CommandQueue::Graphics) override;
+        void queueWaitForCommandList(CommandQueue waitQueue, CommandQueue executionQueue, uint64_t instance) override;
+        void waitForIdle() override;
+        void runGarbageCollection() override;
+        bool queryFeatureSupport(Feature feature, void* pInfo = nullptr, size_t infoSize = 0) override;
+        Object getNativeQueue(ObjectType objectType, CommandQueue queue) override;
+        IMessageCallback* getMessageCallback() override { return m_MessageCallback; }
+
+        // Internal interface
+        Queue* getQueue(CommandQueue type) { return m_Queues[int(type)].get(); }
+        // created on the first rasterized draw
+        Rasterizer* getRasterizer();
+
+        // CPU shaders for the rasterizer, set as VS and PS of a GraphicsPipelineDesc
+        ShaderHandle createVertexShader(VertexShaderFunction function, uint32_t varyingCount);
+        ShaderHandle createPixelShader(PixelShaderFunction function);
+
+        // pipelines compiled, those created from a valid binary are not
+        uint32_t getPipelineCompileCount() const { return m_PipelineCompileCount; }
+
+    private:
+        IMessageCallback* m_MessageCallback;
+        std::array<std::unique_ptr<Queue>, (int)CommandQueue::Count> m_Queues;
+        std::unique_ptr<Rasterizer> m_Rasterizer;
+        int32_t m_RasterizerWorkerCount;
+        uint32_t m_PipelineCompileMicroseconds;
+        std::atomic<uint32_t> m_PipelineCompileCount{ 0 };
+
+        // the binary of a pipeline is a magic and the hash of its desc, a binary for another desc doesn't match
+        std::vector<uint8_t> compilePipeline(const PipelineHash& hash);
+        static bool isPipelineBinaryValid(const PipelineHash& hash, const void* binary, size_t binarySize);
+        void executeCommands(const CommandListInstance& instance);
+        void error(const std::string& message) const;
+    };
+
+}
+}
+}
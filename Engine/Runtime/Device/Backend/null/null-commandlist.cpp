@@ -0,0 +1,1058 @@
+#include "null-backend.h"
+
+#include "../../RHI/misc.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace redtea {
+namespace device {
+namespace null {
+
+    namespace
+    {
+        template<typename T> void storeChannel(uint8_t* texel, uint32_t channel, T value)
+        {
+            memcpy(texel + channel * sizeof(T), &value, sizeof(T));
+        }
+
+        uint8_t unormToByte(float value)
+        {
+            return uint8_t(std::lround(std::min(std::max(value, 0.f), 1.f) * 255.f));
+        }
+
+        // formats with 8-bit normalized or 32-bit channels, others are cleared to zero
+        void encodeClearColor(Format format, const Color& color, uint8_t* texel)
+        {
+            const FormatInfo& formatInfo = getFormatInfo(format);
+            const uint32_t channelCount = uint32_t(formatInfo.hasRed) + uint32_t(formatInfo.hasGreen) + uint32_t(formatInfo.hasBlue) + uint32_t(formatInfo.hasAlpha);
+            if (!channelCount)
+                return;
+
+            const bool isBGR = format == Format::BGRA8_UNORM || format == Format::SBGRA8_UNORM;
+            const float channels[4] = { isBGR ? color.b : color.r, color.g, isBGR ? color.r : color.b, color.a };
+            const uint32_t channelBytes = formatInfo.bytesPerBlock / channelCount;
+
+            for (uint32_t channel = 0; channel < channelCount; channel++)
+            {
+                if (formatInfo.kind == FormatKind::Normalized && channelBytes == 1 && !formatInfo.isSigned)
+                    storeChannel(texel, channel, unormToByte(channels[channel]));
+                else if (formatInfo.kind == FormatKind::Float && channelBytes == 4)
+                    storeChannel(texel, channel, channels[channel]);
+                else if (formatInfo.kind == FormatKind::Integer && channelBytes == 4)
+                    storeChannel(texel, channel, uint32_t(channels[channel]));
+            }
+        }
+
+        void encodeClearUInt(Format format, uint32_t value, uint8_t* texel)
+        {
+            const FormatInfo& formatInfo = getFormatInfo(format);
+            const uint32_t channelCount = uint32_t(formatInfo.hasRed) + uint32_t(formatInfo.hasGreen) + uint32_t(formatInfo.hasBlue) + uint32_t(formatInfo.hasAlpha);
+            if (!channelCount)
+                return;
+
+            // the value is truncated to the width of every channel
+            const uint32_t channelBytes = std::min(formatInfo.bytesPerBlock / channelCount, 4u);
+            for (uint32_t channel = 0; channel < channelCount; channel++)
+                memcpy(texel + channel * channelBytes, &value, channelBytes);
+        }
+
+        void encodeDepthStencil(Format format, bool clearDepth, float depth, bool clearStencil, uint8_t stencil, uint8_t* texel, uint8_t* mask)
+        {
+            switch (format)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case Format::D16: {
+                const uint16_t value = uint16_t(std::lround(depth * 65535.f));
+                memcpy(texel, &value, sizeof(value));
+                memset(mask, clearDepth ? 0xff : 0, 2);
+                break;
+            }
+
+            case Format::D24S8: {
+                const uint32_t value = uint32_t(std::lround(double(depth) * 0xffffff)) | (uint32_t(stencil) << 24);
+                memcpy(texel, &value, sizeof(value));
+                memset(mask, clearDepth ? 0xff : 0, 3);
+                mask[3] = clearStencil ? 0xff : 0;
+                break;
+            }
+
+            case Format::D32:
+                memcpy(texel, &depth, sizeof(depth));
+                memset(mask, clearDepth ? 0xff : 0, 4);
+                break;
+
+            case Format::D32S8:
+                memcpy(texel, &depth, sizeof(depth));
+                texel[4] = stencil;
+                memset(mask, clearDepth ? 0xff : 0, 4);
+                mask[4] = clearStencil ? 0xff : 0;
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    CommandList::CommandList(Device* device, IMessageCallback* messageCallback, const CommandListParameters& params)
+        : m_Device(device)
+        , m_Queue(device->getQueue(params.queueType))
+        , m_MessageCallback(messageCallback)
+        , m_StateTracker(messageCallback)
+        , m_Desc(params)
+    {
+    }
+
+    IDevice* CommandList::getDevice()
+    {
+        return m_Device;
+    }
+
+    void CommandList::open()
+    {
+        m_Instance = std::make_shared<CommandListInstance>();
+        m_Instance->commandQueue = m_Desc.queueType;
+
+        m_RecordingVersion = MakeVersion(m_Queue->recordingInstance++, m_Desc.queueType, false);
+        m_Statistics = CommandListStatistics();
+        m_PushConstants.clear();
+    }
+
+    void CommandList::close()
+    {
+        m_StateTracker.endSplitTransitions();
+        m_StateTracker.keepBufferInitialStates();
+        m_StateTracker.keepTextureInitialStates();
+        commitBarriers();
+
+        clearStateCache();
+    }
+
+    void CommandList::clearStateCache()
+    {
+        m_CurrentGraphicsStateValid = false;
+        m_CurrentComputeStateValid = false;
+        m_CurrentMeshletStateValid = false;
+        m_CurrentRayTracingStateValid = false;
+    }
+
+    void CommandList::clearState()
+    {
+        clearStateCache();
+    }
+
+    std::shared_ptr<CommandListInstance> CommandList::executed(Queue* pQueue)
+    {
+        std::shared_ptr<CommandListInstance> instance = m_Instance;
+        instance->submittedInstance = pQueue->lastSubmittedInstance;
+        m_Instance.reset();
+
+        // the queue completes the instance before executeCommandLists returns
+        for (const auto& it : instance->referencedTimerQueries)
+        {
+            it->started = true;
+            it->resolved = true;
+            it->time = 0.f;
+        }
+
+        m_StateTracker.commandListSubmitted();
+
+        m_RecordingVersion = 0;
+
+        return instance;
+    }
+
+    Command& CommandList::addCommand(CommandType type, void* dest, void* src)
+    {
+        if (type != CommandType::Draw)
+            m_Statistics.transfers++;
+
+        m_Instance->commands.emplace_back();
+        Command& command = m_Instance->commands.back();
+        command.type = type;
+        command.dest = dest;
+        command.src = src;
+        return command;
+    }
+
+    uint64_t CommandList::upload(const void* data, size_t size)
+    {
+        std::vector<uint8_t>& memory = m_Instance->uploadMemory;
+
+        const uint64_t offset = memory.size();
+        memory.resize(memory.size() + size);
+        if (data)
+            memcpy(memory.data() + offset, data, size);
+        return offset;
+    }
+
+    void CommandList::writeBuffer(IBuffer* _b, const void* data, size_t dataSize, uint64_t destOffsetBytes)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_b);
+
+        if (destOffsetBytes + dataSize > buffer->desc.byteSize)
+        {
+            std::stringstream ss;
+            ss << "writeBuffer to " << utils::DebugNameToString(buffer->desc.debugName) << " is out of bounds";
+            m_MessageCallback->message(MessageSeverity::Error, ss.str().c_str());
+            return;
+        }
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireBufferState(buffer, ResourceStates::CopyDest);
+        }
+        commitBarriers();
+
+        Command& command = addCommand(CommandType::WriteBuffer, buffer, nullptr);
+        command.destOffset = destOffsetBytes;
+        command.srcOffset = upload(data, dataSize);
+        command.size = dataSize;
+
+        m_Instance->referencedResources.push_back(buffer);
+    }
+
+    void CommandList::clearBufferUInt(IBuffer* _b, uint32_t clearValue)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_b);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireBufferState(buffer, ResourceStates::UnorderedAccess);
+        }
+        commitBarriers();
+
+        Command& command = addCommand(CommandType::FillBuffer, buffer, nullptr);
+        command.srcOffset = upload(&clearValue, sizeof(clearValue));
+        command.size = sizeof(clearValue);
+
+        m_Instance->referencedResources.push_back(buffer);
+    }
+
+    void CommandList::copyBuffer(IBuffer* _dest, uint64_t destOffsetBytes, IBuffer* _src, uint64_t srcOffsetBytes, uint64_t dataSizeBytes)
+    {
+        Buffer* dest = CHECKED_CAST<Buffer*>(_dest);
+        Buffer* src = CHECKED_CAST<Buffer*>(_src);
+
+        if (destOffsetBytes + dataSizeBytes > dest->desc.byteSize || srcOffsetBytes + dataSizeBytes > src->desc.byteSize)
+        {
+            m_MessageCallback->message(MessageSeverity::Error, "copyBuffer is out of bounds");
+            return;
+        }
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireBufferState(dest, ResourceStates::CopyDest);
+            requireBufferState(src, ResourceStates::CopySource);
+        }
+        commitBarriers();
+
+        Command& command = addCommand(CommandType::CopyBuffer, dest, src);
+        command.destOffset = destOffsetBytes;
+        command.srcOffset = srcOffsetBytes;
+        command.size = dataSizeBytes;
+
+        m_Instance->referencedResources.push_back(dest);
+        m_Instance->referencedResources.push_back(src);
+    }
+
+    void CommandList::fillTexture(Texture* t, TextureSubresourceSet subresources, const uint8_t* texel, const uint8_t* mask, size_t texelSize)
+    {
+        Command& command = addCommand(CommandType::FillTexture, static_cast<TextureMemory*>(t), nullptr);
+        command.subresources = subresources.resolve(t->desc, false);
+        command.srcOffset = upload(texel, texelSize);
+        command.size = texelSize;
+        upload(mask, texelSize);
+
+        m_Instance->referencedResources.push_back(t);
+    }
+
+    void CommandList::clearTextureFloat(ITexture* _t, TextureSubresourceSet subresources, const Color& clearColor)
+    {
+        Texture* t = CHECKED_CAST<Texture*>(_t);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(t, subresources, t->desc.isRenderTarget ? ResourceStates::RenderTarget : ResourceStates::UnorderedAccess);
+        }
+        commitBarriers();
+
+        uint8_t texel[16] = {};
+        uint8_t mask[16];
+        memset(mask, 0xff, sizeof(mask));
+        encodeClearColor(t->desc.format, clearColor, texel);
+        fillTexture(t, subresources, texel, mask, t->bytesPerBlock);
+    }
+
+    void CommandList::clearDepthStencilTexture(ITexture* _t, TextureSubresourceSet subresources, bool clearDepth, float depth, bool clearStencil, uint8_t stencil)
+    {
+        if (!clearDepth && !clearStencil)
+            return;
+
+        Texture* t = CHECKED_CAST<Texture*>(_t);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(t, subresources, ResourceStates::DepthWrite);
+        }
+        commitBarriers();
+
+        uint8_t texel[8] = {};
+        uint8_t mask[8] = {};
+        encodeDepthStencil(t->desc.format, clearDepth, depth, clearStencil, stencil, texel, mask);
+        fillTexture(t, subresources, texel, mask, std::min<size_t>(t->bytesPerBlock, sizeof(texel)));
+    }
+
+    void CommandList::clearTextureUInt(ITexture* _t, TextureSubresourceSet subresources, uint32_t clearColor)
+    {
+        Texture* t = CHECKED_CAST<Texture*>(_t);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(t, subresources, t->desc.isUAV ? ResourceStates::UnorderedAccess : ResourceStates::RenderTarget);
+        }
+        commitBarriers();
+
+        uint8_t texel[16] = {};
+        uint8_t mask[16];
+        memset(mask, 0xff, sizeof(mask));
+        encodeClearUInt(t->desc.format, clearColor, texel);
+        fillTexture(t, subresources, texel, mask, t->bytesPerBlock);
+    }
+
+    void CommandList::copyTexture(ITexture* _dst, const TextureSlice& dstSlice, ITexture* _src, const TextureSlice& srcSlice)
+    {
+        Texture* dst = CHECKED_CAST<Texture*>(_dst);
+        Texture* src = CHECKED_CAST<Texture*>(_src);
+
+        auto resolvedDstSlice = dstSlice.resolve(dst->desc);
+        auto resolvedSrcSlice = srcSlice.resolve(src->desc);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(dst, TextureSubresourceSet(resolvedDstSlice.mipLevel, 1, resolvedDstSlice.arraySlice, 1), ResourceStates::CopyDest);
+            requireTextureState(src, TextureSubresourceSet(resolvedSrcSlice.mipLevel, 1, resolvedSrcSlice.arraySlice, 1), ResourceStates::CopySource);
+        }
+        commitBarriers();
+
+        Command& command = addCommand(CommandType::CopyTexture, static_cast<TextureMemory*>(dst), static_cast<TextureMemory*>(src));
+        command.destSlice = resolvedDstSlice;
+        command.srcSlice = resolvedSrcSlice;
+
+        m_Instance->referencedResources.push_back(dst);
+        m_Instance->referencedResources.push_back(src);
+    }
+
+    void CommandList::copyTexture(ITexture* _dst, const TextureSlice& dstSlice, IStagingTexture* _src, const TextureSlice& srcSlice)
+    {
+        StagingTexture* src = CHECKED_CAST<StagingTexture*>(_src);
+        Texture* dst = CHECKED_CAST<Texture*>(_dst);
+
+        auto resolvedDstSlice = dstSlice.resolve(dst->desc);
+        auto resolvedSrcSlice = srcSlice.resolve(src->desc);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(dst, TextureSubresourceSet(resolvedDstSlice.mipLevel, 1, resolvedDstSlice.arraySlice, 1), ResourceStates::CopyDest);
+        }
+        commitBarriers();
+
+        Command& command = addCommand(CommandType::CopyTexture, static_cast<TextureMemory*>(dst), static_cast<TextureMemory*>(src));
+        command.destSlice = resolvedDstSlice;
+        command.srcSlice = resolvedSrcSlice;
+
+        m_Instance->referencedResources.push_back(dst);
+        m_Instance->referencedResources.push_back(src);
+    }
+
+    void CommandList::copyTexture(IStagingTexture* _dst, const TextureSlice& dstSlice, ITexture* _src, const TextureSlice& srcSlice)
+    {
+        Texture* src = CHECKED_CAST<Texture*>(_src);
+        StagingTexture* dst = CHECKED_CAST<StagingTexture*>(_dst);
+
+        auto resolvedDstSlice = dstSlice.resolve(dst->desc);
+        auto resolvedSrcSlice = srcSlice.resolve(src->desc);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(src, TextureSubresourceSet(resolvedSrcSlice.mipLevel, 1, resolvedSrcSlice.arraySlice, 1), ResourceStates::CopySource);
+        }
+        commitBarriers();
+
+        Command& command = addCommand(CommandType::CopyTexture, static_cast<TextureMemory*>(dst), static_cast<TextureMemory*>(src));
+        command.destSlice = resolvedDstSlice;
+        command.srcSlice = resolvedSrcSlice;
+
+        m_Instance->referencedResources.push_back(src);
+        m_Instance->referencedResources.push_back(dst);
+    }
+
+    void CommandList::writeTexture(ITexture* _dest, uint32_t arraySlice, uint32_t mipLevel, const void* data, size_t rowPitch, size_t depthPitch)
+    {
+        Texture* dest = CHECKED_CAST<Texture*>(_dest);
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(dest, TextureSubresourceSet(mipLevel, 1, arraySlice, 1), ResourceStates::CopyDest);
+        }
+        commitBarriers();
+
+        // repacked to the layout of the subresource, the rows of the caller may be padded
+        const SubresourceFootprint& footprint = dest->getFootprint(mipLevel, arraySlice);
+        const uint64_t offset = upload(nullptr, size_t(footprint.depthPitch * footprint.depth));
+        uint8_t* packed = m_Instance->uploadMemory.data() + offset;
+
+        for (uint32_t z = 0; z < footprint.depth; z++)
+        {
+            const uint8_t* srcSlice = static_cast<const uint8_t*>(data) + z * depthPitch;
+            for (uint32_t row = 0; row < footprint.rowCount; row++)
+            {
+                memcpy(packed + z * footprint.depthPitch + row * footprint.rowPitch, srcSlice + row * rowPitch, size_t(footprint.rowPitch));
+            }
+        }
+
+        Command& command = addCommand(CommandType::WriteTexture, static_cast<TextureMemory*>(dest), nullptr);
+        command.destSlice.mipLevel = mipLevel;
+        command.destSlice.arraySlice = arraySlice;
+        command.srcOffset = offset;
+        command.size = footprint.depthPitch * footprint.depth;
+
+        m_Instance->referencedResources.push_back(dest);
+    }
+
+    void CommandList::resolveTexture(ITexture* _dest, const TextureSubresourceSet& dstSubresources, ITexture* _src, const TextureSubresourceSet& srcSubresources)
+    {
+        Texture* dest = CHECKED_CAST<Texture*>(_dest);
+        Texture* src = CHECKED_CAST<Texture*>(_src);
+
+        TextureSubresourceSet dstSR = dstSubresources.resolve(dest->desc, false);
+        TextureSubresourceSet srcSR = srcSubresources.resolve(src->desc, false);
+
+        if (dstSR.numArraySlices != srcSR.numArraySlices || dstSR.numMipLevels != srcSR.numMipLevels)
+            // let the validation layer handle the messages
+            return;
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireTextureState(_dest, dstSubresources, ResourceStates::ResolveDest);
+            requireTextureState(_src, srcSubresources, ResourceStates::ResolveSource);
+        }
+        commitBarriers();
+
+        // a multisampled texture keeps a single sample per texel, the resolve is a copy
+        for (ArraySlice arrayIndex = 0; arrayIndex < dstSR.numArraySlices; arrayIndex++)
+        {
+            for (MipLevel mipLevel = 0; mipLevel < dstSR.numMipLevels; mipLevel++)
+            {
+                TextureSlice dstSlice;
+                dstSlice.mipLevel = dstSR.baseMipLevel + mipLevel;
+                dstSlice.arraySlice = dstSR.baseArraySlice + arrayIndex;
+
+                TextureSlice srcSlice;
+                srcSlice.mipLevel = srcSR.baseMipLevel + mipLevel;
+                srcSlice.arraySlice = srcSR.baseArraySlice + arrayIndex;
+
+                Command& command = addCommand(CommandType::CopyTexture, static_cast<TextureMemory*>(dest), static_cast<TextureMemory*>(src));
+                command.destSlice = dstSlice.resolve(dest->desc);
+                command.srcSlice = srcSlice.resolve(src->desc);
+            }
+        }
+
+        m_Instance->referencedResources.push_back(dest);
+        m_Instance->referencedResources.push_back(src);
+    }
+
+    void CommandList::setPushConstants(const void* data, size_t byteSize)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_PushConstants.assign(bytes, bytes + byteSize);
+    }
+
+    void CommandList::setBindings(const BindingSetVector& bindings, uint32_t bindingUpdateMask)
+    {
+        for (uint32_t bindingSetIndex = 0; bindingSetIndex < uint32_t(bindings.size()); bindingSetIndex++)
+        {
+            IBindingSet* _bindingSet = bindings[bindingSetIndex];
+
+            if (!_bindingSet)
+                continue;
+
+            const bool updateThisSet = (bindingUpdateMask & (1 << bindingSetIndex)) != 0;
+
+            if (_bindingSet->getDesc())
+            {
+                BindingSet* bindingSet = CHECKED_CAST<BindingSet*>(_bindingSet);
+
+                if (updateThisSet && bindingSet->desc.trackLiveness)
+                    m_Instance->referencedResources.push_back(bindingSet);
+
+                if (m_EnableAutomaticBarriers && (updateThisSet || bindingSet->hasUavBindings)) // UAV bindings may place UAV barriers on the same binding set
+                {
+                    setResourceStatesForBindingSet(bindingSet);
+                }
+            }
+            else if (updateThisSet)
+            {
+                m_Instance->referencedResources.push_back(_bindingSet);
+            }
+        }
+    }
+
+    void CommandList::setIndirectParams(IBuffer* indirectParams)
+    {
+        if (m_EnableAutomaticBarriers)
+        {
+            requireBufferState(indirectParams, ResourceStates::IndirectArgument);
+        }
+        m_Instance->referencedResources.push_back(indirectParams);
+    }
+
+    void CommandList::setGraphicsState(const GraphicsState& state)
+    {
+        const bool updateFramebuffer = !m_CurrentGraphicsStateValid || m_CurrentGraphicsState.framebuffer != state.framebuffer;
+        const bool updatePipeline = !m_CurrentGraphicsStateValid || m_CurrentGraphicsState.pipeline != state.pipeline;
+        const bool updateIndirectParams = !m_CurrentGraphicsStateValid || m_CurrentGraphicsState.indirectParams != state.indirectParams;
+        const bool updateIndexBuffer = !m_CurrentGraphicsStateValid || m_CurrentGraphicsState.indexBuffer != state.indexBuffer;
+        const bool updateVertexBuffers = !m_CurrentGraphicsStateValid || ArraysAreDifferent(m_CurrentGraphicsState.vertexBuffers, state.vertexBuffers);
+
+        uint32_t bindingUpdateMask = ~0u;
+        if (m_CurrentGraphicsStateValid && !updatePipeline)
+            bindingUpdateMask = ArrayDifferenceMask(m_CurrentGraphicsState.bindings, state.bindings);
+
+        if (updatePipeline)
+        {
+            m_Instance->referencedResources.push_back(state.pipeline);
+        }
+
+        if (updateFramebuffer)
+        {
+            if (m_EnableAutomaticBarriers)
+            {
+                const DepthStencilState& depthStencil = state.pipeline->getDesc().renderState.depthStencilState;
+                setResourceStatesForFramebuffer(state.framebuffer, depthStencil.depthWriteEnable || depthStencil.stencilWriteMask);
+            }
+            m_Instance->referencedResources.push_back(state.framebuffer);
+        }
+
+        setBindings(state.bindings, bindingUpdateMask);
+
+        if (state.indirectParams && updateIndirectParams)
+        {
+            setIndirectParams(state.indirectParams);
+        }
+
+        if (updateIndexBuffer && state.indexBuffer.buffer)
+        {
+            if (m_EnableAutomaticBarriers)
+            {
+                requireBufferState(state.indexBuffer.buffer, ResourceStates::IndexBuffer);
+            }
+            m_Instance->referencedResources.push_back(state.indexBuffer.buffer);
+        }
+
+        if (updateVertexBuffers)
+        {
+            for (const VertexBufferBinding& binding : state.vertexBuffers)
+            {
+                if (m_EnableAutomaticBarriers)
+                {
+                    requireBufferState(binding.buffer, ResourceStates::VertexBuffer);
+                }
+                m_Instance->referencedResources.push_back(binding.buffer);
+            }
+        }
+
+        if (updateFramebuffer && state.shadingRateState.enabled && state.framebuffer->getDesc().shadingRateAttachment.valid())
+        {
+            setTextureState(state.framebuffer->getDesc().shadingRateAttachment.texture, TextureSubresourceSet(0, 1, 0, 1), ResourceStates::ShadingRateSurface);
+        }
+
+        commitBarriers();
+
+        m_CurrentGraphicsStateValid = true;
+        m_CurrentComputeStateValid = false;
+        m_CurrentMeshletStateValid = false;
+        m_CurrentRayTracingStateValid = false;
+        m_CurrentGraphicsState = state;
+    }
+
+    void CommandList::recordDraw(const DrawArguments& args, bool indexed, uint32_t indirectOffset)
+    {
+        m_Statistics.draws++;
+
+        if (!m_CurrentGraphicsStateValid)
+            return;
+
+        const GraphicsState& state = m_CurrentGraphicsState;
+        GraphicsPipeline* pso = CHECKED_CAST<GraphicsPipeline*>(state.pipeline);
+        Shader* vertexShader = CHECKED_CAST<Shader*>(pso->desc.VS.Get());
+        if (!vertexShader || !vertexShader->vertexFunction)
+            return;
+
+        DrawCommand draw;
+        draw.pipeline = pso;
+        draw.framebuffer = CHECKED_CAST<Framebuffer*>(state.framebuffer);
+        draw.viewport = state.viewport;
+        draw.blendConstantColor = state.blendConstantColor;
+        draw.bindings = state.bindings;
+        draw.vertexBuffers = state.vertexBuffers;
+        draw.indexBuffer = state.indexBuffer;
+        draw.args = args;
+        draw.indexed = indexed;
+        if (indirectOffset != ~0u)
+        {
+            draw.indirectParams = CHECKED_CAST<Buffer*>(state.indirectParams);
+            draw.indirectOffset = indirectOffset;
+        }
+        draw.pushConstantsOffset = upload(m_PushConstants.data(), m_PushConstants.size());
+        draw.pushConstantsSize = uint32_t(m_PushConstants.size());
+
+        Command& command = addCommand(CommandType::Draw, nullptr, nullptr);
+        command.srcOffset = m_Instance->draws.size();
+        m_Instance->draws.push_back(draw);
+    }
+
+    void CommandList::draw(const DrawArguments& args)
+    {
+        recordDraw(args, false, ~0u);
+    }
+
+    void CommandList::drawIndexed(const DrawArguments& args)
+    {
+        recordDraw(args, true, ~0u);
+    }
+
+    void CommandList::drawIndirect(uint32_t offsetBytes)
+    {
+        assert(m_CurrentGraphicsState.indirectParams); // validation layer handles this
+        recordDraw(DrawArguments(), false, offsetBytes);
+    }
+
+    void CommandList::setComputeState(const ComputeState& state)
+    {
+        const bool updatePipeline = !m_CurrentComputeStateValid || m_CurrentComputeState.pipeline != state.pipeline;
+        const bool updateIndirectParams = !m_CurrentComputeStateValid || m_CurrentComputeState.indirectParams != state.indirectParams;
+
+        uint32_t bindingUpdateMask = ~0u;
+        if (m_CurrentComputeStateValid && !updatePipeline)
+            bindingUpdateMask = ArrayDifferenceMask(m_CurrentComputeState.bindings, state.bindings);
+
+        if (updatePipeline)
+        {
+            m_Instance->referencedResources.push_back(state.pipeline);
+        }
+
+        setBindings(state.bindings, bindingUpdateMask);
+
+        if (state.indirectParams && updateIndirectParams)
+        {
+            setIndirectParams(state.indirectParams);
+        }
+
+        m_CurrentGraphicsStateValid = false;
+        m_CurrentComputeStateValid = true;
+        m_CurrentMeshletStateValid = false;
+        m_CurrentRayTracingStateValid = false;
+        m_CurrentComputeState = state;
+
+        commitBarriers();
+    }
+
+    void CommandList::dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+    {
+        (void)groupsX;
+        (void)groupsY;
+        (void)groupsZ;
+        m_Statistics.dispatches++;
+    }
+
+    void CommandList::dispatchIndirect(uint32_t offsetBytes)
+    {
+        (void)offsetBytes;
+        assert(m_CurrentComputeState.indirectParams); // validation layer handles this
+        m_Statistics.dispatches++;
+    }
+
+    void CommandList::setMeshletState(const MeshletState& state)
+    {
+        const bool updateFramebuffer = !m_CurrentMeshletStateValid || m_CurrentMeshletState.framebuffer != state.framebuffer;
+        const bool updatePipeline = !m_CurrentMeshletStateValid || m_CurrentMeshletState.pipeline != state.pipeline;
+        const bool updateIndirectParams = !m_CurrentMeshletStateValid || m_CurrentMeshletState.indirectParams != state.indirectParams;
+
+        uint32_t bindingUpdateMask = ~0u;
+        if (m_CurrentMeshletStateValid && !updatePipeline)
+            bindingUpdateMask = ArrayDifferenceMask(m_CurrentMeshletState.bindings, state.bindings);
+
+        if (updatePipeline)
+        {
+            m_Instance->referencedResources.push_back(state.pipeline);
+        }
+
+        if (updateFramebuffer)
+        {
+            if (m_EnableAutomaticBarriers)
+            {
+                const DepthStencilState& depthStencil = state.pipeline->getDesc().renderState.depthStencilState;
+                setResourceStatesForFramebuffer(state.framebuffer, depthStencil.depthWriteEnable || depthStencil.stencilWriteMask);
+            }
+            m_Instance->referencedResources.push_back(state.framebuffer);
+        }
+
+        setBindings(state.bindings, bindingUpdateMask);
+
+        if (state.indirectParams && updateIndirectParams)
+        {
+            setIndirectParams(state.indirectParams);
+        }
+
+        commitBarriers();
+
+        m_CurrentGraphicsStateValid = false;
+        m_CurrentComputeStateValid = false;
+        m_CurrentMeshletStateValid = true;
+        m_CurrentRayTracingStateValid = false;
+        m_CurrentMeshletState = state;
+    }
+
+    void CommandList::dispatchMesh(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+    {
+        (void)groupsX;
+        (void)groupsY;
+        (void)groupsZ;
+        m_Statistics.dispatches++;
+    }
+
+    void CommandList::setRayTracingState(const rt::State& state)
+    {
+        ShaderTable* shaderTable = CHECKED_CAST<ShaderTable*>(state.shaderTable);
+
+        const bool updateShaderTable = !m_CurrentRayTracingStateValid || m_CurrentRayTracingState.shaderTable != state.shaderTable;
+
+        uint32_t bindingUpdateMask = ~0u;
+        if (m_CurrentRayTracingStateValid && !updateShaderTable)
+            bindingUpdateMask = ArrayDifferenceMask(m_CurrentRayTracingState.bindings, state.bindings);
+
+        if (updateShaderTable)
+        {
+            m_Instance->referencedResources.push_back(shaderTable);
+        }
+
+        setBindings(state.bindings, bindingUpdateMask);
+
+        commitBarriers();
+
+        m_CurrentGraphicsStateValid = false;
+        m_CurrentComputeStateValid = false;
+        m_CurrentMeshletStateValid = false;
+        m_CurrentRayTracingStateValid = true;
+        m_CurrentRayTracingState = state;
+    }
+
+    void CommandList::dispatchRays(const rt::DispatchRaysArguments& args)
+    {
+        (void)args;
+        m_Statistics.dispatches++;
+    }
+
+    void CommandList::buildBottomLevelAccelStruct(rt::IAccelStruct* _as, const rt::GeometryDesc* pGeometries, size_t numGeometries, rt::AccelStructBuildFlags buildFlags)
+    {
+        (void)buildFlags;
+        AccelStruct* as = CHECKED_CAST<AccelStruct*>(_as);
+
+        for (size_t i = 0; i < numGeometries; i++)
+        {
+            const rt::GeometryDesc& geometryDesc = pGeometries[i];
+
+            if (geometryDesc.geometryType == rt::GeometryType::Triangles)
+            {
+                const auto& triangles = geometryDesc.geometryData.triangles;
+
+                if (m_EnableAutomaticBarriers)
+                {
+                    if (triangles.indexBuffer)
+                        requireBufferState(triangles.indexBuffer, ResourceStates::AccelStructBuildInput);
+                    requireBufferState(triangles.vertexBuffer, ResourceStates::AccelStructBuildInput);
+                }
+
+                if (triangles.indexBuffer)
+                    m_Instance->referencedResources.push_back(triangles.indexBuffer);
+                m_Instance->referencedResources.push_back(triangles.vertexBuffer);
+            }
+            else
+            {
+                const auto& aabbs = geometryDesc.geometryData.aabbs;
+
+                if (m_EnableAutomaticBarriers)
+                {
+                    requireBufferState(aabbs.buffer, ResourceStates::AccelStructBuildInput);
+                }
+
+                m_Instance->referencedResources.push_back(aabbs.buffer);
+            }
+        }
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireBufferState(as->dataBuffer, ResourceStates::AccelStructWrite);
+        }
+        commitBarriers();
+
+        if (as->desc.trackLiveness)
+            m_Instance->referencedResources.push_back(as);
+    }
+
+    void CommandList::compactBottomLevelAccelStructs()
+    {
+        // nothing to compact, the acceleration structures hold no data
+    }
+
+    void CommandList::buildTopLevelAccelStruct(rt::IAccelStruct* _as, const rt::InstanceDesc* pInstances, size_t numInstances, rt::AccelStructBuildFlags buildFlags)
+    {
+        (void)buildFlags;
+        AccelStruct* as = CHECKED_CAST<AccelStruct*>(_as);
+
+        as->bottomLevelASes.clear();
+
+        for (size_t i = 0; i < numInstances; i++)
+        {
+            const rt::InstanceDesc& instance = pInstances[i];
+            AccelStruct* blas = CHECKED_CAST<AccelStruct*>(instance.bottomLevelAS);
+
+            if (blas->desc.trackLiveness)
+                as->bottomLevelASes.push_back(blas);
+
+            if (m_EnableAutomaticBarriers)
+            {
+                requireBufferState(blas->dataBuffer, ResourceStates::AccelStructBuildBlas);
+            }
+        }
+
+        if (m_EnableAutomaticBarriers)
+        {
+            requireBufferState(as->dataBuffer, ResourceStates::AccelStructWrite);
+        }
+        commitBarriers();
+
+        if (as->desc.trackLiveness)
+            m_Instance->referencedResources.push_back(as);
+    }
+
+    void CommandList::beginTimerQuery(ITimerQuery* _query)
+    {
+        TimerQuery* query = CHECKED_CAST<TimerQuery*>(_query);
+
+        m_Instance->referencedTimerQueries.push_back(query);
+    }
+
+    void CommandList::endTimerQuery(ITimerQuery* _query)
+    {
+        TimerQuery* query = CHECKED_CAST<TimerQuery*>(_query);
+
+        m_Instance->referencedTimerQueries.push_back(query);
+    }
+
+    void CommandList::beginMarker(const char* name)
+    {
+        (void)name;
+    }
+
+    void CommandList::endMarker()
+    {
+    }
+
+    void CommandList::setResourceStatesForBindingSet(IBindingSet* _bindingSet)
+    {
+        if (_bindingSet->getDesc() == nullptr)
+            return; // is bindless
+
+        BindingSet* bindingSet = CHECKED_CAST<BindingSet*>(_bindingSet);
+
+        for (auto bindingIndex : bindingSet->bindingsThatNeedTransitions)
+        {
+            const BindingSetItem& binding = bindingSet->desc.bindings[bindingIndex];
+
+            switch (binding.type)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case ResourceType::Texture_SRV:
+                requireTextureState(CHECKED_CAST<ITexture*>(binding.resourceHandle), binding.subresources, ResourceStates::ShaderResource);
+                break;
+
+            case ResourceType::Texture_UAV:
+                requireTextureState(CHECKED_CAST<ITexture*>(binding.resourceHandle), binding.subresources, ResourceStates::UnorderedAccess);
+                break;
+
+            case ResourceType::TypedBuffer_SRV:
+            case ResourceType::StructuredBuffer_SRV:
+            case ResourceType::RawBuffer_SRV:
+                requireBufferState(CHECKED_CAST<IBuffer*>(binding.resourceHandle), ResourceStates::ShaderResource);
+                break;
+
+            case ResourceType::TypedBuffer_UAV:
+            case ResourceType::StructuredBuffer_UAV:
+            case ResourceType::RawBuffer_UAV:
+                requireBufferState(CHECKED_CAST<IBuffer*>(binding.resourceHandle), ResourceStates::UnorderedAccess);
+                break;
+
+            case ResourceType::ConstantBuffer:
+                requireBufferState(CHECKED_CAST<IBuffer*>(binding.resourceHandle), ResourceStates::ConstantBuffer);
+                break;
+
+            case ResourceType::RayTracingAccelStruct:
+                requireBufferState(CHECKED_CAST<AccelStruct*>(binding.resourceHandle)->dataBuffer, ResourceStates::AccelStructRead);
+                break;
+
+            default:
+                // do nothing
+                break;
+            }
+        }
+    }
+
+    void CommandList::requireTextureState(ITexture* _texture, TextureSubresourceSet subresources, ResourceStates state)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        m_StateTracker.requireTextureState(texture, subresources, state);
+    }
+
+    void CommandList::requireBufferState(IBuffer* _buffer, ResourceStates state)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        m_StateTracker.requireBufferState(buffer, state);
+    }
+
+    void CommandList::commitBarriers()
+    {
+        const auto& textureBarriers = m_StateTracker.getTextureBarriers();
+        const auto& bufferBarriers = m_StateTracker.getBufferBarriers();
+        if (textureBarriers.empty() && bufferBarriers.empty())
+            return;
+
+        m_Statistics.requestedBarriers += uint32_t(textureBarriers.size() + bufferBarriers.size());
+        m_StateTracker.optimizeBarriers();
+
+        // counted the way D3D12 would issue them: a barrier to the same state is a UAV barrier
+        for (const auto& barrier : textureBarriers)
+        {
+            if (barrier.split == BarrierSplit::Begin)
+                m_Statistics.splitBarriers++;
+            else if (barrier.stateBefore != barrier.stateAfter)
+                m_Statistics.textureBarriers++;
+            else if ((barrier.stateAfter & ResourceStates::UnorderedAccess) != 0)
+                m_Statistics.uavBarriers++;
+        }
+
+        for (const auto& barrier : bufferBarriers)
+        {
+            if (barrier.split == BarrierSplit::Begin)
+                m_Statistics.splitBarriers++;
+            else if (barrier.stateBefore != barrier.stateAfter)
+                m_Statistics.bufferBarriers++;
+            else if ((barrier.stateAfter & (ResourceStates::UnorderedAccess | ResourceStates::AccelStructWrite)) != 0)
+                m_Statistics.uavBarriers++;
+        }
+
+        m_StateTracker.clearBarriers();
+    }
+
+    void CommandList::setEnableAutomaticBarriers(bool enable)
+    {
+        m_EnableAutomaticBarriers = enable;
+    }
+
+    void CommandList::setEnableUavBarriersForTexture(ITexture* _texture, bool enableBarriers)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        m_StateTracker.setEnableUavBarriersForTexture(texture, enableBarriers);
+    }
+
+    void CommandList::setEnableUavBarriersForBuffer(IBuffer* _buffer, bool enableBarriers)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        m_StateTracker.setEnableUavBarriersForBuffer(buffer, enableBarriers);
+    }
+
+    void CommandList::beginTrackingTextureState(ITexture* _texture, TextureSubresourceSet subresources, ResourceStates stateBits)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        m_StateTracker.beginTrackingTextureState(texture, subresources, stateBits);
+    }
+
+    void CommandList::beginTrackingBufferState(IBuffer* _buffer, ResourceStates stateBits)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        m_StateTracker.beginTrackingBufferState(buffer, stateBits);
+    }
+
+    void CommandList::setTextureState(ITexture* _texture, TextureSubresourceSet subresources, ResourceStates stateBits)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        m_StateTracker.endTrackingTextureState(texture, subresources, stateBits, false);
+    }
+
+    void CommandList::setBufferState(IBuffer* _buffer, ResourceStates stateBits)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        m_StateTracker.endTrackingBufferState(buffer, stateBits, false);
+    }
+
+    void CommandList::beginTextureStateTransition(ITexture* _texture, ResourceStates stateBits)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        m_StateTracker.beginTextureStateTransition(texture, stateBits);
+    }
+
+    void CommandList::beginBufferStateTransition(IBuffer* _buffer, ResourceStates stateBits)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        m_StateTracker.beginBufferStateTransition(buffer, stateBits);
+    }
+
+    void CommandList::setAccelStructState(rt::IAccelStruct* _as, ResourceStates stateBits)
+    {
+        AccelStruct* as = CHECKED_CAST<AccelStruct*>(_as);
+
+        if (as->dataBuffer)
+            m_StateTracker.endTrackingBufferState(as->dataBuffer, stateBits, false);
+    }
+
+    void CommandList::setPermanentTextureState(ITexture* _texture, ResourceStates stateBits)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        m_StateTracker.endTrackingTextureState(texture, AllSubresources, stateBits, true);
+    }
+
+    void CommandList::setPermanentBufferState(IBuffer* _buffer, ResourceStates stateBits)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        m_StateTracker.endTrackingBufferState(buffer, stateBits, true);
+    }
+
+    ResourceStates CommandList::getTextureSubresourceState(ITexture* _texture, ArraySlice arraySlice, MipLevel mipLevel)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        return m_StateTracker.getTextureSubresourceState(texture, arraySlice, mipLevel);
+    }
+
+    ResourceStates CommandList::getBufferState(IBuffer* _buffer)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        return m_StateTracker.getBufferState(buffer);
+    }
+
+}
+}
+}
@@ -0,0 +1,827 @@
+#include "null-backend.h"
+
+#include "../../RHI/misc.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+namespace redtea {
+namespace device {
+namespace null {
+
+    namespace
+    {
+        class LoggerMessageCallback : public IMessageCallback
+        {
+        public:
+            void message(MessageSeverity severity, const char* messageText) override
+            {
+                if (severity == MessageSeverity::Info || severity == MessageSeverity::Warning)
+                    LOGW_FORMAT("%s", messageText);
+                else
+                    LOGE_FORMAT("%s", messageText);
+            }
+        };
+
+        LoggerMessageCallback s_LoggerMessageCallback;
+    }
+
+    DeviceHandle createDevice(const DeviceDesc& desc)
+    {
+        Device* device = new Device(desc);
+        return DeviceHandle::Create(device);
+    }
+
+    Device::Device(const DeviceDesc& desc)
+        : m_MessageCallback(desc.errorCB ? desc.errorCB : &s_LoggerMessageCallback)
+        , m_RasterizerWorkerCount(desc.rasterizerWorkerCount)
+        , m_PipelineCompileMicroseconds(desc.pipelineCompileMicroseconds)
+    {
+        m_Queues[int(CommandQueue::Graphics)] = std::make_unique<Queue>();
+        if (desc.enableComputeQueue)
+            m_Queues[int(CommandQueue::Compute)] = std::make_unique<Queue>();
+        if (desc.enableCopyQueue)
+            m_Queues[int(CommandQueue::Copy)] = std::make_unique<Queue>();
+    }
+
+    Device::~Device()
+    {
+        waitForIdle();
+        runGarbageCollection();
+    }
+
+    void Device::error(const std::string& message) const
+    {
+        m_MessageCallback->message(MessageSeverity::Error, message.c_str());
+    }
+
+    GraphicsAPI Device::getGraphicsAPI()
+    {
+        return GraphicsAPI::NULL_DEVICE;
+    }
+
+    Object Device::getNativeQueue(ObjectType objectType, CommandQueue queue)
+    {
+        (void)objectType;
+        (void)queue;
+        return nullptr;
+    }
+
+    bool Device::queryFeatureSupport(Feature feature, void* pInfo, size_t infoSize)
+    {
+        (void)pInfo;
+        (void)infoSize;
+
+        switch (feature)  // NOLINT(clang-diagnostic-switch-enum)
+        {
+        case Feature::DeferredCommandLists:
+        case Feature::VirtualResources:
+        case Feature::ShaderSpecializations:
+        case Feature::Meshlets:
+        case Feature::RayTracingAccelStruct:
+        case Feature::RayTracingPipeline:
+            return true;
+        case Feature::ComputeQueue:
+            return getQueue(CommandQueue::Compute) != nullptr;
+        case Feature::CopyQueue:
+            return getQueue(CommandQueue::Copy) != nullptr;
+        default:
+            return false;
+        }
+    }
+
+    HeapHandle Device::createHeap(const HeapDesc& d)
+    {
+        Heap* heap = new Heap();
+        heap->desc = d;
+        heap->memory.resize(d.capacity);
+        return HeapHandle::Create(heap);
+    }
+
+    TextureHandle Device::createTexture(const TextureDesc& d)
+    {
+        Texture* texture = new Texture(d);
+        texture->computeLayout(d);
+
+        if (!d.isVirtual)
+        {
+            texture->memory.resize(texture->byteSize);
+            texture->data = texture->memory.data();
+        }
+
+        return TextureHandle::Create(texture);
+    }
+
+    MemoryRequirements Device::getTextureMemoryRequirements(ITexture* _texture)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+
+        MemoryRequirements memReq;
+        memReq.size = Align(texture->byteSize, c_ResourceAlignment);
+        memReq.alignment = c_ResourceAlignment;
+        return memReq;
+    }
+
+    bool Device::bindTextureMemory(ITexture* _texture, IHeap* _heap, uint64_t offset)
+    {
+        Texture* texture = CHECKED_CAST<Texture*>(_texture);
+        Heap* heap = CHECKED_CAST<Heap*>(_heap);
+
+        if (texture->data || !texture->desc.isVirtual || offset + texture->byteSize > heap->desc.capacity)
+            return false;
+
+        texture->heap = heap;
+        texture->data = heap->memory.data() + offset;
+        return true;
+    }
+
+    TextureHandle Device::createHandleForNativeTexture(ObjectType objectType, Object texture, const TextureDesc& desc)
+    {
+        (void)objectType;
+        (void)texture;
+        (void)desc;
+        return nullptr;
+    }
+
+    StagingTextureHandle Device::createStagingTexture(const TextureDesc& d, CpuAccessMode cpuAccess)
+    {
+        StagingTexture* texture = new StagingTexture();
+        texture->desc = d;
+        texture->cpuAccess = cpuAccess;
+        texture->computeLayout(d);
+        texture->memory.resize(texture->byteSize);
+        texture->data = texture->memory.data();
+        return StagingTextureHandle::Create(texture);
+    }
+
+    void* Device::mapStagingTexture(IStagingTexture* _tex, const TextureSlice& slice, CpuAccessMode cpuAccess, size_t* outRowPitch)
+    {
+        (void)cpuAccess;
+        StagingTexture* tex = CHECKED_CAST<StagingTexture*>(_tex);
+
+        const TextureSlice resolvedSlice = slice.resolve(tex->desc);
+        *outRowPitch = size_t(tex->getFootprint(resolvedSlice.mipLevel, resolvedSlice.arraySlice).rowPitch);
+        return tex->getTexel(resolvedSlice);
+    }
+
+    void Device::unmapStagingTexture(IStagingTexture* tex)
+    {
+        (void)tex;
+    }
+
+    BufferHandle Device::createBuffer(const BufferDesc& d)
+    {
+        Buffer* buffer = new Buffer(d);
+
+        if (!d.isVirtual)
+        {
+            buffer->memory.resize(d.byteSize);
+            buffer->data = buffer->memory.data();
+        }
+
+        return BufferHandle::Create(buffer);
+    }
+
+    void* Device::mapBuffer(IBuffer* _b, CpuAccessMode mapFlags)
+    {
+        (void)mapFlags;
+        Buffer* b = CHECKED_CAST<Buffer*>(_b);
+
+        // every submitted command list has completed, nothing to wait for
+        return b->data;
+    }
+
+    void Device::unmapBuffer(IBuffer* b)
+    {
+        (void)b;
+    }
+
+    MemoryRequirements Device::getBufferMemoryRequirements(IBuffer* _buffer)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+
+        MemoryRequirements memReq;
+        memReq.size = Align(buffer->desc.byteSize, c_ResourceAlignment);
+        memReq.alignment = c_ResourceAlignment;
+        return memReq;
+    }
+
+    bool Device::bindBufferMemory(IBuffer* _buffer, IHeap* _heap, uint64_t offset)
+    {
+        Buffer* buffer = CHECKED_CAST<Buffer*>(_buffer);
+        Heap* heap = CHECKED_CAST<Heap*>(_heap);
+
+        if (buffer->data || !buffer->desc.isVirtual || offset + buffer->desc.byteSize > heap->desc.capacity)
+            return false;
+
+        buffer->heap = heap;
+        buffer->data = heap->memory.data() + offset;
+        return true;
+    }
+
+    BufferHandle Device::createHandleForNativeBuffer(ObjectType objectType, Object buffer, const BufferDesc& desc)
+    {
+        (void)objectType;
+        (void)buffer;
+        (void)desc;
+        return nullptr;
+    }
+
+    ShaderHandle Device::createShader(const ShaderDesc& d, const void* binary, size_t binarySize)
+    {
+        Shader* shader = new Shader();
+        shader->desc = d;
+        shader->bytecode.resize(binarySize);
+        if (binarySize)
+            memcpy(shader->bytecode.data(), binary, binarySize);
+        return ShaderHandle::Create(shader);
+    }
+
+    ShaderHandle Device::createVertexShader(VertexShaderFunction function, uint32_t varyingCount)
+    {
+        if (varyingCount > c_MaxVaryings)
+        {
+            error("Too many varyings for the rasterizer");
+            return nullptr;
+        }
+
+        Shader* shader = new Shader();
+        shader->desc.shaderType = ShaderType::Vertex;
+        shader->vertexFunction = std::move(function);
+        shader->varyingCount = varyingCount;
+        return ShaderHandle::Create(shader);
+    }
+
+    ShaderHandle Device::createPixelShader(PixelShaderFunction function)
+    {
+        Shader* shader = new Shader();
+        shader->desc.shaderType = ShaderType::Pixel;
+        shader->pixelFunction = std::move(function);
+        return ShaderHandle::Create(shader);
+    }
+
+    ShaderHandle Device::createShaderSpecialization(IShader* _baseShader, const ShaderSpecialization* constants, uint32_t numConstants)
+    {
+        Shader* baseShader = CHECKED_CAST<Shader*>(_baseShader);
+
+        Shader* shader = new Shader();
+        shader->desc = baseShader->desc;
+        shader->bytecode = baseShader->bytecode;
+        shader->specializationConstants = baseShader->specializationConstants;
+        shader->specializationConstants.insert(shader->specializationConstants.end(), constants, constants + numConstants);
+        return ShaderHandle::Create(shader);
+    }
+
+    ShaderLibraryHandle Device::createShaderLibrary(const void* binary, size_t binarySize)
+    {
+        ShaderLibrary* library = new ShaderLibrary();
+        library->bytecode.resize(binarySize);
+        if (binarySize)
+            memcpy(library->bytecode.data(), binary, binarySize);
+        return ShaderLibraryHandle::Create(library);
+    }
+
+    SamplerHandle Device::createSampler(const SamplerDesc& d)
+    {
+        Sampler* sampler = new Sampler();
+        sampler->desc = d;
+        return SamplerHandle::Create(sampler);
+    }
+
+    InputLayoutHandle Device::createInputLayout(const VertexAttributeDesc* d, uint32_t attributeCount, IShader* vertexShader)
+    {
+        (void)vertexShader;
+        InputLayout* layout = new InputLayout();
+        layout->attributes.assign(d, d + attributeCount);
+        return InputLayoutHandle::Create(layout);
+    }
+
+    EventQueryHandle Device::createEventQuery()
+    {
+        return EventQueryHandle::Create(new EventQuery());
+    }
+
+    void Device::setEventQuery(IEventQuery* _query, CommandQueue queue)
+    {
+        EventQuery* query = CHECKED_CAST<EventQuery*>(_query);
+
+        query->queue = queue;
+        query->instance = getQueue(queue)->lastSubmittedInstance;
+        query->started = true;
+    }
+
+    bool Device::pollEventQuery(IEventQuery* _query)
+    {
+        EventQuery* query = CHECKED_CAST<EventQuery*>(_query);
+
+        if (!query->started)
+            return false;
+
+        return getQueue(query->queue)->lastCompletedInstance >= query->instance;
+    }
+
+    void Device::waitEventQuery(IEventQuery* query)
+    {
+        // work completes on submission
+        (void)query;
+    }
+
+    void Device::resetEventQuery(IEventQuery* _query)
+    {
+        EventQuery* query = CHECKED_CAST<EventQuery*>(_query);
+
+        query->started = false;
+        query->instance = 0;
+    }
+
+    TimerQueryHandle Device::createTimerQuery()
+    {
+        return TimerQueryHandle::Create(new TimerQuery());
+    }
+
+    bool Device::pollTimerQuery(ITimerQuery* _query)
+    {
+        TimerQuery* query = CHECKED_CAST<TimerQuery*>(_query);
+
+        return query->started && query->resolved;
+    }
+
+    float Device::getTimerQueryTime(ITimerQuery* _query)
+    {
+        TimerQuery* query = CHECKED_CAST<TimerQuery*>(_query);
+
+        return query->time;
+    }
+
+    void Device::resetTimerQuery(ITimerQuery* _query)
+    {
+        TimerQuery* query = CHECKED_CAST<TimerQuery*>(_query);
+
+        query->started = false;
+        query->resolved = false;
+        query->time = 0.f;
+    }
+
+    FramebufferHandle Device::createFramebuffer(const FramebufferDesc& desc)
+    {
+        Framebuffer* fb = new Framebuffer();
+        fb->desc = desc;
+        fb->framebufferInfo = FramebufferInfo(desc);
+
+        for (const auto& attachment : desc.colorAttachments)
+            fb->resources.push_back(attachment.texture);
+
+        if (desc.depthAttachment.valid())
+            fb->resources.push_back(desc.depthAttachment.texture);
+
+        if (desc.shadingRateAttachment.valid())
+            fb->resources.push_back(desc.shadingRateAttachment.texture);
+
+        return FramebufferHandle::Create(fb);
+    }
+
+    static constexpr uint32_t c_PipelineBinaryMagic = 0x4f53504e; // "NPSO"
+
+    std::vector<uint8_t> Device::compilePipeline(const PipelineHash& hash)
+    {
+        if (m_PipelineCompileMicroseconds)
+            std::this_thread::sleep_for(std::chrono::microseconds(m_PipelineCompileMicroseconds));
+        m_PipelineCompileCount++;
+
+        std::vector<uint8_t> binary(sizeof(c_PipelineBinaryMagic) + sizeof(hash));
+        memcpy(binary.data(), &c_PipelineBinaryMagic, sizeof(c_PipelineBinaryMagic));
+        memcpy(binary.data() + sizeof(c_PipelineBinaryMagic), &hash, sizeof(hash));
+        return binary;
+    }
+
+    bool Device::isPipelineBinaryValid(const PipelineHash& hash, const void* binary, size_t binarySize)
+    {
+        if (!binary || binarySize != sizeof(c_PipelineBinaryMagic) + sizeof(hash))
+            return false;
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(binary);
+        return memcmp(bytes, &c_PipelineBinaryMagic, sizeof(c_PipelineBinaryMagic)) == 0
+            && memcmp(bytes + sizeof(c_PipelineBinaryMagic), &hash, sizeof(hash)) == 0;
+    }
+
+    GraphicsPipelineHandle Device::createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb)
+    {
+        return createGraphicsPipeline(desc, fb, nullptr, 0);
+    }
+
+    ComputePipelineHandle Device::createComputePipeline(const ComputePipelineDesc& desc)
+    {
+        return createComputePipeline(desc, nullptr, 0);
+    }
+
+    MeshletPipelineHandle Device::createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb)
+    {
+        return createMeshletPipeline(desc, fb, nullptr, 0);
+    }
+
+    GraphicsPipelineHandle Device::createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize)
+    {
+        GraphicsPipeline* pso = new GraphicsPipeline();
+        pso->desc = desc;
+        pso->framebufferInfo = fb->getFramebufferInfo();
+
+        const PipelineHash hash = hashPipelineDesc(desc, pso->framebufferInfo);
+        if (isPipelineBinaryValid(hash, binary, binarySize))
+            pso->binary.assign(static_cast<const uint8_t*>(binary), static_cast<const uint8_t*>(binary) + binarySize);
+        else
+            pso->binary = compilePipeline(hash);
+
+        return GraphicsPipelineHandle::Create(pso);
+    }
+
+    ComputePipelineHandle Device::createComputePipeline(const ComputePipelineDesc& desc, const void* binary, size_t binarySize)
+    {
+        ComputePipeline* pso = new ComputePipeline();
+        pso->desc = desc;
+
+        const PipelineHash hash = hashPipelineDesc(desc);
+        if (isPipelineBinaryValid(hash, binary, binarySize))
+            pso->binary.assign(static_cast<const uint8_t*>(binary), static_cast<const uint8_t*>(binary) + binarySize);
+        else
+            pso->binary = compilePipeline(hash);
+
+        return ComputePipelineHandle::Create(pso);
+    }
+
+    MeshletPipelineHandle Device::createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize)
+    {
+        MeshletPipeline* pso = new MeshletPipeline();
+        pso->desc = desc;
+        pso->framebufferInfo = fb->getFramebufferInfo();
+
+        const PipelineHash hash = hashPipelineDesc(desc, pso->framebufferInfo);
+        if (isPipelineBinaryValid(hash, binary, binarySize))
+            pso->binary.assign(static_cast<const uint8_t*>(binary), static_cast<const uint8_t*>(binary) + binarySize);
+        else
+            pso->binary = compilePipeline(hash);
+
+        return MeshletPipelineHandle::Create(pso);
+    }
+
+    bool Device::getPipelineBinary(IResource* pipeline, std::vector<uint8_t>& binary)
+    {
+        if (auto graphics = dynamic_cast<GraphicsPipeline*>(pipeline))
+            binary = graphics->binary;
+        else if (auto compute = dynamic_cast<ComputePipeline*>(pipeline))
+            binary = compute->binary;
+        else if (auto meshlet = dynamic_cast<MeshletPipeline*>(pipeline))
+            binary = meshlet->binary;
+        else
+            return false;
+
+        return !binary.empty();
+    }
+
+    rt::PipelineHandle Device::createRayTracingPipeline(const rt::PipelineDesc& desc)
+    {
+        RayTracingPipeline* pso = new RayTracingPipeline();
+        pso->desc = desc;
+        return rt::PipelineHandle::Create(pso);
+    }
+
+    BindingLayoutHandle Device::createBindingLayout(const BindingLayoutDesc& desc)
+    {
+        BindingLayout* layout = new BindingLayout();
+        layout->desc = desc;
+        return BindingLayoutHandle::Create(layout);
+    }
+
+    BindingLayoutHandle Device::createBindlessLayout(const BindlessLayoutDesc& desc)
+    {
+        BindlessLayout* layout = new BindlessLayout();
+        layout->desc = desc;
+        return BindingLayoutHandle::Create(layout);
+    }
+
+    BindingSetHandle Device::createBindingSet(const BindingSetDesc& desc, IBindingLayout* _layout)
+    {
+        const BindingLayoutDesc* layoutDesc = _layout ? _layout->getDesc() : nullptr;
+        if (!layoutDesc)
+        {
+            error("Binding sets need a regular binding layout");
+            return nullptr;
+        }
+
+        BindingSet* bindingSet = new BindingSet();
+        bindingSet->desc = desc;
+        bindingSet->layout = _layout;
+
+        for (size_t bindingIndex = 0; bindingIndex < desc.bindings.size(); bindingIndex++)
+        {
+            const BindingSetItem& binding = desc.bindings[bindingIndex];
+
+            const bool found = std::any_of(layoutDesc->bindings.begin(), layoutDesc->bindings.end(),
+                [&binding](const BindingLayoutItem& item) { return item.slot == binding.slot && item.type == binding.type; });
+            if (!found)
+            {
+                std::stringstream ss;
+                ss << "Binding of type " << utils::ResourceTypeToString(binding.type) << " at slot " << binding.slot
+                    << " is not declared in the binding layout";
+                error(ss.str());
+            }
+
+            if (binding.resourceHandle)
+                bindingSet->resources.push_back(binding.resourceHandle);
+
+            switch (binding.type)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case ResourceType::Texture_SRV:
+            case ResourceType::Texture_UAV: {
+                bindingSet->hasUavBindings |= binding.type == ResourceType::Texture_UAV;
+                Texture* texture = CHECKED_CAST<Texture*>(binding.resourceHandle);
+                if (texture && !texture->permanentState)
+                    bindingSet->bindingsThatNeedTransitions.push_back(static_cast<uint16_t>(bindingIndex));
+                break;
+            }
+
+            case ResourceType::TypedBuffer_SRV:
+            case ResourceType::TypedBuffer_UAV:
+            case ResourceType::StructuredBuffer_SRV:
+            case ResourceType::StructuredBuffer_UAV:
+            case ResourceType::RawBuffer_SRV:
+            case ResourceType::RawBuffer_UAV:
+            case ResourceType::ConstantBuffer: {
+                bindingSet->hasUavBindings |= binding.type == ResourceType::TypedBuffer_UAV
+                    || binding.type == ResourceType::StructuredBuffer_UAV
+                    || binding.type == ResourceType::RawBuffer_UAV;
+                Buffer* buffer = CHECKED_CAST<Buffer*>(binding.resourceHandle);
+                if (buffer && !buffer->permanentState)
+                    bindingSet->bindingsThatNeedTransitions.push_back(static_cast<uint16_t>(bindingIndex));
+                break;
+            }
+
+            case ResourceType::RayTracingAccelStruct:
+                bindingSet->bindingsThatNeedTransitions.push_back(static_cast<uint16_t>(bindingIndex));
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        return BindingSetHandle::Create(bindingSet);
+    }
+
+    DescriptorTableHandle Device::createDescriptorTable(IBindingLayout* layout)
+    {
+        (void)layout;
+        return DescriptorTableHandle::Create(new DescriptorTable());
+    }
+
+    void Device::resizeDescriptorTable(IDescriptorTable* _descriptorTable, uint32_t newSize, bool keepContents)
+    {
+        DescriptorTable* descriptorTable = CHECKED_CAST<DescriptorTable*>(_descriptorTable);
+
+        BindingSetItem empty = BindingSetItem::None(0);
+        if (!keepContents)
+            descriptorTable->descriptors.clear();
+        descriptorTable->descriptors.resize(newSize, empty);
+    }
+
+    bool Device::writeDescriptorTable(IDescriptorTable* _descriptorTable, const BindingSetItem& item)
+    {
+        DescriptorTable* descriptorTable = CHECKED_CAST<DescriptorTable*>(_descriptorTable);
+
+        if (item.slot >= descriptorTable->descriptors.size())
+            return false;
+
+        descriptorTable->descriptors[item.slot] = item;
+        return true;
+    }
+
+    rt::AccelStructHandle Device::createAccelStruct(const rt::AccelStructDesc& desc)
+    {
+        AccelStruct* as = new AccelStruct();
+        as->desc = desc;
+
+        BufferDesc bufferDesc;
+        bufferDesc.byteSize = c_ResourceAlignment;
+        bufferDesc.isAccelStructStorage = true;
+        bufferDesc.canHaveUAVs = true;
+        bufferDesc.debugName = desc.debugName;
+        bufferDesc.initialState = desc.isTopLevel ? ResourceStates::AccelStructRead : ResourceStates::AccelStructBuildBlas;
+        bufferDesc.keepInitialState = true;
+        as->dataBuffer = RefCountPtr<Buffer>::Create(new Buffer(bufferDesc));
+
+        return rt::AccelStructHandle::Create(as);
+    }
+
+    MemoryRequirements Device::getAccelStructMemoryRequirements(rt::IAccelStruct* as)
+    {
+        (void)as;
+        MemoryRequirements memReq;
+        memReq.size = c_ResourceAlignment;
+        memReq.alignment = c_ResourceAlignment;
+        return memReq;
+    }
+
+    bool Device::bindAccelStructMemory(rt::IAccelStruct* as, IHeap* heap, uint64_t offset)
+    {
+        (void)as;
+        (void)heap;
+        (void)offset;
+        return true;
+    }
+
+    CommandListHandle Device::createCommandList(const CommandListParameters& params)
+    {
+        if (!getQueue(params.queueType))
+            return nullptr;
+
+        CommandList* commandList = new CommandList(this, m_MessageCallback, params);
+        return CommandListHandle::Create(commandList);
+    }
+
+    uint64_t Device::executeCommandLists(ICommandList* const* pCommandLists, size_t numCommandLists, CommandQueue executionQueue)
+    {
+        Queue* pQueue = getQueue(executionQueue);
+
+        pQueue->lastSubmittedInstance++;
+
+        for (size_t i = 0; i < numCommandLists; i++)
+        {
+            auto instance = CHECKED_CAST<CommandList*>(pCommandLists[i])->executed(pQueue);
+            executeCommands(*instance);
+            pQueue->commandListsInFlight.push_front(instance);
+        }
+
+        pQueue->lastCompletedInstance = pQueue->lastSubmittedInstance;
+
+        return pQueue->lastSubmittedInstance;
+    }
+
+    Rasterizer* Device::getRasterizer()
+    {
+        if (!m_Rasterizer)
+            m_Rasterizer = std::make_unique<Rasterizer>(m_MessageCallback, m_RasterizerWorkerCount);
+
+        return m_Rasterizer.get();
+    }
+
+    void Device::queueWaitForCommandList(CommandQueue waitQueue, CommandQueue executionQueue, uint64_t instanceID)
+    {
+        (void)waitQueue;
+        Queue* pExecutionQueue = getQueue(executionQueue);
+        assert(instanceID <= pExecutionQueue->lastSubmittedInstance);
+        (void)pExecutionQueue;
+        (void)instanceID;
+    }
+
+    void Device::waitForIdle()
+    {
+        // every queue completes its work on submission
+    }
+
+    void Device::runGarbageCollection()
+    {
+        for (const auto& pQueue : m_Queues)
+        {
+            if (!pQueue)
+                continue;
+
+            while (!pQueue->commandListsInFlight.empty())
+            {
+                std::shared_ptr<CommandListInstance> instance = pQueue->commandListsInFlight.back();
+
+                if (pQueue->lastCompletedInstance >= instance->submittedInstance)
+                {
+                    pQueue->commandListsInFlight.pop_back();
+                }
+                else
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    static void copyTextureRegion(TextureMemory* dest, const TextureSlice& destSlice, TextureMemory* src, const TextureSlice& srcSlice)
+    {
+        // the extent is the one of the source, as on D3D12
+        const SubresourceFootprint& destFootprint = dest->getFootprint(destSlice.mipLevel, destSlice.arraySlice);
+        const SubresourceFootprint& srcFootprint = src->getFootprint(srcSlice.mipLevel, srcSlice.arraySlice);
+        const uint64_t rowBytes = uint64_t((srcSlice.width + src->blockSize - 1) / src->blockSize) * src->bytesPerBlock;
+        const uint32_t rowCount = (srcSlice.height + src->blockSize - 1) / src->blockSize;
+
+        uint8_t* destTexel = dest->getTexel(destSlice);
+        const uint8_t* srcTexel = src->getTexel(srcSlice);
+        for (uint32_t z = 0; z < srcSlice.depth; z++)
+        {
+            for (uint32_t row = 0; row < rowCount; row++)
+            {
+                memcpy(destTexel + z * destFootprint.depthPitch + row * destFootprint.rowPitch,
+                    srcTexel + z * srcFootprint.depthPitch + row * srcFootprint.rowPitch, size_t(rowBytes));
+            }
+        }
+    }
+
+    static void fillMemory(uint8_t* dest, uint64_t size, const uint8_t* pattern, uint64_t patternSize)
+    {
+        if (!patternSize)
+            return;
+
+        for (uint64_t offset = 0; offset + patternSize <= size; offset += patternSize)
+            memcpy(dest + offset, pattern, size_t(patternSize));
+    }
+
+    static void fillMaskedMemory(uint8_t* dest, uint64_t size, const uint8_t* pattern, const uint8_t* mask, uint64_t patternSize)
+    {
+        if (!patternSize)
+            return;
+
+        for (uint64_t offset = 0; offset + patternSize <= size; offset += patternSize)
+        {
+            for (uint64_t i = 0; i < patternSize; i++)
+                dest[offset + i] = uint8_t((dest[offset + i] & ~mask[i]) | (pattern[i] & mask[i]));
+        }
+    }
+
+    void Device::executeCommands(const CommandListInstance& instance)
+    {
+        const uint8_t* upload = instance.uploadMemory.data();
+
+        for (const Command& command : instance.commands)
+        {
+            switch (command.type)
+            {
+            case CommandType::WriteBuffer: {
+                Buffer* dest = static_cast<Buffer*>(command.dest);
+                if (dest->data)
+                    memcpy(dest->data + command.destOffset, upload + command.srcOffset, size_t(command.size));
+                break;
+            }
+
+            case CommandType::CopyBuffer: {
+                Buffer* dest = static_cast<Buffer*>(command.dest);
+                Buffer* src = static_cast<Buffer*>(command.src);
+                if (dest->data && src->data)
+                    memmove(dest->data + command.destOffset, src->data + command.srcOffset, size_t(command.size));
+                break;
+            }
+
+            case CommandType::FillBuffer: {
+                Buffer* dest = static_cast<Buffer*>(command.dest);
+                if (dest->data)
+                    fillMemory(dest->data, dest->desc.byteSize, upload + command.srcOffset, command.size);
+                break;
+            }
+
+            case CommandType::WriteTexture: {
+                TextureMemory* dest = static_cast<TextureMemory*>(command.dest);
+                if (dest->data)
+                {
+                    const SubresourceFootprint& footprint = dest->getFootprint(command.destSlice.mipLevel, command.destSlice.arraySlice);
+                    memcpy(dest->data + footprint.offset, upload + command.srcOffset, size_t(command.size));
+                }
+                break;
+            }
+
+            case CommandType::CopyTexture: {
+                TextureMemory* dest = static_cast<TextureMemory*>(command.dest);
+                TextureMemory* src = static_cast<TextureMemory*>(command.src);
+                if (dest->data && src->data)
+                    copyTextureRegion(dest, command.destSlice, src, command.srcSlice);
+                break;
+            }
+
+            case CommandType::FillTexture: {
+                TextureMemory* dest = static_cast<TextureMemory*>(command.dest);
+                if (!dest->data)
+                    break;
+
+                const TextureSubresourceSet& subresources = command.subresources;
+                for (ArraySlice arraySlice = subresources.baseArraySlice; arraySlice < subresources.baseArraySlice + subresources.numArraySlices; arraySlice++)
+                {
+                    for (MipLevel mipLevel = subresources.baseMipLevel; mipLevel < subresources.baseMipLevel + subresources.numMipLevels; mipLevel++)
+                    {
+                        const SubresourceFootprint& footprint = dest->getFootprint(mipLevel, arraySlice);
+                        fillMaskedMemory(dest->data + footprint.offset, footprint.depthPitch * footprint.depth,
+                            upload + command.srcOffset, upload + command.srcOffset + command.size, command.size);
+                    }
+                }
+                break;
+            }
+
+            case CommandType::Draw: {
+                const DrawCommand& draw = instance.draws[command.srcOffset];
+                getRasterizer()->draw(draw, upload + draw.pushConstantsOffset);
+                break;
+            }
+
+            default:
+                utils::InvalidEnum();
+                break;
+            }
+        }
+    }
+
+}
+}
+}
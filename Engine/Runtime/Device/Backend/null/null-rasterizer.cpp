@@ -0,0 +1,1083 @@
+#include "null-backend.h"
+
+#include "../../RHI/misc.h"
+#include "math/packing.h"
+#include "utils/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <sstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTERIZER_SSE2 1
+#include <emmintrin.h>
+#else
+#define RASTERIZER_SSE2 0
+#endif
+
+namespace redtea {
+namespace device {
+namespace null {
+
+    namespace
+    {
+        static constexpr int32_t kSubpixelBits = 4;
+        static constexpr int32_t kSubpixelScale = 1 << kSubpixelBits;
+        // screen coordinates stay within +-8192 pixels, which keeps the edge functions of a
+        // tile in 32 bits, the margin covers the rounding of the clipper
+        static constexpr float kGuardBand = 8000.f;
+        static constexpr float kMinW = 1e-6f;
+        static constexpr uint32_t kMaxClipVertices = 16;
+        static constexpr uint32_t kSetupChunkSize = 1024;
+
+        struct ClipVertex
+        {
+            float position[4];
+            float varyings[c_MaxVaryings];
+        };
+
+        struct ClipPlanes
+        {
+            float guardBandX;
+            float guardBandY;
+            bool depthClip;
+        };
+
+        // >= 0 inside, planes: w, the four guard band sides, near and far
+        float planeDistance(const float* p, uint32_t plane, const ClipPlanes& planes)
+        {
+            switch (plane)
+            {
+            case 0: return p[3] - kMinW;
+            case 1: return planes.guardBandX * p[3] - p[0];
+            case 2: return planes.guardBandX * p[3] + p[0];
+            case 3: return planes.guardBandY * p[3] - p[1];
+            case 4: return planes.guardBandY * p[3] + p[1];
+            case 5: return p[2];
+            default: return p[3] - p[2];
+            }
+        }
+
+        uint32_t outcode(const float* p, const ClipPlanes& planes, uint32_t planeCount)
+        {
+            uint32_t code = 0;
+            for (uint32_t plane = 0; plane < planeCount; plane++)
+            {
+                if (planeDistance(p, plane, planes) < 0.f)
+                    code |= 1u << plane;
+            }
+            return code;
+        }
+
+        // Sutherland-Hodgman against the planes in codes, returns the vertex count of the polygon
+        uint32_t clipPolygon(ClipVertex* polygon, ClipVertex* scratch, uint32_t codes, const ClipPlanes& planes, uint32_t varyingCount)
+        {
+            uint32_t count = 3;
+            ClipVertex* in = polygon;
+            ClipVertex* out = scratch;
+
+            for (uint32_t plane = 0; codes >> plane; plane++)
+            {
+                if (!(codes & (1u << plane)))
+                    continue;
+
+                uint32_t outCount = 0;
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    const ClipVertex& a = in[i];
+                    const ClipVertex& b = in[(i + 1) % count];
+                    const float da = planeDistance(a.position, plane, planes);
+                    const float db = planeDistance(b.position, plane, planes);
+
+                    if (da >= 0.f)
+                        out[outCount++] = a;
+
+                    if ((da >= 0.f) != (db >= 0.f))
+                    {
+                        const float t = da / (da - db);
+                        ClipVertex& v = out[outCount++];
+                        for (uint32_t k = 0; k < 4; k++)
+                            v.position[k] = a.position[k] + (b.position[k] - a.position[k]) * t;
+                        for (uint32_t k = 0; k < varyingCount; k++)
+                            v.varyings[k] = a.varyings[k] + (b.varyings[k] - a.varyings[k]) * t;
+                    }
+                }
+
+                count = outCount;
+                std::swap(in, out);
+                if (count < 3)
+                    return 0;
+            }
+
+            if (in != polygon)
+                std::copy(in, in + count, polygon);
+            return count;
+        }
+
+        int32_t floorDiv(int64_t value, int32_t divisor)
+        {
+            return int32_t(value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor));
+        }
+
+        struct TargetView
+        {
+            uint8_t* data = nullptr;
+            uint64_t rowPitch = 0;
+            uint32_t bytesPerPixel = 0;
+            Format format = Format::UNKNOWN;
+
+            uint8_t* getPixel(int32_t x, int32_t y) const { return data + uint64_t(y) * rowPitch + uint64_t(x) * bytesPerPixel; }
+        };
+
+        float linearToSrgb(float value)
+        {
+            return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+        }
+
+        float srgbToLinear(float value)
+        {
+            return value <= 0.04045f ? value * (1.f / 12.92f) : std::pow((value + 0.055f) * (1.f / 1.055f), 2.4f);
+        }
+
+        void encodeColor(Format format, const float* rgba, uint8_t* texel)
+        {
+            switch (format)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case Format::R8_UNORM:
+            case Format::RG8_UNORM:
+            case Format::RGBA8_UNORM:
+                for (uint32_t c = 0; c < getFormatInfo(format).bytesPerBlock; c++)
+                    texel[c] = math::packing::floatToUnorm8(rgba[c]);
+                break;
+
+            case Format::SRGBA8_UNORM:
+                for (uint32_t c = 0; c < 3; c++)
+                    texel[c] = math::packing::floatToUnorm8(linearToSrgb(std::min(std::max(rgba[c], 0.f), 1.f)));
+                texel[3] = math::packing::floatToUnorm8(rgba[3]);
+                break;
+
+            case Format::BGRA8_UNORM:
+                texel[0] = math::packing::floatToUnorm8(rgba[2]);
+                texel[1] = math::packing::floatToUnorm8(rgba[1]);
+                texel[2] = math::packing::floatToUnorm8(rgba[0]);
+                texel[3] = math::packing::floatToUnorm8(rgba[3]);
+                break;
+
+            case Format::SBGRA8_UNORM:
+                texel[0] = math::packing::floatToUnorm8(linearToSrgb(std::min(std::max(rgba[2], 0.f), 1.f)));
+                texel[1] = math::packing::floatToUnorm8(linearToSrgb(std::min(std::max(rgba[1], 0.f), 1.f)));
+                texel[2] = math::packing::floatToUnorm8(linearToSrgb(std::min(std::max(rgba[0], 0.f), 1.f)));
+                texel[3] = math::packing::floatToUnorm8(rgba[3]);
+                break;
+
+            case Format::R10G10B10A2_UNORM: {
+                const uint32_t r = uint32_t(std::lrint(std::min(std::max(rgba[0], 0.f), 1.f) * 1023.f));
+                const uint32_t g = uint32_t(std::lrint(std::min(std::max(rgba[1], 0.f), 1.f) * 1023.f));
+                const uint32_t b = uint32_t(std::lrint(std::min(std::max(rgba[2], 0.f), 1.f) * 1023.f));
+                const uint32_t a = uint32_t(std::lrint(std::min(std::max(rgba[3], 0.f), 1.f) * 3.f));
+                const uint32_t packed = r | (g << 10) | (b << 20) | (a << 30);
+                memcpy(texel, &packed, sizeof(packed));
+                break;
+            }
+
+            case Format::R16_FLOAT:
+            case Format::RG16_FLOAT:
+            case Format::RGBA16_FLOAT:
+                for (uint32_t c = 0; c < getFormatInfo(format).bytesPerBlock / 2u; c++)
+                {
+                    const uint16_t half = math::packing::floatToHalf(rgba[c]);
+                    memcpy(texel + c * 2, &half, sizeof(half));
+                }
+                break;
+
+            case Format::R32_FLOAT:
+            case Format::RG32_FLOAT:
+            case Format::RGB32_FLOAT:
+            case Format::RGBA32_FLOAT:
+                memcpy(texel, rgba, getFormatInfo(format).bytesPerBlock);
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        void decodeColor(Format format, const uint8_t* texel, float* rgba)
+        {
+            rgba[0] = rgba[1] = rgba[2] = 0.f;
+            rgba[3] = 1.f;
+
+            switch (format)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case Format::R8_UNORM:
+            case Format::RG8_UNORM:
+            case Format::RGBA8_UNORM:
+                for (uint32_t c = 0; c < getFormatInfo(format).bytesPerBlock; c++)
+                    rgba[c] = math::packing::unorm8ToFloat(texel[c]);
+                break;
+
+            case Format::SRGBA8_UNORM:
+                for (uint32_t c = 0; c < 3; c++)
+                    rgba[c] = srgbToLinear(math::packing::unorm8ToFloat(texel[c]));
+                rgba[3] = math::packing::unorm8ToFloat(texel[3]);
+                break;
+
+            case Format::BGRA8_UNORM:
+                rgba[0] = math::packing::unorm8ToFloat(texel[2]);
+                rgba[1] = math::packing::unorm8ToFloat(texel[1]);
+                rgba[2] = math::packing::unorm8ToFloat(texel[0]);
+                rgba[3] = math::packing::unorm8ToFloat(texel[3]);
+                break;
+
+            case Format::SBGRA8_UNORM:
+                rgba[0] = srgbToLinear(math::packing::unorm8ToFloat(texel[2]));
+                rgba[1] = srgbToLinear(math::packing::unorm8ToFloat(texel[1]));
+                rgba[2] = srgbToLinear(math::packing::unorm8ToFloat(texel[0]));
+                rgba[3] = math::packing::unorm8ToFloat(texel[3]);
+                break;
+
+            case Format::R10G10B10A2_UNORM: {
+                uint32_t packed;
+                memcpy(&packed, texel, sizeof(packed));
+                rgba[0] = float(packed & 0x3ff) * (1.f / 1023.f);
+                rgba[1] = float((packed >> 10) & 0x3ff) * (1.f / 1023.f);
+                rgba[2] = float((packed >> 20) & 0x3ff) * (1.f / 1023.f);
+                rgba[3] = float(packed >> 30) * (1.f / 3.f);
+                break;
+            }
+
+            case Format::R16_FLOAT:
+            case Format::RG16_FLOAT:
+            case Format::RGBA16_FLOAT:
+                for (uint32_t c = 0; c < getFormatInfo(format).bytesPerBlock / 2u; c++)
+                {
+                    uint16_t half;
+                    memcpy(&half, texel + c * 2, sizeof(half));
+                    rgba[c] = math::packing::halfToFloat(half);
+                }
+                break;
+
+            case Format::R32_FLOAT:
+            case Format::RG32_FLOAT:
+            case Format::RGB32_FLOAT:
+            case Format::RGBA32_FLOAT:
+                memcpy(rgba, texel, getFormatInfo(format).bytesPerBlock);
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        float readDepth(Format format, const uint8_t* texel)
+        {
+            switch (format)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case Format::D16: {
+                uint16_t value;
+                memcpy(&value, texel, sizeof(value));
+                return float(value) * (1.f / 65535.f);
+            }
+            case Format::D24S8: {
+                uint32_t value;
+                memcpy(&value, texel, sizeof(value));
+                return float(double(value & 0xffffff) * (1.0 / 0xffffff));
+            }
+            default: {
+                float value;
+                memcpy(&value, texel, sizeof(value));
+                return value;
+            }
+            }
+        }
+
+        void writeDepth(Format format, uint8_t* texel, float depth)
+        {
+            switch (format)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case Format::D16: {
+                const uint16_t value = uint16_t(std::lrint(depth * 65535.f));
+                memcpy(texel, &value, sizeof(value));
+                break;
+            }
+            case Format::D24S8: {
+                uint32_t value;
+                memcpy(&value, texel, sizeof(value));
+                value = (value & 0xff000000u) | uint32_t(std::lrint(double(depth) * 0xffffff));
+                memcpy(texel, &value, sizeof(value));
+                break;
+            }
+            default:
+                memcpy(texel, &depth, sizeof(depth));
+                break;
+            }
+        }
+
+        bool compare(ComparisonFunc func, float value, float reference)
+        {
+            switch (func)
+            {
+            case ComparisonFunc::Never: return false;
+            case ComparisonFunc::Less: return value < reference;
+            case ComparisonFunc::Equal: return value == reference;
+            case ComparisonFunc::LessOrEqual: return value <= reference;
+            case ComparisonFunc::Greater: return value > reference;
+            case ComparisonFunc::NotEqual: return value != reference;
+            case ComparisonFunc::GreaterOrEqual: return value >= reference;
+            case ComparisonFunc::Always:
+            default: return true;
+            }
+        }
+
+        // dual source factors fall back to the single source ones
+        float blendFactor(BlendFactor factor, const float* src, const float* dst, const Color& constant, uint32_t channel)
+        {
+            const float constantChannel = channel == 0 ? constant.r : channel == 1 ? constant.g : channel == 2 ? constant.b : constant.a;
+
+            switch (factor)
+            {
+            case BlendFactor::Zero: return 0.f;
+            case BlendFactor::One: return 1.f;
+            case BlendFactor::SrcColor:
+            case BlendFactor::Src1Color: return src[channel];
+            case BlendFactor::InvSrcColor:
+            case BlendFactor::InvSrc1Color: return 1.f - src[channel];
+            case BlendFactor::SrcAlpha:
+            case BlendFactor::Src1Alpha: return src[3];
+            case BlendFactor::InvSrcAlpha:
+            case BlendFactor::InvSrc1Alpha: return 1.f - src[3];
+            case BlendFactor::DstAlpha: return dst[3];
+            case BlendFactor::InvDstAlpha: return 1.f - dst[3];
+            case BlendFactor::DstColor: return dst[channel];
+            case BlendFactor::InvDstColor: return 1.f - dst[channel];
+            case BlendFactor::SrcAlphaSaturate: return channel == 3 ? 1.f : std::min(src[3], 1.f - dst[3]);
+            case BlendFactor::ConstantColor: return constantChannel;
+            case BlendFactor::InvConstantColor: return 1.f - constantChannel;
+            default: return 1.f;
+            }
+        }
+
+        float blendOp(BlendOp op, float src, float dst)
+        {
+            switch (op)
+            {
+            case BlendOp::Subrtact: return src - dst;
+            case BlendOp::ReverseSubtract: return dst - src;
+            case BlendOp::Min: return std::min(src, dst);
+            case BlendOp::Max: return std::max(src, dst);
+            case BlendOp::Add:
+            default: return src + dst;
+            }
+        }
+
+        void blend(const BlendState::RenderTarget& target, const Color& constant, const float* src, float* dst)
+        {
+            float result[4];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                const bool alpha = c == 3;
+                const BlendOp op = alpha ? target.blendOpAlpha : target.blendOp;
+                if (op == BlendOp::Min || op == BlendOp::Max)
+                {
+                    result[c] = blendOp(op, src[c], dst[c]);
+                    continue;
+                }
+
+                const float srcFactor = blendFactor(alpha ? target.srcBlendAlpha : target.srcBlend, src, dst, constant, c);
+                const float dstFactor = blendFactor(alpha ? target.destBlendAlpha : target.destBlend, src, dst, constant, c);
+                result[c] = blendOp(op, src[c] * srcFactor, dst[c] * dstFactor);
+            }
+            memcpy(dst, result, sizeof(result));
+        }
+
+        TargetView getTargetView(const FramebufferAttachment& attachment)
+        {
+            Texture* texture = CHECKED_CAST<Texture*>(attachment.texture);
+
+            TargetView view;
+            if (!texture->data)
+                return view;
+
+            const SubresourceFootprint& footprint = texture->getFootprint(attachment.subresources.baseMipLevel, attachment.subresources.baseArraySlice);
+            view.data = texture->data + footprint.offset;
+            view.rowPitch = footprint.rowPitch;
+            view.bytesPerPixel = texture->bytesPerBlock;
+            view.format = texture->desc.format;
+            return view;
+        }
+    }
+
+    const uint8_t* ShaderContext::getBuffer(uint32_t set, uint32_t slot) const
+    {
+        if (!bindings || set >= bindings->size() || !(*bindings)[set])
+            return nullptr;
+
+        const BindingSetDesc* desc = (*bindings)[set]->getDesc();
+        if (!desc)
+            return nullptr;
+
+        for (const BindingSetItem& item : desc->bindings)
+        {
+            if (item.slot != slot)
+                continue;
+
+            switch (item.type)  // NOLINT(clang-diagnostic-switch-enum)
+            {
+            case ResourceType::TypedBuffer_SRV:
+            case ResourceType::TypedBuffer_UAV:
+            case ResourceType::StructuredBuffer_SRV:
+            case ResourceType::StructuredBuffer_UAV:
+            case ResourceType::RawBuffer_SRV:
+            case ResourceType::RawBuffer_UAV:
+            case ResourceType::ConstantBuffer:
+            case ResourceType::VolatileConstantBuffer: {
+                const Buffer* buffer = CHECKED_CAST<const Buffer*>(item.resourceHandle);
+                return buffer && buffer->data ? buffer->data + item.range.byteOffset : nullptr;
+            }
+            default:
+                break;
+            }
+        }
+
+        return nullptr;
+    }
+
+    Rasterizer::Rasterizer(IMessageCallback* messageCallback, int32_t workerCount)
+        : m_MessageCallback(messageCallback)
+        , m_ThreadPool(workerCount < 0 ? std::make_unique<common::ThreadPool>() : std::make_unique<common::ThreadPool>(uint32_t(workerCount)))
+    {
+    }
+
+    Rasterizer::~Rasterizer() = default;
+
+    bool Rasterizer::isSupportedColorFormat(Format format)
+    {
+        switch (format)  // NOLINT(clang-diagnostic-switch-enum)
+        {
+        case Format::R8_UNORM:
+        case Format::RG8_UNORM:
+        case Format::RGBA8_UNORM:
+        case Format::SRGBA8_UNORM:
+        case Format::BGRA8_UNORM:
+        case Format::SBGRA8_UNORM:
+        case Format::R10G10B10A2_UNORM:
+        case Format::R16_FLOAT:
+        case Format::RG16_FLOAT:
+        case Format::RGBA16_FLOAT:
+        case Format::R32_FLOAT:
+        case Format::RG32_FLOAT:
+        case Format::RGB32_FLOAT:
+        case Format::RGBA32_FLOAT:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool Rasterizer::isSupportedDepthFormat(Format format)
+    {
+        return format == Format::D16 || format == Format::D24S8 || format == Format::D32 || format == Format::D32S8;
+    }
+
+    void Rasterizer::draw(const DrawCommand& command, const uint8_t* pushConstants)
+    {
+        const GraphicsPipelineDesc& pipelineDesc = command.pipeline->desc;
+        const RenderState& renderState = pipelineDesc.renderState;
+        const Shader* vertexShader = CHECKED_CAST<const Shader*>(pipelineDesc.VS.Get());
+        const Shader* pixelShader = CHECKED_CAST<const Shader*>(pipelineDesc.PS.Get());
+        const FramebufferDesc& framebufferDesc = command.framebuffer->desc;
+        const FramebufferInfo& framebufferInfo = command.framebuffer->framebufferInfo;
+
+        if (pipelineDesc.primType != PrimitiveType::TriangleList && pipelineDesc.primType != PrimitiveType::TriangleStrip)
+        {
+            m_MessageCallback->message(MessageSeverity::Warning, "The rasterizer only draws triangle lists and strips");
+            return;
+        }
+
+        if (pixelShader && !pixelShader->pixelFunction)
+        {
+            m_MessageCallback->message(MessageSeverity::Error, "A rasterized draw needs a pixel shader made by createPixelShader");
+            return;
+        }
+
+        // targets
+
+        static_vector<TargetView, c_MaxRenderTargets> colorTargets;
+        for (const FramebufferAttachment& attachment : framebufferDesc.colorAttachments)
+        {
+            const TargetView view = getTargetView(attachment);
+            if (!view.data || !isSupportedColorFormat(view.format))
+            {
+                std::stringstream ss;
+                ss << "The rasterizer cannot write to render target " << utils::DebugNameToString(attachment.texture->getDesc().debugName)
+                    << " of format " << utils::FormatToString(attachment.texture->getDesc().format);
+                m_MessageCallback->message(MessageSeverity::Error, ss.str().c_str());
+                return;
+            }
+            colorTargets.push_back(view);
+        }
+
+        TargetView depthTarget;
+        if (framebufferDesc.depthAttachment.valid())
+        {
+            depthTarget = getTargetView(framebufferDesc.depthAttachment);
+            if (!depthTarget.data || !isSupportedDepthFormat(depthTarget.format))
+            {
+                m_MessageCallback->message(MessageSeverity::Error, "The rasterizer cannot use the depth attachment");
+                return;
+            }
+        }
+
+        // arguments and viewport
+
+        DrawArguments args = command.args;
+        if (command.indirectParams)
+        {
+            // D3D12_DRAW_ARGUMENTS: vertex count, instance count, start vertex, start instance
+            uint32_t indirect[4] = {};
+            if (command.indirectParams->data && command.indirectOffset + sizeof(indirect) <= command.indirectParams->desc.byteSize)
+                memcpy(indirect, command.indirectParams->data + command.indirectOffset, sizeof(indirect));
+            args.vertexCount = indirect[0];
+            args.instanceCount = indirect[1];
+            args.startVertexLocation = indirect[2];
+            args.startInstanceLocation = indirect[3];
+        }
+
+        if (args.vertexCount < 3 || args.instanceCount == 0)
+            return;
+
+        const Viewport viewport = command.viewport.viewports.empty() ? framebufferInfo.getViewport() : command.viewport.viewports[0];
+        const float halfWidth = viewport.width() * 0.5f;
+        const float halfHeight = viewport.height() * 0.5f;
+        if (halfWidth <= 0.f || halfHeight <= 0.f)
+            return;
+
+        ClipPlanes clipPlanes;
+        clipPlanes.guardBandX = (kGuardBand - std::abs(viewport.minX + halfWidth)) / halfWidth;
+        clipPlanes.guardBandY = (kGuardBand - std::abs(viewport.minY + halfHeight)) / halfHeight;
+        clipPlanes.depthClip = renderState.rasterState.depthClipEnable;
+        if (clipPlanes.guardBandX < 1.f || clipPlanes.guardBandY < 1.f)
+        {
+            m_MessageCallback->message(MessageSeverity::Error, "The viewport is too large for the rasterizer");
+            return;
+        }
+        const uint32_t clipPlaneCount = clipPlanes.depthClip ? 7 : 5;
+
+        Rect bounds(int(framebufferInfo.width), int(framebufferInfo.height));
+        const Rect viewportRect(viewport);
+        bounds.minX = std::max(bounds.minX, viewportRect.minX);
+        bounds.maxX = std::min(bounds.maxX, viewportRect.maxX);
+        bounds.minY = std::max(bounds.minY, viewportRect.minY);
+        bounds.maxY = std::min(bounds.maxY, viewportRect.maxY);
+        if (renderState.rasterState.scissorEnable && !command.viewport.scissorRects.empty())
+        {
+            const Rect& scissor = command.viewport.scissorRects[0];
+            bounds.minX = std::max(bounds.minX, scissor.minX);
+            bounds.maxX = std::min(bounds.maxX, scissor.maxX);
+            bounds.minY = std::max(bounds.minY, scissor.minY);
+            bounds.maxY = std::min(bounds.maxY, scissor.maxY);
+        }
+        if (bounds.width() <= 0 || bounds.height() <= 0)
+            return;
+
+        // shader context
+
+        ShaderContext context;
+        for (const VertexBufferBinding& binding : command.vertexBuffers)
+        {
+            const Buffer* buffer = CHECKED_CAST<const Buffer*>(binding.buffer);
+            if (buffer && buffer->data && binding.slot < c_MaxVertexAttributes)
+                context.vertexBuffers[binding.slot] = buffer->data + binding.offset;
+        }
+        if (const InputLayout* inputLayout = CHECKED_CAST<const InputLayout*>(pipelineDesc.inputLayout.Get()))
+        {
+            for (const VertexAttributeDesc& attribute : inputLayout->attributes)
+            {
+                if (attribute.bufferIndex < c_MaxVertexAttributes)
+                    context.vertexStrides[attribute.bufferIndex] = attribute.elementStride;
+            }
+        }
+        context.bindings = &command.bindings;
+        context.pushConstants = command.pushConstantsSize ? pushConstants : nullptr;
+        context.pushConstantsSize = command.pushConstantsSize;
+
+        // vertices, a draw shades every vertex it references once per instance
+
+        std::vector<uint32_t> vertexIds;
+        m_Indices.resize(args.vertexCount);
+        if (command.indexed)
+        {
+            const Buffer* indexBuffer = CHECKED_CAST<const Buffer*>(command.indexBuffer.buffer);
+            const uint32_t indexSize = command.indexBuffer.format == Format::R16_UINT ? 2 : 4;
+            const uint64_t indexStart = command.indexBuffer.offset + uint64_t(args.startIndexLocation) * indexSize;
+            if (!indexBuffer || !indexBuffer->data || indexStart + uint64_t(args.vertexCount) * indexSize > indexBuffer->desc.byteSize)
+            {
+                m_MessageCallback->message(MessageSeverity::Error, "The index buffer of a rasterized draw is out of bounds");
+                return;
+            }
+
+            uint32_t minIndex = ~0u;
+            uint32_t maxIndex = 0;
+            const uint8_t* indices = indexBuffer->data + indexStart;
+            for (uint32_t i = 0; i < args.vertexCount; i++)
+            {
+                uint32_t index = 0;
+                if (indexSize == 2)
+                {
+                    uint16_t shortIndex;
+                    memcpy(&shortIndex, indices + i * 2, sizeof(shortIndex));
+                    index = shortIndex;
+                }
+                else
+                {
+                    memcpy(&index, indices + i * 4, sizeof(index));
+                }
+                m_Indices[i] = index;
+                minIndex = std::min(minIndex, index);
+                maxIndex = std::max(maxIndex, index);
+            }
+
+            // a compact range is shaded as a whole and shared by the triangles
+            if (uint64_t(maxIndex - minIndex) < uint64_t(args.vertexCount) * 2)
+            {
+                vertexIds.resize(maxIndex - minIndex + 1);
+                for (uint32_t i = 0; i < uint32_t(vertexIds.size()); i++)
+                    vertexIds[i] = minIndex + i + args.startVertexLocation;
+                for (uint32_t& index : m_Indices)
+                    index -= minIndex;
+            }
+            else
+            {
+                vertexIds.resize(args.vertexCount);
+                for (uint32_t i = 0; i < args.vertexCount; i++)
+                {
+                    vertexIds[i] = m_Indices[i] + args.startVertexLocation;
+                    m_Indices[i] = i;
+                }
+            }
+        }
+        else
+        {
+            vertexIds.resize(args.vertexCount);
+            for (uint32_t i = 0; i < args.vertexCount; i++)
+            {
+                vertexIds[i] = args.startVertexLocation + i;
+                m_Indices[i] = i;
+            }
+        }
+
+        const uint32_t varyingCount = vertexShader->varyingCount;
+        const size_t verticesPerInstance = vertexIds.size();
+        const size_t vertexCount = verticesPerInstance * args.instanceCount;
+        m_Positions.resize(vertexCount * 4);
+        m_Varyings.resize(vertexCount * varyingCount);
+
+        m_ThreadPool->parallelFor(0, vertexCount, 1024, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                const uint32_t instance = uint32_t(i / verticesPerInstance);
+                vertexShader->vertexFunction(context, vertexIds[i % verticesPerInstance], args.startInstanceLocation + instance,
+                    &m_Positions[i * 4], varyingCount ? &m_Varyings[i * varyingCount] : nullptr);
+            }
+        });
+
+        // clipping and triangle setup, in chunks that keep the submission order
+
+        const bool strip = pipelineDesc.primType == PrimitiveType::TriangleStrip;
+        const uint32_t trianglesPerInstance = strip ? args.vertexCount - 2 : args.vertexCount / 3;
+        const size_t triangleCount = size_t(trianglesPerInstance) * args.instanceCount;
+        const size_t chunkCount = (triangleCount + kSetupChunkSize - 1) / kSetupChunkSize;
+        if (m_Chunks.size() < chunkCount)
+            m_Chunks.resize(chunkCount);
+
+        const RasterCullMode cullMode = renderState.rasterState.cullMode;
+        const bool frontCounterClockwise = renderState.rasterState.frontCounterClockwise;
+        const float minDepth = std::min(viewport.minZ, viewport.maxZ);
+        const float maxDepth = std::max(viewport.minZ, viewport.maxZ);
+
+        m_ThreadPool->parallelFor(0, chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd)
+        {
+            for (size_t chunkIndex = chunkBegin; chunkIndex < chunkEnd; chunkIndex++)
+            {
+                SetupChunk& chunk = m_Chunks[chunkIndex];
+                chunk.triangles.clear();
+                chunk.varyings.clear();
+                chunk.culled = 0;
+
+                const size_t first = chunkIndex * kSetupChunkSize;
+                const size_t last = std::min(first + kSetupChunkSize, triangleCount);
+                for (size_t triangle = first; triangle < last; triangle++)
+                {
+                    const size_t instance = triangle / trianglesPerInstance;
+                    const uint32_t primitive = uint32_t(triangle % trianglesPerInstance);
+
+                    uint32_t corners[3];
+                    if (strip)
+                    {
+                        // odd triangles of a strip swap two vertices to keep the winding
+                        corners[0] = m_Indices[primitive + (primitive & 1)];
+                        corners[1] = m_Indices[primitive + 1 - (primitive & 1)];
+                        corners[2] = m_Indices[primitive + 2];
+                    }
+                    else
+                    {
+                        corners[0] = m_Indices[primitive * 3];
+                        corners[1] = m_Indices[primitive * 3 + 1];
+                        corners[2] = m_Indices[primitive * 3 + 2];
+                    }
+
+                    ClipVertex polygon[kMaxClipVertices];
+                    ClipVertex scratch[kMaxClipVertices];
+                    uint32_t codes[3];
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        const size_t vertex = instance * verticesPerInstance + corners[k];
+                        memcpy(polygon[k].position, &m_Positions[vertex * 4], sizeof(float) * 4);
+                        if (varyingCount)
+                            memcpy(polygon[k].varyings, &m_Varyings[vertex * varyingCount], sizeof(float) * varyingCount);
+                        codes[k] = outcode(polygon[k].position, clipPlanes, clipPlaneCount);
+                    }
+
+                    if (codes[0] & codes[1] & codes[2])
+                    {
+                        chunk.culled++;
+                        continue;
+                    }
+
+                    uint32_t polygonSize = 3;
+                    if (codes[0] | codes[1] | codes[2])
+                        polygonSize = clipPolygon(polygon, scratch, codes[0] | codes[1] | codes[2], clipPlanes, varyingCount);
+
+                    // project the polygon, then set up its fan
+                    float screenX[kMaxClipVertices], screenY[kMaxClipVertices], screenZ[kMaxClipVertices], invW[kMaxClipVertices];
+                    int64_t fixedX[kMaxClipVertices], fixedY[kMaxClipVertices];
+                    for (uint32_t k = 0; k < polygonSize; k++)
+                    {
+                        const float* p = polygon[k].position;
+                        invW[k] = 1.f / p[3];
+                        screenX[k] = viewport.minX + (p[0] * invW[k] + 1.f) * halfWidth;
+                        screenY[k] = viewport.minY + (1.f - p[1] * invW[k]) * halfHeight;
+                        screenZ[k] = std::min(std::max(viewport.minZ + p[2] * invW[k] * (viewport.maxZ - viewport.minZ), minDepth), maxDepth);
+                        fixedX[k] = std::lrint(screenX[k] * kSubpixelScale);
+                        fixedY[k] = std::lrint(screenY[k] * kSubpixelScale);
+                    }
+
+                    for (uint32_t fan = 1; fan + 1 < polygonSize; fan++)
+                    {
+                        uint32_t v[3] = { 0, fan, fan + 1 };
+
+                        int64_t area = (fixedX[v[1]] - fixedX[v[0]]) * (fixedY[v[2]] - fixedY[v[0]])
+                            - (fixedX[v[2]] - fixedX[v[0]]) * (fixedY[v[1]] - fixedY[v[0]]);
+                        if (area == 0)
+                        {
+                            chunk.culled++;
+                            continue;
+                        }
+
+                        // y points down, a positive area is clockwise on screen
+                        const bool frontFacing = frontCounterClockwise ? area < 0 : area > 0;
+                        if ((cullMode == RasterCullMode::Back && !frontFacing) || (cullMode == RasterCullMode::Front && frontFacing))
+                        {
+                            chunk.culled++;
+                            continue;
+                        }
+
+                        if (area < 0)
+                        {
+                            std::swap(v[1], v[2]);
+                            area = -area;
+                        }
+
+                        RasterTriangle tri;
+                        int64_t minFixedX = fixedX[v[0]], maxFixedX = fixedX[v[0]];
+                        int64_t minFixedY = fixedY[v[0]], maxFixedY = fixedY[v[0]];
+                        for (uint32_t edge = 0; edge < 3; edge++)
+                        {
+                            const uint32_t i = v[edge];
+                            const uint32_t j = v[(edge + 1) % 3];
+                            const int64_t a = fixedY[i] - fixedY[j];
+                            const int64_t b = fixedX[j] - fixedX[i];
+                            const bool topLeft = a > 0 || (a == 0 && b > 0);
+                            tri.a[edge] = a;
+                            tri.b[edge] = b;
+                            tri.c[edge] = -(a * fixedX[i] + b * fixedY[i]) - (topLeft ? 0 : 1);
+
+                            minFixedX = std::min(minFixedX, fixedX[i]);
+                            maxFixedX = std::max(maxFixedX, fixedX[i]);
+                            minFixedY = std::min(minFixedY, fixedY[i]);
+                            maxFixedY = std::max(maxFixedY, fixedY[i]);
+                        }
+
+                        tri.minX = std::max(floorDiv(minFixedX, kSubpixelScale), bounds.minX);
+                        tri.maxX = std::min(floorDiv(maxFixedX, kSubpixelScale) + 1, bounds.maxX);
+                        tri.minY = std::max(floorDiv(minFixedY, kSubpixelScale), bounds.minY);
+                        tri.maxY = std::min(floorDiv(maxFixedY, kSubpixelScale) + 1, bounds.maxY);
+                        if (tri.minX >= tri.maxX || tri.minY >= tri.maxY)
+                        {
+                            chunk.culled++;
+                            continue;
+                        }
+
+                        // edge 2 runs from vertex 2 to 0 and edge 0 from 0 to 1, so they are the
+                        // barycentrics of vertices 1 and 2 and vanish at vertex 0
+                        const float scale = float(kSubpixelScale) / float(area);
+                        tri.baryX[0] = float(tri.a[2]) * scale;
+                        tri.baryY[0] = float(tri.b[2]) * scale;
+                        tri.baryX[1] = float(tri.a[0]) * scale;
+                        tri.baryY[1] = float(tri.b[0]) * scale;
+                        tri.originX = float(fixedX[v[0]]) / kSubpixelScale;
+                        tri.originY = float(fixedY[v[0]]) / kSubpixelScale;
+
+                        tri.varyings = uint32_t(chunk.varyings.size());
+                        for (uint32_t k = 0; k < 3; k++)
+                        {
+                            tri.z[k] = screenZ[v[k]];
+                            tri.invW[k] = invW[v[k]];
+                            for (uint32_t n = 0; n < varyingCount; n++)
+                                chunk.varyings.push_back(polygon[v[k]].varyings[n] * invW[v[k]]);
+                        }
+
+                        chunk.triangles.push_back(tri);
+                    }
+                }
+            }
+        });
+
+        m_Triangles.clear();
+        m_TriangleVaryings.clear();
+        for (size_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+        {
+            SetupChunk& chunk = m_Chunks[chunkIndex];
+            const uint32_t varyingBase = uint32_t(m_TriangleVaryings.size());
+            for (RasterTriangle& tri : chunk.triangles)
+            {
+                tri.varyings += varyingBase;
+                m_Triangles.push_back(tri);
+            }
+            m_TriangleVaryings.insert(m_TriangleVaryings.end(), chunk.varyings.begin(), chunk.varyings.end());
+            m_Statistics.culledTriangles += chunk.culled;
+        }
+        m_Statistics.triangles += triangleCount;
+
+        // binning
+
+        const uint32_t tilesX = (framebufferInfo.width + c_RasterTileSize - 1) / c_RasterTileSize;
+        const uint32_t tilesY = (framebufferInfo.height + c_RasterTileSize - 1) / c_RasterTileSize;
+        if (m_Bins.size() < size_t(tilesX) * tilesY)
+            m_Bins.resize(size_t(tilesX) * tilesY);
+        for (auto& bin : m_Bins)
+            bin.clear();
+
+        for (uint32_t index = 0; index < uint32_t(m_Triangles.size()); index++)
+        {
+            const RasterTriangle& tri = m_Triangles[index];
+            for (int32_t ty = tri.minY / int32_t(c_RasterTileSize); ty <= (tri.maxY - 1) / int32_t(c_RasterTileSize); ty++)
+            {
+                for (int32_t tx = tri.minX / int32_t(c_RasterTileSize); tx <= (tri.maxX - 1) / int32_t(c_RasterTileSize); tx++)
+                    m_Bins[size_t(ty) * tilesX + tx].push_back(index);
+            }
+        }
+
+        m_ActiveTiles.clear();
+        for (uint32_t tile = 0; tile < tilesX * tilesY; tile++)
+        {
+            if (!m_Bins[tile].empty())
+                m_ActiveTiles.push_back(tile);
+        }
+
+        // tiles
+
+        const DepthStencilState& depthState = renderState.depthStencilState;
+        const bool depthTest = depthTarget.data && depthState.depthTestEnable;
+        const bool depthWrite = depthTarget.data && depthState.depthWriteEnable;
+        const PixelShaderFunction* pixelFunction = pixelShader ? &pixelShader->pixelFunction : nullptr;
+        const Color blendConstant = command.blendConstantColor;
+        std::atomic<uint64_t> shadedPixels{ 0 };
+
+        m_ThreadPool->parallelFor(0, m_ActiveTiles.size(), 1, [&](size_t tileBegin, size_t tileEnd)
+        {
+            float varyings[c_MaxVaryings];
+            float colors[4 * c_MaxRenderTargets];
+            uint64_t shaded = 0;
+
+            auto shadePixel = [&](const RasterTriangle& tri, int32_t x, int32_t y)
+            {
+                const float dx = float(x) + 0.5f - tri.originX;
+                const float dy = float(y) + 0.5f - tri.originY;
+                const float b1 = tri.baryX[0] * dx + tri.baryY[0] * dy;
+                const float b2 = tri.baryX[1] * dx + tri.baryY[1] * dy;
+                const float b0 = 1.f - b1 - b2;
+
+                const float z = std::min(std::max(tri.z[0] * b0 + tri.z[1] * b1 + tri.z[2] * b2, minDepth), maxDepth);
+                uint8_t* depthTexel = depthTarget.data ? depthTarget.getPixel(x, y) : nullptr;
+                if (depthTest && !compare(depthState.depthFunc, z, readDepth(depthTarget.format, depthTexel)))
+                    return;
+
+                const float invW = tri.invW[0] * b0 + tri.invW[1] * b1 + tri.invW[2] * b2;
+                const float w = 1.f / invW;
+                const float* v0 = m_TriangleVaryings.data() + tri.varyings;
+                const float* v1 = v0 + varyingCount;
+                const float* v2 = v1 + varyingCount;
+                for (uint32_t n = 0; n < varyingCount; n++)
+                    varyings[n] = (v0[n] * b0 + v1[n] * b1 + v2[n] * b2) * w;
+
+                if (pixelFunction)
+                {
+                    const float fragCoord[4] = { float(x) + 0.5f, float(y) + 0.5f, z, invW };
+                    if (!(*pixelFunction)(context, fragCoord, varyings, colors))
+                        return;
+                }
+
+                if (depthWrite)
+                    writeDepth(depthTarget.format, depthTexel, z);
+
+                if (pixelFunction)
+                {
+                    for (uint32_t target = 0; target < uint32_t(colorTargets.size()); target++)
+                    {
+                        const BlendState::RenderTarget& blendTarget = renderState.blendState.targets[target];
+                        if (blendTarget.colorWriteMask == ColorMask(0))
+                            continue;
+
+                        const TargetView& view = colorTargets[target];
+                        uint8_t* texel = view.getPixel(x, y);
+                        float* color = &colors[target * 4];
+
+                        if (!blendTarget.blendEnable && blendTarget.colorWriteMask == ColorMask::All)
+                        {
+                            encodeColor(view.format, color, texel);
+                            continue;
+                        }
+
+                        float dst[4];
+                        decodeColor(view.format, texel, dst);
+                        float result[4] = { dst[0], dst[1], dst[2], dst[3] };
+                        if (blendTarget.blendEnable)
+                            blend(blendTarget, blendConstant, color, result);
+                        else
+                            memcpy(result, color, sizeof(result));
+
+                        for (uint32_t c = 0; c < 4; c++)
+                        {
+                            if (!(uint8_t(blendTarget.colorWriteMask) & (1u << c)))
+                                result[c] = dst[c];
+                        }
+                        encodeColor(view.format, result, texel);
+                    }
+                }
+
+                shaded++;
+            };
+
+            for (size_t activeIndex = tileBegin; activeIndex < tileEnd; activeIndex++)
+            {
+                const uint32_t tile = m_ActiveTiles[activeIndex];
+                const int32_t tileMinX = int32_t(tile % tilesX * c_RasterTileSize);
+                const int32_t tileMinY = int32_t(tile / tilesX * c_RasterTileSize);
+
+                for (uint32_t index : m_Bins[tile])
+                {
+                    const RasterTriangle& tri = m_Triangles[index];
+                    const int32_t x0 = std::max(tileMinX, tri.minX);
+                    const int32_t x1 = std::min(tileMinX + int32_t(c_RasterTileSize), tri.maxX);
+                    const int32_t y0 = std::max(tileMinY, tri.minY);
+                    const int32_t y1 = std::min(tileMinY + int32_t(c_RasterTileSize), tri.maxY);
+                    if (x0 >= x1 || y0 >= y1)
+                        continue;
+
+                    // an edge with all four corners of the rectangle on one side either rejects
+                    // the triangle or needs no test, the others stay in 32 bits over the tile
+                    const int64_t cornerX[2] = { int64_t(x0) * kSubpixelScale + kSubpixelScale / 2, int64_t(x1 - 1) * kSubpixelScale + kSubpixelScale / 2 };
+                    const int64_t cornerY[2] = { int64_t(y0) * kSubpixelScale + kSubpixelScale / 2, int64_t(y1 - 1) * kSubpixelScale + kSubpixelScale / 2 };
+                    uint32_t testedEdges = 0;
+                    bool rejected = false;
+                    for (uint32_t edge = 0; edge < 3 && !rejected; edge++)
+                    {
+                        uint32_t inside = 0;
+                        for (uint32_t corner = 0; corner < 4; corner++)
+                        {
+                            const int64_t e = tri.a[edge] * cornerX[corner & 1] + tri.b[edge] * cornerY[corner >> 1] + tri.c[edge];
+                            inside += e >= 0 ? 1 : 0;
+                        }
+                        rejected = inside == 0;
+                        if (inside != 4)
+                            testedEdges |= 1u << edge;
+                    }
+                    if (rejected)
+                        continue;
+
+                    int32_t rowValue[3] = {};
+                    int32_t stepX[3] = {};
+                    int32_t stepY[3] = {};
+                    for (uint32_t edge = 0; edge < 3; edge++)
+                    {
+                        if (testedEdges & (1u << edge))
+                        {
+                            rowValue[edge] = int32_t(tri.a[edge] * cornerX[0] + tri.b[edge] * cornerY[0] + tri.c[edge]);
+                            stepX[edge] = int32_t(tri.a[edge] * kSubpixelScale);
+                            stepY[edge] = int32_t(tri.b[edge] * kSubpixelScale);
+                        }
+                    }
+
+#if RASTERIZER_SSE2
+                    const __m128i laneStep0 = _mm_setr_epi32(0, stepX[0], stepX[0] * 2, stepX[0] * 3);
+                    const __m128i laneStep1 = _mm_setr_epi32(0, stepX[1], stepX[1] * 2, stepX[1] * 3);
+                    const __m128i laneStep2 = _mm_setr_epi32(0, stepX[2], stepX[2] * 2, stepX[2] * 3);
+                    const __m128i quadStep0 = _mm_set1_epi32(stepX[0] * 4);
+                    const __m128i quadStep1 = _mm_set1_epi32(stepX[1] * 4);
+                    const __m128i quadStep2 = _mm_set1_epi32(stepX[2] * 4);
+#endif
+
+                    for (int32_t y = y0; y < y1; y++)
+                    {
+#if RASTERIZER_SSE2
+                        __m128i e0 = _mm_add_epi32(_mm_set1_epi32(rowValue[0]), laneStep0);
+                        __m128i e1 = _mm_add_epi32(_mm_set1_epi32(rowValue[1]), laneStep1);
+                        __m128i e2 = _mm_add_epi32(_mm_set1_epi32(rowValue[2]), laneStep2);
+                        for (int32_t x = x0; x < x1; x += 4)
+                        {
+                            // a lane is covered when no edge value has its sign bit set
+                            const __m128i any = _mm_or_si128(_mm_or_si128(e0, e1), e2);
+                            uint32_t mask = ~uint32_t(_mm_movemask_ps(_mm_castsi128_ps(any))) & 0xf;
+                            if (x1 - x < 4)
+                                mask &= (1u << (x1 - x)) - 1;
+
+                            for (int32_t lane = 0; mask; lane++, mask >>= 1)
+                            {
+                                if (mask & 1)
+                                    shadePixel(tri, x + lane, y);
+                            }
+
+                            e0 = _mm_add_epi32(e0, quadStep0);
+                            e1 = _mm_add_epi32(e1, quadStep1);
+                            e2 = _mm_add_epi32(e2, quadStep2);
+                        }
+#else
+                        int32_t e[3] = { rowValue[0], rowValue[1], rowValue[2] };
+                        for (int32_t x = x0; x < x1; x++)
+                        {
+                            if ((e[0] | e[1] | e[2]) >= 0)
+                                shadePixel(tri, x, y);
+
+                            e[0] += stepX[0];
+                            e[1] += stepX[1];
+                            e[2] += stepX[2];
+                        }
+#endif
+                        rowValue[0] += stepY[0];
+                        rowValue[1] += stepY[1];
+                        rowValue[2] += stepY[2];
+                    }
+                }
+            }
+
+            shadedPixels.fetch_add(shaded, std::memory_order_relaxed);
+        });
+
+        m_Statistics.shadedPixels += shadedPixels.load(std::memory_order_relaxed);
+    }
+
+}
+}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../../RHI/rhi.h"
+
+// Tile based software rasterizer of the Null backend. A draw whose pipeline has a vertex shader
+// made by Device::createVertexShader is rasterized into the CPU memory of its framebuffer when
+// the command list is executed, other draws only go through state tracking.
+//
+// Triangles are set up in 1/16 pixel fixed point and binned into 64x64 pixel tiles, tiles are
+// shaded in parallel and keep the submission order of their triangles, so blending is ordered
+// like on a GPU. Supported: triangle lists and strips, culling, scissor, depth test and write,
+// blending and write masks. Not supported: stencil, depth bias, multisampling, derivatives.
+
+namespace redtea {
+namespace common {
+    class ThreadPool;
+}
+
+namespace device {
+namespace null {
+
+    static constexpr uint32_t c_MaxVaryings = 16;
+    static constexpr uint32_t c_RasterTileSize = 64;
+
+    class Buffer;
+    class GraphicsPipeline;
+    class Framebuffer;
+
+    // resources of the draw as seen by the CPU shaders
+    struct ShaderContext
+    {
+        // by slot, with the offset of the binding applied and the stride of the input layout
+        const uint8_t* vertexBuffers[c_MaxVertexAttributes] = {};
+        uint32_t vertexStrides[c_MaxVertexAttributes] = {};
+        const BindingSetVector* bindings = nullptr;
+        const uint8_t* pushConstants = nullptr;
+        size_t pushConstantsSize = 0;
+
+        const uint8_t* getVertex(uint32_t slot, uint32_t index) const { return vertexBuffers[slot] + size_t(index) * vertexStrides[slot]; }
+        // memory of the buffer bound at slot in binding set set, null if there is none
+        const uint8_t* getBuffer(uint32_t set, uint32_t slot) const;
+    };
+
+    // writes the clip space position (x, y, z, w) and the varyings of a vertex
+    typedef std::function<void(const ShaderContext& context, uint32_t vertexIndex, uint32_t instanceIndex, float* position, float* varyings)> VertexShaderFunction;
+    // fragCoord is (x, y, z, 1 / w) at the pixel center, writes rgba for every render target
+    // and returns false to discard. Runs on several threads at once.
+    typedef std::function<bool(const ShaderContext& context, const float* fragCoord, const float* varyings, float* colors)> PixelShaderFunction;
+
+    struct DrawCommand
+    {
+        GraphicsPipeline* pipeline = nullptr;
+        Framebuffer* framebuffer = nullptr;
+        ViewportState viewport;
+        Color blendConstantColor;
+        BindingSetVector bindings;
+        static_vector<VertexBufferBinding, c_MaxVertexAttributes> vertexBuffers;
+        IndexBufferBinding indexBuffer;
+        DrawArguments args;
+        bool indexed = false;
+        // the arguments are read from this buffer on execution when set
+        Buffer* indirectParams = nullptr;
+        uint32_t indirectOffset = 0;
+        // in the upload memory of the instance
+        uint64_t pushConstantsOffset = 0;
+        uint32_t pushConstantsSize = 0;
+    };
+
+    struct RasterTriangle
+    {
+        // edge functions a * x + b * y + c over 1/16 pixel coordinates, c includes the
+        // top-left bias, a pixel is covered when all three are >= 0 at its center
+        int64_t a[3];
+        int64_t b[3];
+        int64_t c[3];
+        // barycentrics of vertices 1 and 2 over pixel coordinates relative to vertex 0
+        float baryX[2];
+        float baryY[2];
+        float originX;
+        float originY;
+        float z[3];
+        float invW[3];
+        // pixel bounds, inclusive min and exclusive max, clipped to the scissor
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+        // 3 * varyingCount values divided by w, in the varyings of the draw
+        uint32_t varyings;
+    };
+
+    struct RasterizerStatistics
+    {
+        uint64_t triangles = 0;
+        uint64_t culledTriangles = 0;
+        uint64_t shadedPixels = 0;
+    };
+
+    class Rasterizer
+    {
+    public:
+        // workerCount threads help the executing one, -1 for one per core
+        Rasterizer(IMessageCallback* messageCallback, int32_t workerCount);
+        ~Rasterizer();
+
+        void draw(const DrawCommand& command, const uint8_t* pushConstants);
+        const RasterizerStatistics& getStatistics() const { return m_Statistics; }
+
+        static bool isSupportedColorFormat(Format format);
+        static bool isSupportedDepthFormat(Format format);
+
+    private:
+        struct SetupChunk
+        {
+            std::vector<RasterTriangle> triangles;
+            std::vector<float> varyings;
+            uint64_t culled = 0;
+        };
+
+        IMessageCallback* m_MessageCallback;
+        std::unique_ptr<common::ThreadPool> m_ThreadPool;
+        RasterizerStatistics m_Statistics;
+
+        // scratch of the current draw, kept between draws
+        std::vector<float> m_Positions;
+        std::vector<float> m_Varyings;
+        std::vector<uint32_t> m_Indices;
+        std::vector<SetupChunk> m_Chunks;
+        std::vector<RasterTriangle> m_Triangles;
+        std::vector<float> m_TriangleVaryings;
+        std::vector<std::vector<uint32_t>> m_Bins;
+        std::vector<uint32_t> m_ActiveTiles;
+    };
+
+}
+}
+}
@@ -0,0 +1,131 @@
+#include "null-backend.h"
+
+#include "../../RHI/misc.h"
+#include <algorithm>
+
+namespace redtea {
+namespace device {
+namespace null {
+
+    void TextureMemory::computeLayout(const TextureDesc& desc)
+    {
+        const FormatInfo& formatInfo = getFormatInfo(desc.format);
+        bytesPerBlock = formatInfo.bytesPerBlock;
+        blockSize = formatInfo.blockSize;
+        mipLevels = desc.mipLevels;
+
+        const bool is3D = desc.dimension == TextureDimension::Texture3D;
+
+        footprints.clear();
+        footprints.reserve(size_t(desc.mipLevels) * desc.arraySize);
+        byteSize = 0;
+
+        for (ArraySlice arraySlice = 0; arraySlice < desc.arraySize; arraySlice++)
+        {
+            for (MipLevel mipLevel = 0; mipLevel < desc.mipLevels; mipLevel++)
+            {
+                const uint32_t width = std::max(desc.width >> mipLevel, 1u);
+                const uint32_t height = std::max(desc.height >> mipLevel, 1u);
+                const uint32_t depth = is3D ? std::max(desc.depth >> mipLevel, 1u) : 1u;
+
+                SubresourceFootprint footprint;
+                footprint.offset = byteSize;
+                footprint.rowPitch = uint64_t((width + blockSize - 1) / blockSize) * bytesPerBlock;
+                footprint.rowCount = (height + blockSize - 1) / blockSize;
+                footprint.depthPitch = footprint.rowPitch * footprint.rowCount;
+                footprint.depth = depth;
+                footprints.push_back(footprint);
+
+                byteSize = Align(byteSize + footprint.depthPitch * depth, uint64_t(16));
+            }
+        }
+    }
+
+    uint8_t* TextureMemory::getTexel(const TextureSlice& slice) const
+    {
+        const SubresourceFootprint& footprint = getFootprint(slice.mipLevel, slice.arraySlice);
+
+        return data + footprint.offset
+            + slice.z * footprint.depthPitch
+            + (slice.y / blockSize) * footprint.rowPitch
+            + (slice.x / blockSize) * bytesPerBlock;
+    }
+
+    Object Texture::getNativeView(ObjectType objectType, Format format, TextureSubresourceSet subresources, TextureDimension dimension, bool isReadOnlyDSV)
+    {
+        (void)objectType;
+        (void)format;
+        (void)subresources;
+        (void)dimension;
+        (void)isReadOnlyDSV;
+        return nullptr;
+    }
+
+    void Shader::getBytecode(const void** ppBytecode, size_t* pSize) const
+    {
+        if (ppBytecode) *ppBytecode = bytecode.data();
+        if (pSize) *pSize = bytecode.size();
+    }
+
+    void ShaderLibrary::getBytecode(const void** ppBytecode, size_t* pSize) const
+    {
+        if (ppBytecode) *ppBytecode = bytecode.data();
+        if (pSize) *pSize = bytecode.size();
+    }
+
+    ShaderHandle ShaderLibrary::getShader(const char* entryName, ShaderType shaderType)
+    {
+        Shader* shader = new Shader();
+        shader->desc.shaderType = shaderType;
+        shader->desc.entryName = entryName;
+        shader->bytecode = bytecode;
+        return ShaderHandle::Create(shader);
+    }
+
+    const VertexAttributeDesc* InputLayout::getAttributeDesc(uint32_t index) const
+    {
+        if (index < uint32_t(attributes.size()))
+            return &attributes[index];
+        else
+            return nullptr;
+    }
+
+    void ShaderTable::setRayGenerationShader(const char* exportName, IBindingSet* bindings /*= nullptr*/)
+    {
+        rayGenerationShader.exportName = exportName;
+        rayGenerationShader.localBindings = bindings;
+    }
+
+    int ShaderTable::addMissShader(const char* exportName, IBindingSet* bindings /*= nullptr*/)
+    {
+        missShaders.push_back({ exportName, bindings });
+        return int(missShaders.size()) - 1;
+    }
+
+    int ShaderTable::addHitGroup(const char* exportName, IBindingSet* bindings /*= nullptr*/)
+    {
+        hitGroups.push_back({ exportName, bindings });
+        return int(hitGroups.size()) - 1;
+    }
+
+    int ShaderTable::addCallableShader(const char* exportName, IBindingSet* bindings /*= nullptr*/)
+    {
+        callableShaders.push_back({ exportName, bindings });
+        return int(callableShaders.size()) - 1;
+    }
+
+    rt::IPipeline* ShaderTable::getPipeline()
+    {
+        return pipeline;
+    }
+
+    rt::ShaderTableHandle RayTracingPipeline::createShaderTable()
+    {
+        ShaderTable* shaderTable = new ShaderTable();
+        shaderTable->pipeline = this;
+        return rt::ShaderTableHandle::Create(shaderTable);
+    }
+
+}
+}
+}
@@ -0,0 +1,176 @@
+#include "binding_set_cache.h"
+
+namespace redtea {
+namespace device {
+
+    BindingSetCache::BindingSetCache(IDevice* device, uint32_t maxSets, uint32_t maxFrameAge, uint32_t framesInFlight)
+        : m_Device(device)
+        , m_MaxSets(maxSets)
+        , m_MaxFrameAge(maxFrameAge)
+        , m_TransientRing(framesInFlight ? framesInFlight : 1)
+    { }
+
+    size_t BindingSetCache::hashBindingSet(const BindingSetDesc& desc, IBindingLayout* layout)
+    {
+        size_t hash = std::hash<BindingSetDesc>()(desc);
+        hash_combine(hash, layout);
+        hash_combine(hash, desc.trackLiveness);
+        return hash;
+    }
+
+    bool BindingSetCache::matches(IBindingSet* set, const BindingSetDesc& desc, IBindingLayout* layout)
+    {
+        const BindingSetDesc* setDesc = set->getDesc();
+        return set->getLayout() == layout && setDesc && *setDesc == desc && setDesc->trackLiveness == desc.trackLiveness;
+    }
+
+    BindingSetHandle BindingSetCache::getBindingSet(const BindingSetDesc& desc, IBindingLayout* layout)
+    {
+        const size_t hash = hashBindingSet(desc, layout);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto range = m_Sets.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                EntryList::iterator entry = it->second;
+                if (matches(entry->set, desc, layout))
+                {
+                    entry->lastUsedFrame = m_Frame;
+                    m_Entries.splice(m_Entries.begin(), m_Entries, entry);
+                    m_Statistics.hits++;
+                    return entry->set;
+                }
+            }
+        }
+
+        BindingSetHandle set = m_Device->createBindingSet(desc, layout);
+        if (!set)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Statistics.creates++;
+
+        // another thread may have created it in the meantime, both sets work
+        Entry entry;
+        entry.hash = hash;
+        entry.set = set;
+        entry.lastUsedFrame = m_Frame;
+        m_Entries.push_front(std::move(entry));
+        m_Sets.emplace(hash, m_Entries.begin());
+
+        while (m_Entries.size() > m_MaxSets)
+            evict(std::prev(m_Entries.end()));
+
+        return set;
+    }
+
+    BindingSetHandle BindingSetCache::getTransientBindingSet(const BindingSetDesc& desc, IBindingLayout* layout)
+    {
+        const size_t hash = hashBindingSet(desc, layout);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto range = m_TransientSets.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                Entry& entry = it->second;
+                if (matches(entry.set, desc, layout))
+                {
+                    // moves to the slot of this frame, the older slot lets go of it when the ring gets back there
+                    if (entry.lastUsedFrame != m_Frame)
+                    {
+                        entry.lastUsedFrame = m_Frame;
+                        m_TransientRing[m_Frame % m_TransientRing.size()].push_back(entry);
+                    }
+                    m_Statistics.hits++;
+                    return entry.set;
+                }
+            }
+        }
+
+        BindingSetHandle set = m_Device->createBindingSet(desc, layout);
+        if (!set)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Statistics.creates++;
+
+        Entry entry;
+        entry.hash = hash;
+        entry.set = set;
+        entry.lastUsedFrame = m_Frame;
+        m_TransientRing[m_Frame % m_TransientRing.size()].push_back(entry);
+        m_TransientSets.emplace(hash, std::move(entry));
+
+        return set;
+    }
+
+    void BindingSetCache::evict(EntryList::iterator entry)
+    {
+        auto range = m_Sets.equal_range(entry->hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == entry)
+            {
+                m_Sets.erase(it);
+                break;
+            }
+        }
+
+        m_Entries.erase(entry);
+        m_Statistics.evictions++;
+    }
+
+    void BindingSetCache::beginFrame()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Frame++;
+
+        while (!m_Entries.empty())
+        {
+            EntryList::iterator oldest = std::prev(m_Entries.end());
+            if (m_Entries.size() <= m_MaxSets && oldest->lastUsedFrame + m_MaxFrameAge > m_Frame)
+                break;
+            evict(oldest);
+        }
+
+        // the slot last held the sets of the frame framesInFlight frames ago, those used since are in a newer slot
+        std::vector<Entry>& slot = m_TransientRing[m_Frame % m_TransientRing.size()];
+        for (const Entry& retired : slot)
+        {
+            auto range = m_TransientSets.equal_range(retired.hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second.set == retired.set)
+                {
+                    if (it->second.lastUsedFrame == retired.lastUsedFrame)
+                        m_TransientSets.erase(it);
+                    break;
+                }
+            }
+        }
+        slot.clear();
+    }
+
+    void BindingSetCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Sets.clear();
+        m_Entries.clear();
+        m_TransientSets.clear();
+        for (std::vector<Entry>& slot : m_TransientRing)
+            slot.clear();
+    }
+
+    BindingSetCacheStatistics BindingSetCache::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        BindingSetCacheStatistics statistics = m_Statistics;
+        statistics.sets = uint32_t(m_Entries.size());
+        statistics.transientSets = uint32_t(m_TransientSets.size());
+        return statistics;
+    }
+
+}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "rhi.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Binding set cache on top of IDevice. The same BindingSetDesc for the same layout returns the
+// binding set created the first time instead of a new one with its own descriptors, e.g. for the
+// material bindings of every draw.
+//
+//     BindingSetCache cache(device);
+//     ... every frame ...
+//     cache.beginFrame();
+//     state.bindings = { cache.getBindingSet(materialDesc, materialLayout) };
+//     state.bindings.push_back(cache.getTransientBindingSet(perDrawDesc, perDrawLayout));
+//
+// Sets are looked up by the hash of their desc and checked against the desc of the set, the
+// resources are compared by address. The cache holds a reference to its sets, and a set to its
+// resources, so a resource stays alive until the sets using it are evicted. getBindingSet() sets
+// are evicted by beginFrame() when unused for maxFrameAge frames, and the least recently used
+// first when there are more than maxSets. getTransientBindingSet() sets only live while the frame
+// they were last used in is in flight, they sit in a ring with a slot per frame and a slot is
+// released as a whole when the ring comes back to it. The functions may be called from any thread.
+
+namespace redtea {
+namespace device {
+
+    struct BindingSetCacheStatistics
+    {
+        uint32_t hits = 0;
+        uint32_t creates = 0;
+        uint32_t evictions = 0;
+        // alive in the cache now
+        uint32_t sets = 0;
+        uint32_t transientSets = 0;
+    };
+
+    class BindingSetCache
+    {
+    public:
+        explicit BindingSetCache(IDevice* device, uint32_t maxSets = 4096, uint32_t maxFrameAge = 60, uint32_t framesInFlight = 3);
+
+        BindingSetHandle getBindingSet(const BindingSetDesc& desc, IBindingLayout* layout);
+        BindingSetHandle getTransientBindingSet(const BindingSetDesc& desc, IBindingLayout* layout);
+
+        // evicts the sets that have aged out and releases the transient sets of the frame the ring is back to
+        void beginFrame();
+        void clear();
+
+        BindingSetCacheStatistics getStatistics();
+
+    private:
+        struct Entry
+        {
+            size_t hash = 0;
+            BindingSetHandle set;
+            uint64_t lastUsedFrame = 0;
+        };
+
+        typedef std::list<Entry> EntryList;
+
+        static size_t hashBindingSet(const BindingSetDesc& desc, IBindingLayout* layout);
+        static bool matches(IBindingSet* set, const BindingSetDesc& desc, IBindingLayout* layout);
+        void evict(EntryList::iterator entry);
+
+        IDevice* m_Device;
+        uint32_t m_MaxSets;
+        uint32_t m_MaxFrameAge;
+        std::mutex m_Mutex;
+        uint64_t m_Frame = 0;
+
+        // most recently used first
+        EntryList m_Entries;
+        std::unordered_multimap<size_t, EntryList::iterator> m_Sets;
+
+        // one slot per frame in flight holding the transient sets used in that frame
+        std::vector<std::vector<Entry>> m_TransientRing;
+        std::unordered_multimap<size_t, Entry> m_TransientSets;
+
+        BindingSetCacheStatistics m_Statistics;
+    };
+
+}
+}
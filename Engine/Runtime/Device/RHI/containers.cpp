@@ -1,57 +1,337 @@
 #include "containers.h"
 
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace redtea
 {
 namespace device
 {
 
-    BitSetAllocator::BitSetAllocator(const size_t capacity, bool multithreaded)
-        : m_MultiThreaded(multithreaded)
+    static uint32_t countTrailingZeros(uint64_t value)
     {
-        m_Allocated.resize(capacity);
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return uint32_t(index);
+#else
+        return uint32_t(__builtin_ctzll(value));
+#endif
     }
 
-    int BitSetAllocator::allocate()
+    static uint32_t countLeadingZeros(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - uint32_t(index);
+#else
+        return uint32_t(__builtin_clzll(value));
+#endif
+    }
+
+    // bit i stays set when bits i to i + count - 1 are all set, count <= 64
+    static uint64_t findRuns(uint64_t bits, uint32_t count)
+    {
+        for (uint32_t length = 1; length < count; )
+        {
+            const uint32_t shift = std::min(length, count - length);
+            bits &= bits >> shift;
+            length += shift;
+        }
+        return bits;
+    }
+
+    // count bits from bit, 0 < count <= 64
+    static uint64_t bitMask(uint32_t bit, uint32_t count)
+    {
+        return (count == 64 ? ~0ull : (1ull << count) - 1) << bit;
+    }
+
+    BitmapAllocator::BitmapAllocator(uint32_t capacity)
+    {
+        grow(capacity);
+    }
+
+    void BitmapAllocator::grow(uint32_t capacity)
     {
-        if (m_MultiThreaded)
-            m_Mutex.lock();
+        if (capacity <= m_Capacity && !m_Levels.empty())
+            return;
 
-        int result = -1;
+        std::vector<Level> levels;
+        uint32_t wordCount = std::max((capacity + 63) / 64, 1u);
+        do
+        {
+            Level level;
+            level.words.reset(new std::atomic<uint64_t>[wordCount]);
+            level.wordCount = wordCount;
+            for (uint32_t word = 0; word < wordCount; word++)
+                level.words[word].store(0, std::memory_order_relaxed);
+            levels.push_back(std::move(level));
+            wordCount = (wordCount + 63) / 64;
+        } while (levels.back().wordCount > 1);
 
-        int capacity = static_cast<int>(m_Allocated.size());
-        for (int i = 0; i < capacity; i++)
+        Level& slots = levels[0];
+        if (!m_Levels.empty())
         {
-            int ii = (m_NextAvailable + i) % capacity;
+            for (uint32_t word = 0; word < m_Levels[0].wordCount; word++)
+                slots.words[word].store(m_Levels[0].words[word].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        for (uint32_t index = m_Capacity; index < capacity; )
+        {
+            const uint32_t bit = index & 63;
+            const uint32_t count = std::min(64 - bit, capacity - index);
+            slots.words[index >> 6].fetch_or(bitMask(bit, count), std::memory_order_relaxed);
+            index += count;
+        }
 
-            if (!m_Allocated[ii])
+        for (size_t level = 1; level < levels.size(); level++)
+        {
+            for (uint32_t word = 0; word < levels[level - 1].wordCount; word++)
             {
-                result = ii;
-                m_NextAvailable = (ii + 1) % capacity;
-                m_Allocated[ii] = true;
-                break;
+                if (levels[level - 1].words[word].load(std::memory_order_relaxed))
+                    levels[level].words[word >> 6].fetch_or(1ull << (word & 63), std::memory_order_relaxed);
             }
         }
 
-        if (m_MultiThreaded)
-            m_Mutex.unlock();
+        m_Levels = std::move(levels);
+        m_Capacity = capacity;
+    }
+
+    uint32_t BitmapAllocator::findNext(size_t level, uint32_t index) const
+    {
+        const Level& bits = m_Levels[level];
+        uint32_t word = index >> 6;
+
+        while (word < bits.wordCount)
+        {
+            const uint64_t value = bits.words[word].load() & (~0ull << (index & 63));
+            if (value)
+                return (word << 6) + countTrailingZeros(value);
+
+            // the level above tells which of the following words have a bit set, the last level has a single word
+            if (level + 1 == m_Levels.size())
+                return c_InvalidIndex;
+
+            word = findNext(level + 1, word + 1);
+            if (word == c_InvalidIndex)
+                return c_InvalidIndex;
+
+            index = word << 6;
+        }
+
+        return c_InvalidIndex;
+    }
+
+    uint32_t BitmapAllocator::findRange(uint32_t index, uint32_t count) const
+    {
+        const Level& slots = m_Levels[0];
+        // the free slots at the end of the words looked at so far
+        uint32_t runStart = 0;
+        uint32_t runLength = 0;
+        uint32_t word = 0;
+
+        for (;;)
+        {
+            uint64_t value;
+            if (runLength)
+            {
+                // the run can only go on in the next word
+                if (++word == slots.wordCount)
+                    return c_InvalidIndex;
+                value = slots.words[word].load();
+            }
+            else
+            {
+                const uint32_t next = findNext(0, index);
+                if (next == c_InvalidIndex)
+                    return c_InvalidIndex;
+                word = next >> 6;
+                value = slots.words[word].load() & (~0ull << (next & 63));
+            }
+
+            if (runLength)
+            {
+                const uint32_t prefix = value == ~0ull ? 64 : countTrailingZeros(~value);
+                if (runLength + prefix >= count)
+                    return runStart;
+            }
+
+            if (count <= 64)
+            {
+                const uint64_t runs = findRuns(value, count);
+                if (runs)
+                    return (word << 6) + countTrailingZeros(runs);
+            }
+
+            if (value == ~0ull)
+            {
+                if (!runLength)
+                    runStart = word << 6;
+                runLength += 64;
+            }
+            else
+            {
+                runLength = countLeadingZeros(~value);
+                runStart = (word << 6) + 64 - runLength;
+            }
 
-        return result;
+            index = (word + 1) << 6;
+        }
     }
 
-    void BitSetAllocator::release(const int index)
+    void BitmapAllocator::markEmpty(size_t level, uint32_t word)
+    {
+        if (level + 1 == m_Levels.size())
+            return;
+
+        const uint64_t bit = 1ull << (word & 63);
+        std::atomic<uint64_t>& summary = m_Levels[level + 1].words[word >> 6];
+        if ((summary.fetch_and(~bit) & ~bit) == 0)
+            markEmpty(level + 1, word >> 6);
+
+        // a release may have freed a slot of the word before its summary bit was cleared
+        if (m_Levels[level].words[word].load())
+            markNonEmpty(level, word);
+    }
+
+    void BitmapAllocator::markNonEmpty(size_t level, uint32_t word)
+    {
+        if (level + 1 == m_Levels.size())
+            return;
+
+        // when the summary word already had a bit set, the levels above have theirs or are being fixed by markEmpty()
+        const uint64_t bit = 1ull << (word & 63);
+        if (m_Levels[level + 1].words[word >> 6].fetch_or(bit) == 0)
+            markNonEmpty(level + 1, word >> 6);
+    }
+
+    uint32_t BitmapAllocator::allocate()
+    {
+        for (;;)
+        {
+            const uint32_t index = findNext(0, 0);
+            if (index == c_InvalidIndex)
+                return c_InvalidIndex;
+
+            const uint64_t bit = 1ull << (index & 63);
+            const uint64_t previous = m_Levels[0].words[index >> 6].fetch_and(~bit);
+            if (previous & bit)
+            {
+                if ((previous & ~bit) == 0)
+                    markEmpty(0, index >> 6);
+                return index;
+            }
+
+            // another thread took it
+        }
+    }
+
+    uint32_t BitmapAllocator::allocateRange(uint32_t count)
+    {
+        if (count == 1)
+            return allocate();
+
+        if (count == 0 || count > m_Capacity)
+            return c_InvalidIndex;
+
+        uint32_t index = 0;
+        for (;;)
+        {
+            const uint32_t first = findRange(index, count);
+            if (first == c_InvalidIndex)
+                return c_InvalidIndex;
+
+            if (claim(first, count))
+                return first;
+
+            // another thread took a part of it, looks again from the same slot
+            index = first;
+        }
+    }
+
+    bool BitmapAllocator::claim(uint32_t first, uint32_t count)
+    {
+        const uint32_t end = first + count;
+        for (uint32_t index = first; index < end; )
+        {
+            const uint32_t word = index >> 6;
+            const uint32_t bits = std::min(64 - (index & 63), end - index);
+            const uint64_t mask = bitMask(index & 63, bits);
+
+            const uint64_t previous = m_Levels[0].words[word].fetch_and(~mask);
+            if ((previous & mask) != mask)
+            {
+                // gives back the slots taken so far
+                if (previous & mask && m_Levels[0].words[word].fetch_or(previous & mask) == 0)
+                    markNonEmpty(0, word);
+                releaseRange(first, index - first);
+                return false;
+            }
+
+            if ((previous & ~mask) == 0)
+                markEmpty(0, word);
+
+            index += bits;
+        }
+
+        return true;
+    }
+
+    bool BitmapAllocator::release(uint32_t index)
+    {
+        return releaseRange(index, 1);
+    }
+
+    bool BitmapAllocator::releaseRange(uint32_t first, uint32_t count)
     {
-        if (index >= 0 && index < static_cast<int>(m_Allocated.size()))
+        if (first >= m_Capacity || count > m_Capacity - first)
+            return false;
+
+        bool allocated = true;
+        const uint32_t end = first + count;
+        for (uint32_t index = first; index < end; )
         {
-            if (m_MultiThreaded)
-                m_Mutex.lock();
+            const uint32_t word = index >> 6;
+            const uint32_t bits = std::min(64 - (index & 63), end - index);
+            const uint64_t mask = bitMask(index & 63, bits);
 
-            m_Allocated[index] = false;
-            m_NextAvailable = std::min(m_NextAvailable, index);
+            const uint64_t previous = m_Levels[0].words[word].fetch_or(mask);
+            if (previous & mask)
+                allocated = false;
+            if (previous == 0)
+                markNonEmpty(0, word);
 
-            if (m_MultiThreaded)
-                m_Mutex.unlock();
+            index += bits;
         }
+
+        return allocated;
+    }
+
+    bool BitmapAllocator::isAllocated(uint32_t index) const
+    {
+        return index < m_Capacity && !(m_Levels[0].words[index >> 6].load() & (1ull << (index & 63)));
+    }
+
+    BitSetAllocator::BitSetAllocator(const size_t capacity, bool /*multithreaded*/)
+        : m_Allocator(uint32_t(capacity))
+    {
+    }
+
+    int BitSetAllocator::allocate()
+    {
+        const uint32_t index = m_Allocator.allocate();
+        return index == BitmapAllocator::c_InvalidIndex ? -1 : int(index);
     }
 
+    void BitSetAllocator::release(const int index)
+    {
+        if (index >= 0)
+            m_Allocator.release(uint32_t(index));
+    }
+
+}
 }
-}
\ No newline at end of file
@@ -2,8 +2,10 @@
 
 #include <array>
 #include <assert.h>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -142,6 +144,58 @@ private:
     size_type current_size = 0;
 };
 
+// Slot allocator over a hierarchical bitmap: one bit per slot in 64-bit words, and summary levels
+// above them with one bit per word of the level below that is set when the word may have a free
+// slot. A search goes down from the single top word with count-trailing-zeros, skipping full words
+// 64 at a time per level, so finding a free slot among 1M takes four word reads instead of a scan.
+//
+// allocate() and release() are lock-free and may be called from any thread, as may
+// allocateRange() and releaseRange() which take a contiguous range word by word and give it back
+// when another thread got a part of it first. A summary bit can be set over a full word for a
+// moment, the search then moves on, so the slot bits are the only truth. grow() must not run
+// concurrently with anything else.
+class BitmapAllocator
+{
+public:
+    static constexpr uint32_t c_InvalidIndex = ~0u;
+
+    explicit BitmapAllocator(uint32_t capacity = 0);
+
+    // the lowest free slot, c_InvalidIndex when all are allocated
+    uint32_t allocate();
+    // the first slot of the lowest free range of count slots, c_InvalidIndex when there is none
+    uint32_t allocateRange(uint32_t count);
+    // false when a slot was not allocated
+    bool release(uint32_t index);
+    bool releaseRange(uint32_t first, uint32_t count);
+
+    // adds free slots at the end, the allocated slots stay allocated
+    void grow(uint32_t capacity);
+
+    bool isAllocated(uint32_t index) const;
+    uint32_t getCapacity() const { return m_Capacity; }
+
+private:
+    struct Level
+    {
+        std::unique_ptr<std::atomic<uint64_t>[]> words;
+        uint32_t wordCount = 0;
+    };
+
+    // the first set bit at or after index on the level, c_InvalidIndex when there is none
+    uint32_t findNext(size_t level, uint32_t index) const;
+    // the first slot at or after index of a free range of count slots, c_InvalidIndex when there is none
+    uint32_t findRange(uint32_t index, uint32_t count) const;
+    bool claim(uint32_t first, uint32_t count);
+    void markEmpty(size_t level, uint32_t word);
+    void markNonEmpty(size_t level, uint32_t word);
+
+    // m_Levels[0] holds a bit per slot that is set when the slot is free, the last level has a single word
+    std::vector<Level> m_Levels;
+    uint32_t m_Capacity = 0;
+};
+
+// Fixed number of indices, e.g. for queries. Lock-free, multithreaded is kept for the callers.
 class BitSetAllocator
 {
 public:
@@ -151,10 +205,7 @@ public:
     void release(int index);
 
 private:
-    int m_NextAvailable = 0;
-    std::vector<bool> m_Allocated;
-    bool m_MultiThreaded;
-    std::mutex m_Mutex;
+    BitmapAllocator m_Allocator;
 };
 
 }
@@ -0,0 +1,645 @@
+#include "pipeline_cache.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace redtea {
+namespace device {
+
+    namespace
+    {
+        constexpr uint64_t c_BlockAlignment = 64;
+
+        // all offsets are from the start of the file
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t fileSize;
+            uint32_t graphicsAPI;
+            uint32_t entryCount;        // EntryRecord at entriesOffset
+            uint64_t entriesOffset;
+        };
+
+        struct EntryRecord
+        {
+            uint64_t hashLow;
+            uint64_t hashHigh;
+            uint64_t offset;
+            uint64_t size;
+            uint64_t checksum;          // hashBytes(binary).low
+        };
+
+        uint64_t rotl64(uint64_t x, int r)
+        {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        uint64_t fmix64(uint64_t k)
+        {
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdull;
+            k ^= k >> 33;
+            k *= 0xc4ceb9fe1a85ec53ull;
+            k ^= k >> 33;
+            return k;
+        }
+
+        // the fields of a desc one after the other with a fixed size, nothing of the layout of the structs
+        class DescWriter
+        {
+        public:
+            void u8(uint8_t value) { m_Bytes.push_back(value); }
+            void u32(uint32_t value) { append(&value, sizeof(value)); }
+            void u64(uint64_t value) { append(&value, sizeof(value)); }
+            void f32(float value) { append(&value, sizeof(value)); }
+            void str(const std::string& value) { u32(uint32_t(value.size())); append(value.data(), value.size()); }
+            void hash(const PipelineHash& value) { u64(value.low); u64(value.high); }
+
+            PipelineHash finish() const { return hashBytes(m_Bytes.data(), m_Bytes.size()); }
+
+        private:
+            void append(const void* data, size_t size)
+            {
+                const uint8_t* bytes = static_cast<const uint8_t*>(data);
+                m_Bytes.insert(m_Bytes.end(), bytes, bytes + size);
+            }
+
+            std::vector<uint8_t> m_Bytes;
+        };
+
+        // what the pipeline is, so that pipelines of different kinds never share a hash
+        enum class PipelineKind : uint8_t
+        {
+            Graphics,
+            Compute,
+            Meshlet
+        };
+
+        void writeBindingLayoutItem(DescWriter& writer, const BindingLayoutItem& item)
+        {
+            writer.u32(item.slot);
+            writer.u8(uint8_t(item.type));
+            writer.u32(item.size);
+        }
+
+        void writeBindingLayouts(DescWriter& writer, const BindingLayoutVector& layouts)
+        {
+            writer.u32(uint32_t(layouts.size()));
+            for (const BindingLayoutHandle& layout : layouts)
+            {
+                const BindingLayoutDesc* desc = layout ? layout->getDesc() : nullptr;
+                const BindlessLayoutDesc* bindlessDesc = layout ? layout->getBindlessDesc() : nullptr;
+
+                if (desc)
+                {
+                    writer.u8(1);
+                    writer.u32(uint32_t(desc->visibility));
+                    writer.u32(desc->registerSpace);
+                    writer.u32(uint32_t(desc->bindings.size()));
+                    for (const BindingLayoutItem& item : desc->bindings)
+                        writeBindingLayoutItem(writer, item);
+                    writer.u32(desc->bindingOffsets.shaderResource);
+                    writer.u32(desc->bindingOffsets.sampler);
+                    writer.u32(desc->bindingOffsets.constantBuffer);
+                    writer.u32(desc->bindingOffsets.unorderedAccess);
+                }
+                else if (bindlessDesc)
+                {
+                    writer.u8(2);
+                    writer.u32(uint32_t(bindlessDesc->visibility));
+                    writer.u32(bindlessDesc->firstSlot);
+                    writer.u32(bindlessDesc->maxCapacity);
+                    writer.u32(uint32_t(bindlessDesc->registerSpaces.size()));
+                    for (const BindingLayoutItem& item : bindlessDesc->registerSpaces)
+                        writeBindingLayoutItem(writer, item);
+                }
+                else
+                    writer.u8(0);
+            }
+        }
+
+        void writeRenderState(DescWriter& writer, const RenderState& state)
+        {
+            const BlendState& blend = state.blendState;
+            for (const BlendState::RenderTarget& target : blend.targets)
+            {
+                writer.u8(target.blendEnable);
+                writer.u8(uint8_t(target.srcBlend));
+                writer.u8(uint8_t(target.destBlend));
+                writer.u8(uint8_t(target.blendOp));
+                writer.u8(uint8_t(target.srcBlendAlpha));
+                writer.u8(uint8_t(target.destBlendAlpha));
+                writer.u8(uint8_t(target.blendOpAlpha));
+                writer.u8(uint8_t(target.colorWriteMask));
+            }
+            writer.u8(blend.alphaToCoverageEnable);
+
+            const DepthStencilState& depthStencil = state.depthStencilState;
+            writer.u8(depthStencil.depthTestEnable);
+            writer.u8(depthStencil.depthWriteEnable);
+            writer.u8(uint8_t(depthStencil.depthFunc));
+            writer.u8(depthStencil.stencilEnable);
+            writer.u8(depthStencil.stencilReadMask);
+            writer.u8(depthStencil.stencilWriteMask);
+            writer.u8(depthStencil.stencilRefValue);
+            for (const DepthStencilState::StencilOpDesc* face : { &depthStencil.frontFaceStencil, &depthStencil.backFaceStencil })
+            {
+                writer.u8(uint8_t(face->failOp));
+                writer.u8(uint8_t(face->depthFailOp));
+                writer.u8(uint8_t(face->passOp));
+                writer.u8(uint8_t(face->stencilFunc));
+            }
+
+            const RasterState& raster = state.rasterState;
+            writer.u8(uint8_t(raster.fillMode));
+            writer.u8(uint8_t(raster.cullMode));
+            writer.u8(raster.frontCounterClockwise);
+            writer.u8(raster.depthClipEnable);
+            writer.u8(raster.scissorEnable);
+            writer.u8(raster.multisampleEnable);
+            writer.u8(raster.antialiasedLineEnable);
+            writer.u32(uint32_t(raster.depthBias));
+            writer.f32(raster.depthBiasClamp);
+            writer.f32(raster.slopeScaledDepthBias);
+            writer.u8(raster.forcedSampleCount);
+            writer.u8(raster.programmableSamplePositionsEnable);
+            writer.u8(raster.conservativeRasterEnable);
+            writer.u8(raster.quadFillEnable);
+            for (int i = 0; i < 16; i++)
+            {
+                writer.u8(uint8_t(raster.samplePositionsX[i]));
+                writer.u8(uint8_t(raster.samplePositionsY[i]));
+            }
+
+            writer.u8(state.singlePassStereo.enabled);
+            writer.u8(state.singlePassStereo.independentViewportMask);
+            writer.u32(state.singlePassStereo.renderTargetIndexOffset);
+        }
+
+        void writeFramebufferInfo(DescWriter& writer, const FramebufferInfo& info)
+        {
+            writer.u32(uint32_t(info.colorFormats.size()));
+            for (Format format : info.colorFormats)
+                writer.u32(uint32_t(format));
+            writer.u32(uint32_t(info.depthFormat));
+            writer.u32(info.width);
+            writer.u32(info.height);
+            writer.u32(info.sampleCount);
+            writer.u32(info.sampleQuality);
+        }
+
+        template<typename ShaderHasher>
+        PipelineHash hashGraphicsDesc(const GraphicsPipelineDesc& desc, const FramebufferInfo& framebufferInfo, ShaderHasher&& hashShader)
+        {
+            DescWriter writer;
+            writer.u8(uint8_t(PipelineKind::Graphics));
+            writer.u8(uint8_t(desc.primType));
+            writer.u32(desc.patchControlPoints);
+
+            const uint32_t attributeCount = desc.inputLayout ? desc.inputLayout->getNumAttributes() : 0;
+            writer.u32(attributeCount);
+            for (uint32_t index = 0; index < attributeCount; index++)
+            {
+                const VertexAttributeDesc* attribute = desc.inputLayout->getAttributeDesc(index);
+                writer.str(attribute->name);
+                writer.u32(uint32_t(attribute->format));
+                writer.u32(attribute->arraySize);
+                writer.u32(attribute->bufferIndex);
+                writer.u32(attribute->offset);
+                writer.u32(attribute->elementStride);
+                writer.u8(attribute->isInstanced);
+            }
+
+            for (IShader* shader : { desc.VS.Get(), desc.HS.Get(), desc.DS.Get(), desc.GS.Get(), desc.PS.Get() })
+                writer.hash(hashShader(shader));
+
+            writeRenderState(writer, desc.renderState);
+            writer.u8(desc.shadingRateState.enabled);
+            writer.u8(uint8_t(desc.shadingRateState.shadingRate));
+            writer.u8(uint8_t(desc.shadingRateState.pipelinePrimitiveCombiner));
+            writer.u8(uint8_t(desc.shadingRateState.imageCombiner));
+            writeBindingLayouts(writer, desc.bindingLayouts);
+            writeFramebufferInfo(writer, framebufferInfo);
+            return writer.finish();
+        }
+
+        template<typename ShaderHasher>
+        PipelineHash hashComputeDesc(const ComputePipelineDesc& desc, ShaderHasher&& hashShader)
+        {
+            DescWriter writer;
+            writer.u8(uint8_t(PipelineKind::Compute));
+            writer.hash(hashShader(desc.CS.Get()));
+            writeBindingLayouts(writer, desc.bindingLayouts);
+            return writer.finish();
+        }
+
+        template<typename ShaderHasher>
+        PipelineHash hashMeshletDesc(const MeshletPipelineDesc& desc, const FramebufferInfo& framebufferInfo, ShaderHasher&& hashShader)
+        {
+            DescWriter writer;
+            writer.u8(uint8_t(PipelineKind::Meshlet));
+            writer.u8(uint8_t(desc.primType));
+            for (IShader* shader : { desc.AS.Get(), desc.MS.Get(), desc.PS.Get() })
+                writer.hash(hashShader(shader));
+            writeRenderState(writer, desc.renderState);
+            writeBindingLayouts(writer, desc.bindingLayouts);
+            writeFramebufferInfo(writer, framebufferInfo);
+            return writer.finish();
+        }
+
+        class FileWriter
+        {
+        public:
+            explicit FileWriter(const char* path) : m_File(std::fopen(path, "wb")) { }
+            ~FileWriter()
+            {
+                if (m_File)
+                    std::fclose(m_File);
+            }
+
+            bool isOpen() const { return m_File != nullptr; }
+
+            // appends a block at the next aligned offset and returns that offset
+            uint64_t write(const void* data, size_t size)
+            {
+                static const char zeros[c_BlockAlignment] = {};
+                const uint64_t offset = (m_Size + c_BlockAlignment - 1) & ~(c_BlockAlignment - 1);
+                const size_t padding = size_t(offset - m_Size);
+                m_Ok &= std::fwrite(zeros, 1, padding, m_File) == padding;
+                m_Ok &= size == 0 || std::fwrite(data, 1, size, m_File) == size;
+                m_Size = offset + size;
+                return offset;
+            }
+
+            // the header sits at offset 0 and is rewritten once every offset is known
+            bool finish(FileHeader header)
+            {
+                header.fileSize = m_Size;
+                m_Ok &= std::fseek(m_File, 0, SEEK_SET) == 0;
+                m_Ok &= std::fwrite(&header, sizeof(header), 1, m_File) == 1;
+                m_Ok &= std::fclose(m_File) == 0;
+                m_File = nullptr;
+                return m_Ok;
+            }
+
+        private:
+            std::FILE* m_File;
+            uint64_t m_Size = 0;
+            bool m_Ok = true;
+        };
+
+        // bounds checked typed views into the mapping
+        template<typename T>
+        const T* getFileData(const common::MappedFile& file, uint64_t offset, uint64_t count)
+        {
+            if (offset > file.size() || offset % alignof(T) != 0 || count > (file.size() - offset) / sizeof(T))
+                return nullptr;
+            return reinterpret_cast<const T*>(static_cast<const uint8_t*>(file.data()) + offset);
+        }
+    }
+
+    PipelineHash hashBytes(const void* data, size_t size, uint64_t seed)
+    {
+        constexpr uint64_t c1 = 0x87c37b91114253d5ull;
+        constexpr uint64_t c2 = 0x4cf5ad432745937full;
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        const size_t blockCount = size / 16;
+        uint64_t h1 = seed;
+        uint64_t h2 = seed;
+
+        for (size_t block = 0; block < blockCount; block++)
+        {
+            uint64_t k1, k2;
+            memcpy(&k1, bytes + block * 16, sizeof(k1));
+            memcpy(&k2, bytes + block * 16 + 8, sizeof(k2));
+
+            k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+            h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+            k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+            h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+        }
+
+        const uint8_t* tail = bytes + blockCount * 16;
+        const size_t tailSize = size & 15;
+        uint64_t k1 = 0;
+        uint64_t k2 = 0;
+        for (size_t i = 0; i < tailSize; i++)
+        {
+            if (i < 8)
+                k1 ^= uint64_t(tail[i]) << (i * 8);
+            else
+                k2 ^= uint64_t(tail[i]) << ((i - 8) * 8);
+        }
+        if (tailSize > 8)
+        {
+            k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        }
+        if (tailSize > 0)
+        {
+            k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        }
+
+        h1 ^= uint64_t(size);
+        h2 ^= uint64_t(size);
+        h1 += h2;
+        h2 += h1;
+        h1 = fmix64(h1);
+        h2 = fmix64(h2);
+        h1 += h2;
+        h2 += h1;
+
+        PipelineHash hash;
+        hash.low = h1;
+        hash.high = h2;
+        return hash;
+    }
+
+    PipelineHash hashShader(IShader* shader)
+    {
+        if (!shader)
+            return PipelineHash();
+
+        const ShaderDesc& desc = shader->getDesc();
+        const void* bytecode = nullptr;
+        size_t bytecodeSize = 0;
+        shader->getBytecode(&bytecode, &bytecodeSize);
+
+        DescWriter writer;
+        writer.u32(uint32_t(desc.shaderType));
+        writer.str(desc.entryName);
+        if (bytecodeSize)
+            writer.hash(hashBytes(bytecode, bytecodeSize));
+        else
+            writer.str(desc.debugName);
+        return writer.finish();
+    }
+
+    PipelineHash hashPipelineDesc(const GraphicsPipelineDesc& desc, const FramebufferInfo& framebufferInfo)
+    {
+        return hashGraphicsDesc(desc, framebufferInfo, hashShader);
+    }
+
+    PipelineHash hashPipelineDesc(const ComputePipelineDesc& desc)
+    {
+        return hashComputeDesc(desc, hashShader);
+    }
+
+    PipelineHash hashPipelineDesc(const MeshletPipelineDesc& desc, const FramebufferInfo& framebufferInfo)
+    {
+        return hashMeshletDesc(desc, framebufferInfo, hashShader);
+    }
+
+    PipelineCache::PipelineCache(IDevice* device)
+        : m_Device(device)
+    { }
+
+    bool PipelineCache::load(const char* path)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return loadFile(path);
+    }
+
+    bool PipelineCache::loadFile(const char* path)
+    {
+        m_FileEntries.clear();
+        m_File.close();
+        m_Statistics.loadedBinaries = 0;
+
+        if (!m_File.open(path))
+            return false;
+
+        const FileHeader* header = getFileData<FileHeader>(m_File, 0, 1);
+        const EntryRecord* records = header ? getFileData<EntryRecord>(m_File, header->entriesOffset, header->entryCount) : nullptr;
+        if (!records || header->magic != c_Magic || header->version != c_Version || header->fileSize != m_File.size()
+            || header->graphicsAPI != uint32_t(m_Device->getGraphicsAPI()))
+        {
+            m_File.close();
+            return false;
+        }
+
+        for (uint32_t index = 0; index < header->entryCount; index++)
+        {
+            const EntryRecord& record = records[index];
+            if (!getFileData<uint8_t>(m_File, record.offset, record.size))
+                continue;
+
+            PipelineHash hash;
+            hash.low = record.hashLow;
+            hash.high = record.hashHigh;
+
+            FileEntry& entry = m_FileEntries[hash];
+            entry.offset = record.offset;
+            entry.size = record.size;
+            entry.checksum = record.checksum;
+        }
+
+        m_Statistics.loadedBinaries = uint32_t(m_FileEntries.size());
+        return true;
+    }
+
+    bool PipelineCache::save(const char* path)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        const std::string tempPath = std::string(path) + ".tmp";
+        FileWriter writer(tempPath.c_str());
+        if (!writer.isOpen())
+            return false;
+
+        FileHeader header{};
+        header.magic = c_Magic;
+        header.version = c_Version;
+        header.graphicsAPI = uint32_t(m_Device->getGraphicsAPI());
+        writer.write(&header, sizeof(header));
+
+        std::vector<EntryRecord> records;
+        records.reserve(m_NewBinaries.size() + m_FileEntries.size());
+
+        auto writeEntry = [&](const PipelineHash& hash, const void* binary, size_t size, uint64_t checksum)
+        {
+            EntryRecord record{};
+            record.hashLow = hash.low;
+            record.hashHigh = hash.high;
+            record.offset = writer.write(binary, size);
+            record.size = size;
+            record.checksum = checksum;
+            records.push_back(record);
+        };
+
+        for (const auto& it : m_NewBinaries)
+            writeEntry(it.first, it.second.data(), it.second.size(), hashBytes(it.second.data(), it.second.size()).low);
+
+        for (const auto& it : m_FileEntries)
+        {
+            if (m_NewBinaries.find(it.first) == m_NewBinaries.end())
+                writeEntry(it.first, getFileData<uint8_t>(m_File, it.second.offset, it.second.size), size_t(it.second.size), it.second.checksum);
+        }
+
+        header.entryCount = uint32_t(records.size());
+        header.entriesOffset = writer.write(records.data(), records.size() * sizeof(EntryRecord));
+        if (!writer.finish(header))
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        // the old file can't be replaced while it is mapped on Windows
+        m_File.close();
+        m_FileEntries.clear();
+#ifdef _WIN32
+        std::remove(path);
+#endif
+        const bool renamed = std::rename(tempPath.c_str(), path) == 0;
+
+        // keep the binaries, from the new file even when it couldn't be renamed
+        if (!loadFile(renamed ? path : tempPath.c_str()))
+            return false;
+
+        m_NewBinaries.clear();
+        m_Statistics.savedBinaries = uint32_t(records.size());
+        return renamed;
+    }
+
+    void PipelineCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_GraphicsPipelines.clear();
+        m_ComputePipelines.clear();
+        m_MeshletPipelines.clear();
+        m_ShaderHashes.clear();
+    }
+
+    PipelineCacheStatistics PipelineCache::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Statistics;
+    }
+
+    PipelineHash PipelineCache::getShaderHash(IShader* shader)
+    {
+        if (!shader)
+            return PipelineHash();
+
+        auto it = m_ShaderHashes.find(shader);
+        if (it != m_ShaderHashes.end())
+            return it->second.second;
+
+        const PipelineHash hash = hashShader(shader);
+        m_ShaderHashes[shader] = std::make_pair(ShaderHandle(shader), hash);
+        return hash;
+    }
+
+    void PipelineCache::findBinary(const PipelineHash& hash, std::vector<uint8_t>& binary)
+    {
+        auto newBinary = m_NewBinaries.find(hash);
+        if (newBinary != m_NewBinaries.end())
+        {
+            binary = newBinary->second;
+            return;
+        }
+
+        auto entry = m_FileEntries.find(hash);
+        if (entry == m_FileEntries.end())
+            return;
+
+        const uint8_t* data = getFileData<uint8_t>(m_File, entry->second.offset, entry->second.size);
+        if (hashBytes(data, size_t(entry->second.size)).low != entry->second.checksum)
+        {
+            m_Statistics.corruptBinaries++;
+            m_FileEntries.erase(entry);
+            return;
+        }
+
+        binary.assign(data, data + entry->second.size);
+    }
+
+    template<typename Handle>
+    Handle PipelineCache::findPipeline(std::unique_lock<std::mutex>& lock, PipelineMap<Handle>& pipelines, const PipelineHash& hash, std::vector<uint8_t>& binary)
+    {
+        m_Condition.wait(lock, [this, &hash]() { return m_Compiling.find(hash) == m_Compiling.end(); });
+
+        auto it = pipelines.find(hash);
+        if (it != pipelines.end())
+        {
+            m_Statistics.hits++;
+            return it->second;
+        }
+
+        m_Compiling.insert(hash);
+        findBinary(hash, binary);
+        return nullptr;
+    }
+
+    template<typename Handle>
+    Handle PipelineCache::addPipeline(PipelineMap<Handle>& pipelines, const PipelineHash& hash, Handle pipeline, const std::vector<uint8_t>& fileBinary)
+    {
+        std::vector<uint8_t> binary;
+        const bool hasBinary = pipeline && m_Device->getPipelineBinary(pipeline, binary);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Compiling.erase(hash);
+
+            if (pipeline)
+            {
+                pipelines[hash] = pipeline;
+
+                // the driver keeps the binary it was given unless it rejected it
+                if (!fileBinary.empty() && binary == fileBinary)
+                    m_Statistics.binaryHits++;
+                else
+                {
+                    m_Statistics.compiles++;
+                    if (hasBinary)
+                        m_NewBinaries[hash] = std::move(binary);
+                }
+            }
+        }
+
+        m_Condition.notify_all();
+        return pipeline;
+    }
+
+    GraphicsPipelineHandle PipelineCache::createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        const PipelineHash hash = hashGraphicsDesc(desc, fb->getFramebufferInfo(), [this](IShader* shader) { return getShaderHash(shader); });
+        std::vector<uint8_t> binary;
+        if (GraphicsPipelineHandle pipeline = findPipeline(lock, m_GraphicsPipelines, hash, binary))
+            return pipeline;
+        lock.unlock();
+
+        GraphicsPipelineHandle pipeline = m_Device->createGraphicsPipeline(desc, fb, binary.data(), binary.size());
+        return addPipeline(m_GraphicsPipelines, hash, pipeline, binary);
+    }
+
+    ComputePipelineHandle PipelineCache::createComputePipeline(const ComputePipelineDesc& desc)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        const PipelineHash hash = hashComputeDesc(desc, [this](IShader* shader) { return getShaderHash(shader); });
+        std::vector<uint8_t> binary;
+        if (ComputePipelineHandle pipeline = findPipeline(lock, m_ComputePipelines, hash, binary))
+            return pipeline;
+        lock.unlock();
+
+        ComputePipelineHandle pipeline = m_Device->createComputePipeline(desc, binary.data(), binary.size());
+        return addPipeline(m_ComputePipelines, hash, pipeline, binary);
+    }
+
+    MeshletPipelineHandle PipelineCache::createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        const PipelineHash hash = hashMeshletDesc(desc, fb->getFramebufferInfo(), [this](IShader* shader) { return getShaderHash(shader); });
+        std::vector<uint8_t> binary;
+        if (MeshletPipelineHandle pipeline = findPipeline(lock, m_MeshletPipelines, hash, binary))
+            return pipeline;
+        lock.unlock();
+
+        MeshletPipelineHandle pipeline = m_Device->createMeshletPipeline(desc, fb, binary.data(), binary.size());
+        return addPipeline(m_MeshletPipelines, hash, pipeline, binary);
+    }
+
+}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "rhi.h"
+#include "utils/mapped_file.h"
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Pipeline cache on top of IDevice. Pipelines are keyed by a stable 128-bit hash of everything
+// that goes into them: the bytecode of the shaders, the render state, the input layout, the
+// binding layouts and the framebuffer info. The same desc returns the same pipeline, and the
+// driver binaries of the pipelines can be saved to a file that a later run maps to create its
+// pipelines without compiling them again.
+//
+//     PipelineCache cache(device);
+//     cache.load("pipelines.bin");
+//     GraphicsPipelineHandle pipeline = cache.createGraphicsPipeline(desc, framebuffer);
+//     ...
+//     cache.save("pipelines.bin");
+//
+// The file is versioned and checked when it is loaded. Every binary has a checksum, checked
+// before the binary is used, and the driver validates it too, a pipeline whose binary is bad
+// is compiled as if there were none. save() writes a new file and renames it over the old
+// one, so the cache file is never left half written. The functions may be called from any
+// thread, a thread creating a pipeline another one is compiling waits for it.
+
+namespace redtea {
+namespace device {
+
+    struct PipelineHash
+    {
+        uint64_t low = 0;
+        uint64_t high = 0;
+
+        bool operator==(const PipelineHash& other) const { return low == other.low && high == other.high; }
+        bool operator!=(const PipelineHash& other) const { return !(*this == other); }
+    };
+
+    // MurmurHash3 x64 128, the same on every platform and in every run
+    PipelineHash hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+    // the bytecode, or the type and the names of shaders without bytecode such as the CPU shaders
+    // of the Null backend, which need a debug name to tell them apart
+    PipelineHash hashShader(IShader* shader);
+
+    PipelineHash hashPipelineDesc(const GraphicsPipelineDesc& desc, const FramebufferInfo& framebufferInfo);
+    PipelineHash hashPipelineDesc(const ComputePipelineDesc& desc);
+    PipelineHash hashPipelineDesc(const MeshletPipelineDesc& desc, const FramebufferInfo& framebufferInfo);
+
+    struct PipelineCacheStatistics
+    {
+        // pipelines the cache already had
+        uint32_t hits = 0;
+        // pipelines created with a binary from the file, and without
+        uint32_t binaryHits = 0;
+        uint32_t compiles = 0;
+        // binaries found by load(), and written by the last save()
+        uint32_t loadedBinaries = 0;
+        uint32_t savedBinaries = 0;
+        // binaries that failed their checksum
+        uint32_t corruptBinaries = 0;
+    };
+
+    class PipelineCache
+    {
+    public:
+        static constexpr uint32_t c_Magic = 0x43505452; // "RTPC"
+        static constexpr uint32_t c_Version = 1;
+
+        explicit PipelineCache(IDevice* device);
+
+        // maps a file written by save(), false when it is missing or was written by another
+        // version or graphics API. The pipelines the cache already has are kept.
+        bool load(const char* path);
+        // the binaries of every pipeline created since load() and the loaded ones not used
+        bool save(const char* path);
+
+        GraphicsPipelineHandle createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb);
+        ComputePipelineHandle createComputePipeline(const ComputePipelineDesc& desc);
+        MeshletPipelineHandle createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb);
+
+        // releases the pipelines, keeps the binaries
+        void clear();
+
+        PipelineCacheStatistics getStatistics();
+
+    private:
+        struct PipelineHashHasher
+        {
+            size_t operator()(const PipelineHash& hash) const { return size_t(hash.low); }
+        };
+
+        // a binary in the mapped file
+        struct FileEntry
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            uint64_t checksum = 0;
+        };
+
+        template<typename Handle>
+        using PipelineMap = std::unordered_map<PipelineHash, Handle, PipelineHashHasher>;
+
+        PipelineHash getShaderHash(IShader* shader);
+        // the binary of the pipeline, from the binaries of this run first and the file second
+        void findBinary(const PipelineHash& hash, std::vector<uint8_t>& binary);
+        // the pipeline when the cache has it, otherwise null and the binary to create it with,
+        // after waiting for the thread compiling it if there is one
+        template<typename Handle>
+        Handle findPipeline(std::unique_lock<std::mutex>& lock, PipelineMap<Handle>& pipelines, const PipelineHash& hash, std::vector<uint8_t>& binary);
+        template<typename Handle>
+        Handle addPipeline(PipelineMap<Handle>& pipelines, const PipelineHash& hash, Handle pipeline, const std::vector<uint8_t>& fileBinary);
+        bool loadFile(const char* path);
+
+        IDevice* m_Device;
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        // pipelines being created outside of the lock
+        std::unordered_set<PipelineHash, PipelineHashHasher> m_Compiling;
+        PipelineMap<GraphicsPipelineHandle> m_GraphicsPipelines;
+        PipelineMap<ComputePipelineHandle> m_ComputePipelines;
+        PipelineMap<MeshletPipelineHandle> m_MeshletPipelines;
+        // shaders are kept alive so their address stays theirs
+        std::unordered_map<IShader*, std::pair<ShaderHandle, PipelineHash>> m_ShaderHashes;
+        common::MappedFile m_File;
+        std::unordered_map<PipelineHash, FileEntry, PipelineHashHasher> m_FileEntries;
+        // binaries of the pipelines compiled since the file was loaded or saved
+        std::unordered_map<PipelineHash, std::vector<uint8_t>, PipelineHashHasher> m_NewBinaries;
+        PipelineCacheStatistics m_Statistics;
+    };
+
+}
+}
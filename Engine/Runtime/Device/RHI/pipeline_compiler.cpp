@@ -0,0 +1,196 @@
+#include "pipeline_compiler.h"
+
+#include "utils/thread_pool.h"
+#include <algorithm>
+
+namespace redtea {
+namespace device {
+
+    PipelineCompiler::PipelineCompiler(PipelineCache& cache, int32_t workerCount)
+        : m_Cache(cache)
+    {
+        const uint32_t workers = workerCount < 0 ? std::max(common::ThreadPool::defaultWorkerCount(), 1u) : uint32_t(workerCount);
+        if (workers)
+            m_ThreadPool = std::make_unique<common::ThreadPool>(workers);
+    }
+
+    PipelineCompiler::~PipelineCompiler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (auto& it : m_Queue)
+            {
+                it.second->m_Queued = false;
+                it.second->m_Ready.store(true, std::memory_order_release);
+            }
+            m_Queue.clear();
+        }
+        m_Condition.notify_all();
+
+        // the workers finish the pipelines they started, their other tasks find the queue empty
+        m_ThreadPool.reset();
+    }
+
+    PipelineCompiler::QueueKey PipelineCompiler::getQueueKey(const AsyncGraphicsPipeline* pipeline)
+    {
+        // higher priorities first
+        return QueueKey(~uint32_t(pipeline->m_Priority), pipeline->m_Sequence);
+    }
+
+    AsyncGraphicsPipelineHandle PipelineCompiler::createGraphicsPipelineAsync(const GraphicsPipelineDesc& desc, IFramebuffer* fb,
+        PipelineCompilePriority priority, IGraphicsPipeline* fallback)
+    {
+        AsyncGraphicsPipeline* pipeline = new AsyncGraphicsPipeline();
+        pipeline->m_Desc = desc;
+        pipeline->m_Framebuffer = fb;
+        pipeline->m_Fallback = fallback;
+        pipeline->m_Priority = priority;
+        AsyncGraphicsPipelineHandle handle = AsyncGraphicsPipelineHandle::Create(pipeline);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Queue.empty() && m_Compiling == 0)
+                m_BusyStart = std::chrono::steady_clock::now();
+
+            pipeline->m_Sequence = m_NextSequence++;
+            pipeline->m_Queued = true;
+            m_Queue.emplace(getQueueKey(pipeline), handle);
+        }
+
+        // every task compiles the most urgent pipeline when it runs, not the one it was submitted for
+        if (m_ThreadPool)
+        {
+            m_ThreadPool->submit([this]()
+            {
+                AsyncGraphicsPipelineHandle next = popPending();
+                if (next)
+                    compile(next);
+            });
+        }
+
+        return handle;
+    }
+
+    AsyncGraphicsPipelineHandle PipelineCompiler::popPending()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Queue.empty())
+            return nullptr;
+
+        AsyncGraphicsPipelineHandle pipeline = std::move(m_Queue.begin()->second);
+        m_Queue.erase(m_Queue.begin());
+        pipeline->m_Queued = false;
+        m_Compiling++;
+        return pipeline;
+    }
+
+    void PipelineCompiler::compile(AsyncGraphicsPipeline* pipeline)
+    {
+        GraphicsPipelineHandle result = m_Cache.createGraphicsPipeline(pipeline->m_Desc, pipeline->m_Framebuffer);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            pipeline->m_Pipeline = result;
+            pipeline->m_Ready.store(true, std::memory_order_release);
+
+            if (result)
+                m_Statistics.compiled++;
+            else
+                m_Statistics.failed++;
+
+            m_Compiling--;
+            if (m_Queue.empty() && m_Compiling == 0)
+                m_Statistics.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_BusyStart).count();
+        }
+
+        m_Condition.notify_all();
+    }
+
+    IGraphicsPipeline* PipelineCompiler::resolve(AsyncGraphicsPipeline* pipeline)
+    {
+        if (pipeline->isReady())
+            return pipeline->m_Pipeline ? pipeline->m_Pipeline.Get() : pipeline->m_Fallback.Get();
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (pipeline->m_Fallback)
+            m_Statistics.fallbackDraws++;
+        else
+            m_Statistics.skippedDraws++;
+        return pipeline->m_Fallback;
+    }
+
+    IGraphicsPipeline* PipelineCompiler::wait(AsyncGraphicsPipeline* pipeline)
+    {
+        if (pipeline->isReady())
+            return pipeline->m_Pipeline;
+
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Statistics.stalls++;
+
+            if (!pipeline->m_Queued)
+            {
+                // a worker has it
+                m_Condition.wait(lock, [pipeline]() { return pipeline->isReady(); });
+                return pipeline->m_Pipeline;
+            }
+
+            m_Queue.erase(getQueueKey(pipeline));
+            pipeline->m_Queued = false;
+            m_Compiling++;
+        }
+
+        compile(pipeline);
+        return pipeline->m_Pipeline;
+    }
+
+    void PipelineCompiler::setPriority(AsyncGraphicsPipeline* pipeline, PipelineCompilePriority priority)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (!pipeline->m_Queued)
+        {
+            pipeline->m_Priority = priority;
+            return;
+        }
+
+        auto it = m_Queue.find(getQueueKey(pipeline));
+        AsyncGraphicsPipelineHandle handle = std::move(it->second);
+        m_Queue.erase(it);
+        pipeline->m_Priority = priority;
+        m_Queue.emplace(getQueueKey(pipeline), std::move(handle));
+    }
+
+    uint32_t PipelineCompiler::compilePending(uint32_t maxCount)
+    {
+        uint32_t count = 0;
+        while (count < maxCount)
+        {
+            AsyncGraphicsPipelineHandle pipeline = popPending();
+            if (!pipeline)
+                break;
+
+            compile(pipeline);
+            count++;
+        }
+        return count;
+    }
+
+    void PipelineCompiler::waitForIdle()
+    {
+        // helps the workers rather than only waiting for them
+        compilePending();
+
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Condition.wait(lock, [this]() { return m_Queue.empty() && m_Compiling == 0; });
+    }
+
+    PipelineCompilerStatistics PipelineCompiler::getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        PipelineCompilerStatistics statistics = m_Statistics;
+        statistics.pending = uint32_t(m_Queue.size()) + m_Compiling;
+        return statistics;
+    }
+
+}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "pipeline_cache.h"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+
+// Background compilation of graphics pipelines. createGraphicsPipelineAsync() returns at once with
+// a handle that becomes ready once a worker has created the pipeline through the PipelineCache, so
+// pipelines with a binary in the cache file are ready almost right away. Until then resolve()
+// gives the fallback pipeline passed when it was created, or null when the draw has to be skipped,
+// and the thread recording the draws never waits for the driver.
+//
+//     PipelineCompiler compiler(cache);
+//     AsyncGraphicsPipelineHandle pipeline = compiler.createGraphicsPipelineAsync(desc, fb, PipelineCompilePriority::High, simplePipeline);
+//     ...
+//     state.pipeline = compiler.resolve(pipeline);
+//     if (state.pipeline)
+//         ... setGraphicsState(state), draw ...
+//
+// Pipelines are compiled highest priority first, in the order they were requested within one
+// priority. Without workers nothing is compiled until compilePending() or waitForIdle() is called
+// on a thread of the application's choosing, e.g. with a budget per frame.
+
+namespace redtea {
+namespace common {
+    class ThreadPool;
+}
+
+namespace device {
+
+    enum class PipelineCompilePriority : uint8_t
+    {
+        Low,
+        Normal,
+        High
+    };
+
+    class AsyncGraphicsPipeline : public RefCounter<IResource>
+    {
+    public:
+        bool isReady() const { return m_Ready.load(std::memory_order_acquire); }
+        // null until the pipeline is ready, and when it failed to compile
+        IGraphicsPipeline* getPipeline() const { return isReady() ? m_Pipeline.Get() : nullptr; }
+        IGraphicsPipeline* getFallback() const { return m_Fallback; }
+        const GraphicsPipelineDesc& getDesc() const { return m_Desc; }
+
+    private:
+        friend class PipelineCompiler;
+
+        GraphicsPipelineDesc m_Desc;
+        FramebufferHandle m_Framebuffer;
+        GraphicsPipelineHandle m_Fallback;
+        GraphicsPipelineHandle m_Pipeline;
+        PipelineCompilePriority m_Priority = PipelineCompilePriority::Normal;
+        uint64_t m_Sequence = 0;
+        bool m_Queued = false;
+        std::atomic<bool> m_Ready{ false };
+    };
+
+    typedef RefCountPtr<AsyncGraphicsPipeline> AsyncGraphicsPipelineHandle;
+
+    struct PipelineCompilerStatistics
+    {
+        // waiting for a worker or being compiled
+        uint32_t pending = 0;
+        uint32_t compiled = 0;
+        uint32_t failed = 0;
+        // draws that found their pipeline not ready and used the fallback or were skipped
+        uint32_t fallbackDraws = 0;
+        uint32_t skippedDraws = 0;
+        // wait() calls that had to compile the pipeline or wait for a worker
+        uint32_t stalls = 0;
+        // time the compiler had pipelines pending
+        double busySeconds = 0.0;
+
+        uint32_t getStallsAvoided() const { return fallbackDraws + skippedDraws; }
+        double getCompiledPerSecond() const { return busySeconds > 0.0 ? double(compiled + failed) / busySeconds : 0.0; }
+    };
+
+    class PipelineCompiler
+    {
+    public:
+        // workerCount threads compile the pipelines, -1 for one per core and at least one.
+        // The cache has to outlive the compiler.
+        explicit PipelineCompiler(PipelineCache& cache, int32_t workerCount = -1);
+        // pipelines not compiled yet become ready without a pipeline
+        ~PipelineCompiler();
+
+        PipelineCompiler(const PipelineCompiler&) = delete;
+        PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+        AsyncGraphicsPipelineHandle createGraphicsPipelineAsync(const GraphicsPipelineDesc& desc, IFramebuffer* fb,
+            PipelineCompilePriority priority = PipelineCompilePriority::Normal, IGraphicsPipeline* fallback = nullptr);
+
+        // the pipeline to draw with: the compiled one, the fallback until then, null to skip the draw
+        IGraphicsPipeline* resolve(AsyncGraphicsPipeline* pipeline);
+        // the compiled pipeline, compiled on the calling thread when no worker has started it yet
+        IGraphicsPipeline* wait(AsyncGraphicsPipeline* pipeline);
+        // e.g. High for pipelines that are needed now and only have a fallback
+        void setPriority(AsyncGraphicsPipeline* pipeline, PipelineCompilePriority priority);
+
+        // compiles up to maxCount pending pipelines on the calling thread, returns how many
+        uint32_t compilePending(uint32_t maxCount = ~0u);
+        void waitForIdle();
+
+        PipelineCompilerStatistics getStatistics();
+
+    private:
+        typedef std::pair<uint32_t, uint64_t> QueueKey;
+
+        static QueueKey getQueueKey(const AsyncGraphicsPipeline* pipeline);
+        // takes the first pipeline of the queue, null when it is empty
+        AsyncGraphicsPipelineHandle popPending();
+        void compile(AsyncGraphicsPipeline* pipeline);
+
+        PipelineCache& m_Cache;
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::map<QueueKey, AsyncGraphicsPipelineHandle> m_Queue;
+        uint32_t m_Compiling = 0;
+        uint64_t m_NextSequence = 0;
+        std::chrono::steady_clock::time_point m_BusyStart;
+        PipelineCompilerStatistics m_Statistics;
+        // destroyed first, its workers use the members above
+        std::unique_ptr<common::ThreadPool> m_ThreadPool;
+    };
+
+}
+}
@@ -0,0 +1,964 @@
+#include "render_graph.h"
+
+#include "misc.h"
+#include "rhi_utils.h"
+#include <algorithm>
+#include <array>
+#include <sstream>
+
+namespace redtea {
+namespace device {
+
+    static const ResourceStates c_ReadOnlyStates = ResourceStates::ConstantBuffer
+        | ResourceStates::VertexBuffer
+        | ResourceStates::IndexBuffer
+        | ResourceStates::IndirectArgument
+        | ResourceStates::ShaderResource
+        | ResourceStates::DepthRead
+        | ResourceStates::CopySource
+        | ResourceStates::ResolveSource
+        | ResourceStates::AccelStructRead
+        | ResourceStates::AccelStructBuildInput
+        | ResourceStates::ShadingRateSurface;
+
+    static bool isReadOnly(ResourceStates state)
+    {
+        return state != ResourceStates::Unknown && (state & ~c_ReadOnlyStates) == 0;
+    }
+
+    static bool isSameLayout(const TextureDesc& a, const TextureDesc& b)
+    {
+        return a.width == b.width
+            && a.height == b.height
+            && a.depth == b.depth
+            && a.arraySize == b.arraySize
+            && a.mipLevels == b.mipLevels
+            && a.sampleCount == b.sampleCount
+            && a.sampleQuality == b.sampleQuality
+            && a.format == b.format
+            && a.dimension == b.dimension
+            && a.isRenderTarget == b.isRenderTarget
+            && a.isUAV == b.isUAV
+            && a.isTypeless == b.isTypeless
+            && a.isShadingRateSurface == b.isShadingRateSurface;
+    }
+
+    static bool isSameLayout(const BufferDesc& a, const BufferDesc& b)
+    {
+        return a.byteSize == b.byteSize
+            && a.structStride == b.structStride
+            && a.format == b.format
+            && a.canHaveUAVs == b.canHaveUAVs
+            && a.canHaveTypedViews == b.canHaveTypedViews
+            && a.canHaveRawViews == b.canHaveRawViews
+            && a.isVertexBuffer == b.isVertexBuffer
+            && a.isIndexBuffer == b.isIndexBuffer
+            && a.isConstantBuffer == b.isConstantBuffer
+            && a.isDrawIndirectArgs == b.isDrawIndirectArgs
+            && a.isAccelStructBuildInput == b.isAccelStructBuildInput
+            && a.isAccelStructStorage == b.isAccelStructStorage;
+    }
+
+    RenderGraphTexture RenderGraphBuilder::createTexture(const TextureDesc& desc)
+    {
+        RenderGraph::Resource resource;
+        resource.isTexture = true;
+        resource.textureDesc = desc;
+
+        RenderGraphTexture texture;
+        texture.index = m_Graph.addResource(std::move(resource));
+        return texture;
+    }
+
+    RenderGraphBuffer RenderGraphBuilder::createBuffer(const BufferDesc& desc)
+    {
+        RenderGraph::Resource resource;
+        resource.bufferDesc = desc;
+
+        RenderGraphBuffer buffer;
+        buffer.index = m_Graph.addResource(std::move(resource));
+        return buffer;
+    }
+
+    RenderGraphTexture RenderGraphBuilder::read(RenderGraphTexture texture, ResourceStates state)
+    {
+        if (!m_Graph.addAccess(m_Pass, texture.index, state, false))
+            return RenderGraphTexture();
+        return texture;
+    }
+
+    RenderGraphTexture RenderGraphBuilder::write(RenderGraphTexture texture, ResourceStates state)
+    {
+        if (!m_Graph.addAccess(m_Pass, texture.index, state, true))
+            return RenderGraphTexture();
+        return texture;
+    }
+
+    RenderGraphBuffer RenderGraphBuilder::read(RenderGraphBuffer buffer, ResourceStates state)
+    {
+        if (!m_Graph.addAccess(m_Pass, buffer.index, state, false))
+            return RenderGraphBuffer();
+        return buffer;
+    }
+
+    RenderGraphBuffer RenderGraphBuilder::write(RenderGraphBuffer buffer, ResourceStates state)
+    {
+        if (!m_Graph.addAccess(m_Pass, buffer.index, state, true))
+            return RenderGraphBuffer();
+        return buffer;
+    }
+
+    void RenderGraphBuilder::setSideEffects()
+    {
+        m_Graph.m_Passes[m_Pass].sideEffects = true;
+    }
+
+    void RenderGraphBuilder::setQueue(CommandQueue queue)
+    {
+        m_Graph.m_Passes[m_Pass].requestedQueue = queue;
+    }
+
+    void RenderGraphBuilder::setCost(float cost)
+    {
+        m_Graph.m_Passes[m_Pass].cost = cost;
+    }
+
+    ITexture* RenderGraphContext::getTexture(RenderGraphTexture texture) const
+    {
+        if (texture.index >= m_Graph.m_Resources.size())
+            return nullptr;
+
+        return m_Graph.m_Resources[texture.index].texture;
+    }
+
+    IBuffer* RenderGraphContext::getBuffer(RenderGraphBuffer buffer) const
+    {
+        if (buffer.index >= m_Graph.m_Resources.size())
+            return nullptr;
+
+        return m_Graph.m_Resources[buffer.index].buffer;
+    }
+
+    RenderGraph::RenderGraph(IDevice* device)
+        : m_Device(device)
+    {
+    }
+
+    RenderGraphTexture RenderGraph::importTexture(ITexture* texture, ResourceStates initialState, ResourceStates finalState)
+    {
+        Resource resource;
+        resource.isTexture = true;
+        resource.imported = true;
+        resource.texture = texture;
+        resource.textureDesc = texture->getDesc();
+        resource.initialState = initialState;
+        resource.finalState = finalState == ResourceStates::Unknown ? initialState : finalState;
+
+        RenderGraphTexture handle;
+        handle.index = addResource(std::move(resource));
+        return handle;
+    }
+
+    RenderGraphBuffer RenderGraph::importBuffer(IBuffer* buffer, ResourceStates initialState, ResourceStates finalState)
+    {
+        Resource resource;
+        resource.imported = true;
+        resource.buffer = buffer;
+        resource.bufferDesc = buffer->getDesc();
+        resource.initialState = initialState;
+        resource.finalState = finalState == ResourceStates::Unknown ? initialState : finalState;
+
+        RenderGraphBuffer handle;
+        handle.index = addResource(std::move(resource));
+        return handle;
+    }
+
+    uint32_t RenderGraph::addPass(const char* name, const RenderGraphSetupFunction& setup, RenderGraphExecuteFunction execute)
+    {
+        const uint32_t index = uint32_t(m_Passes.size());
+        m_Passes.emplace_back();
+        m_Passes.back().name = name;
+        m_Passes.back().execute = std::move(execute);
+        m_Compiled = false;
+
+        RenderGraphBuilder builder(*this, index);
+        setup(builder);
+        return index;
+    }
+
+    uint32_t RenderGraph::addResource(Resource&& resource)
+    {
+        m_Resources.push_back(std::move(resource));
+        m_Compiled = false;
+        return uint32_t(m_Resources.size()) - 1;
+    }
+
+    bool RenderGraph::addAccess(uint32_t pass, uint32_t resource, ResourceStates state, bool write)
+    {
+        if (resource >= m_Resources.size())
+        {
+            std::stringstream ss;
+            ss << "Render graph pass " << m_Passes[pass].name << " uses an invalid resource";
+            m_Device->getMessageCallback()->message(MessageSeverity::Error, ss.str().c_str());
+            return false;
+        }
+
+        // the accesses of a pass to one resource become one state
+        for (Access& access : m_Passes[pass].accesses)
+        {
+            if (access.resource == resource)
+            {
+                access.state = access.state | state;
+                access.read = access.read || !write;
+                access.write = access.write || write;
+                return true;
+            }
+        }
+
+        Access access;
+        access.resource = resource;
+        access.state = state;
+        access.read = !write;
+        access.write = write;
+        m_Passes[pass].accesses.push_back(access);
+        return true;
+    }
+
+    void RenderGraph::compile()
+    {
+        m_Statistics = RenderGraphStatistics();
+        m_Statistics.passes = uint32_t(m_Passes.size());
+
+        cullPasses();
+        planTransitions();
+        scheduleQueues();
+        planSplitBarriers();
+        allocateTransientResources();
+
+        m_Compiled = true;
+    }
+
+    void RenderGraph::cullPasses()
+    {
+        // a resource is used by the passes reading it and, when imported, by whoever comes after
+        // the graph. A pass that reads and writes a resource doesn't keep its earlier writers alive
+        // by itself, nobody would see the result.
+        for (Resource& resource : m_Resources)
+            resource.refCount = resource.imported ? 1 : 0;
+
+        for (Pass& pass : m_Passes)
+        {
+            pass.culled = false;
+            pass.refCount = 0;
+            for (const Access& access : pass.accesses)
+            {
+                if (access.write)
+                    pass.refCount++;
+                else
+                    m_Resources[access.resource].refCount++;
+            }
+        }
+
+        std::vector<uint32_t> unused;
+
+        auto cullPass = [this, &unused](Pass& pass)
+        {
+            pass.culled = true;
+            m_Statistics.culledPasses++;
+
+            for (const Access& access : pass.accesses)
+            {
+                if (!access.write && --m_Resources[access.resource].refCount == 0)
+                    unused.push_back(access.resource);
+            }
+        };
+
+        for (uint32_t index = 0; index < uint32_t(m_Resources.size()); index++)
+        {
+            if (m_Resources[index].refCount == 0)
+                unused.push_back(index);
+        }
+
+        for (Pass& pass : m_Passes)
+        {
+            if (pass.refCount == 0 && !pass.sideEffects)
+                cullPass(pass);
+        }
+
+        while (!unused.empty())
+        {
+            const uint32_t resource = unused.back();
+            unused.pop_back();
+
+            for (Pass& pass : m_Passes)
+            {
+                if (pass.culled)
+                    continue;
+
+                for (const Access& access : pass.accesses)
+                {
+                    if (access.resource == resource && access.write && --pass.refCount == 0 && !pass.sideEffects)
+                        cullPass(pass);
+                }
+            }
+        }
+    }
+
+    void RenderGraph::planTransitions()
+    {
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> uses(m_Resources.size());
+
+        for (Resource& resource : m_Resources)
+        {
+            resource.firstPass = ~0u;
+            resource.lastPass = 0;
+        }
+
+        for (uint32_t passIndex = 0; passIndex < uint32_t(m_Passes.size()); passIndex++)
+        {
+            Pass& pass = m_Passes[passIndex];
+            pass.transitions.clear();
+            pass.dependencies.clear();
+            if (pass.culled)
+                continue;
+
+            for (uint32_t accessIndex = 0; accessIndex < uint32_t(pass.accesses.size()); accessIndex++)
+            {
+                const uint32_t resourceIndex = pass.accesses[accessIndex].resource;
+                Resource& resource = m_Resources[resourceIndex];
+                resource.firstPass = std::min(resource.firstPass, passIndex);
+                resource.lastPass = passIndex;
+                uses[resourceIndex].push_back(std::make_pair(passIndex, accessIndex));
+            }
+        }
+
+        auto addDependency = [this](uint32_t pass, uint32_t dependency)
+        {
+            std::vector<uint32_t>& dependencies = m_Passes[pass].dependencies;
+            if (dependency != ~0u && dependency != pass && std::find(dependencies.begin(), dependencies.end(), dependency) == dependencies.end())
+                dependencies.push_back(dependency);
+        };
+
+        // consecutive read-only uses share one combined state, so a resource read by several
+        // passes in different ways goes through one barrier instead of one per pass. Writes are
+        // ordered after everything before them, reads after the last write and after the first
+        // read of their run, which makes the transition.
+        for (uint32_t resourceIndex = 0; resourceIndex < uint32_t(m_Resources.size()); resourceIndex++)
+        {
+            const auto& resourceUses = uses[resourceIndex];
+            uint32_t lastWriter = ~0u;
+            std::vector<uint32_t> readers;
+            size_t first = 0;
+            while (first < resourceUses.size())
+            {
+                const uint32_t passIndex = resourceUses[first].first;
+                const Access& access = m_Passes[passIndex].accesses[resourceUses[first].second];
+                if (access.write || !isReadOnly(access.state))
+                {
+                    m_Passes[passIndex].transitions.push_back(std::make_pair(resourceIndex, access.state));
+                    addDependency(passIndex, lastWriter);
+                    for (uint32_t reader : readers)
+                        addDependency(passIndex, reader);
+                    lastWriter = passIndex;
+                    readers.clear();
+                    first++;
+                    continue;
+                }
+
+                size_t last = first;
+                ResourceStates combined = ResourceStates::Unknown;
+                while (last < resourceUses.size())
+                {
+                    const Access& read = m_Passes[resourceUses[last].first].accesses[resourceUses[last].second];
+                    if (read.write || !isReadOnly(read.state))
+                        break;
+                    combined = combined | read.state;
+                    last++;
+                }
+
+                for (size_t use = first; use < last; use++)
+                {
+                    const uint32_t reader = resourceUses[use].first;
+                    m_Passes[reader].transitions.push_back(std::make_pair(resourceIndex, combined));
+                    addDependency(reader, lastWriter);
+                    addDependency(reader, resourceUses[first].first);
+                    readers.push_back(reader);
+                }
+                first = last;
+            }
+        }
+    }
+
+    void RenderGraph::scheduleQueues()
+    {
+        m_Submissions.clear();
+        m_SubmissionClocks.clear();
+
+        const size_t queueCount = size_t(CommandQueue::Count);
+        bool queueAvailable[queueCount] = { true, m_Device->queryFeatureSupport(Feature::ComputeQueue), m_Device->queryFeatureSupport(Feature::CopyQueue) };
+
+        // the last submission of every queue known to be complete before a submission starts,
+        // its own queue included, -1 for none
+        typedef SubmissionClock Clock;
+        std::vector<Clock>& clocks = m_SubmissionClocks;
+        Clock queueClocks[queueCount];
+        int64_t openSubmission[queueCount];
+        for (size_t queue = 0; queue < queueCount; queue++)
+        {
+            queueClocks[queue].fill(-1);
+            openSubmission[queue] = -1;
+        }
+
+        auto openNew = [&](CommandQueue queue, std::vector<uint32_t>& waitFor)
+        {
+            const uint32_t index = uint32_t(m_Submissions.size());
+            Clock clock = queueClocks[size_t(queue)];
+
+            // the latest submissions first, their own waits may cover the earlier ones
+            std::sort(waitFor.begin(), waitFor.end(), std::greater<uint32_t>());
+            RenderGraphSubmission submission;
+            submission.queue = queue;
+            for (uint32_t wait : waitFor)
+            {
+                const CommandQueue waitQueue = m_Submissions[wait].queue;
+                if (clock[size_t(waitQueue)] >= int64_t(wait))
+                    continue;
+
+                submission.waits.push_back(MakeVersion(wait, waitQueue, false));
+                for (size_t other = 0; other < queueCount; other++)
+                    clock[other] = std::max(clock[other], clocks[wait][other]);
+                m_Statistics.crossQueueWaits++;
+            }
+            clock[size_t(queue)] = index;
+
+            m_Submissions.push_back(submission);
+            clocks.push_back(clock);
+            queueClocks[size_t(queue)] = clock;
+            openSubmission[size_t(queue)] = index;
+        };
+
+        std::vector<uint32_t> waitFor;
+        for (uint32_t passIndex = 0; passIndex < uint32_t(m_Passes.size()); passIndex++)
+        {
+            Pass& pass = m_Passes[passIndex];
+            if (pass.culled)
+                continue;
+
+            pass.queue = queueAvailable[size_t(pass.requestedQueue)] ? pass.requestedQueue : CommandQueue::Graphics;
+            if (pass.queue != CommandQueue::Graphics)
+                m_Statistics.asyncPasses++;
+
+            const size_t queue = size_t(pass.queue);
+            const Clock& current = openSubmission[queue] >= 0 ? clocks[size_t(openSubmission[queue])] : queueClocks[queue];
+
+            waitFor.clear();
+            for (uint32_t dependency : pass.dependencies)
+            {
+                const Pass& dependencyPass = m_Passes[dependency];
+                if (dependencyPass.queue == pass.queue)
+                    continue;
+
+                // what this pass waits for has to be submitted first
+                const size_t dependencyQueue = size_t(dependencyPass.queue);
+                if (openSubmission[dependencyQueue] == int64_t(dependencyPass.submission))
+                    openSubmission[dependencyQueue] = -1;
+
+                if (current[dependencyQueue] < int64_t(dependencyPass.submission))
+                    waitFor.push_back(dependencyPass.submission);
+            }
+
+            if (openSubmission[queue] < 0 || !waitFor.empty())
+                openNew(pass.queue, waitFor);
+
+            pass.submission = uint32_t(openSubmission[queue]);
+            m_Submissions[pass.submission].passes.push_back(passIndex);
+        }
+
+        // the frame ends on the graphics queue once the others are done, which is also where the
+        // imported resources go to their final states
+        waitFor.clear();
+        for (size_t queue = 1; queue < queueCount; queue++)
+        {
+            if (queueClocks[queue][queue] >= 0)
+                waitFor.push_back(uint32_t(queueClocks[queue][queue]));
+        }
+
+        const size_t graphics = size_t(CommandQueue::Graphics);
+        const Clock& current = openSubmission[graphics] >= 0 ? clocks[size_t(openSubmission[graphics])] : queueClocks[graphics];
+        bool joined = openSubmission[graphics] >= 0;
+        for (uint32_t wait : waitFor)
+            joined = joined && current[size_t(m_Submissions[wait].queue)] >= int64_t(wait);
+        if (!joined)
+            openNew(CommandQueue::Graphics, waitFor);
+
+        // expected timeline: a submission starts when its queue is free and its waits are done
+        std::vector<float> finish(m_Submissions.size());
+        float queueFree[queueCount] = {};
+        for (size_t index = 0; index < m_Submissions.size(); index++)
+        {
+            const RenderGraphSubmission& submission = m_Submissions[index];
+            float start = queueFree[size_t(submission.queue)];
+            for (uint64_t wait : submission.waits)
+                start = std::max(start, finish[VersionGetInstance(wait)]);
+
+            float cost = 0.f;
+            for (uint32_t passIndex : submission.passes)
+                cost += m_Passes[passIndex].cost;
+
+            finish[index] = start + cost;
+            queueFree[size_t(submission.queue)] = finish[index];
+            m_Statistics.serialCost += cost;
+            m_Statistics.scheduledCost = std::max(m_Statistics.scheduledCost, finish[index]);
+        }
+
+        m_Statistics.submissions = uint32_t(m_Submissions.size());
+    }
+
+    void RenderGraph::planSplitBarriers()
+    {
+        for (Pass& pass : m_Passes)
+            pass.splitTransitions.clear();
+
+        if (!m_SplitBarriers)
+            return;
+
+        // position of every pass in its submission
+        std::vector<uint32_t> positions(m_Passes.size(), 0);
+        for (const RenderGraphSubmission& submission : m_Submissions)
+        {
+            for (uint32_t position = 0; position < uint32_t(submission.passes.size()); position++)
+                positions[submission.passes[position]] = position;
+        }
+
+        // the last pass using every resource and the state it left the resource in
+        std::vector<uint32_t> lastPass(m_Resources.size(), ~0u);
+        std::vector<ResourceStates> lastState(m_Resources.size(), ResourceStates::Unknown);
+        for (uint32_t passIndex = 0; passIndex < uint32_t(m_Passes.size()); passIndex++)
+        {
+            const Pass& pass = m_Passes[passIndex];
+            if (pass.culled)
+                continue;
+
+            for (const auto& transitionDesc : pass.transitions)
+            {
+                const uint32_t resourceIndex = transitionDesc.first;
+                const uint32_t previous = lastPass[resourceIndex];
+
+                // a split is only worth it with work in between, and both halves must be in one command list
+                if (previous != ~0u &&
+                    transitionDesc.second != lastState[resourceIndex] &&
+                    m_Passes[previous].submission == pass.submission &&
+                    positions[passIndex] > positions[previous] + 1)
+                {
+                    m_Passes[previous].splitTransitions.push_back(transitionDesc);
+                }
+
+                lastPass[resourceIndex] = passIndex;
+                lastState[resourceIndex] = transitionDesc.second;
+            }
+        }
+    }
+
+    RenderGraph::CachedResource* RenderGraph::findCachedResource(const Resource& resource, bool matchOffset)
+    {
+        for (CachedResource& cached : m_Cache)
+        {
+            if (cached.used || (matchOffset && cached.offset != resource.offset))
+                continue;
+
+            if (resource.isTexture ? (cached.texture && isSameLayout(cached.textureDesc, resource.textureDesc))
+                : (cached.buffer && isSameLayout(cached.bufferDesc, resource.bufferDesc)))
+                return &cached;
+        }
+
+        return nullptr;
+    }
+
+    bool RenderGraph::isOrderedBefore(uint32_t first, uint32_t second) const
+    {
+        // every last use of first has to be complete before any first use of second starts. On
+        // the same queue that's the pass order, across queues the submission of the later pass
+        // has to wait for the one of the earlier pass, directly or through other waits
+        const size_t queueCount = size_t(CommandQueue::Count);
+        for (size_t lastQueue = 0; lastQueue < queueCount; lastQueue++)
+        {
+            const std::pair<uint32_t, uint32_t>& lifetime = m_QueueLifetimes[first * queueCount + lastQueue];
+            if (lifetime.first == ~0u)
+                continue;
+
+            const uint32_t lastPass = lifetime.second;
+
+            for (size_t firstQueue = 0; firstQueue < queueCount; firstQueue++)
+            {
+                const uint32_t firstPass = m_QueueLifetimes[second * queueCount + firstQueue].first;
+                if (firstPass == ~0u)
+                    continue;
+
+                if (lastQueue == firstQueue)
+                {
+                    if (lastPass >= firstPass)
+                        return false;
+                }
+                else if (m_SubmissionClocks[m_Passes[firstPass].submission][lastQueue] < int64_t(m_Passes[lastPass].submission))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void RenderGraph::allocateTransientResources()
+    {
+        std::vector<uint32_t> transients;
+        for (uint32_t index = 0; index < uint32_t(m_Resources.size()); index++)
+        {
+            Resource& resource = m_Resources[index];
+            resource.cacheIndex = ~0u;
+            if (resource.imported)
+                continue;
+
+            resource.texture = nullptr;
+            resource.buffer = nullptr;
+            if (resource.firstPass == ~0u)
+                continue;
+
+            // memory requirements of a layout seen before come from the cache, others from a
+            // resource that is kept when it can be placed
+            if (CachedResource* cached = findCachedResource(resource, false))
+            {
+                resource.memoryRequirements = cached->memoryRequirements;
+            }
+            else if (resource.isTexture)
+            {
+                TextureDesc desc = resource.textureDesc;
+                desc.isVirtual = true;
+                desc.initialState = ResourceStates::Common;
+                desc.keepInitialState = false;
+                resource.texture = m_Device->createTexture(desc);
+                resource.memoryRequirements = m_Device->getTextureMemoryRequirements(resource.texture);
+            }
+            else
+            {
+                BufferDesc desc = resource.bufferDesc;
+                desc.isVirtual = true;
+                desc.initialState = ResourceStates::Common;
+                desc.keepInitialState = false;
+                resource.buffer = m_Device->createBuffer(desc);
+                resource.memoryRequirements = m_Device->getBufferMemoryRequirements(resource.buffer);
+            }
+
+            if (resource.isTexture)
+                m_Statistics.transientTextures++;
+            else
+                m_Statistics.transientBuffers++;
+            m_Statistics.transientBytes += resource.memoryRequirements.size;
+            transients.push_back(index);
+        }
+
+        // the first and last pass using each transient on every queue, passes of one queue run in
+        // the order they were added
+        const size_t queueCount = size_t(CommandQueue::Count);
+        m_QueueLifetimes.assign(m_Resources.size() * queueCount, std::make_pair(~0u, 0u));
+        for (uint32_t passIndex = 0; passIndex < uint32_t(m_Passes.size()); passIndex++)
+        {
+            const Pass& pass = m_Passes[passIndex];
+            if (pass.culled)
+                continue;
+
+            for (const Access& access : pass.accesses)
+            {
+                std::pair<uint32_t, uint32_t>& lifetime = m_QueueLifetimes[access.resource * queueCount + size_t(pass.queue)];
+                lifetime.first = std::min(lifetime.first, passIndex);
+                lifetime.second = passIndex;
+            }
+        }
+
+        // largest first, each at the lowest offset that doesn't overlap the memory of a resource
+        // placed before it whose lifetime isn't ordered before or after its own on the GPU
+        std::stable_sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+            return m_Resources[a].memoryRequirements.size > m_Resources[b].memoryRequirements.size;
+        });
+
+        uint64_t heapSize = 0;
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;
+        for (size_t placed = 0; placed < transients.size(); placed++)
+        {
+            Resource& resource = m_Resources[transients[placed]];
+            const uint64_t alignment = std::max(resource.memoryRequirements.alignment, uint64_t(1));
+
+            ranges.clear();
+            for (size_t other = 0; other < placed; other++)
+            {
+                const Resource& neighbour = m_Resources[transients[other]];
+                if (!isOrderedBefore(transients[other], transients[placed]) && !isOrderedBefore(transients[placed], transients[other]))
+                    ranges.push_back(std::make_pair(neighbour.offset, neighbour.offset + neighbour.memoryRequirements.size));
+            }
+            std::sort(ranges.begin(), ranges.end());
+
+            uint64_t offset = 0;
+            for (const auto& range : ranges)
+            {
+                if (Align(offset, alignment) + resource.memoryRequirements.size <= range.first)
+                    break;
+                offset = std::max(offset, range.second);
+            }
+
+            resource.offset = Align(offset, alignment);
+            heapSize = std::max(heapSize, resource.offset + resource.memoryRequirements.size);
+        }
+        m_Statistics.heapBytes = heapSize;
+
+        if (heapSize != 0 && (!m_Heap || m_Heap->getDesc().capacity < heapSize))
+        {
+            // everything in the cache lives in the old heap
+            m_Cache.clear();
+            m_Heap = m_Device->createHeap(HeapDesc().setCapacity(heapSize).setType(HeapType::DeviceLocal).setDebugName("RenderGraph"));
+            if (!m_Heap)
+            {
+                m_Device->getMessageCallback()->message(MessageSeverity::Error, "Couldn't create the render graph heap");
+                return;
+            }
+        }
+
+        std::vector<CachedResource> cache;
+        cache.reserve(transients.size());
+        for (uint32_t index : transients)
+        {
+            Resource& resource = m_Resources[index];
+            CachedResource entry;
+
+            if (CachedResource* cached = findCachedResource(resource, true))
+            {
+                cached->used = true;
+                entry = *cached;
+                entry.used = false;
+                resource.texture = cached->texture;
+                resource.buffer = cached->buffer;
+            }
+            else
+            {
+                if (resource.isTexture)
+                {
+                    // the resource made for the memory requirements is bound if there is one
+                    if (!resource.texture)
+                    {
+                        TextureDesc desc = resource.textureDesc;
+                        desc.isVirtual = true;
+                        desc.initialState = ResourceStates::Common;
+                        desc.keepInitialState = false;
+                        resource.texture = m_Device->createTexture(desc);
+                    }
+                    m_Device->bindTextureMemory(resource.texture, m_Heap, resource.offset);
+                }
+                else
+                {
+                    if (!resource.buffer)
+                    {
+                        BufferDesc desc = resource.bufferDesc;
+                        desc.isVirtual = true;
+                        desc.initialState = ResourceStates::Common;
+                        desc.keepInitialState = false;
+                        resource.buffer = m_Device->createBuffer(desc);
+                    }
+                    m_Device->bindBufferMemory(resource.buffer, m_Heap, resource.offset);
+                }
+
+                entry.textureDesc = resource.textureDesc;
+                entry.bufferDesc = resource.bufferDesc;
+                entry.texture = resource.texture;
+                entry.buffer = resource.buffer;
+                entry.memoryRequirements = resource.memoryRequirements;
+                entry.offset = resource.offset;
+            }
+
+            resource.cacheIndex = uint32_t(cache.size());
+            cache.push_back(entry);
+        }
+
+        m_Cache = std::move(cache);
+    }
+
+    void RenderGraph::transition(ICommandList* commandList, Resource& resource, ResourceStates state)
+    {
+        if (state != resource.currentState)
+            m_Statistics.barriers++;
+        else if ((state & ResourceStates::UnorderedAccess) != 0)
+            m_Statistics.uavBarriers++;
+        else
+            return;
+
+        if (resource.isTexture)
+            commandList->setTextureState(resource.texture, AllSubresources, state);
+        else
+            commandList->setBufferState(resource.buffer, state);
+
+        resource.currentState = state;
+    }
+
+    void RenderGraph::prepareRecording()
+    {
+        if (!m_Compiled)
+            compile();
+
+        m_Statistics.barriers = 0;
+        m_Statistics.uavBarriers = 0;
+        m_Statistics.barrierBatches = 0;
+        m_Statistics.splitBarriers = 0;
+
+        for (Resource& resource : m_Resources)
+        {
+            if (!resource.imported && resource.cacheIndex != ~0u)
+                resource.currentState = m_Cache[resource.cacheIndex].state;
+            else
+                resource.currentState = resource.initialState;
+        }
+        m_TrackedIn.assign(m_Resources.size(), ~0u);
+    }
+
+    void RenderGraph::track(ICommandList* commandList, Resource& resource, uint32_t submission)
+    {
+        const uint32_t index = uint32_t(&resource - m_Resources.data());
+        if (m_TrackedIn[index] == submission)
+            return;
+
+        m_TrackedIn[index] = submission;
+        if (resource.isTexture)
+            commandList->beginTrackingTextureState(resource.texture, AllSubresources, resource.currentState);
+        else
+            commandList->beginTrackingBufferState(resource.buffer, resource.currentState);
+    }
+
+    void RenderGraph::recordPass(ICommandList* commandList, Pass& pass, uint32_t submission)
+    {
+        const uint32_t barriers = m_Statistics.barriers + m_Statistics.uavBarriers;
+        for (const auto& transitionDesc : pass.transitions)
+        {
+            Resource& resource = m_Resources[transitionDesc.first];
+            if (!resource.texture && !resource.buffer)
+                continue;
+
+            track(commandList, resource, submission);
+            transition(commandList, resource, transitionDesc.second);
+        }
+
+        if (m_Statistics.barriers + m_Statistics.uavBarriers != barriers)
+        {
+            commandList->commitBarriers();
+            m_Statistics.barrierBatches++;
+        }
+
+        if (pass.execute)
+        {
+            RenderGraphContext context(*this, commandList);
+            pass.execute(context);
+        }
+
+        for (const auto& transitionDesc : pass.splitTransitions)
+        {
+            Resource& resource = m_Resources[transitionDesc.first];
+            if (!resource.texture && !resource.buffer)
+                continue;
+
+            if (resource.isTexture)
+                commandList->beginTextureStateTransition(resource.texture, transitionDesc.second);
+            else
+                commandList->beginBufferStateTransition(resource.buffer, transitionDesc.second);
+            m_Statistics.splitBarriers++;
+        }
+
+        if (!pass.splitTransitions.empty())
+        {
+            commandList->commitBarriers();
+            m_Statistics.barrierBatches++;
+        }
+    }
+
+    void RenderGraph::recordFinalStates(ICommandList* commandList, uint32_t submission)
+    {
+        const uint32_t barriers = m_Statistics.barriers + m_Statistics.uavBarriers;
+        for (Resource& resource : m_Resources)
+        {
+            if (resource.firstPass == ~0u)
+                continue;
+
+            if (resource.imported)
+            {
+                if (resource.currentState != resource.finalState)
+                {
+                    track(commandList, resource, submission);
+                    transition(commandList, resource, resource.finalState);
+                }
+            }
+            else if (resource.cacheIndex != ~0u)
+            {
+                m_Cache[resource.cacheIndex].state = resource.currentState;
+            }
+        }
+
+        if (m_Statistics.barriers + m_Statistics.uavBarriers != barriers)
+        {
+            commandList->commitBarriers();
+            m_Statistics.barrierBatches++;
+        }
+    }
+
+    void RenderGraph::execute(ICommandList* commandList)
+    {
+        prepareRecording();
+
+        commandList->setEnableAutomaticBarriers(false);
+        for (Pass& pass : m_Passes)
+        {
+            if (!pass.culled)
+                recordPass(commandList, pass, 0);
+        }
+        recordFinalStates(commandList, 0);
+        commandList->setEnableAutomaticBarriers(true);
+    }
+
+    uint64_t RenderGraph::submit()
+    {
+        prepareRecording();
+
+        // submissions are made in the order compile() created them, which puts every submission
+        // after the ones it waits for and every use of a resource after the uses it depends on
+        std::vector<uint64_t> instances(m_Submissions.size());
+        uint64_t lastGraphicsInstance = 0;
+        for (uint32_t index = 0; index < uint32_t(m_Submissions.size()); index++)
+        {
+            const RenderGraphSubmission& submission = m_Submissions[index];
+            CommandListHandle& commandList = m_CommandLists[size_t(submission.queue)];
+            if (!commandList)
+                commandList = m_Device->createCommandList(CommandListParameters().setQueueType(submission.queue));
+
+            commandList->open();
+            commandList->setEnableAutomaticBarriers(false);
+            for (uint32_t passIndex : submission.passes)
+                recordPass(commandList, m_Passes[passIndex], index);
+            if (index + 1 == m_Submissions.size())
+                recordFinalStates(commandList, index);
+            commandList->setEnableAutomaticBarriers(true);
+            commandList->close();
+
+            for (uint64_t wait : submission.waits)
+                m_Device->queueWaitForCommandList(submission.queue, VersionGetQueue(wait), instances[VersionGetInstance(wait)]);
+
+            ICommandList* commandLists[] = { commandList };
+            instances[index] = m_Device->executeCommandLists(commandLists, 1, submission.queue);
+            if (submission.queue == CommandQueue::Graphics)
+                lastGraphicsInstance = instances[index];
+        }
+
+        return lastGraphicsInstance;
+    }
+
+    void RenderGraph::reset()
+    {
+        m_Passes.clear();
+        m_Resources.clear();
+        m_Compiled = false;
+    }
+
+}
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "rhi.h"
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Frame graph on top of ICommandList. Passes declare the resources they read and write when they
+// are added, compile() culls the passes whose results are never used, plans the state of every
+// resource in every pass and places the transient resources in one heap, aliasing the memory of
+// resources whose lifetimes don't overlap on the GPU, across queues only when a submission waits
+// for the other. execute() records the passes in the order they were
+// added with their barriers batched in front of each pass.
+//
+//     RenderGraph graph(device);
+//     RenderGraphTexture output = graph.importTexture(backBuffer, ResourceStates::Present);
+//     graph.addPass("tonemap", [&](RenderGraphBuilder& builder) {
+//         hdr = builder.read(hdr);
+//         builder.write(output);
+//     }, [=](RenderGraphContext& context) {
+//         ... context.getTexture(hdr) ...
+//     });
+//     graph.compile();
+//     graph.execute(commandList);
+//     graph.reset();
+//
+// The graph owns the barriers of the resources it knows about: automatic barriers are disabled
+// while the passes run and enabled again at the end of execute(). Transient resources keep their
+// memory between frames as long as the next compile() places them the same way, their contents
+// are undefined at the start of the first pass that uses them.
+//
+// Passes that only record compute or copy work can ask for the Compute or Copy queue. compile()
+// moves them there when the device has the queue and splits the passes into submissions, each
+// waiting for the submissions of other queues it depends on unless an earlier wait already covers
+// them. submit() records and submits those with the graph's own command lists, the last graphics
+// submission waits for the other queues so the next frame starts from a joined state. The graph
+// doesn't move transitions between queues: a pass on the Compute or Copy queue must only need
+// states that queue can transition to and from.
+//
+// With split barriers enabled the transition of a resource to the state a later pass needs begins
+// right after the pass that used it before, when other passes of the same command list run in
+// between, and ends in front of the pass that needs it.
+
+namespace redtea {
+namespace device {
+
+    struct RenderGraphTexture
+    {
+        uint32_t index = ~0u;
+
+        bool valid() const { return index != ~0u; }
+    };
+
+    struct RenderGraphBuffer
+    {
+        uint32_t index = ~0u;
+
+        bool valid() const { return index != ~0u; }
+    };
+
+    struct RenderGraphStatistics
+    {
+        uint32_t passes = 0;
+        uint32_t culledPasses = 0;
+        uint32_t transientTextures = 0;
+        uint32_t transientBuffers = 0;
+        // the transient resources allocated one by one and placed in the shared heap
+        uint64_t transientBytes = 0;
+        uint64_t heapBytes = 0;
+        // recorded by the last execute()
+        uint32_t barriers = 0;
+        uint32_t uavBarriers = 0;
+        uint32_t barrierBatches = 0;
+        uint32_t splitBarriers = 0;
+        // passes moved to the Compute and Copy queues and what it takes to run them there
+        uint32_t asyncPasses = 0;
+        uint32_t submissions = 0;
+        uint32_t crossQueueWaits = 0;
+        // sums of the pass costs, one pass after the other and with the queues overlapping
+        float serialCost = 0.f;
+        float scheduledCost = 0.f;
+
+        uint64_t getSavedBytes() const { return transientBytes - heapBytes; }
+        float getExpectedOverlap() const { return serialCost - scheduledCost; }
+    };
+
+    struct RenderGraphSubmission
+    {
+        CommandQueue queue = CommandQueue::Graphics;
+        std::vector<uint32_t> passes;
+        // MakeVersion(submission index, queue, false) of the submissions waited for first
+        std::vector<uint64_t> waits;
+    };
+
+    class RenderGraph;
+
+    class RenderGraphBuilder
+    {
+    public:
+        // transient resources, only alive between the first and the last pass that use them
+        RenderGraphTexture createTexture(const TextureDesc& desc);
+        RenderGraphBuffer createBuffer(const BufferDesc& desc);
+
+        RenderGraphTexture read(RenderGraphTexture texture, ResourceStates state = ResourceStates::ShaderResource);
+        RenderGraphTexture write(RenderGraphTexture texture, ResourceStates state = ResourceStates::RenderTarget);
+        RenderGraphBuffer read(RenderGraphBuffer buffer, ResourceStates state = ResourceStates::ShaderResource);
+        RenderGraphBuffer write(RenderGraphBuffer buffer, ResourceStates state = ResourceStates::UnorderedAccess);
+
+        // keeps the pass when nothing reads what it writes, e.g. for readbacks
+        void setSideEffects();
+        // Compute or Copy when the pass only records that kind of work and may run asynchronously
+        void setQueue(CommandQueue queue);
+        // relative GPU time of the pass, only used for the expected overlap
+        void setCost(float cost);
+
+    private:
+        friend class RenderGraph;
+
+        RenderGraphBuilder(RenderGraph& graph, uint32_t pass)
+            : m_Graph(graph)
+            , m_Pass(pass)
+        { }
+
+        RenderGraph& m_Graph;
+        uint32_t m_Pass;
+    };
+
+    class RenderGraphContext
+    {
+    public:
+        ICommandList* getCommandList() const { return m_CommandList; }
+        ITexture* getTexture(RenderGraphTexture texture) const;
+        IBuffer* getBuffer(RenderGraphBuffer buffer) const;
+
+    private:
+        friend class RenderGraph;
+
+        RenderGraphContext(const RenderGraph& graph, ICommandList* commandList)
+            : m_Graph(graph)
+            , m_CommandList(commandList)
+        { }
+
+        const RenderGraph& m_Graph;
+        ICommandList* m_CommandList;
+    };
+
+    typedef std::function<void(RenderGraphBuilder& builder)> RenderGraphSetupFunction;
+    typedef std::function<void(RenderGraphContext& context)> RenderGraphExecuteFunction;
+
+    class RenderGraph
+    {
+    public:
+        explicit RenderGraph(IDevice* device);
+
+        // finalState is the state the resource is left in by execute(), Unknown for initialState.
+        // Imported resources are outputs of the graph: the passes writing them are never culled.
+        RenderGraphTexture importTexture(ITexture* texture, ResourceStates initialState, ResourceStates finalState = ResourceStates::Unknown);
+        RenderGraphBuffer importBuffer(IBuffer* buffer, ResourceStates initialState, ResourceStates finalState = ResourceStates::Unknown);
+
+        // setup runs right away, returns the index of the pass
+        uint32_t addPass(const char* name, const RenderGraphSetupFunction& setup, RenderGraphExecuteFunction execute);
+
+        void compile();
+        // records every pass into commandList, which has to be open, whatever their queue
+        void execute(ICommandList* commandList);
+        // records and submits the submissions planned by compile(), returns the instance of the
+        // last graphics submission
+        uint64_t submit();
+        // forgets the passes and resources, keeps the heap and the transient resources for the next frame
+        void reset();
+        // off by default, applies from the next compile()
+        void setSplitBarriers(bool enable) { m_SplitBarriers = enable; m_Compiled = false; }
+
+        bool isPassCulled(uint32_t pass) const { return m_Passes[pass].culled; }
+        CommandQueue getPassQueue(uint32_t pass) const { return m_Passes[pass].queue; }
+        const std::vector<RenderGraphSubmission>& getSubmissions() const { return m_Submissions; }
+        const RenderGraphStatistics& getStatistics() const { return m_Statistics; }
+
+    private:
+        friend class RenderGraphBuilder;
+        friend class RenderGraphContext;
+
+        struct Resource
+        {
+            bool isTexture = false;
+            bool imported = false;
+            TextureDesc textureDesc;
+            BufferDesc bufferDesc;
+            TextureHandle texture;
+            BufferHandle buffer;
+            ResourceStates initialState = ResourceStates::Unknown;
+            ResourceStates finalState = ResourceStates::Unknown;
+            ResourceStates currentState = ResourceStates::Unknown;
+            uint32_t refCount = 0;
+            uint32_t firstPass = ~0u;
+            uint32_t lastPass = 0;
+            MemoryRequirements memoryRequirements;
+            uint64_t offset = 0;
+            uint32_t cacheIndex = ~0u;
+        };
+
+        struct Access
+        {
+            uint32_t resource;
+            ResourceStates state;
+            bool read;
+            bool write;
+        };
+
+        struct Pass
+        {
+            std::string name;
+            RenderGraphExecuteFunction execute;
+            std::vector<Access> accesses;
+            // the states the resources of the pass are put in before it runs
+            std::vector<std::pair<uint32_t, ResourceStates>> transitions;
+            // the transitions begun after the pass runs for a later pass of the same submission
+            std::vector<std::pair<uint32_t, ResourceStates>> splitTransitions;
+            // earlier passes using a resource of this one in a way that orders them
+            std::vector<uint32_t> dependencies;
+            CommandQueue requestedQueue = CommandQueue::Graphics;
+            CommandQueue queue = CommandQueue::Graphics;
+            float cost = 1.f;
+            uint32_t submission = 0;
+            uint32_t refCount = 0;
+            bool sideEffects = false;
+            bool culled = false;
+        };
+
+        // transient resources of the previous compile(), reused when they land at the same offset
+        struct CachedResource
+        {
+            TextureDesc textureDesc;
+            BufferDesc bufferDesc;
+            TextureHandle texture;
+            BufferHandle buffer;
+            MemoryRequirements memoryRequirements;
+            uint64_t offset = 0;
+            ResourceStates state = ResourceStates::Common;
+            bool used = false;
+        };
+
+        uint32_t addResource(Resource&& resource);
+        bool addAccess(uint32_t pass, uint32_t resource, ResourceStates state, bool write);
+        void cullPasses();
+        void planTransitions();
+        void scheduleQueues();
+        void planSplitBarriers();
+        void allocateTransientResources();
+        // whether every use of the first resource is done before the second one is first used
+        bool isOrderedBefore(uint32_t first, uint32_t second) const;
+        CachedResource* findCachedResource(const Resource& resource, bool matchOffset);
+        void prepareRecording();
+        void recordPass(ICommandList* commandList, Pass& pass, uint32_t submission);
+        void recordFinalStates(ICommandList* commandList, uint32_t submission);
+        void track(ICommandList* commandList, Resource& resource, uint32_t submission);
+        void transition(ICommandList* commandList, Resource& resource, ResourceStates state);
+
+        IDevice* m_Device;
+        std::vector<Pass> m_Passes;
+        std::vector<Resource> m_Resources;
+        std::vector<CachedResource> m_Cache;
+        std::vector<RenderGraphSubmission> m_Submissions;
+        // the last submission of every queue known to be complete before a submission starts
+        typedef std::array<int64_t, size_t(CommandQueue::Count)> SubmissionClock;
+        std::vector<SubmissionClock> m_SubmissionClocks;
+        // the first and last pass of every resource on every queue, ~0u first for none
+        std::vector<std::pair<uint32_t, uint32_t>> m_QueueLifetimes;
+        // the submission each resource is tracked in by the command list being recorded
+        std::vector<uint32_t> m_TrackedIn;
+        CommandListHandle m_CommandLists[size_t(CommandQueue::Count)];
+        HeapHandle m_Heap;
+        RenderGraphStatistics m_Statistics;
+        bool m_SplitBarriers = false;
+        bool m_Compiled = false;
+    };
+
+}
+}
@@ -104,7 +104,8 @@ namespace device
     {
         D3D11,
         D3D12,
-        VULKAN
+        VULKAN,
+        NULL_DEVICE
     };
 
     enum class Format : uint8_t
@@ -2318,6 +2319,12 @@ namespace device
         virtual void setBufferState(IBuffer* buffer, ResourceStates stateBits) = 0;
         virtual void setAccelStructState(rt::IAccelStruct* as, ResourceStates stateBits) = 0;
 
+        // Split transitions - begin moving an entire texture or a buffer to stateBits now, the transition ends when the
+        // resource is next used or set to a state, which lets the GPU overlap it with the work recorded in between.
+        // The resource must not be used in between. Call commitBarriers() after.
+        virtual void beginTextureStateTransition(ITexture* texture, ResourceStates stateBits) = 0;
+        virtual void beginBufferStateTransition(IBuffer* buffer, ResourceStates stateBits) = 0;
+
         // Permanent resource state transitions - these make resource usage cheaper by excluding it from state tracking in the future.
         // Like setTexture/BufferState, these methods put barriers into the pending list. Call commitBarriers() after.
         virtual void setPermanentTextureState(ITexture* texture, ResourceStates stateBits) = 0;
@@ -2436,6 +2443,15 @@ namespace device
 
         virtual MeshletPipelineHandle createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb) = 0;
 
+        // Create pipelines from a binary returned by getPipelineBinary for the same desc.
+        // The driver validates the binary, a pipeline whose binary it rejects is compiled as usual.
+        virtual GraphicsPipelineHandle createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize) = 0;
+        virtual ComputePipelineHandle createComputePipeline(const ComputePipelineDesc& desc, const void* binary, size_t binarySize) = 0;
+        virtual MeshletPipelineHandle createMeshletPipeline(const MeshletPipelineDesc& desc, IFramebuffer* fb, const void* binary, size_t binarySize) = 0;
+
+        // Driver binary of a graphics, compute or meshlet pipeline, false when there is none.
+        virtual bool getPipelineBinary(IResource* pipeline, std::vector<uint8_t>& binary) = 0;
+
         virtual rt::PipelineHandle createRayTracingPipeline(const rt::PipelineDesc& desc) = 0;
         
         virtual BindingLayoutHandle createBindingLayout(const BindingLayoutDesc& desc) = 0;
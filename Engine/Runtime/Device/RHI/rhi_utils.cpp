@@ -12,6 +12,7 @@ namespace device {
         case GraphicsAPI::D3D11:  return "D3D11";
         case GraphicsAPI::D3D12:  return "D3D12";
         case GraphicsAPI::VULKAN: return "Vulkan";
+        case GraphicsAPI::NULL_DEVICE: return "Null";
         default:                         return "<UNKNOWN>";
         }
     }
@@ -2,11 +2,80 @@
 
 #include "rhi.h"
 #include "rhi_utils.h"
+#include <algorithm>
+#include <mutex>
 #include <sstream>
 
 namespace redtea {
 namespace device {
 
+    namespace
+    {
+        // reuses the indices of destroyed resources, so the trackers' tables stay as large as
+        // the number of resources alive at once
+        class TrackingIndexAllocator
+        {
+        public:
+            uint32_t allocate()
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+
+                if (m_Free.empty())
+                    return m_Next++;
+
+                const uint32_t index = m_Free.back();
+                m_Free.pop_back();
+                return index;
+            }
+
+            void release(uint32_t index)
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Free.push_back(index);
+            }
+
+        private:
+            std::mutex m_Mutex;
+            std::vector<uint32_t> m_Free;
+            uint32_t m_Next = 0;
+        };
+
+        // never destroyed, resources may outlive the static objects
+        TrackingIndexAllocator& getTextureIndexAllocator()
+        {
+            static TrackingIndexAllocator* allocator = new TrackingIndexAllocator();
+            return *allocator;
+        }
+
+        TrackingIndexAllocator& getBufferIndexAllocator()
+        {
+            static TrackingIndexAllocator* allocator = new TrackingIndexAllocator();
+            return *allocator;
+        }
+    }
+
+    BufferStateExtension::BufferStateExtension(const BufferDesc& desc)
+        : descRef(desc)
+        , trackingIndex(getBufferIndexAllocator().allocate())
+    {
+    }
+
+    BufferStateExtension::~BufferStateExtension()
+    {
+        getBufferIndexAllocator().release(trackingIndex);
+    }
+
+    TextureStateExtension::TextureStateExtension(const TextureDesc& desc)
+        : descRef(desc)
+        , trackingIndex(getTextureIndexAllocator().allocate())
+    {
+    }
+
+    TextureStateExtension::~TextureStateExtension()
+    {
+        getTextureIndexAllocator().release(trackingIndex);
+    }
+
     bool verifyPermanentResourceState(ResourceStates permanentState, ResourceStates requiredState, bool isTexture, const std::string& debugName, IMessageCallback* messageCallback)
     {
         if ((permanentState & requiredState) != requiredState)
@@ -27,6 +96,37 @@ namespace device {
         return mipLevel + arraySlice * desc.mipLevels;
     }
 
+    static bool isNoOpBarrier(const TextureBarrier& barrier)
+    {
+        return barrier.stateBefore == barrier.stateAfter && (barrier.stateAfter & ResourceStates::UnorderedAccess) == 0;
+    }
+
+    static bool isNoOpBarrier(const BufferBarrier& barrier)
+    {
+        return barrier.stateBefore == barrier.stateAfter && (barrier.stateAfter & (ResourceStates::UnorderedAccess | ResourceStates::AccelStructWrite)) == 0;
+    }
+
+    // Folds a barrier into an earlier one of the same resource with nothing recorded in between.
+    // Split halves only fold into each other, the pair becomes a regular barrier.
+    template<typename Barrier>
+    static bool mergeBarriers(Barrier& earlier, const Barrier& later)
+    {
+        if (earlier.split == BarrierSplit::None && later.split == BarrierSplit::None && earlier.stateAfter == later.stateBefore)
+        {
+            earlier.stateAfter = later.stateAfter;
+            return true;
+        }
+
+        if (earlier.split == BarrierSplit::Begin && later.split == BarrierSplit::End
+            && earlier.stateBefore == later.stateBefore && earlier.stateAfter == later.stateAfter)
+        {
+            earlier.split = BarrierSplit::None;
+            return true;
+        }
+
+        return false;
+    }
+
     void CommandListResourceStateTracker::setEnableUavBarriersForTexture(TextureStateExtension* texture, bool enableBarriers)
     {
         TextureState* tracking = getTextureStateTracking(texture, true);
@@ -113,6 +213,83 @@ namespace device {
         }
     }
 
+    void CommandListResourceStateTracker::beginTextureStateTransition(TextureStateExtension* texture, ResourceStates stateBits)
+    {
+        if (texture->permanentState != 0)
+            return;
+
+        TextureState* tracking = getTextureStateTracking(texture, true);
+
+        // Only textures in one known state are split, the others transition when the state is required
+        if (!tracking->subresourceStates.empty() ||
+            tracking->state == ResourceStates::Unknown ||
+            tracking->state == stateBits ||
+            tracking->pendingState != ResourceStates::Unknown)
+            return;
+
+        TextureBarrier barrier;
+        barrier.texture = texture;
+        barrier.entireTexture = true;
+        barrier.split = BarrierSplit::Begin;
+        barrier.stateBefore = tracking->state;
+        barrier.stateAfter = stateBits;
+        m_TextureBarriers.push_back(barrier);
+
+        tracking->pendingState = stateBits;
+    }
+
+    void CommandListResourceStateTracker::beginBufferStateTransition(BufferStateExtension* buffer, ResourceStates stateBits)
+    {
+        if (buffer->descRef.isVolatile || buffer->permanentState != 0 || buffer->descRef.cpuAccess != CpuAccessMode::None)
+            return;
+
+        BufferState* tracking = getBufferStateTracking(buffer, true);
+
+        if (tracking->state == ResourceStates::Unknown ||
+            tracking->state == stateBits ||
+            tracking->pendingState != ResourceStates::Unknown)
+            return;
+
+        BufferBarrier barrier;
+        barrier.buffer = buffer;
+        barrier.split = BarrierSplit::Begin;
+        barrier.stateBefore = tracking->state;
+        barrier.stateAfter = stateBits;
+        m_BufferBarriers.push_back(barrier);
+
+        tracking->pendingState = stateBits;
+        // later transitions must not be combined with the barriers placed before the split
+        tracking->barrierBatch = ~0u;
+    }
+
+    void CommandListResourceStateTracker::endSplitTransition(TextureState* tracking)
+    {
+        TextureBarrier barrier;
+        barrier.texture = tracking->texture;
+        barrier.entireTexture = true;
+        barrier.split = BarrierSplit::End;
+        barrier.stateBefore = tracking->state;
+        barrier.stateAfter = tracking->pendingState;
+        m_TextureBarriers.push_back(barrier);
+
+        tracking->state = tracking->pendingState;
+        tracking->pendingState = ResourceStates::Unknown;
+    }
+
+    void CommandListResourceStateTracker::endSplitTransition(BufferState* tracking)
+    {
+        BufferBarrier barrier;
+        barrier.buffer = tracking->buffer;
+        barrier.split = BarrierSplit::End;
+        barrier.stateBefore = tracking->state;
+        barrier.stateAfter = tracking->pendingState;
+        m_BufferBarriers.push_back(barrier);
+
+        tracking->state = tracking->pendingState;
+        tracking->pendingState = ResourceStates::Unknown;
+        tracking->barrierBatch = ~0u;
+    }
+
     ResourceStates CommandListResourceStateTracker::getTextureSubresourceState(TextureStateExtension* texture, ArraySlice arraySlice, MipLevel mipLevel)
     {
         TextureState* tracking = getTextureStateTracking(texture, false);
@@ -120,6 +297,9 @@ namespace device {
         if (!tracking)
             return ResourceStates::Unknown;
 
+        if (tracking->subresourceStates.empty())
+            return tracking->state;
+
         uint32_t subresource = calcSubresource(mipLevel, arraySlice, texture->descRef);
         return tracking->subresourceStates[subresource];
     }
@@ -145,6 +325,15 @@ namespace device {
         subresources = subresources.resolve(texture->descRef, false);
 
         TextureState* tracking = getTextureStateTracking(texture, true);
+
+        if (tracking->pendingState != ResourceStates::Unknown)
+        {
+            // The texture is used, its split transition ends here and may be all that's needed
+            const bool transitionEnded = tracking->pendingState == state && subresources.isEntireTexture(texture->descRef);
+            endSplitTransition(tracking);
+            if (transitionEnded)
+                return;
+        }
         
         if (subresources.isEntireTexture(texture->descRef) && tracking->subresourceStates.empty())
         {
@@ -238,6 +427,13 @@ namespace device {
                     }
                 }
             }
+
+            if (subresources.isEntireTexture(texture->descRef))
+            {
+                // Every subresource is in the same state again, go back to tracking the entire texture
+                tracking->subresourceStates.clear();
+                tracking->state = state;
+            }
         }
     }
 
@@ -261,6 +457,15 @@ namespace device {
 
         BufferState* tracking = getBufferStateTracking(buffer, true);
 
+        if (tracking->pendingState != ResourceStates::Unknown)
+        {
+            // The buffer is used, its split transition ends here and may be all that's needed
+            const bool transitionEnded = tracking->pendingState == state;
+            endSplitTransition(tracking);
+            if (transitionEnded)
+                return;
+        }
+
         if (tracking->state == ResourceStates::Unknown)
         {
             std::stringstream ss;
@@ -274,20 +479,14 @@ namespace device {
         bool uavNecessary = ((state & ResourceStates::UnorderedAccess) != 0)
             && (tracking->enableUavBarriers || !tracking->firstUavBarrierPlaced);
 
-        if (transitionNecessary)
+        if (transitionNecessary && tracking->barrierBatch == m_BarrierBatch)
         {
-            // See if this buffer is already used for a different purpose in this batch.
-            // If it is, combine the state bits.
+            // The buffer is already used for a different purpose in this batch, combine the state bits.
             // Example: same buffer used as index and vertex buffer, or as SRV and indirect arguments.
-            for (BufferBarrier& barrier : m_BufferBarriers)
-            {
-                if (barrier.buffer == buffer)
-                {
-                    barrier.stateAfter = ResourceStates(barrier.stateAfter | state);
-                    tracking->state = barrier.stateAfter;
-                    return;
-                }
-            }
+            BufferBarrier& barrier = m_BufferBarriers[tracking->barrierIndex];
+            barrier.stateAfter = ResourceStates(barrier.stateAfter | state);
+            tracking->state = barrier.stateAfter;
+            return;
         }
 
         if (transitionNecessary || uavNecessary)
@@ -296,6 +495,8 @@ namespace device {
             barrier.buffer = buffer;
             barrier.stateBefore = tracking->state;
             barrier.stateAfter = state;
+            tracking->barrierIndex = uint32_t(m_BufferBarriers.size());
+            tracking->barrierBatch = m_BarrierBatch;
             m_BufferBarriers.push_back(barrier);
         }
 
@@ -309,12 +510,13 @@ namespace device {
 
     void CommandListResourceStateTracker::keepBufferInitialStates()
     {
-        for (auto& [buffer, tracking] : m_BufferStates)
+        for (uint32_t index = 0; index < m_BufferStateCount; index++)
         {
+            BufferStateExtension* buffer = m_BufferStates[index].buffer;
             if (buffer->descRef.keepInitialState && 
                 !buffer->permanentState &&
                 !buffer->descRef.isVolatile &&
-                !tracking->permanentTransition)
+                !m_BufferStates[index].permanentTransition)
             {
                 requireBufferState(buffer, buffer->descRef.initialState);
             }
@@ -323,17 +525,146 @@ namespace device {
 
     void CommandListResourceStateTracker::keepTextureInitialStates()
     {
-        for (auto& [texture, tracking] : m_TextureStates)
+        for (uint32_t index = 0; index < m_TextureStateCount; index++)
         {
+            TextureStateExtension* texture = m_TextureStates[index].texture;
             if (texture->descRef.keepInitialState && 
                 !texture->permanentState && 
-                !tracking->permanentTransition)
+                !m_TextureStates[index].permanentTransition)
             {
                 requireTextureState(texture, AllSubresources, texture->descRef.initialState);
             }
         }
     }
 
+    void CommandListResourceStateTracker::endSplitTransitions()
+    {
+        for (uint32_t index = 0; index < m_TextureStateCount; index++)
+        {
+            if (m_TextureStates[index].pendingState != ResourceStates::Unknown)
+                endSplitTransition(&m_TextureStates[index]);
+        }
+
+        for (uint32_t index = 0; index < m_BufferStateCount; index++)
+        {
+            if (m_BufferStates[index].pendingState != ResourceStates::Unknown)
+                endSplitTransition(&m_BufferStates[index]);
+        }
+    }
+
+    void CommandListResourceStateTracker::optimizeBarriers()
+    {
+        // A new batch stamp, the barrier positions recorded below index the list being rewritten.
+        // Nothing is recorded between the pending barriers, so the ones of a resource can be folded
+        // into its previous barrier as long as no other barrier of that resource sits in between.
+        m_BarrierBatch++;
+
+        bool anyDropped = false;
+        for (size_t index = 0; index < m_TextureBarriers.size(); index++)
+        {
+            TextureBarrier& barrier = m_TextureBarriers[index];
+            TextureState* tracking = getTextureStateTracking(barrier.texture, false);
+
+            if (tracking->barrierBatch == m_BarrierBatch)
+            {
+                TextureBarrier& earlier = m_TextureBarriers[tracking->barrierIndex];
+                if (earlier.entireTexture == barrier.entireTexture &&
+                    (earlier.entireTexture || (earlier.mipLevel == barrier.mipLevel && earlier.arraySlice == barrier.arraySlice)) &&
+                    mergeBarriers(earlier, barrier))
+                {
+                    barrier.texture = nullptr;
+                    anyDropped = true;
+
+                    if (isNoOpBarrier(earlier))
+                    {
+                        earlier.texture = nullptr;
+                        tracking->barrierBatch = ~0u;
+                    }
+                    continue;
+                }
+            }
+
+            tracking->barrierIndex = uint32_t(index);
+            tracking->barrierBatch = m_BarrierBatch;
+        }
+
+        // Compact the list, per-subresource transitions of every subresource with the same states
+        // are next to each other and become one barrier for the entire texture
+        size_t count = 0;
+        for (size_t index = 0; index < m_TextureBarriers.size(); )
+        {
+            const TextureBarrier barrier = m_TextureBarriers[index];
+            if (!barrier.texture)
+            {
+                index++;
+                continue;
+            }
+
+            size_t runEnd = index + 1;
+            if (!barrier.entireTexture && barrier.split == BarrierSplit::None)
+            {
+                while (runEnd < m_TextureBarriers.size() &&
+                    m_TextureBarriers[runEnd].texture == barrier.texture &&
+                    !m_TextureBarriers[runEnd].entireTexture &&
+                    m_TextureBarriers[runEnd].split == BarrierSplit::None &&
+                    m_TextureBarriers[runEnd].stateBefore == barrier.stateBefore &&
+                    m_TextureBarriers[runEnd].stateAfter == barrier.stateAfter)
+                    runEnd++;
+            }
+
+            const TextureDesc& desc = barrier.texture->descRef;
+            if (runEnd - index == size_t(desc.mipLevels) * desc.arraySize && runEnd - index > 1)
+            {
+                m_TextureBarriers[count] = barrier;
+                m_TextureBarriers[count].entireTexture = true;
+                m_TextureBarriers[count].mipLevel = 0;
+                m_TextureBarriers[count].arraySlice = 0;
+                count++;
+                index = runEnd;
+            }
+            else
+            {
+                if (count != index)
+                    m_TextureBarriers[count] = barrier;
+                count++;
+                index++;
+            }
+        }
+        m_TextureBarriers.resize(count);
+
+        for (size_t index = 0; index < m_BufferBarriers.size(); index++)
+        {
+            BufferBarrier& barrier = m_BufferBarriers[index];
+            BufferState* tracking = getBufferStateTracking(barrier.buffer, false);
+
+            if (tracking->barrierBatch == m_BarrierBatch && mergeBarriers(m_BufferBarriers[tracking->barrierIndex], barrier))
+            {
+                BufferBarrier& earlier = m_BufferBarriers[tracking->barrierIndex];
+                barrier.buffer = nullptr;
+                anyDropped = true;
+
+                if (isNoOpBarrier(earlier))
+                {
+                    earlier.buffer = nullptr;
+                    tracking->barrierBatch = ~0u;
+                }
+                continue;
+            }
+
+            tracking->barrierIndex = uint32_t(index);
+            tracking->barrierBatch = m_BarrierBatch;
+        }
+
+        if (anyDropped)
+        {
+            m_BufferBarriers.erase(std::remove_if(m_BufferBarriers.begin(), m_BufferBarriers.end(),
+                [](const BufferBarrier& barrier) { return barrier.buffer == nullptr; }), m_BufferBarriers.end());
+        }
+
+        // the positions are stale now, requireBufferState must not combine with them
+        m_BarrierBatch++;
+    }
+
     void CommandListResourceStateTracker::commandListSubmitted()
     {
         for (auto [texture, state] : m_PermanentTextureStates)
@@ -366,32 +697,51 @@ namespace device {
         }
         m_PermanentBufferStates.clear();
 
-        for (const auto& [texture, stateTracking] : m_TextureStates)
+        // only what this command list touched is reset, the pools keep their memory
+        for (uint32_t index = 0; index < m_TextureStateCount; index++)
         {
-            if (texture->descRef.keepInitialState && !texture->stateInitialized)
-                texture->stateInitialized = true;
+            TextureState& tracking = m_TextureStates[index];
+            if (tracking.texture->descRef.keepInitialState && !tracking.texture->stateInitialized)
+                tracking.texture->stateInitialized = true;
+
+            m_TextureSlots[tracking.texture->trackingIndex] = 0;
+            tracking.texture = nullptr;
+            tracking.subresourceStates.clear();
         }
+        m_TextureStateCount = 0;
 
-        m_TextureStates.clear();
-        m_BufferStates.clear();
+        for (uint32_t index = 0; index < m_BufferStateCount; index++)
+        {
+            BufferState& tracking = m_BufferStates[index];
+            m_BufferSlots[tracking.buffer->trackingIndex] = 0;
+            tracking.buffer = nullptr;
+        }
+        m_BufferStateCount = 0;
     }
 
     TextureState* CommandListResourceStateTracker::getTextureStateTracking(TextureStateExtension* texture, bool allowCreate)
     {
-        auto it = m_TextureStates.find(texture);
-
-        if (it != m_TextureStates.end())
+        const uint32_t trackingIndex = texture->trackingIndex;
+        if (trackingIndex < m_TextureSlots.size() && m_TextureSlots[trackingIndex] != 0)
         {
-            return it->second.get();
+            return &m_TextureStates[m_TextureSlots[trackingIndex] - 1];
         }
 
         if (!allowCreate)
             return nullptr;
-        
-        std::unique_ptr<TextureState> trackingRef = std::make_unique<TextureState>();
 
-        TextureState* tracking = trackingRef.get();
-        m_TextureStates.insert(std::make_pair(texture, std::move(trackingRef)));
+        if (trackingIndex >= m_TextureSlots.size())
+            m_TextureSlots.resize(std::max(size_t(trackingIndex) + 1, m_TextureSlots.size() * 2), 0);
+
+        if (m_TextureStateCount == m_TextureStates.size())
+            m_TextureStates.emplace_back();
+
+        TextureState* tracking = &m_TextureStates[m_TextureStateCount];
+        std::vector<ResourceStates> subresourceStates = std::move(tracking->subresourceStates);
+        *tracking = TextureState();
+        tracking->subresourceStates = std::move(subresourceStates);
+        tracking->texture = texture;
+        m_TextureSlots[trackingIndex] = ++m_TextureStateCount;
         
         if (texture->descRef.keepInitialState)
         {
@@ -403,20 +753,25 @@ namespace device {
 
     BufferState* CommandListResourceStateTracker::getBufferStateTracking(BufferStateExtension* buffer, bool allowCreate)
     {
-        auto it = m_BufferStates.find(buffer);
-
-        if (it != m_BufferStates.end())
+        const uint32_t trackingIndex = buffer->trackingIndex;
+        if (trackingIndex < m_BufferSlots.size() && m_BufferSlots[trackingIndex] != 0)
         {
-            return it->second.get();
+            return &m_BufferStates[m_BufferSlots[trackingIndex] - 1];
         }
 
         if (!allowCreate)
             return nullptr;
 
-        std::unique_ptr<BufferState> trackingRef = std::make_unique<BufferState>();
+        if (trackingIndex >= m_BufferSlots.size())
+            m_BufferSlots.resize(std::max(size_t(trackingIndex) + 1, m_BufferSlots.size() * 2), 0);
 
-        BufferState* tracking = trackingRef.get();
-        m_BufferStates.insert(std::make_pair(buffer, std::move(trackingRef)));
+        if (m_BufferStateCount == m_BufferStates.size())
+            m_BufferStates.emplace_back();
+
+        BufferState* tracking = &m_BufferStates[m_BufferStateCount];
+        *tracking = BufferState();
+        tracking->buffer = buffer;
+        m_BufferSlots[trackingIndex] = ++m_BufferStateCount;
                                                    
         if (buffer->descRef.keepInitialState)
         {
@@ -426,4 +781,4 @@ namespace device {
         return tracking;
     }
 }
-}
\ No newline at end of file
+}
@@ -2,7 +2,6 @@
 
 #include "rhi.h"
 #include <memory>
-#include <unordered_map>
 
 namespace redtea {
 namespace device {
@@ -11,10 +10,14 @@ namespace device {
     {
         const BufferDesc& descRef;
         ResourceStates permanentState = ResourceStates::Unknown;
+        // small and unique among the live buffers, indexes the tables of the state trackers
+        const uint32_t trackingIndex;
 
-        explicit BufferStateExtension(const BufferDesc& desc)
-            : descRef(desc)
-        { }
+        explicit BufferStateExtension(const BufferDesc& desc);
+        ~BufferStateExtension();
+
+        BufferStateExtension(const BufferStateExtension&) = delete;
+        BufferStateExtension& operator=(const BufferStateExtension&) = delete;
     };
 
     struct TextureStateExtension
@@ -22,16 +25,27 @@ namespace device {
         const TextureDesc& descRef;
         ResourceStates permanentState = ResourceStates::Unknown;
         bool stateInitialized = false;
+        // small and unique among the live textures, indexes the tables of the state trackers
+        const uint32_t trackingIndex;
 
-        explicit TextureStateExtension(const TextureDesc& desc)
-            : descRef(desc)
-        { }
+        explicit TextureStateExtension(const TextureDesc& desc);
+        ~TextureStateExtension();
+
+        TextureStateExtension(const TextureStateExtension&) = delete;
+        TextureStateExtension& operator=(const TextureStateExtension&) = delete;
     };
 
     struct TextureState
     {
+        TextureStateExtension* texture = nullptr;
         std::vector<ResourceStates> subresourceStates;
         ResourceStates state = ResourceStates::Unknown;
+        // the state of a begun split transition, Unknown for none
+        ResourceStates pendingState = ResourceStates::Unknown;
+        // position of the texture's last barrier while optimizeBarriers() runs, valid while
+        // barrierBatch matches the tracker's
+        uint32_t barrierIndex = 0;
+        uint32_t barrierBatch = ~0u;
         bool enableUavBarriers = true;
         bool firstUavBarrierPlaced = false;
         bool permanentTransition = false;
@@ -39,18 +53,34 @@ namespace device {
 
     struct BufferState
     {
+        BufferStateExtension* buffer = nullptr;
         ResourceStates state = ResourceStates::Unknown;
+        // the state of a begun split transition, Unknown for none
+        ResourceStates pendingState = ResourceStates::Unknown;
+        // position of the buffer's transition in the pending barriers, valid while barrierBatch
+        // matches the tracker's
+        uint32_t barrierIndex = 0;
+        uint32_t barrierBatch = ~0u;
         bool enableUavBarriers = true;
         bool firstUavBarrierPlaced = false;
         bool permanentTransition = false;
     };
 
+    // Begin and End are the two halves of a split barrier, recorded with the same states
+    enum class BarrierSplit : uint8_t
+    {
+        None,
+        Begin,
+        End
+    };
+
     struct TextureBarrier
     {
         TextureStateExtension* texture = nullptr;
         MipLevel mipLevel = 0;
         ArraySlice arraySlice = 0;
         bool entireTexture = false;
+        BarrierSplit split = BarrierSplit::None;
         ResourceStates stateBefore = ResourceStates::Unknown;
         ResourceStates stateAfter = ResourceStates::Unknown;
     };
@@ -58,6 +88,7 @@ namespace device {
     struct BufferBarrier
     {
         BufferStateExtension* buffer = nullptr;
+        BarrierSplit split = BarrierSplit::None;
         ResourceStates stateBefore = ResourceStates::Unknown;
         ResourceStates stateAfter = ResourceStates::Unknown;
     };
@@ -80,6 +111,9 @@ namespace device {
         void endTrackingTextureState(TextureStateExtension* texture, TextureSubresourceSet subresources, ResourceStates stateBits, bool permanent);
         void endTrackingBufferState(BufferStateExtension* buffer, ResourceStates stateBits, bool permanent);
 
+        void beginTextureStateTransition(TextureStateExtension* texture, ResourceStates stateBits);
+        void beginBufferStateTransition(BufferStateExtension* buffer, ResourceStates stateBits);
+
         ResourceStates getTextureSubresourceState(TextureStateExtension* texture, ArraySlice arraySlice, MipLevel mipLevel);
         ResourceStates getBufferState(BufferStateExtension* buffer);
 
@@ -90,17 +124,33 @@ namespace device {
 
         void keepBufferInitialStates();
         void keepTextureInitialStates();
+        // ends the split transitions nothing has ended, before the command list is closed
+        void endSplitTransitions();
         void commandListSubmitted();
 
+        // Rewrites the pending barriers before they are committed: transitions of the same
+        // subresource are chained into one, chains back to the state they started from are
+        // dropped and the per-subresource transitions of a whole texture become one barrier.
+        void optimizeBarriers();
+
         [[nodiscard]] const std::vector<TextureBarrier>& getTextureBarriers() const { return m_TextureBarriers; }
         [[nodiscard]] const std::vector<BufferBarrier>& getBufferBarriers() const { return m_BufferBarriers; }
-        void clearBarriers() { m_TextureBarriers.clear(); m_BufferBarriers.clear(); }
+        void clearBarriers() { m_TextureBarriers.clear(); m_BufferBarriers.clear(); m_BarrierBatch++; }
 
     private:
         IMessageCallback* m_MessageCallback;
 
-        std::unordered_map<TextureStateExtension*, std::unique_ptr<TextureState>> m_TextureStates;
-        std::unordered_map<BufferStateExtension*, std::unique_ptr<BufferState>> m_BufferStates;
+        // by tracking index, 1 + the position of the resource's state in the pool or 0 when the
+        // command list hasn't touched it
+        std::vector<uint32_t> m_TextureSlots;
+        std::vector<uint32_t> m_BufferSlots;
+
+        // the states of the touched resources come first, the rest keeps its memory for reuse
+        std::vector<TextureState> m_TextureStates;
+        std::vector<BufferState> m_BufferStates;
+        uint32_t m_TextureStateCount = 0;
+        uint32_t m_BufferStateCount = 0;
+        uint32_t m_BarrierBatch = 0;
 
         // Deferred transitions of textures and buffers to permanent states.
         // They are executed only when the command list is executed, not when the app calls endTrackingTextureState.
@@ -112,6 +162,8 @@ namespace device {
 
         TextureState* getTextureStateTracking(TextureStateExtension* texture, bool allowCreate);
         BufferState* getBufferStateTracking(BufferStateExtension* buffer, bool allowCreate);
+        void endSplitTransition(TextureState* tracking);
+        void endSplitTransition(BufferState* tracking);
     };
 
     bool verifyPermanentResourceState(ResourceStates permanentState, ResourceStates requiredState, bool isTexture, const std::string& debugName, IMessageCallback* messageCallback);
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "utils/memory.h"
+#include "utils/arena.h"
 #include "utils/struct_of_arrays.h"
 #include "utils/lockfree_queue.h"
 #include <string>
@@ -84,4 +85,51 @@ TEST(LOCKFREEQUEUE_TEST, for_each)
 	std::cout << result << std::endl;
 	queue.pop(result);
 	std::cout << result << std::endl; 
-}
\ No newline at end of file
+}
+
+TEST(ARENA_TEST, alloc_free)
+{
+	using namespace redtea::common;
+	Arena arena(4096);
+	EXPECT_EQ(arena.getReservedSize(), 0);
+
+	// a freed allocation serves the next one of its size
+	void* a = arena.alloc(100);
+	void* b = arena.alloc(100);
+	EXPECT_NE(a, b);
+	EXPECT_EQ(uintptr_t(a) % alignof(std::max_align_t), 0);
+	arena.free(a);
+	EXPECT_EQ(arena.alloc(90), a);
+	EXPECT_EQ(arena.getBlockCount(), 1);
+
+	// large ones get a block of their own
+	void* large = arena.alloc(10000);
+	EXPECT_EQ(arena.getBlockCount(), 2);
+	arena.free(large);
+	EXPECT_EQ(arena.alloc(9000), large);
+
+	// arrays move in and out of an arena with their elements
+	using Soa = StructureOfArraysBase<ArenaAllocator, int, float>;
+	Soa soa;
+	for (int n = 0; n < 100; n++)
+	{
+		soa.push_back(n, float(n) * 0.5f);
+	}
+	soa.setAllocator(ArenaAllocator(&arena));
+	EXPECT_EQ(soa.getAllocator().getArena(), &arena);
+	for (int n = 100; n < 300; n++)
+	{
+		soa.push_back(n, float(n) * 0.5f);
+	}
+	soa.setAllocator(ArenaAllocator());
+	ASSERT_EQ(soa.size(), 300);
+	for (int n = 0; n < 300; n++)
+	{
+		EXPECT_EQ(soa.elementAt<0>(n), n);
+		EXPECT_EQ(soa.elementAt<1>(n), float(n) * 0.5f);
+	}
+
+	arena.release();
+	EXPECT_EQ(arena.getReservedSize(), 0);
+	EXPECT_EQ(arena.getBlockCount(), 0);
+}
@@ -1,7 +1,28 @@
 #include "../Engine/Core/world.h"
 #include "../Engine/Core/component_manager.h"
 #include "../Engine/Core/entity.h"
+#include "../Engine/Core/transform_manager.h"
+#include "../Engine/Core/entity_command_buffer.h"
+#include "../Engine/Core/entity_events.h"
+#include "../Engine/Core/system_scheduler.h"
+#include "../Engine/Core/snapshot.h"
+#include "../Engine/Core/prefab.h"
+#include "../Engine/Core/render_proxy.h"
+#include "../Engine/Core/spatial_index.h"
+#include "../Engine/Core/broadphase.h"
+#include "utils/thread_pool.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 TEST(CORE_TEST, world)
 {
@@ -62,3 +83,2351 @@ TEST(CORE_TEST, component_manager)
 	manager.RemoveComponent(e);
 	EXPECT_EQ(manager.HasComponent(e), false);
 }
+
+TEST(CORE_TEST, change_version)
+{
+	using namespace redtea::core;
+	class HealthManager : public ComponentManagerBase<float, int>
+	{
+	public:
+		enum
+		{
+			Health,
+			Team
+		};
+
+		PROXY_DEFINE(HealthManager)
+			DEFINE_FEILD(Health, health)
+			DEFINE_FEILD(Team, team)
+		PROXY_END()
+	};
+
+	World world;
+	HealthManager manager;
+	std::vector<Entity> entities(200);
+	world.GetEntityManager()->InitEntity(int(entities.size()), entities.data());
+	for (auto e : entities)
+	{
+		manager.AddComponent(e);
+	}
+
+	auto collect = [&](uint32_t since) {
+		std::vector<ComponentInstance::Type> rows;
+		manager.ForEachChanged(since, [&](ComponentInstance::Type i) { rows.push_back(i); });
+		return rows;
+	};
+
+	// new rows count as changed
+	uint32_t seen = 0;
+	EXPECT_EQ(collect(seen).size(), entities.size());
+	seen = manager.NewVersion();
+	EXPECT_TRUE(collect(seen).empty());
+
+	// reads through a const proxy leave the version alone
+	HealthManager const& reader = manager;
+	float health = reader[5].health;
+	EXPECT_EQ(health, 0.0f);
+	EXPECT_TRUE(collect(seen).empty());
+
+	manager[5].health = 10.0f;
+	manager[150].team = 2;
+	manager.MarkChanged(70);
+	EXPECT_EQ(collect(seen), (std::vector<ComponentInstance::Type>{ 5, 70, 150 }));
+	EXPECT_GT(manager.GetChangeVersion(5), seen);
+
+	// the row moved into the hole counts as changed
+	uint32_t since = seen;
+	seen = manager.NewVersion();
+	manager.RemoveComponent(entities[9]);
+	EXPECT_EQ(collect(seen), (std::vector<ComponentInstance::Type>{ 10 }));
+	EXPECT_EQ(collect(since).size(), 4);
+
+	// transform propagation marks every rewritten world matrix
+	TransformManager tm;
+	auto root = tm.AddComponent(entities[0]);
+	tm.AddComponent(entities[1], root);
+	tm.AddComponent(entities[2]);
+	tm.Update();
+	seen = tm.NewVersion();
+	tm.SetPosition(tm.GetInstance(entities[0]), { 1, 0, 0 });
+	tm.Update();
+	std::vector<Entity> changed;
+	tm.ForEachChanged(seen, [&](ComponentInstance::Type i) { changed.push_back(tm.GetEntity(i)); });
+	EXPECT_EQ(changed.size(), 2);
+	EXPECT_TRUE(std::find(changed.begin(), changed.end(), entities[1]) != changed.end());
+}
+
+namespace {
+	using redtea::core::TransformManager;
+
+	// parents precede children, every level range holds exactly the rows of that depth and
+	// the parent, child and sibling links agree with each other
+	void CheckLevelOrder(TransformManager const& tm)
+	{
+		std::vector<redtea::core::SnapshotColumn> layout;
+		tm.GetSnapshotLayout(layout);
+		std::vector<std::vector<uint8_t>> columns(layout.size());
+		std::vector<void const*> pointers;
+		for (size_t c = 0; c < layout.size(); c++)
+		{
+			columns[c].resize(tm.GetComponentCount() * layout[c].elementSize);
+			tm.SaveColumn(c, nullptr, tm.GetComponentCount(), columns[c].data());
+			pointers.push_back(columns[c].data());
+		}
+		EXPECT_TRUE(tm.CheckRows(tm.GetComponentCount(), pointers.data()));
+
+		for (size_t level = 0; level < tm.GetLevelCount(); level++)
+		{
+			auto range = tm.GetLevelRange(level);
+			EXPECT_LT(range.first, range.second);
+			for (auto i = range.first; i < range.second; i++)
+			{
+				EXPECT_EQ(tm.GetDepth(i), level);
+				auto parent = tm.GetParent(i);
+				EXPECT_EQ(parent == 0, level == 0);
+				EXPECT_LT(parent, i);
+				if (parent)
+				{
+					EXPECT_EQ(tm.GetDepth(parent) + 1, level);
+				}
+			}
+		}
+		size_t count = tm.GetLevelCount() ? tm.GetLevelRange(tm.GetLevelCount() - 1).second - 1 : 0;
+		EXPECT_EQ(count, tm.GetComponentCount());
+	}
+}
+
+TEST(CORE_TEST, transform_manager)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	World world;
+	auto section = world.CreateSection();
+	TransformManager tm;
+
+	auto a = section->CreateEntity();
+	auto b = section->CreateEntity();
+	auto c = section->CreateEntity();
+	auto d = section->CreateEntity();
+	tm.AddComponent(a);
+	tm.AddComponent(b, tm.GetInstance(a));
+	tm.AddComponent(c, tm.GetInstance(b));
+	tm.AddComponent(d);
+	CheckLevelOrder(tm);
+	EXPECT_EQ(tm.GetLevelCount(), 3);
+
+	tm.SetLocalTransform(tm.GetInstance(a), { 1, 0, 0 }, math::Quaternion<float>(1.0f), math::Vector3f(2.0f));
+	tm.SetPosition(tm.GetInstance(b), { 0, 2, 0 });
+	tm.SetPosition(tm.GetInstance(c), { 0, 0, 3 });
+	tm.SetPosition(tm.GetInstance(d), { 10, 0, 0 });
+	EXPECT_EQ(tm.Update(), 4);
+	EXPECT_EQ(tm.Update(), 0);
+	auto worldPosition = [&](Entity e) { return tm.GetWorldTransform(tm.GetInstance(e)).data[3].xyz; };
+	EXPECT_EQ(worldPosition(c), math::Vector3f(1, 4, 6));
+
+	// 90 degrees around z on the root turns +y into -x
+	tm.SetRotation(tm.GetInstance(a), { std::sqrt(0.5f), 0.0f, 0.0f, std::sqrt(0.5f) });
+	EXPECT_EQ(tm.Update(), 3);
+	EXPECT_NEAR(worldPosition(c).x, -3.0f, 1e-5f);
+	EXPECT_NEAR(worldPosition(c).y, 0.0f, 1e-5f);
+	EXPECT_NEAR(worldPosition(c).z, 6.0f, 1e-5f);
+	tm.SetRotation(tm.GetInstance(a), math::Quaternion<float>(1.0f));
+
+	// a moves under d, the whole subtree goes one level deeper
+	tm.SetParent(tm.GetInstance(a), tm.GetInstance(d));
+	CheckLevelOrder(tm);
+	EXPECT_EQ(tm.GetLevelCount(), 4);
+	EXPECT_EQ(tm.Update(), 3);
+	EXPECT_EQ(worldPosition(c), math::Vector3f(11, 4, 6));
+
+	tm.SetParent(tm.GetInstance(c), 0);
+	CheckLevelOrder(tm);
+	tm.Update();
+	EXPECT_EQ(worldPosition(c), math::Vector3f(0, 0, 3));
+
+	// removing a orphans b, which keeps its local transform
+	tm.RemoveComponent(a);
+	CheckLevelOrder(tm);
+	EXPECT_FALSE(tm.HasComponent(a));
+	EXPECT_EQ(tm.GetParent(tm.GetInstance(b)), 0);
+	EXPECT_EQ(tm.GetComponentCount(), 3);
+	tm.Update();
+	EXPECT_EQ(worldPosition(b), math::Vector3f(0, 2, 0));
+
+	// random reparenting against a reference walk up the parents
+	std::mt19937 rng(3);
+	std::vector<Entity> entities(2000);
+	world.GetEntityManager()->InitEntity(int(entities.size()), entities.data());
+	for (size_t n = 0; n < entities.size(); n++)
+	{
+		TransformManager::Instance parent = n && rng() % 4 ? tm.GetInstance(entities[rng() % n]) : 0;
+		auto i = tm.AddComponent(entities[n], parent);
+		tm.SetLocalTransform(i, { float(rng() % 7), float(rng() % 5), 1.0f }, math::Quaternion<float>(1.0f), math::Vector3f(float(1 + rng() % 2)));
+	}
+	common::ThreadPool pool(3);
+	for (int round = 0; round < 4; round++)
+	{
+		for (int op = 0; op < 300; op++)
+		{
+			auto i = tm.GetInstance(entities[rng() % entities.size()]);
+			auto parent = rng() % 5 ? tm.GetInstance(entities[rng() % entities.size()]) : 0;
+			bool cycle = false;
+			for (auto p = parent; p; p = tm.GetParent(p))
+			{
+				cycle |= p == i;
+			}
+			// i is 0 once its entity lost the component
+			if (i && !cycle)
+			{
+				tm.SetParent(i, parent);
+			}
+		}
+		tm.RemoveComponent(entities[rng() % entities.size()]);
+		CheckLevelOrder(tm);
+		tm.Update(&pool);
+		for (size_t n = 0; n < entities.size(); n++)
+		{
+			auto i = tm.GetInstance(entities[n]);
+			if (!i)
+			{
+				continue;
+			}
+			math::Vector3f expected = tm.GetPosition(i);
+			for (auto p = tm.GetParent(i); p; p = tm.GetParent(p))
+			{
+				expected = tm.GetPosition(p) + tm.GetScale(p).x * expected;
+			}
+			EXPECT_EQ(tm.GetWorldTransform(i).data[3].xyz, expected);
+		}
+	}
+}
+
+TEST(CORE_TEST, DISABLED_bench_transform_manager)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	const size_t count = 1000000;
+	const size_t roots = 1000;
+	World world;
+	std::vector<Entity> entities(count);
+	world.GetEntityManager()->InitEntity(int(count), entities.data());
+
+	// forest of 1000 trees with three children per node, added in level order
+	TransformManager tm;
+	std::vector<TransformManager::Instance> instances(count);
+	for (size_t n = 0; n < count; n++)
+	{
+		instances[n] = tm.AddComponent(entities[n], n < roots ? 0 : instances[(n - roots) / 3]);
+	}
+	tm.Update();
+	std::cout << count << " nodes, " << tm.GetLevelCount() << " levels" << std::endl;
+
+	std::mt19937 rng(1);
+	common::ThreadPool pool;
+	auto bench = [&](const char* name, common::ThreadPool* p) {
+		const int frames = 10;
+		double total = 0;
+		size_t updated = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (size_t k = 0; k < count / 10; k++)
+			{
+				auto i = tm.GetInstance(entities[rng() % count]);
+				tm.SetPosition(i, { float(frame), 1.0f, 2.0f });
+			}
+			auto start = std::chrono::high_resolution_clock::now();
+			updated += tm.Update(p);
+			std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+			total += time.count();
+		}
+		std::cout << name << ": " << total / frames << " ms/frame, " << updated / frames << " nodes rewritten" << std::endl;
+	};
+	bench("10% dirty, 1 thread", nullptr);
+	bench("10% dirty, pool", &pool);
+}
+
+TEST(CORE_TEST, entity_command_buffer)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class ValueManager : public ComponentManagerBase<int>
+	{
+	};
+
+	EntityManager em;
+	ValueManager a;
+	ValueManager b;
+	TransformManager tm;
+	em.RegisterComponentManager(&a);
+	em.RegisterComponentManager(&b);
+	em.RegisterComponentManager(&tm);
+
+	const size_t count = 2000;
+	std::vector<Entity> entities(count);
+	em.InitEntity(int(count), entities.data());
+
+	// every entity is recorded by exactly one chunk, so its commands keep their order
+	EntityCommandBuffer ecb(&em);
+	common::ThreadPool pool(3);
+	pool.parallelFor(0, count, 64, [&](size_t first, size_t last)
+	{
+		for (size_t n = first; n < last; n++)
+		{
+			ecb.AddComponent(&a, entities[n]);
+			if (n % 2 == 0)
+			{
+				ecb.AddComponent(&b, entities[n]);
+			}
+			if (n % 4 == 0)
+			{
+				ecb.RemoveComponent(&b, entities[n]);
+			}
+			if (n % 3 == 0)
+			{
+				ecb.AddComponent(&tm, entities[n]);
+			}
+			if (n % 10 == 0)
+			{
+				ecb.DestroyEntity(entities[n]);
+			}
+		}
+	});
+	EXPECT_EQ(a.GetComponentCount(), 0);
+	EXPECT_GT(ecb.GetCommandCount(), count);
+	ecb.Playback();
+	EXPECT_EQ(ecb.GetCommandCount(), 0);
+
+	auto check = [&](auto const& manager)
+	{
+		for (size_t i = 1; i <= manager.GetComponentCount(); i++)
+		{
+			EXPECT_EQ(manager.GetInstance(manager.GetEntity(i)), i);
+		}
+	};
+	for (size_t n = 0; n < count; n++)
+	{
+		const bool alive = n % 10 != 0;
+		EXPECT_EQ(a.HasComponent(entities[n]), alive);
+		EXPECT_EQ(b.HasComponent(entities[n]), alive && n % 2 == 0 && n % 4 != 0);
+		EXPECT_EQ(tm.HasComponent(entities[n]), alive && n % 3 == 0);
+	}
+	EXPECT_EQ(em.mFreeList.size(), count / 10);
+	check(a);
+	check(b);
+	CheckLevelOrder(tm);
+
+	// a second frame reuses the segments, removals go through one compaction per manager
+	for (size_t n = 0; n < count; n += 7)
+	{
+		ecb.RemoveComponent(&a, entities[n]);
+	}
+	ecb.RemoveComponent(&a, entities[1]);
+	ecb.AddComponent(&a, entities[1]);
+	ecb.Playback();
+	for (size_t n = 0; n < count; n++)
+	{
+		EXPECT_EQ(a.HasComponent(entities[n]), n % 10 != 0 && (n % 7 != 0 || n == 1));
+	}
+	check(a);
+
+	// managers leave the registry when they go away
+	{
+		ValueManager c;
+		em.RegisterComponentManager(&c);
+		EXPECT_EQ(em.GetComponentManagers().size(), 4);
+	}
+	EXPECT_EQ(em.GetComponentManagers().size(), 3);
+	em.DestroyEntity(entities[1]);
+	EXPECT_FALSE(a.HasComponent(entities[1]));
+}
+
+TEST(CORE_TEST, system_scheduler)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class ValueManager : public ComponentManagerBase<int>
+	{
+	};
+	ValueManager m1, m2, m3;
+
+	std::mutex lock;
+	std::vector<SystemScheduler::SystemId> order;
+	SystemScheduler scheduler;
+	auto add = [&](const char* name, std::vector<IComponentManager const*> reads,
+		std::vector<IComponentManager const*> writes, int sleep)
+	{
+		auto id = SystemScheduler::SystemId(scheduler.GetSystemCount());
+		return scheduler.AddSystem(name, std::move(reads), std::move(writes), [&, id, sleep](common::ThreadPool*)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
+			std::lock_guard<std::mutex> guard(lock);
+			order.push_back(id);
+		});
+	};
+	auto a = add("a", {}, { &m1 }, 1);
+	auto b = add("b", { &m1 }, { &m2 }, 20);
+	auto c = add("c", { &m1 }, {}, 1);
+	auto d = add("d", {}, { &m3 }, 1);
+	auto e = add("e", { &m2, &m3 }, {}, 5);
+	auto f = add("f", {}, { &m1 }, 1);
+
+	common::ThreadPool pool(3);
+	for (int frame = 0; frame < 2; frame++)
+	{
+		order.clear();
+		scheduler.Run(&pool);
+		ASSERT_EQ(order.size(), 6);
+		auto position = [&](SystemScheduler::SystemId id)
+		{
+			return std::find(order.begin(), order.end(), id) - order.begin();
+		};
+		for (SystemScheduler::SystemId id = 0; id < scheduler.GetSystemCount(); id++)
+		{
+			for (auto dep : scheduler.GetDependencies(id))
+			{
+				EXPECT_LT(position(dep), position(id));
+			}
+		}
+	}
+
+	using Ids = std::vector<SystemScheduler::SystemId>;
+	EXPECT_EQ(scheduler.GetDependencies(a), Ids());
+	EXPECT_EQ(scheduler.GetDependencies(b), Ids({ a }));
+	EXPECT_EQ(scheduler.GetDependencies(c), Ids({ a }));
+	EXPECT_EQ(scheduler.GetDependencies(d), Ids());
+	EXPECT_EQ(scheduler.GetDependencies(e), Ids({ b, d }));
+	// writer after readers waits for all of them
+	EXPECT_EQ(scheduler.GetDependencies(f), Ids({ a, b, c }));
+
+	EXPECT_EQ(scheduler.GetCriticalPath(), Ids({ a, b, e }));
+	EXPECT_GE(scheduler.GetTiming(b).duration, 20.0);
+	EXPECT_GE(scheduler.GetTiming(b).start, scheduler.GetTiming(a).start + scheduler.GetTiming(a).duration);
+	EXPECT_GE(scheduler.GetCriticalPathTime(), 20.0);
+	EXPECT_GE(scheduler.GetFrameTime(), scheduler.GetCriticalPathTime() - 1.0);
+
+	// disabled systems drop out of the graph and never run
+	scheduler.SetEnabled(b, false);
+	order.clear();
+	scheduler.Run(nullptr);
+	EXPECT_EQ(order.size(), 5);
+	EXPECT_TRUE(std::find(order.begin(), order.end(), b) == order.end());
+	EXPECT_EQ(scheduler.GetDependencies(e), Ids({ d }));
+	EXPECT_EQ(scheduler.GetDependencies(f), Ids({ a, c }));
+
+	// a system going wide gets the workers the other systems are done with, none of them
+	// waits in the scheduler for the frame to end
+	SystemScheduler wide;
+	for (int n = 0; n < 3; n++)
+	{
+		wide.AddSystem("busy", {}, {}, [](common::ThreadPool*)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		});
+	}
+	std::vector<std::thread::id> threads;
+	wide.AddSystem("wide", {}, {}, [&](common::ThreadPool* p)
+	{
+		p->parallelFor(0, 64, 1, [&](size_t, size_t)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			std::lock_guard<std::mutex> guard(lock);
+			if (std::find(threads.begin(), threads.end(), std::this_thread::get_id()) == threads.end())
+			{
+				threads.push_back(std::this_thread::get_id());
+			}
+		});
+	});
+	wide.Run(&pool);
+	EXPECT_GT(threads.size(), 1);
+}
+
+TEST(CORE_TEST, bulk_remove)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class ValueManager : public ComponentManagerBase<int>
+	{
+	public:
+		int& Value(Instance i) { return GetElement<0>(i); }
+	};
+
+	World world;
+	EntityManager* em = world.GetEntityManager();
+	std::vector<Entity> entities(3000);
+	em->InitEntity(int(entities.size()), entities.data());
+
+	// survivors keep their order and the index follows them
+	ValueManager values;
+	EntityMask dying;
+	for (size_t n = 0; n < 1000; n++)
+	{
+		values.Value(values.AddComponent(entities[n])) = int(n);
+		if (n % 3 == 0 || (n > 500 && n < 600))
+		{
+			dying.Set(entities[n]);
+		}
+	}
+	values.RemoveComponents(dying);
+	EXPECT_EQ(values.GetComponentCount(), 1000 - 334 - 66);
+	for (ComponentInstance::Type i = 1; i <= values.GetComponentCount(); i++)
+	{
+		EXPECT_EQ(values.GetInstance(values.GetEntity(i)), i);
+		if (i > 1)
+		{
+			EXPECT_LT(values.Value(i - 1), values.Value(i));
+		}
+	}
+	for (size_t n = 0; n < 1000; n++)
+	{
+		EXPECT_EQ(values.HasComponent(entities[n]), !dying.Test(entities[n]));
+	}
+
+	// children of dying transforms become roots, everything else keeps its parent
+	TransformManager tm;
+	std::mt19937 rng(5);
+	for (size_t n = 0; n < entities.size(); n++)
+	{
+		auto parent = n && rng() % 4 ? tm.GetInstance(entities[rng() % n]) : 0;
+		auto i = tm.AddComponent(entities[n], parent);
+		tm.SetPosition(i, { float(rng() % 7), float(rng() % 5), 1.0f });
+	}
+	tm.Update();
+	std::vector<Entity> parents(entities.size());
+	std::vector<bool> hasParent(entities.size());
+	dying.Clear();
+	for (size_t n = 0; n < entities.size(); n++)
+	{
+		auto parent = tm.GetParent(tm.GetInstance(entities[n]));
+		hasParent[n] = parent != 0;
+		parents[n] = parent ? tm.GetEntity(parent) : entities[n];
+		if (rng() % 5 == 0)
+		{
+			dying.Set(entities[n]);
+		}
+	}
+	tm.RemoveComponents(dying);
+	CheckLevelOrder(tm);
+	size_t linked = 0;
+	size_t children = 0;
+	for (size_t n = 0; n < entities.size(); n++)
+	{
+		auto i = tm.GetInstance(entities[n]);
+		EXPECT_EQ(i != 0, !dying.Test(entities[n]));
+		if (!i)
+		{
+			continue;
+		}
+		auto parent = tm.GetParent(i);
+		EXPECT_EQ(parent != 0, hasParent[n] && !dying.Test(parents[n]));
+		if (parent)
+		{
+			EXPECT_EQ(tm.GetEntity(parent), parents[n]);
+			linked++;
+		}
+		for (auto c = tm.GetFirstChild(i); c; c = tm.GetNextSibling(c))
+		{
+			EXPECT_EQ(tm.GetParent(c), i);
+			children++;
+		}
+	}
+	EXPECT_EQ(linked, children);
+	tm.Update();
+	for (size_t n = 0; n < entities.size(); n++)
+	{
+		auto i = tm.GetInstance(entities[n]);
+		if (i)
+		{
+			math::Vector3f expected = tm.GetPosition(i);
+			for (auto p = tm.GetParent(i); p; p = tm.GetParent(p))
+			{
+				expected = tm.GetPosition(p) + expected;
+			}
+			EXPECT_EQ(tm.GetWorldTransform(i).data[3].xyz, expected);
+		}
+	}
+
+	// destroying a section strips its entities from every registered manager
+	ValueManager a;
+	ValueManager b;
+	em->RegisterComponentManager(&a);
+	em->RegisterComponentManager(&b);
+	auto sa = world.CreateSection();
+	auto sb = world.CreateSection();
+	std::vector<Entity> kept;
+	for (int n = 0; n < 500; n++)
+	{
+		Entity e = (n % 2 ? sa : sb)->CreateEntity();
+		a.AddComponent(e);
+		if (n % 3)
+		{
+			b.AddComponent(e);
+		}
+		if (n % 2 == 0)
+		{
+			kept.push_back(e);
+		}
+	}
+	const size_t freed = em->mFreeList.size();
+	sa->Destroy();
+	EXPECT_EQ(em->mFreeList.size(), freed + 250);
+	EXPECT_EQ(a.GetComponentCount(), 250);
+	for (Entity e : kept)
+	{
+		EXPECT_TRUE(a.HasComponent(e));
+		if (b.HasComponent(e))
+		{
+			EXPECT_EQ(b.GetEntity(b.GetInstance(e)), e);
+		}
+	}
+	EXPECT_EQ(b.GetComponentCount(), 166);
+}
+
+TEST(CORE_TEST, DISABLED_bench_section_teardown)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class BodyManager : public ComponentManagerBase<math::Vector3f, math::Vector3f, math::Quaternion<float>>
+	{
+	};
+	class TagManager : public ComponentManagerBase<uint32_t>
+	{
+	};
+
+	// two sections of 200K entities each, created interleaved so neither owns a contiguous
+	// block of rows, then one of them is unloaded
+	const int count = 200000;
+	auto run = [&](const char* name, bool bulk)
+	{
+		double total = 0.0;
+		const int repeats = 5;
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			World world;
+			BodyManager bodies;
+			TagManager tags;
+			world.GetEntityManager()->RegisterComponentManager(&bodies);
+			world.GetEntityManager()->RegisterComponentManager(&tags);
+			auto keep = world.CreateSection();
+			auto unload = world.CreateSection();
+			std::vector<Entity> dying;
+			for (int n = 0; n < 2 * count; n++)
+			{
+				Entity e = (n % 2 ? unload : keep)->CreateEntity();
+				bodies.AddComponent(e);
+				tags.AddComponent(e);
+				if (n % 2)
+				{
+					dying.push_back(e);
+				}
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			if (bulk)
+			{
+				unload->Destroy();
+			}
+			else
+			{
+				for (Entity e : dying)
+				{
+					bodies.RemoveComponent(e);
+					tags.RemoveComponent(e);
+					world.GetEntityManager()->DestroyEntity(e);
+				}
+			}
+			total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			EXPECT_EQ(bodies.GetComponentCount(), size_t(count));
+			world.GetEntityManager()->UnregisterComponentManager(&bodies);
+			world.GetEntityManager()->UnregisterComponentManager(&tags);
+		}
+		std::cout << name << ": " << total / repeats << " ms" << std::endl;
+	};
+	run("per entity", false);
+	run("bulk", true);
+}
+
+namespace {
+	using redtea::core::Entity;
+
+	// random forest over entities, parents always come earlier in the list
+	void BuildForest(redtea::core::TransformManager& tm, std::vector<Entity> const& entities, std::mt19937& rng)
+	{
+		for (size_t n = 0; n < entities.size(); n++)
+		{
+			auto parent = n && rng() % 4 ? tm.GetInstance(entities[rng() % n]) : 0;
+			auto i = tm.AddComponent(entities[n], parent);
+			tm.SetPosition(i, { float(rng() % 7), float(rng() % 5), 1.0f });
+		}
+	}
+}
+
+TEST(CORE_TEST, section_streaming)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class ValueManager : public ComponentManagerBase<uint32_t>
+	{
+	public:
+		uint32_t& Value(Instance i) { return GetElement<0>(i); }
+	};
+
+	World live;
+	ValueManager values;
+	TransformManager tm;
+	live.GetEntityManager()->RegisterComponentManager(&values);
+	live.GetEntityManager()->RegisterComponentManager(&tm);
+
+	// sections are built off thread while the owning thread keeps creating entities
+	World staging(&live);
+	ValueManager stagedValues;
+	TransformManager stagedTm;
+	staging.GetEntityManager()->RegisterComponentManager(&stagedValues);
+	staging.GetEntityManager()->RegisterComponentManager(&stagedTm);
+	std::vector<Entity> staged;
+	std::vector<Section*> stagedSections;
+	std::thread worker([&]()
+	{
+		std::mt19937 rng(11);
+		for (int s = 0; s < 2; s++)
+		{
+			Section* section = staging.CreateSection();
+			stagedSections.push_back(section);
+			for (int n = 0; n < 500; n++)
+			{
+				staged.push_back(section->CreateEntity());
+			}
+		}
+		BuildForest(stagedTm, staged, rng);
+		for (Entity e : staged)
+		{
+			stagedValues.Value(stagedValues.AddComponent(e)) = e.GetId();
+		}
+		stagedTm.Update();
+	});
+
+	std::mt19937 rng(7);
+	Section* own = live.CreateSection();
+	std::vector<Entity> entities;
+	for (int n = 0; n < 800; n++)
+	{
+		entities.push_back(own->CreateEntity());
+	}
+	BuildForest(tm, entities, rng);
+	for (Entity e : entities)
+	{
+		values.Value(values.AddComponent(e)) = e.GetId();
+	}
+	tm.Update();
+	worker.join();
+
+	auto parentOf = [](TransformManager const& m, Entity e)
+	{
+		auto p = m.GetParent(m.GetInstance(e));
+		return p ? m.GetEntity(p) : e;
+	};
+	std::vector<Entity> parents;
+	for (Entity e : entities)
+	{
+		parents.push_back(parentOf(tm, e));
+	}
+	for (Entity e : staged)
+	{
+		parents.push_back(parentOf(stagedTm, e));
+	}
+
+	// the rows already there are left alone, only the new ones count as changed
+	const uint32_t since = values.NewVersion();
+	common::ThreadPool pool(2);
+	live.Merge(staging, &pool);
+	size_t changed = 0;
+	values.ForEachChanged(since, [&changed](auto) { changed++; });
+	EXPECT_EQ(changed, staged.size());
+	EXPECT_EQ(stagedTm.GetComponentCount(), 0);
+	EXPECT_EQ(stagedValues.GetComponentCount(), 0);
+	EXPECT_EQ(live.GetSectionById(1), stagedSections[0]);
+	EXPECT_EQ(live.GetSectionById(2), stagedSections[1]);
+	EXPECT_EQ(live.GetSectionById(3), nullptr);
+
+	entities.insert(entities.end(), staged.begin(), staged.end());
+	std::vector<Entity::Type> ids;
+	for (Entity e : entities)
+	{
+		ids.push_back(e.GetId());
+	}
+	std::sort(ids.begin(), ids.end());
+	EXPECT_TRUE(std::unique(ids.begin(), ids.end()) == ids.end());
+
+	CheckLevelOrder(tm);
+	EXPECT_EQ(tm.GetComponentCount(), entities.size());
+	tm.Update();
+	for (size_t n = 0; n < entities.size(); n++)
+	{
+		auto i = tm.GetInstance(entities[n]);
+		ASSERT_NE(i, 0);
+		EXPECT_EQ(parentOf(tm, entities[n]), parents[n]);
+		EXPECT_EQ(values.Value(values.GetInstance(entities[n])), entities[n].GetId());
+		for (auto c = tm.GetFirstChild(i); c; c = tm.GetNextSibling(c))
+		{
+			EXPECT_EQ(tm.GetParent(c), i);
+		}
+		math::Vector3f expected = tm.GetPosition(i);
+		for (auto p = tm.GetParent(i); p; p = tm.GetParent(p))
+		{
+			expected = tm.GetPosition(p) + expected;
+		}
+		EXPECT_EQ(tm.GetWorldTransform(i).data[3].xyz, expected);
+	}
+
+	// a small section only moves the first rows of each level out of its way
+	{
+		World small(&live);
+		ValueManager smallValues;
+		TransformManager smallTm;
+		small.GetEntityManager()->RegisterComponentManager(&smallValues);
+		small.GetEntityManager()->RegisterComponentManager(&smallTm);
+		Section* section = small.CreateSection();
+		Entity root = section->CreateEntity();
+		auto parent = smallTm.AddComponent(root);
+		for (int n = 0; n < 5; n++)
+		{
+			parent = smallTm.AddComponent(section->CreateEntity(), parent);
+		}
+		live.Merge(small);
+		CheckLevelOrder(tm);
+		EXPECT_EQ(tm.GetComponentCount(), entities.size() + 6);
+		EXPECT_EQ(tm.GetDepth(tm.GetInstance(root)), 0);
+	}
+
+	// merged sections belong to the live world from now on
+	live.GetSectionById(1)->Destroy();
+	EXPECT_EQ(values.GetComponentCount(), 1300);
+	EXPECT_EQ(tm.GetComponentCount(), 1306);
+	CheckLevelOrder(tm);
+}
+
+TEST(CORE_TEST, DISABLED_bench_section_streaming)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class ValueManager : public ComponentManagerBase<math::Vector3f, uint32_t>
+	{
+	};
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+
+	// 500K live entities, then a section of 50K streamed in
+	const size_t liveCount = 500000;
+	const size_t sectionCount = 50000;
+	World live;
+	ValueManager values;
+	TransformManager tm;
+	live.GetEntityManager()->RegisterComponentManager(&values);
+	live.GetEntityManager()->RegisterComponentManager(&tm);
+	std::mt19937 rng(1);
+	std::vector<Entity> entities;
+	Section* own = live.CreateSection();
+	for (size_t n = 0; n < liveCount; n++)
+	{
+		entities.push_back(own->CreateEntity());
+		values.AddComponent(entities.back());
+	}
+	BuildForest(tm, entities, rng);
+
+	auto build = [&](World& world, ValueManager& v, TransformManager& t)
+	{
+		std::vector<Entity> section;
+		Section* s = world.CreateSection();
+		for (size_t n = 0; n < sectionCount; n++)
+		{
+			section.push_back(s->CreateEntity());
+			v.AddComponent(section.back());
+		}
+		BuildForest(t, section, rng);
+	};
+
+	World staging(&live);
+	ValueManager stagedValues;
+	TransformManager stagedTm;
+	staging.GetEntityManager()->RegisterComponentManager(&stagedValues);
+	staging.GetEntityManager()->RegisterComponentManager(&stagedTm);
+	auto start = Clock::now();
+	std::thread worker([&]() { build(staging, stagedValues, stagedTm); });
+	worker.join();
+	const double worker_ms = ms(start);
+
+	start = Clock::now();
+	live.Merge(staging);
+	const double merge_ms = ms(start);
+
+	start = Clock::now();
+	build(live, values, tm);
+	const double direct_ms = ms(start);
+
+	std::cout << "build on worker: " << worker_ms << " ms, merge on owner: " << merge_ms
+		<< " ms, build directly on owner: " << direct_ms << " ms" << std::endl;
+}
+
+TEST(CORE_TEST, snapshot)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class BodyManager : public ComponentManagerBase<math::Vector3f, uint32_t>
+	{
+	public:
+		math::Vector3f& Velocity(Instance i) { return GetElement<0>(i); }
+		uint32_t& Tag(Instance i) { return GetElement<1>(i); }
+	};
+	const std::string worldPath = ::testing::TempDir() + "redtea_world.snapshot";
+	const std::string sectionPath = ::testing::TempDir() + "redtea_section.snapshot";
+
+	World world;
+	BodyManager bodies;
+	TransformManager tm;
+	world.GetEntityManager()->RegisterComponentManager(&bodies);
+	world.GetEntityManager()->RegisterComponentManager(&tm);
+	std::mt19937 rng(9);
+	std::vector<Entity> all;
+	for (int s = 0; s < 3; s++)
+	{
+		Section* section = world.CreateSection();
+		std::vector<Entity> entities;
+		for (int n = 0; n < 400; n++)
+		{
+			entities.push_back(section->CreateEntity());
+			if (n % 3)
+			{
+				auto i = bodies.AddComponent(entities.back());
+				bodies.Velocity(i) = { float(n), float(s), 1.0f };
+				bodies.Tag(i) = entities.back().GetId() * 7;
+			}
+		}
+		BuildForest(tm, entities, rng);
+		all.insert(all.end(), entities.begin(), entities.end());
+	}
+	tm.Update();
+	// free ids survive a round trip too
+	Entity dead = world.GetEntityManager()->CreateEntity();
+	world.GetEntityManager()->DestroyEntity(dead);
+	ASSERT_TRUE(Snapshot::SaveWorld(world, worldPath.c_str()));
+
+	auto sameRow = [&](BodyManager& b, TransformManager& t, Entity from, Entity to)
+	{
+		auto bi = bodies.GetInstance(from);
+		auto bj = b.GetInstance(to);
+		ASSERT_EQ(bi != 0, bj != 0);
+		if (bi)
+		{
+			EXPECT_EQ(b.Velocity(bj), bodies.Velocity(bi));
+			EXPECT_EQ(b.Tag(bj), bodies.Tag(bi));
+		}
+		auto ti = tm.GetInstance(from);
+		auto tj = t.GetInstance(to);
+		EXPECT_EQ(t.GetPosition(tj), tm.GetPosition(ti));
+		EXPECT_EQ(t.GetWorldTransform(tj).data[3].xyz, tm.GetWorldTransform(ti).data[3].xyz);
+		EXPECT_EQ(t.GetDepth(tj), tm.GetDepth(ti));
+	};
+
+	{
+		World loaded;
+		BodyManager b;
+		TransformManager t;
+		loaded.GetEntityManager()->RegisterComponentManager(&b);
+		loaded.GetEntityManager()->RegisterComponentManager(&t);
+		ASSERT_TRUE(Snapshot::LoadWorld(loaded, worldPath.c_str()));
+		EXPECT_EQ(loaded.GetEntityManager()->mCurrentID, world.GetEntityManager()->mCurrentID);
+		EXPECT_EQ(loaded.GetEntityManager()->mFreeList, world.GetEntityManager()->mFreeList);
+		ASSERT_NE(loaded.GetSectionById(2), nullptr);
+		EXPECT_EQ(loaded.GetSectionById(3), nullptr);
+		EXPECT_EQ(b.GetComponentCount(), bodies.GetComponentCount());
+		EXPECT_EQ(t.GetComponentCount(), tm.GetComponentCount());
+		CheckLevelOrder(t);
+		for (Entity e : all)
+		{
+			sameRow(b, t, e, e);
+			auto parent = tm.GetParent(tm.GetInstance(e));
+			auto loadedParent = t.GetParent(t.GetInstance(e));
+			EXPECT_EQ(parent ? tm.GetEntity(parent) : e, loadedParent ? t.GetEntity(loadedParent) : e);
+		}
+		EXPECT_EQ(t.Update(), 0);
+
+		// only a fresh world loads
+		EXPECT_FALSE(Snapshot::LoadWorld(loaded, worldPath.c_str()));
+	}
+
+	// a section streamed into another world gets new ids and keeps its hierarchy
+	ASSERT_TRUE(Snapshot::SaveSection(*world.GetSectionById(1), sectionPath.c_str()));
+	{
+		World live;
+		BodyManager b;
+		TransformManager t;
+		live.GetEntityManager()->RegisterComponentManager(&b);
+		live.GetEntityManager()->RegisterComponentManager(&t);
+		live.CreateSection()->CreateEntity();
+
+		World staging(&live);
+		BodyManager stagedBodies;
+		TransformManager stagedTm;
+		staging.GetEntityManager()->RegisterComponentManager(&stagedBodies);
+		staging.GetEntityManager()->RegisterComponentManager(&stagedTm);
+		Section* section = Snapshot::LoadSection(staging, sectionPath.c_str());
+		ASSERT_NE(section, nullptr);
+		live.Merge(staging);
+		EXPECT_EQ(live.GetSectionById(1), section);
+		EXPECT_EQ(t.GetComponentCount(), 400);
+		CheckLevelOrder(t);
+		auto const& loadedEntities = section->GetEntities();
+		ASSERT_EQ(loadedEntities.size(), 400);
+		std::unordered_map<Entity, Entity> renamed;
+		for (int n = 0; n < 400; n++)
+		{
+			renamed[all[400 + n]] = loadedEntities[n];
+			EXPECT_NE(loadedEntities[n].GetId(), all[400 + n].GetId());
+		}
+		for (int n = 0; n < 400; n++)
+		{
+			Entity from = all[400 + n];
+			Entity to = loadedEntities[n];
+			sameRow(b, t, from, to);
+			auto parent = tm.GetParent(tm.GetInstance(from));
+			auto loadedParent = t.GetParent(t.GetInstance(to));
+			EXPECT_EQ(parent ? renamed[tm.GetEntity(parent)] : to, loadedParent ? t.GetEntity(loadedParent) : to);
+		}
+		EXPECT_EQ(t.Update(), 0);
+	}
+
+	// damaged files and mismatched managers are rejected
+	{
+		std::ifstream in(worldPath, std::ios::binary);
+		std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		std::ofstream(sectionPath, std::ios::binary).write(bytes.data(), std::streamsize(bytes.size() / 2));
+		World loaded;
+		BodyManager b;
+		TransformManager t;
+		loaded.GetEntityManager()->RegisterComponentManager(&b);
+		loaded.GetEntityManager()->RegisterComponentManager(&t);
+		EXPECT_FALSE(Snapshot::LoadWorld(loaded, sectionPath.c_str()));
+		EXPECT_EQ(Snapshot::LoadSection(loaded, sectionPath.c_str()), nullptr);
+	}
+	{
+		World loaded;
+		TransformManager t;
+		BodyManager b;
+		loaded.GetEntityManager()->RegisterComponentManager(&t);
+		loaded.GetEntityManager()->RegisterComponentManager(&b);
+		EXPECT_FALSE(Snapshot::LoadWorld(loaded, worldPath.c_str()));
+		EXPECT_EQ(t.GetComponentCount(), 0);
+	}
+
+	// ids from the file are checked before the world is touched: header fields and records
+	// are patched at their offsets in the file layout
+	const std::string damagedPath = ::testing::TempDir() + "redtea_damaged.snapshot";
+	auto readFile = [](std::string const& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	};
+	auto read64 = [](std::string const& bytes, uint64_t offset)
+	{
+		uint64_t value;
+		std::memcpy(&value, bytes.data() + offset, sizeof(value));
+		return value;
+	};
+	auto damage = [&](std::string bytes, uint64_t offset, uint32_t value)
+	{
+		std::memcpy(&bytes[offset], &value, sizeof(value));
+		std::ofstream(damagedPath, std::ios::binary).write(bytes.data(), std::streamsize(bytes.size()));
+	};
+	auto loadsWorld = [&]()
+	{
+		World loaded;
+		BodyManager b;
+		TransformManager t;
+		loaded.GetEntityManager()->RegisterComponentManager(&b);
+		loaded.GetEntityManager()->RegisterComponentManager(&t);
+		const bool ok = Snapshot::LoadWorld(loaded, damagedPath.c_str());
+		EXPECT_EQ(ok, loaded.GetSectionById(1) != nullptr);
+		EXPECT_EQ(ok, b.GetComponentCount() != 0);
+		return ok;
+	};
+	auto loadsSection = [&]()
+	{
+		World loaded;
+		BodyManager b;
+		TransformManager t;
+		loaded.GetEntityManager()->RegisterComponentManager(&b);
+		loaded.GetEntityManager()->RegisterComponentManager(&t);
+		Section* section = Snapshot::LoadSection(loaded, damagedPath.c_str());
+		EXPECT_EQ(section != nullptr, b.GetComponentCount() != 0);
+		return section != nullptr;
+	};
+	{
+		const std::string bytes = readFile(worldPath);
+		const uint64_t freeList = read64(bytes, 32);
+		const uint64_t sectionIds = read64(bytes, read64(bytes, 40) + 8);
+		const uint64_t bodyIds = read64(bytes, read64(bytes, 48) + 8);
+		uint32_t firstId;
+		std::memcpy(&firstId, &bytes[sectionIds], sizeof(firstId));
+
+		damage(bytes, 0, Snapshot::kMagic);
+		EXPECT_TRUE(loadsWorld());
+		damage(bytes, sectionIds, 0xFFFFFFFF);
+		EXPECT_FALSE(loadsWorld());
+		damage(bytes, sectionIds + 4, firstId);
+		EXPECT_FALSE(loadsWorld());
+		damage(bytes, freeList, world.GetEntityManager()->mCurrentID);
+		EXPECT_FALSE(loadsWorld());
+		// a free id that is also alive
+		damage(bytes, freeList, firstId);
+		EXPECT_FALSE(loadsWorld());
+		damage(bytes, bodyIds, 0xFFFFFFFF);
+		EXPECT_FALSE(loadsWorld());
+
+		// transform rows: ColumnRecord is 16 bytes with the offset at 8
+		const uint64_t transformRecord = read64(bytes, 48) + 24;
+		const uint64_t transformColumns = read64(bytes, transformRecord + 16);
+		uint32_t rowCount;
+		std::memcpy(&rowCount, &bytes[transformRecord], sizeof(rowCount));
+		const uint64_t parents = read64(bytes, transformColumns + TransformManager::Parent * 16 + 8);
+		const uint64_t nextSiblings = read64(bytes, transformColumns + TransformManager::NextSibling * 16 + 8);
+		const uint64_t depths = read64(bytes, transformColumns + TransformManager::Depth * 16 + 8);
+		const uint64_t last = (rowCount - 1) * sizeof(uint32_t);
+		damage(bytes, parents + last, rowCount + 5);
+		EXPECT_FALSE(loadsWorld());
+		damage(bytes, parents + last, rowCount);
+		EXPECT_FALSE(loadsWorld());
+		damage(bytes, depths, 1);
+		EXPECT_FALSE(loadsWorld());
+		damage(bytes, nextSiblings, 2);
+		EXPECT_FALSE(loadsWorld());
+		damage(bytes, nextSiblings + last, rowCount);
+		EXPECT_FALSE(loadsWorld());
+	}
+	// the damaged file cases above wrote over it
+	ASSERT_TRUE(Snapshot::SaveSection(*world.GetSectionById(1), sectionPath.c_str()));
+	{
+		const std::string bytes = readFile(sectionPath);
+		const uint64_t sectionIds = read64(bytes, read64(bytes, 40) + 8);
+		const uint64_t bodyIds = read64(bytes, read64(bytes, 48) + 8);
+		uint32_t firstBody;
+		std::memcpy(&firstBody, &bytes[bodyIds], sizeof(firstBody));
+
+		damage(bytes, 0, Snapshot::kMagic);
+		EXPECT_TRUE(loadsSection());
+		damage(bytes, sectionIds, 0xFFFFFFFF);
+		EXPECT_FALSE(loadsSection());
+		damage(bytes, bodyIds + 4, firstBody);
+		EXPECT_FALSE(loadsSection());
+
+		const uint64_t transformColumns = read64(bytes, read64(bytes, 48) + 24 + 16);
+		const uint64_t depths = read64(bytes, transformColumns + TransformManager::Depth * 16 + 8);
+		damage(bytes, depths, 3);
+		EXPECT_FALSE(loadsSection());
+	}
+	std::remove(worldPath.c_str());
+	std::remove(sectionPath.c_str());
+	std::remove(damagedPath.c_str());
+}
+
+TEST(CORE_TEST, DISABLED_bench_snapshot)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class BodyManager : public ComponentManagerBase<math::Vector3f, math::Vector3f, float>
+	{
+	public:
+		enum
+		{
+			Velocity,
+			Force,
+			Mass
+		};
+
+		PROXY_DEFINE(BodyManager)
+			DEFINE_FEILD(Velocity, velocity)
+			DEFINE_FEILD(Force, force)
+			DEFINE_FEILD(Mass, mass)
+		PROXY_END()
+	};
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+	const std::string path = ::testing::TempDir() + "redtea_bench.snapshot";
+	const size_t count = 1000000;
+
+	// the construction path a level loader takes today: create, add, write fields one by one
+	auto construct = [&](World& world, BodyManager& bodies, TransformManager& tm)
+	{
+		std::mt19937 rng(2);
+		Section* section = world.CreateSection();
+		std::vector<Entity> entities;
+		entities.reserve(count);
+		for (size_t n = 0; n < count; n++)
+		{
+			Entity e = section->CreateEntity();
+			entities.push_back(e);
+			auto i = bodies.AddComponent(e);
+			bodies[i].velocity = math::Vector3f(float(n), 0.0f, 1.0f);
+			bodies[i].force = math::Vector3f(0.0f);
+			bodies[i].mass = 1.0f;
+			auto parent = n >= 1000 ? tm.GetInstance(entities[rng() % (n / 2)]) : 0;
+			tm.SetPosition(tm.AddComponent(e, parent), { float(n % 7), 1.0f, 0.0f });
+		}
+	};
+
+	double construct_ms = 0.0;
+	{
+		World world;
+		BodyManager bodies;
+		TransformManager tm;
+		world.GetEntityManager()->RegisterComponentManager(&bodies);
+		world.GetEntityManager()->RegisterComponentManager(&tm);
+		auto start = Clock::now();
+		construct(world, bodies, tm);
+		construct_ms = ms(start);
+		tm.Update();
+		ASSERT_TRUE(Snapshot::SaveWorld(world, path.c_str()));
+	}
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	const double megabytes = double(file.tellg()) / (1024.0 * 1024.0);
+	double load_ms = 0.0;
+	const int repeats = 5;
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		World world;
+		BodyManager bodies;
+		TransformManager tm;
+		world.GetEntityManager()->RegisterComponentManager(&bodies);
+		world.GetEntityManager()->RegisterComponentManager(&tm);
+		auto start = Clock::now();
+		ASSERT_TRUE(Snapshot::LoadWorld(world, path.c_str()));
+		load_ms += ms(start);
+		EXPECT_EQ(tm.GetComponentCount(), count);
+	}
+	load_ms /= repeats;
+	std::remove(path.c_str());
+	std::cout << "1M entities, " << megabytes << " MB: construct " << construct_ms << " ms, load "
+		<< load_ms << " ms (" << megabytes / load_ms << " GB/s)" << std::endl;
+}
+
+TEST(CORE_TEST, prefab)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class BodyManager : public ComponentManagerBase<math::Vector3f, uint32_t>
+	{
+	public:
+		math::Vector3f& Velocity(Instance i) { return GetElement<0>(i); }
+		uint32_t& Tag(Instance i) { return GetElement<1>(i); }
+	};
+
+	World world;
+	BodyManager bodies;
+	TransformManager tm;
+	world.GetEntityManager()->RegisterComponentManager(&bodies);
+	world.GetEntityManager()->RegisterComponentManager(&tm);
+	Section* section = world.CreateSection();
+
+	// live rows to merge around
+	std::mt19937 rng(4);
+	std::vector<Entity> scenery;
+	for (int n = 0; n < 100; n++)
+	{
+		scenery.push_back(section->CreateEntity());
+	}
+	BuildForest(tm, scenery, rng);
+
+	// a ship with a turret that carries a barrel, captured out of order
+	Entity ship = section->CreateEntity();
+	Entity turret = section->CreateEntity();
+	Entity barrel = section->CreateEntity();
+	auto shipRow = tm.AddComponent(ship);
+	tm.SetPosition(shipRow, { 10.0f, 0.0f, 0.0f });
+	tm.SetPosition(tm.AddComponent(turret, shipRow), { 0.0f, 1.0f, 0.0f });
+	tm.SetPosition(tm.AddComponent(barrel, tm.GetInstance(turret)), { 0.0f, 0.0f, 2.0f });
+	auto body = bodies.AddComponent(ship);
+	bodies.Velocity(body) = { 1.0f, 2.0f, 3.0f };
+	bodies.Tag(body) = 42;
+	tm.Update();
+
+	Prefab prefab;
+	Entity parts[] = { barrel, ship, turret };
+	ASSERT_TRUE(prefab.Capture(world, parts, 3));
+	EXPECT_EQ(prefab.GetEntityCount(), 3);
+
+	// a barrel without its turret and ship would come out as a root of depth 2
+	Prefab orphan;
+	EXPECT_FALSE(orphan.Capture(world, parts, 1));
+	EXPECT_EQ(orphan.GetEntityCount(), 0);
+	EXPECT_EQ(orphan.Instantiate(*section, 10), 103);
+	EXPECT_EQ(section->GetEntities().size(), 103);
+
+	const size_t copies = 50;
+	const size_t liveRows = tm.GetComponentCount();
+	const size_t first = prefab.Instantiate(*section, copies);
+	EXPECT_EQ(first, 103);
+	auto const& entities = section->GetEntities();
+	ASSERT_EQ(entities.size(), 103 + copies * 3);
+	EXPECT_EQ(tm.GetComponentCount(), liveRows + copies * 3);
+	EXPECT_EQ(bodies.GetComponentCount(), 1 + copies);
+	CheckLevelOrder(tm);
+
+	std::vector<Entity::Type> ids;
+	for (size_t k = 0; k < copies; k++)
+	{
+		Entity b = entities[first + k * 3 + 0];
+		Entity s = entities[first + k * 3 + 1];
+		Entity t = entities[first + k * 3 + 2];
+		ids.push_back(b.GetId());
+		ids.push_back(s.GetId());
+		ids.push_back(t.GetId());
+		auto si = tm.GetInstance(s);
+		auto ti = tm.GetInstance(t);
+		auto bi = tm.GetInstance(b);
+		ASSERT_TRUE(si && ti && bi);
+		EXPECT_EQ(tm.GetParent(si), 0);
+		EXPECT_EQ(tm.GetParent(ti), si);
+		EXPECT_EQ(tm.GetParent(bi), ti);
+		EXPECT_EQ(tm.GetFirstChild(si), ti);
+		EXPECT_EQ(tm.GetNextSibling(ti), 0);
+		EXPECT_EQ(tm.GetEntity(bi), b);
+		EXPECT_EQ(tm.GetWorldTransform(bi).data[3].xyz, math::Vector3f(10.0f, 1.0f, 2.0f));
+
+		auto body = bodies.GetInstance(s);
+		ASSERT_NE(body, 0);
+		EXPECT_EQ(bodies.Velocity(body), math::Vector3f(1.0f, 2.0f, 3.0f));
+		EXPECT_EQ(bodies.Tag(body), 42);
+		EXPECT_EQ(bodies.GetInstance(t), 0);
+	}
+	std::sort(ids.begin(), ids.end());
+	EXPECT_EQ(std::unique(ids.begin(), ids.end()), ids.end());
+
+	// copies move on their own
+	Entity moved = entities[first + 3 * 7 + 1];
+	tm.SetPosition(tm.GetInstance(moved), { -5.0f, 0.0f, 0.0f });
+	EXPECT_EQ(tm.Update(), 3);
+	EXPECT_EQ(tm.GetWorldTransform(tm.GetInstance(entities[first + 3 * 7])).data[3].xyz, math::Vector3f(-5.0f, 1.0f, 2.0f));
+	EXPECT_EQ(tm.GetWorldTransform(tm.GetInstance(entities[first + 3 * 8])).data[3].xyz, math::Vector3f(10.0f, 1.0f, 2.0f));
+
+	// and go away like any other entity
+	section->Destroy();
+	EXPECT_EQ(tm.GetComponentCount(), 0);
+	EXPECT_EQ(bodies.GetComponentCount(), 0);
+}
+
+TEST(CORE_TEST, DISABLED_bench_prefab)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class ProjectileManager : public ComponentManagerBase<math::Vector3f, float, uint32_t>
+	{
+	public:
+		enum
+		{
+			Velocity,
+			Life,
+			Owner
+		};
+
+		PROXY_DEFINE(ProjectileManager)
+			DEFINE_FEILD(Velocity, velocity)
+			DEFINE_FEILD(Life, life)
+			DEFINE_FEILD(Owner, owner)
+		PROXY_END()
+	};
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+	const size_t count = 100000;
+	const int repeats = 5;
+
+	double single_ms = 0.0;
+	double prefab_ms = 0.0;
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		World world;
+		ProjectileManager projectiles;
+		TransformManager tm;
+		world.GetEntityManager()->RegisterComponentManager(&projectiles);
+		world.GetEntityManager()->RegisterComponentManager(&tm);
+		Section* section = world.CreateSection();
+		auto start = Clock::now();
+		for (size_t n = 0; n < count; n++)
+		{
+			Entity e = section->CreateEntity();
+			auto i = projectiles.AddComponent(e);
+			projectiles[i].velocity = math::Vector3f(0.0f, 0.0f, 50.0f);
+			projectiles[i].life = 3.0f;
+			projectiles[i].owner = 1;
+			tm.SetPosition(tm.AddComponent(e), { 0.0f, 1.0f, 0.0f });
+		}
+		single_ms += ms(start);
+	}
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		World world;
+		ProjectileManager projectiles;
+		TransformManager tm;
+		world.GetEntityManager()->RegisterComponentManager(&projectiles);
+		world.GetEntityManager()->RegisterComponentManager(&tm);
+		Section* section = world.CreateSection();
+		Entity e = section->CreateEntity();
+		auto i = projectiles.AddComponent(e);
+		projectiles[i].velocity = math::Vector3f(0.0f, 0.0f, 50.0f);
+		projectiles[i].life = 3.0f;
+		projectiles[i].owner = 1;
+		tm.SetPosition(tm.AddComponent(e), { 0.0f, 1.0f, 0.0f });
+		Prefab prefab;
+		ASSERT_TRUE(prefab.Capture(world, &e, 1));
+
+		auto start = Clock::now();
+		prefab.Instantiate(*section, count);
+		prefab_ms += ms(start);
+		EXPECT_EQ(tm.GetComponentCount(), count + 1);
+	}
+	std::cout << "100K projectiles: one by one " << single_ms / repeats << " ms, prefab "
+		<< prefab_ms / repeats << " ms" << std::endl;
+}
+
+TEST(CORE_TEST, render_extraction)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	World world;
+	RenderProxyManager proxies;
+	TransformManager tm;
+	world.GetEntityManager()->RegisterComponentManager(&proxies);
+	world.GetEntityManager()->RegisterComponentManager(&tm);
+	Section* section = world.CreateSection();
+	std::vector<Entity> entities;
+	for (uint32_t n = 0; n < 300; n++)
+	{
+		Entity e = section->CreateEntity();
+		entities.push_back(e);
+		auto i = proxies.AddComponent(e);
+		proxies[i].boundsExtents = math::Vector3f(1.0f);
+		proxies[i].material = n % 4;
+		proxies[i].mesh = n;
+		auto parent = n >= 100 ? tm.GetInstance(entities[n % 100]) : 0;
+		tm.SetPosition(tm.AddComponent(e, parent), { 1.0f, 0.0f, 0.0f });
+	}
+	tm.Update();
+
+	auto check = [&](RenderFrame const* frame)
+	{
+		ASSERT_EQ(frame->proxies.size(), proxies.GetComponentCount());
+		for (size_t n = 0; n < frame->proxies.size(); n++)
+		{
+			RenderProxy const& proxy = frame->proxies[n];
+			auto i = ComponentInstance::Type(n + 1);
+			ASSERT_EQ(proxy.entity, proxies.GetEntity(i));
+			EXPECT_EQ(proxy.mesh, proxies.GetElement<RenderProxyManager::Mesh>(i));
+			EXPECT_EQ(proxy.material, proxies.GetElement<RenderProxyManager::Material>(i));
+			EXPECT_EQ(proxy.world.data[3].xyz, tm.GetWorldTransform(tm.GetInstance(proxy.entity)).data[3].xyz);
+		}
+	};
+
+	RenderExtractor extractor(&proxies, &tm);
+	EXPECT_EQ(extractor.Acquire(), nullptr);
+	// both buffers start empty, and each catches up on its own
+	EXPECT_EQ(extractor.Extract(), 300);
+	RenderFrame const* first = extractor.Acquire();
+	check(first);
+	EXPECT_EQ(first->frame, 1);
+	extractor.Release(first);
+	EXPECT_EQ(extractor.Extract(), 300);
+	EXPECT_EQ(extractor.Extract(), 0);
+	EXPECT_EQ(extractor.Extract(), 0);
+
+	// a moved root drags its children along, a material change is one row
+	tm.SetPosition(tm.GetInstance(entities[3]), { 5.0f, 0.0f, 0.0f });
+	tm.Update();
+	proxies[proxies.GetInstance(entities[50])].material = 9;
+	EXPECT_EQ(extractor.Extract(), 4);
+	RenderFrame const* frame = extractor.Acquire();
+	check(frame);
+	extractor.Release(frame);
+	EXPECT_EQ(extractor.Extract(), 4);
+	frame = extractor.Acquire();
+	check(frame);
+
+	// the frame being drawn stays as it was while the game goes on
+	const std::vector<RenderProxy> drawn = frame->proxies;
+	proxies.RemoveComponent(entities[10]);
+	tm.SetPosition(tm.GetInstance(entities[20]), { -1.0f, 0.0f, 0.0f });
+	tm.Update();
+	extractor.Extract();
+	for (size_t n = 0; n < drawn.size(); n++)
+	{
+		EXPECT_EQ(frame->proxies[n].entity, drawn[n].entity);
+		EXPECT_EQ(frame->proxies[n].world.data[3].xyz, drawn[n].world.data[3].xyz);
+	}
+	extractor.Release(frame);
+	frame = extractor.Acquire();
+	check(frame);
+	extractor.Release(frame);
+
+	// simulation and rendering overlapping on two threads, every frame is consistent
+	common::ThreadPool pool(2);
+	std::atomic<bool> done{ false };
+	std::atomic<int> torn{ 0 };
+	std::atomic<uint64_t> lastDrawn{ 0 };
+	// proxies stay put from here on, entities[10] lost its proxy above
+	std::vector<size_t> rootRows;
+	for (size_t r = 0; r < 100; r++)
+	{
+		if (auto i = proxies.GetInstance(entities[r]))
+		{
+			rootRows.push_back(i - 1);
+		}
+	}
+	// the frame published last still holds the positions set above
+	frame = extractor.Acquire();
+	const uint64_t before = frame->frame;
+	extractor.Release(frame);
+	std::thread render([&]()
+	{
+		uint64_t last = before;
+		while (!done)
+		{
+			if (RenderFrame const* f = extractor.Acquire())
+			{
+				// the game writes the same x into every root per frame
+				if (f->frame != last)
+				{
+					const float x = f->proxies[rootRows[0]].world.data[3].x;
+					for (size_t r : rootRows)
+					{
+						torn += f->proxies[r].world.data[3].x != x;
+					}
+					last = f->frame;
+					lastDrawn = last;
+				}
+				extractor.Release(f);
+			}
+			std::this_thread::yield();
+		}
+	});
+	for (int n = 0; n < 200; n++)
+	{
+		for (size_t r = 0; r < 100; r++)
+		{
+			tm.SetPosition(tm.GetInstance(entities[r]), { float(n), 0.0f, 0.0f });
+		}
+		tm.Update(&pool);
+		extractor.Extract(&pool);
+		std::this_thread::yield();
+	}
+	// the last frame reaches the screen too
+	frame = extractor.Acquire();
+	const uint64_t final = frame->frame;
+	extractor.Release(frame);
+	while (lastDrawn != final)
+	{
+		std::this_thread::yield();
+	}
+	done = true;
+	render.join();
+	EXPECT_EQ(torn, 0);
+}
+
+namespace {
+
+	redtea::math::Aabb RandomBox(std::mt19937& rng, float range, float size)
+	{
+		std::uniform_real_distribution<float> position(-range, range);
+		std::uniform_real_distribution<float> extent(0.1f * size, size);
+		const redtea::math::Vector3f center(position(rng), position(rng), position(rng));
+		return redtea::math::Aabb::FromCenterExtents(center, redtea::math::Vector3f(extent(rng), extent(rng), extent(rng)));
+	}
+}
+
+TEST(CORE_TEST, spatial_index)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	using math::Aabb;
+	using math::Vector3f;
+	World world;
+	BoundsManager bounds;
+	world.GetEntityManager()->RegisterComponentManager(&bounds);
+	Section* section = world.CreateSection();
+	std::mt19937 rng(12);
+	std::vector<Entity> entities;
+	for (int n = 0; n < 2000; n++)
+	{
+		entities.push_back(section->CreateEntity());
+		bounds[bounds.AddComponent(entities.back())].bounds = RandomBox(rng, 100.0f, 3.0f);
+	}
+
+	SpatialIndex index(0.5f);
+	index.Build(bounds);
+	EXPECT_EQ(index.GetCount(), 2000);
+	EXPECT_LE(index.GetHeight(), 13);
+
+	auto boxOf = [&](Entity e) { return bounds.GetElement<BoundsManager::Bounds>(bounds.GetInstance(e)); };
+	auto sorted = [](std::vector<Entity> v)
+	{
+		std::sort(v.begin(), v.end(), [](Entity a, Entity b) { return a.GetId() < b.GetId(); });
+		return v;
+	};
+	auto scan = [&](auto&& test)
+	{
+		std::vector<Entity> result;
+		for (size_t r = 1; r <= bounds.GetComponentCount(); r++)
+		{
+			if (test(bounds.GetElement<BoundsManager::Bounds>(ComponentInstance::Type(r))))
+			{
+				result.push_back(bounds.GetEntity(ComponentInstance::Type(r)));
+			}
+		}
+		return sorted(result);
+	};
+
+	// a frustum looking down +z from the origin, 90 degrees wide
+	SpatialIndex::Frustum frustum;
+	const float s = std::sqrt(0.5f);
+	frustum.planes[0] = math::Vector4f(s, 0.0f, s, 0.0f);
+	frustum.planes[1] = math::Vector4f(-s, 0.0f, s, 0.0f);
+	frustum.planes[2] = math::Vector4f(0.0f, s, s, 0.0f);
+	frustum.planes[3] = math::Vector4f(0.0f, -s, s, 0.0f);
+	frustum.planes[4] = math::Vector4f(0.0f, 0.0f, 1.0f, -1.0f);
+	frustum.planes[5] = math::Vector4f(0.0f, 0.0f, -1.0f, 60.0f);
+	auto inFrustum = [&](Aabb const& b)
+	{
+		for (auto const& p : frustum.planes)
+		{
+			const Vector3f far(p.x >= 0 ? b.max.x : b.min.x, p.y >= 0 ? b.max.y : b.min.y, p.z >= 0 ? b.max.z : b.min.z);
+			if (dot(p.xyz, far) + p.w < 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	auto checkQueries = [&]()
+	{
+		std::vector<Entity> found;
+		auto collect = [&found](Entity e) { found.push_back(e); };
+		for (int q = 0; q < 20; q++)
+		{
+			const Aabb region = RandomBox(rng, 100.0f, 20.0f);
+			found.clear();
+			index.QueryAabb(region, collect);
+			EXPECT_EQ(sorted(found), scan([&](Aabb const& b) { return region.Overlaps(b); }));
+
+			const Vector3f center = region.Center();
+			found.clear();
+			index.QuerySphere(center, 15.0f, collect);
+			EXPECT_EQ(sorted(found), scan([&](Aabb const& b) { return b.DistanceSquared(center) <= 225.0f; }));
+
+			// nearest by distance to the bounds, ties aside
+			std::vector<Entity> nearest;
+			index.QueryNearest(center, 8, nearest);
+			ASSERT_EQ(nearest.size(), 8);
+			std::vector<float> distances;
+			for (size_t r = 1; r <= bounds.GetComponentCount(); r++)
+			{
+				distances.push_back(bounds.GetElement<BoundsManager::Bounds>(ComponentInstance::Type(r)).DistanceSquared(center));
+			}
+			std::sort(distances.begin(), distances.end());
+			for (size_t n = 0; n < nearest.size(); n++)
+			{
+				EXPECT_EQ(boxOf(nearest[n]).DistanceSquared(center), distances[n]);
+			}
+
+			const Vector3f direction = normalize(Vector3f(center.x, center.y, center.z + 150.0f));
+			const Vector3f origin(0.0f, 0.0f, -150.0f);
+			const Vector3f inv(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+			float best = -1.0f;
+			for (size_t r = 1; r <= bounds.GetComponentCount(); r++)
+			{
+				const float t = bounds.GetElement<BoundsManager::Bounds>(ComponentInstance::Type(r)).Intersect(origin, inv, 400.0f);
+				if (t >= 0.0f && (best < 0.0f || t < best))
+				{
+					best = t;
+				}
+			}
+			SpatialIndex::RayHit hit;
+			ASSERT_EQ(index.Raycast(origin, direction, 400.0f, hit), best >= 0.0f);
+			if (best >= 0.0f)
+			{
+				EXPECT_EQ(hit.distance, best);
+				EXPECT_EQ(boxOf(hit.entity).Intersect(origin, inv, 400.0f), best);
+			}
+		}
+		found.clear();
+		index.QueryFrustum(frustum, collect);
+		EXPECT_EQ(sorted(found), scan(inFrustum));
+		EXPECT_FALSE(found.empty());
+	};
+	checkQueries();
+
+	// frames of moving, spawning and dying objects go through Sync
+	std::uniform_real_distribution<float> step(-2.0f, 2.0f);
+	for (int frame = 0; frame < 30; frame++)
+	{
+		for (int n = 0; n < 100; n++)
+		{
+			auto i = ComponentInstance::Type(1 + rng() % bounds.GetComponentCount());
+			Aabb box = bounds.GetElement<BoundsManager::Bounds>(i);
+			const Vector3f delta(step(rng), step(rng), step(rng));
+			bounds[i].bounds = Aabb(box.min + delta, box.max + delta);
+		}
+		for (int n = 0; n < 10; n++)
+		{
+			entities.push_back(section->CreateEntity());
+			bounds[bounds.AddComponent(entities.back())].bounds = RandomBox(rng, 100.0f, 3.0f);
+		}
+		for (int n = 0; n < 8; n++)
+		{
+			world.GetEntityManager()->DestroyEntity(bounds.GetEntity(ComponentInstance::Type(1 + rng() % bounds.GetComponentCount())));
+		}
+		index.Sync(bounds);
+		ASSERT_EQ(index.GetCount(), bounds.GetComponentCount());
+	}
+	EXPECT_LE(index.GetHeight(), 20);
+	checkQueries();
+
+	// direct edits
+	Entity e = bounds.GetEntity(1);
+	index.Remove(e);
+	EXPECT_FALSE(index.Contains(e));
+	index.Insert(e, Aabb(Vector3f(500.0f), Vector3f(501.0f)));
+	std::vector<Entity> nearest;
+	index.QueryNearest(Vector3f(600.0f), 1, nearest);
+	ASSERT_EQ(nearest.size(), 1);
+	EXPECT_EQ(nearest[0], e);
+	index.Move(e, Aabb(Vector3f(-500.0f), Vector3f(-499.0f)));
+	index.QueryNearest(Vector3f(-600.0f), 1, nearest);
+	EXPECT_EQ(nearest[0], e);
+}
+
+TEST(CORE_TEST, DISABLED_bench_spatial_index)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	using math::Aabb;
+	using math::Vector3f;
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+
+	for (size_t count : { size_t(100000), size_t(1000000) })
+	{
+		World world;
+		BoundsManager bounds;
+		world.GetEntityManager()->RegisterComponentManager(&bounds);
+		Section* section = world.CreateSection();
+		std::mt19937 rng(5);
+		// objects spread so that a unit cell holds about one
+		const float range = 0.5f * std::cbrt(float(count));
+		for (size_t n = 0; n < count; n++)
+		{
+			bounds[bounds.AddComponent(section->CreateEntity())].bounds = RandomBox(rng, range, 0.5f);
+		}
+
+		SpatialIndex index(0.2f);
+		auto start = Clock::now();
+		index.Build(bounds);
+		const double build_ms = ms(start);
+
+		// 5% of the objects move a little every frame
+		const int frames = 10;
+		std::uniform_real_distribution<float> step(-0.3f, 0.3f);
+		double sync_ms = 0.0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (size_t n = 0; n < count / 20; n++)
+			{
+				auto i = ComponentInstance::Type(1 + rng() % count);
+				Aabb box = bounds.GetElement<BoundsManager::Bounds>(i);
+				const Vector3f delta(step(rng), step(rng), step(rng));
+				bounds[i].bounds = Aabb(box.min + delta, box.max + delta);
+			}
+			start = Clock::now();
+			index.Sync(bounds);
+			sync_ms += ms(start);
+		}
+
+		// small range queries against a linear scan of the bounds
+		const int queries = 1000;
+		std::vector<Aabb> regions;
+		for (int q = 0; q < queries; q++)
+		{
+			regions.push_back(RandomBox(rng, range, 4.0f));
+		}
+		size_t hits = 0;
+		start = Clock::now();
+		for (auto const& region : regions)
+		{
+			index.QueryAabb(region, [&hits](Entity) { hits++; });
+		}
+		const double query_us = ms(start) * 1000.0 / queries;
+		size_t scanned = 0;
+		Aabb const* boxes = bounds.GetRawArray<BoundsManager::Bounds>();
+		start = Clock::now();
+		for (int q = 0; q < 20; q++)
+		{
+			for (size_t r = 1; r <= count; r++)
+			{
+				scanned += regions[q].Overlaps(boxes[r]);
+			}
+		}
+		const double scan_us = ms(start) * 1000.0 / 20;
+
+		std::vector<Entity> nearest;
+		start = Clock::now();
+		for (auto const& region : regions)
+		{
+			index.QueryNearest(region.Center(), 16, nearest);
+		}
+		const double knn_us = ms(start) * 1000.0 / queries;
+
+		std::cout << count << " objects: build " << build_ms << " ms, sync of 5% moving " << sync_ms / frames
+			<< " ms/frame, height " << index.GetHeight() << ", aabb query " << query_us << " us vs scan " << scan_us
+			<< " us, 16-nearest " << knn_us << " us (" << hits + scanned << ")" << std::endl;
+	}
+}
+
+TEST(CORE_TEST, broadphase)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	using math::Aabb;
+	using math::Vector3f;
+	World world;
+	BoundsManager bounds;
+	world.GetEntityManager()->RegisterComponentManager(&bounds);
+	Section* section = world.CreateSection();
+	std::mt19937 rng(21);
+	for (int n = 0; n < 1500; n++)
+	{
+		bounds[bounds.AddComponent(section->CreateEntity())].bounds = RandomBox(rng, 40.0f, 2.0f);
+	}
+
+	using Key = std::pair<Entity::Type, Entity::Type>;
+	auto key = [](Entity a, Entity b) { return a.GetId() < b.GetId() ? Key(a.GetId(), b.GetId()) : Key(b.GetId(), a.GetId()); };
+	auto expected = [&]()
+	{
+		std::vector<Key> pairs;
+		const size_t count = bounds.GetComponentCount();
+		Aabb const* boxes = bounds.GetRawArray<BoundsManager::Bounds>();
+		for (size_t i = 1; i <= count; i++)
+		{
+			for (size_t j = i + 1; j <= count; j++)
+			{
+				if (boxes[i].Overlaps(boxes[j]))
+				{
+					pairs.push_back(key(bounds.GetEntity(ComponentInstance::Type(i)), bounds.GetEntity(ComponentInstance::Type(j))));
+				}
+			}
+		}
+		std::sort(pairs.begin(), pairs.end());
+		return pairs;
+	};
+	auto found = [&](Broadphase const& broadphase)
+	{
+		std::vector<Key> pairs;
+		for (auto const& pair : broadphase.GetPairs())
+		{
+			pairs.push_back(key(pair.a, pair.b));
+		}
+		std::sort(pairs.begin(), pairs.end());
+		return pairs;
+	};
+
+	Broadphase serial;
+	Broadphase wide;
+	wide.SetPartitionCount(5);
+	common::ThreadPool pool(2);
+	std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+	for (int frame = 0; frame < 20; frame++)
+	{
+		// frame 12 stretches the scene along z, the sweep axis follows
+		for (size_t r = 1; r <= bounds.GetComponentCount(); r++)
+		{
+			auto i = ComponentInstance::Type(r);
+			Aabb box = bounds.GetElement<BoundsManager::Bounds>(i);
+			const Vector3f delta(step(rng), step(rng), frame == 12 ? box.Center().z * 3.0f : step(rng));
+			bounds[i].bounds = Aabb(box.min + delta, box.max + delta);
+		}
+		for (int n = 0; n < 20; n++)
+		{
+			bounds[bounds.AddComponent(section->CreateEntity())].bounds = RandomBox(rng, 40.0f, 2.0f);
+		}
+		for (int n = 0; n < 15; n++)
+		{
+			world.GetEntityManager()->DestroyEntity(bounds.GetEntity(ComponentInstance::Type(1 + rng() % bounds.GetComponentCount())));
+		}
+
+		serial.Update(bounds);
+		wide.Update(bounds, &pool);
+		const auto pairs = expected();
+		ASSERT_FALSE(pairs.empty());
+		ASSERT_EQ(found(serial), pairs) << "frame " << frame;
+		ASSERT_EQ(found(wide), pairs) << "frame " << frame;
+		EXPECT_EQ(serial.GetPairs().size(), pairs.size());
+		EXPECT_EQ(wide.GetPairs().size(), pairs.size());
+		if (frame == 12)
+		{
+			EXPECT_EQ(serial.GetAxis(), 2);
+		}
+	}
+	EXPECT_GT(serial.GetCellCount(), 1);
+
+	// a scene at rest costs no sorting
+	serial.Update(bounds);
+	EXPECT_EQ(serial.GetSortMoves(), 0);
+}
+
+TEST(CORE_TEST, DISABLED_bench_broadphase)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	using math::Aabb;
+	using math::Vector3f;
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+	const size_t count = 50000;
+	const int frames = 30;
+
+	World world;
+	BoundsManager bounds;
+	world.GetEntityManager()->RegisterComponentManager(&bounds);
+	Section* section = world.CreateSection();
+	std::mt19937 rng(8);
+	const float range = 0.6f * std::cbrt(float(count));
+	for (size_t n = 0; n < count; n++)
+	{
+		bounds[bounds.AddComponent(section->CreateEntity())].bounds = RandomBox(rng, range, 0.5f);
+	}
+
+	// every box drifts a little every frame
+	std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+	auto move = [&]()
+	{
+		for (size_t r = 1; r <= count; r++)
+		{
+			auto i = ComponentInstance::Type(r);
+			Aabb box = bounds.GetElement<BoundsManager::Bounds>(i);
+			const Vector3f delta(step(rng), step(rng), step(rng));
+			bounds[i].bounds = Aabb(box.min + delta, box.max + delta);
+		}
+	};
+
+	Broadphase broadphase;
+	broadphase.Update(bounds);
+	double coherent_ms = 0.0;
+	size_t moves = 0;
+	size_t pairs = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		move();
+		auto start = Clock::now();
+		broadphase.Update(bounds);
+		coherent_ms += ms(start);
+		moves += broadphase.GetSortMoves();
+		pairs += broadphase.GetPairs().size();
+	}
+
+	// the same without temporal coherence, every frame sorts from scratch
+	double fresh_ms = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		move();
+		Broadphase fresh;
+		auto start = Clock::now();
+		fresh.Update(bounds);
+		fresh_ms += ms(start);
+	}
+
+	common::ThreadPool pool;
+	Broadphase wide;
+	wide.Update(bounds, &pool);
+	double wide_ms = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		move();
+		auto start = Clock::now();
+		wide.Update(bounds, &pool);
+		wide_ms += ms(start);
+	}
+
+	// pairs through the BVH, one query per box
+	SpatialIndex index(0.1f);
+	index.Build(bounds);
+	double bvh_ms = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		move();
+		auto start = Clock::now();
+		index.Sync(bounds);
+		size_t found = 0;
+		Aabb const* boxes = bounds.GetRawArray<BoundsManager::Bounds>();
+		for (size_t r = 1; r <= count; r++)
+		{
+			index.QueryAabb(boxes[r], [&found](Entity) { found++; });
+		}
+		bvh_ms += ms(start);
+	}
+
+	std::cout << "50K moving boxes, " << pairs / frames << " pairs: sweep and prune " << coherent_ms / frames
+		<< " ms/frame (" << moves / frames << " sort moves), from scratch " << fresh_ms / frames << " ms, "
+		<< pool.getWorkerCount() + 1 << " threads " << wide_ms / frames << " ms, BVH queries " << bvh_ms / frames
+		<< " ms" << std::endl;
+}
+
+TEST(CORE_TEST, world_arena)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class ValueManager : public ComponentManagerBase<uint32_t>
+	{
+	public:
+		uint32_t& Value(Instance i) { return GetElement<0>(i); }
+	};
+
+	// a manager outliving its world is left empty and keeps working on the heap
+	ValueManager survivor;
+	{
+		World world;
+		world.GetEntityManager()->RegisterComponentManager(&survivor);
+		const size_t reserved = world.GetArena()->getReservedSize();
+		Section* section = world.CreateSection();
+		for (uint32_t n = 0; n < 5000; n++)
+		{
+			survivor.Value(survivor.AddComponent(section->CreateEntity())) = n;
+		}
+		EXPECT_GT(world.GetArena()->getReservedSize(), reserved);
+	}
+	EXPECT_EQ(survivor.GetComponentCount(), 0);
+	Entity kept;
+	{
+		World world;
+		world.GetEntityManager()->RegisterComponentManager(&survivor);
+		kept = world.CreateSection()->CreateEntity();
+		survivor.Value(survivor.AddComponent(kept)) = 7;
+		// the rows go back to the heap with the manager
+		world.GetEntityManager()->UnregisterComponentManager(&survivor);
+	}
+	ASSERT_EQ(survivor.GetComponentCount(), 1);
+	EXPECT_EQ(survivor.Value(survivor.GetInstance(kept)), 7);
+
+	// worlds tick on their own threads at once, managers declared first outlive them
+	const int worlds = 4;
+	std::vector<int> failures(worlds, 0);
+	std::vector<std::thread> threads;
+	for (int w = 0; w < worlds; w++)
+	{
+		threads.emplace_back([w, &failures]()
+		{
+			std::mt19937 rng(w);
+			for (int round = 0; round < 3; round++)
+			{
+				ValueManager values;
+				TransformManager tm;
+				World world;
+				world.GetEntityManager()->RegisterComponentManager(&values);
+				world.GetEntityManager()->RegisterComponentManager(&tm);
+				Section* section = world.CreateSection();
+				std::vector<Entity> entities;
+				for (int n = 0; n < 3000; n++)
+				{
+					entities.push_back(section->CreateEntity());
+				}
+				BuildForest(tm, entities, rng);
+				for (Entity e : entities)
+				{
+					values.Value(values.AddComponent(e)) = e.GetId() * worlds + w;
+				}
+				for (size_t n = 0; n < entities.size(); n += 3)
+				{
+					world.GetEntityManager()->DestroyEntity(entities[n]);
+				}
+				tm.Update();
+				for (size_t n = 0; n < entities.size(); n++)
+				{
+					const auto i = values.GetInstance(entities[n]);
+					if ((n % 3 == 0) != (i == 0) || (i && values.Value(i) != entities[n].GetId() * worlds + w))
+					{
+						failures[w]++;
+					}
+				}
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(failures, std::vector<int>(worlds, 0));
+}
+
+TEST(CORE_TEST, DISABLED_bench_world_teardown)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	class BodyManager : public ComponentManagerBase<math::Vector3f, math::Vector3f, math::Quaternion<float>>
+	{
+	};
+	class TagManager : public ComponentManagerBase<uint32_t>
+	{
+	};
+
+	// four sections of 100K entities each, unloaded one by one before the world goes or
+	// dropped with it
+	const int count = 400000;
+	auto run = [&](const char* name, bool sections)
+	{
+		double total = 0.0;
+		const int repeats = 5;
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			BodyManager bodies;
+			TagManager tags;
+			std::unique_ptr<World> world(new World());
+			world->GetEntityManager()->RegisterComponentManager(&bodies);
+			world->GetEntityManager()->RegisterComponentManager(&tags);
+			Section* parts[4] = { world->CreateSection(), world->CreateSection(), world->CreateSection(), world->CreateSection() };
+			for (int n = 0; n < count; n++)
+			{
+				Entity e = parts[n % 4]->CreateEntity();
+				bodies.AddComponent(e);
+				tags.AddComponent(e);
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			if (sections)
+			{
+				for (Section* section : parts)
+				{
+					section->Destroy();
+				}
+			}
+			world.reset();
+			total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			EXPECT_EQ(bodies.GetComponentCount(), 0);
+		}
+		std::cout << name << ": " << total / repeats << " ms" << std::endl;
+	};
+	run("section by section", true);
+	run("whole world", false);
+}
+
+TEST(CORE_TEST, entity_events)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	using math::Aabb;
+	class ValueManager : public ComponentManagerBase<uint32_t>
+	{
+	};
+
+	World world;
+	ValueManager values;
+	BoundsManager bounds;
+	world.GetEntityManager()->RegisterComponentManager(&values);
+	world.GetEntityManager()->RegisterComponentManager(&bounds);
+	EntityEventBus bus;
+	world.GetEntityManager()->SetEventBus(&bus);
+
+	// every batch, and the entities seen per kind and manager
+	struct Seen
+	{
+		size_t batches = 0;
+		std::vector<Entity::Type> ids;
+	};
+	std::map<std::pair<EntityEvent, IComponentManager*>, Seen> seen;
+	auto record = [&seen](EntityEventBatch const& batch)
+	{
+		Seen& s = seen[{ batch.type, batch.manager }];
+		s.batches++;
+		for (size_t n = 0; n < batch.count; n++)
+		{
+			EXPECT_EQ(batch.ids[n], batch.entities[n].GetId());
+			s.ids.push_back(batch.ids[n]);
+		}
+	};
+	for (uint8_t type = 0; type < uint8_t(EntityEvent::Count); type++)
+	{
+		bus.Subscribe(EntityEvent(type), nullptr, record);
+	}
+	auto at = [&seen](EntityEvent type, IComponentManager* manager) -> Seen& { return seen[{ type, manager }]; };
+	auto sorted = [](std::vector<Entity::Type> ids)
+	{
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	};
+	auto idsOf = [](std::vector<Entity> const& entities)
+	{
+		std::vector<Entity::Type> ids;
+		for (Entity e : entities)
+		{
+			ids.push_back(e.GetId());
+		}
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	};
+
+	// the bounds of new entities go into a spatial index, removals take them out again
+	SpatialIndex index;
+	bus.Subscribe(EntityEvent::ComponentAdded, &bounds, [&](EntityEventBatch const& batch)
+	{
+		for (size_t n = 0; n < batch.count; n++)
+		{
+			const auto i = bounds.GetInstance(batch.entities[n]);
+			if (i && !index.Contains(batch.entities[n]))
+			{
+				index.Insert(batch.entities[n], bounds.GetElement<BoundsManager::Bounds>(i));
+			}
+		}
+	});
+	bus.Subscribe(EntityEvent::ComponentRemoved, &bounds, [&](EntityEventBatch const& batch)
+	{
+		for (size_t n = 0; n < batch.count; n++)
+		{
+			if (index.Contains(batch.entities[n]))
+			{
+				index.Remove(batch.entities[n]);
+			}
+		}
+	});
+
+	Section* section = world.CreateSection();
+	std::vector<Entity> entities;
+	for (int n = 0; n < 2000; n++)
+	{
+		entities.push_back(section->CreateEntity());
+	}
+	// two systems add components on their own threads at once
+	std::mt19937 rng(3);
+	std::vector<Aabb> boxes;
+	for (size_t n = 0; n < entities.size(); n++)
+	{
+		boxes.push_back(RandomBox(rng, 50.0f, 1.0f));
+	}
+	std::thread other([&]()
+	{
+		for (size_t n = 0; n < entities.size(); n += 2)
+		{
+			bounds[bounds.AddComponent(entities[n])].bounds = boxes[n];
+		}
+	});
+	values.AddComponents(entities.data(), entities.size());
+	other.join();
+	EXPECT_EQ(bus.GetPendingCount(), 2000 + 2000 + 1000);
+
+	bus.Dispatch();
+	EXPECT_EQ(bus.GetPendingCount(), 0);
+	EXPECT_EQ(sorted(at(EntityEvent::EntityCreated, nullptr).ids), idsOf(entities));
+	EXPECT_EQ(at(EntityEvent::EntityCreated, nullptr).batches, 1);
+	EXPECT_EQ(sorted(at(EntityEvent::ComponentAdded, &values).ids), idsOf(entities));
+	EXPECT_EQ(at(EntityEvent::ComponentAdded, &values).batches, 1);
+	EXPECT_EQ(at(EntityEvent::ComponentAdded, &bounds).ids.size(), 1000);
+	EXPECT_EQ(index.GetCount(), 1000);
+
+	// a bulk removal and a section unload, each manager reports its removals once
+	seen.clear();
+	std::vector<Entity> dropped(entities.begin(), entities.begin() + 100);
+	bounds.RemoveComponents(dropped.data(), dropped.size());
+	section->Destroy();
+	bus.Dispatch();
+	EXPECT_EQ(sorted(at(EntityEvent::EntityDestroyed, nullptr).ids), idsOf(entities));
+	EXPECT_EQ(sorted(at(EntityEvent::ComponentRemoved, &values).ids), idsOf(entities));
+	EXPECT_EQ(at(EntityEvent::ComponentRemoved, &bounds).ids.size(), 1000);
+	EXPECT_EQ(at(EntityEvent::ComponentAdded, &bounds).batches, 0);
+	EXPECT_EQ(index.GetCount(), 0);
+
+	// events recorded by a subscriber wait for the next dispatch
+	seen.clear();
+	auto spawn = bus.Subscribe(EntityEvent::EntityCreated, nullptr, [&](EntityEventBatch const& batch)
+	{
+		values.AddComponents(batch.entities, batch.count);
+	});
+	Entity e = world.CreateSection()->CreateEntity();
+	bus.Dispatch();
+	EXPECT_EQ(at(EntityEvent::ComponentAdded, &values).batches, 0);
+	EXPECT_EQ(bus.GetPendingCount(), 1);
+	bus.Unsubscribe(spawn);
+	bus.Dispatch();
+	ASSERT_EQ(at(EntityEvent::ComponentAdded, &values).ids.size(), 1);
+	EXPECT_EQ(at(EntityEvent::ComponentAdded, &values).ids[0], e.GetId());
+
+	// a component removed and added again, then the entity destroyed and its id handed out
+	// again, reach subscribers in the order they happened
+	std::vector<EntityEvent> history;
+	Entity lone = world.GetEntityManager()->CreateEntity();
+	for (uint8_t type = 0; type < uint8_t(EntityEvent::Count); type++)
+	{
+		bus.Subscribe(EntityEvent(type), nullptr, [&history, lone](EntityEventBatch const& batch)
+		{
+			history.insert(history.end(), size_t(std::count(batch.ids, batch.ids + batch.count, lone.GetId())), batch.type);
+		});
+	}
+	values.AddComponent(lone);
+	values.RemoveComponent(lone);
+	values.AddComponent(lone);
+	world.GetEntityManager()->DestroyEntity(lone);
+	// more than the free list holds, one of them gets the id back
+	std::vector<Entity> recycled(3000);
+	world.GetEntityManager()->InitEntity(int(recycled.size()), recycled.data());
+	bus.Dispatch();
+	const std::vector<EntityEvent> expected = { EntityEvent::EntityCreated, EntityEvent::ComponentAdded,
+		EntityEvent::ComponentRemoved, EntityEvent::ComponentAdded, EntityEvent::ComponentRemoved,
+		EntityEvent::EntityDestroyed, EntityEvent::EntityCreated };
+	EXPECT_EQ(history, expected);
+
+	// without a bus nothing is recorded
+	world.GetEntityManager()->SetEventBus(nullptr);
+	values.AddComponent(world.CreateSection()->CreateEntity());
+	EXPECT_EQ(bus.GetPendingCount(), 0);
+}
+
+TEST(CORE_TEST, DISABLED_bench_entity_events)
+{
+	using namespace redtea;
+	using namespace redtea::core;
+	using Clock = std::chrono::steady_clock;
+	auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+	class ValueManager : public ComponentManagerBase<uint32_t>
+	{
+	};
+	const size_t count = 1000000;
+
+	// one AddComponent per entity, then a bulk removal, with and without a bus
+	auto run = [&](bool observed, double& add, double& remove, double& dispatch)
+	{
+		World world;
+		ValueManager values;
+		world.GetEntityManager()->RegisterComponentManager(&values);
+		EntityEventBus bus;
+		size_t delivered = 0;
+		bus.Subscribe(EntityEvent::ComponentAdded, nullptr, [&delivered](EntityEventBatch const& batch) { delivered += batch.count; });
+		bus.Subscribe(EntityEvent::ComponentRemoved, nullptr, [&delivered](EntityEventBatch const& batch) { delivered += batch.count; });
+		std::vector<Entity> entities(count);
+		world.GetEntityManager()->InitEntity(int(count), entities.data());
+		if (observed)
+		{
+			world.GetEntityManager()->SetEventBus(&bus);
+		}
+
+		auto start = Clock::now();
+		for (Entity e : entities)
+		{
+			values.AddComponent(e);
+		}
+		add = ms(start);
+		start = Clock::now();
+		values.RemoveComponents(entities.data(), count / 2);
+		remove = ms(start);
+		start = Clock::now();
+		bus.Dispatch();
+		dispatch = ms(start);
+		EXPECT_EQ(delivered, observed ? count + count / 2 : 0);
+	};
+	double add[2], remove[2], dispatch[2];
+	run(false, add[0], remove[0], dispatch[0]);
+	run(true, add[1], remove[1], dispatch[1]);
+	std::cout << "1M components added one by one: " << add[0] << " ms, with a bus " << add[1]
+		<< " ms; 500K removed in bulk: " << remove[0] << " ms, with a bus " << remove[1]
+		<< " ms; dispatch " << dispatch[1] << " ms" << std::endl;
+}
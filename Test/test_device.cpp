@@ -1,10 +1,20 @@
 #include "../Engine/Runtime/Device/RHI/resource.h"
+#include "../Engine/Runtime/Device/RHI/binding_set_cache.h"
 #include "../Engine/Runtime/Device/RHI/command_buffer.h"
+#include "../Engine/Runtime/Device/RHI/containers.h"
+#include "../Engine/Runtime/Device/RHI/pipeline_cache.h"
+#include "../Engine/Runtime/Device/RHI/pipeline_compiler.h"
+#include "../Engine/Runtime/Device/RHI/render_graph.h"
+#include "../Engine/Runtime/Device/RHI/rhi_utils.h"
+#include "../Engine/Runtime/Device/Backend/null/null-backend.h"
 #include "../Engine/Runtime/Device/window.h"
 #include "common.h"
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
 
 
 TEST(RESOURCE_TEST, resource)
@@ -92,4 +102,1840 @@ TEST(RHI_TEST, writebuffer_singletread)
 	buffer.Flush();
 	EXPECT_EQ(count, 10000);
 }
-#endif
\ No newline at end of file
+#endif
+
+namespace {
+
+	class CountingMessageCallback : public redtea::device::IMessageCallback
+	{
+	public:
+		int errors = 0;
+
+		void message(redtea::device::MessageSeverity severity, const char* messageText) override
+		{
+			(void)messageText;
+			if (severity == redtea::device::MessageSeverity::Error || severity == redtea::device::MessageSeverity::Fatal)
+				errors++;
+		}
+	};
+
+	struct RasterTarget
+	{
+		redtea::device::TextureHandle color;
+		redtea::device::TextureHandle depth;
+		redtea::device::FramebufferHandle framebuffer;
+
+		template <typename T>
+		const T& texel(redtea::device::ITexture* texture, uint32_t x, uint32_t y) const
+		{
+			redtea::device::TextureSlice slice;
+			slice.x = x;
+			slice.y = y;
+			return *reinterpret_cast<const T*>(static_cast<redtea::device::null::Texture*>(texture)->getTexel(slice));
+		}
+	};
+
+	RasterTarget createRasterTarget(redtea::device::IDevice* device, uint32_t width, uint32_t height, redtea::device::Format colorFormat)
+	{
+		using namespace redtea::device;
+		RasterTarget target;
+
+		TextureDesc desc;
+		desc.width = width;
+		desc.height = height;
+		desc.format = colorFormat;
+		desc.isRenderTarget = true;
+		desc.initialState = ResourceStates::RenderTarget;
+		desc.keepInitialState = true;
+		target.color = device->createTexture(desc);
+
+		desc.format = Format::D32;
+		desc.initialState = ResourceStates::DepthWrite;
+		target.depth = device->createTexture(desc);
+
+		target.framebuffer = device->createFramebuffer(FramebufferDesc().addColorAttachment(target.color).setDepthAttachment(target.depth));
+		return target;
+	}
+
+	// clip space positions (x, y, z, w) followed by varyingCount values per vertex
+	redtea::device::ShaderHandle createArrayVertexShader(redtea::device::IDevice* device, std::vector<float> vertices, uint32_t varyingCount)
+	{
+		using namespace redtea::device;
+		const uint32_t stride = 4 + varyingCount;
+		return static_cast<null::Device*>(device)->createVertexShader(
+			[vertices, stride, varyingCount](const null::ShaderContext&, uint32_t vertexIndex, uint32_t, float* position, float* varyings)
+			{
+				const float* vertex = &vertices[vertexIndex * stride];
+				std::copy(vertex, vertex + 4, position);
+				std::copy(vertex + 4, vertex + stride, varyings);
+				(void)varyingCount;
+			}, varyingCount);
+	}
+}
+
+TEST(RHI_TEST, null_buffer_roundtrip)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+	EXPECT_EQ(device->getGraphicsAPI(), GraphicsAPI::NULL_DEVICE);
+
+	BufferDesc desc;
+	desc.byteSize = 64;
+	desc.initialState = ResourceStates::CopyDest;
+	desc.keepInitialState = true;
+	BufferHandle src = device->createBuffer(desc);
+	BufferHandle dst = device->createBuffer(desc);
+
+	uint32_t values[4] = { 1, 2, 3, 4 };
+	CommandListHandle cmd = device->createCommandList();
+	cmd->open();
+	cmd->clearBufferUInt(dst, 7);
+	cmd->writeBuffer(src, values, sizeof(values), 16);
+	cmd->copyBuffer(dst, 0, src, 16, sizeof(values));
+	cmd->close();
+
+	// nothing runs before the command list is executed
+	const uint32_t* mapped = static_cast<const uint32_t*>(device->mapBuffer(dst, CpuAccessMode::Read));
+	EXPECT_EQ(mapped[0], 0u);
+
+	device->executeCommandLists(&cmd, 1);
+	EXPECT_EQ(mapped[0], 1u);
+	EXPECT_EQ(mapped[3], 4u);
+	EXPECT_EQ(mapped[4], 7u);
+	EXPECT_EQ(mapped[15], 7u);
+	device->unmapBuffer(dst);
+
+	const null::CommandListStatistics& stats = static_cast<null::CommandList*>(cmd.Get())->getStatistics();
+	EXPECT_EQ(stats.transfers, 3u);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, null_texture_readback)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+
+	TextureDesc desc;
+	desc.width = 4;
+	desc.height = 4;
+	desc.mipLevels = 2;
+	desc.format = Format::RGBA8_UNORM;
+	desc.isRenderTarget = true;
+	desc.initialState = ResourceStates::ShaderResource;
+	desc.keepInitialState = true;
+	TextureHandle texture = device->createTexture(desc);
+	StagingTextureHandle staging = device->createStagingTexture(desc, CpuAccessMode::Read);
+
+	// rows padded to 32 bytes by the caller
+	uint8_t data[4 * 32] = {};
+	for (int row = 0; row < 4; row++)
+		for (int x = 0; x < 16; x++)
+			data[row * 32 + x] = uint8_t(row * 16 + x);
+
+	CommandListHandle cmd = device->createCommandList();
+	cmd->open();
+	cmd->writeTexture(texture, 0, 0, data, 32, 0);
+	cmd->clearTextureFloat(texture, TextureSubresourceSet(1, 1, 0, 1), Color(1.f, 0.f, 0.f, 1.f));
+	cmd->copyTexture(staging, TextureSlice(), texture, TextureSlice());
+	TextureSlice mip1;
+	mip1.mipLevel = 1;
+	cmd->copyTexture(staging, mip1, texture, mip1);
+	cmd->close();
+	device->executeCommandLists(&cmd, 1);
+
+	size_t rowPitch = 0;
+	const uint8_t* texels = static_cast<const uint8_t*>(device->mapStagingTexture(staging, TextureSlice(), CpuAccessMode::Read, &rowPitch));
+	EXPECT_EQ(rowPitch, 16u);
+	EXPECT_EQ(texels[0], 0);
+	EXPECT_EQ(texels[rowPitch * 3 + 15], 63);
+	device->unmapStagingTexture(staging);
+
+	texels = static_cast<const uint8_t*>(device->mapStagingTexture(staging, mip1, CpuAccessMode::Read, &rowPitch));
+	EXPECT_EQ(rowPitch, 8u);
+	EXPECT_EQ(texels[0], 255);
+	EXPECT_EQ(texels[1], 0);
+	EXPECT_EQ(texels[7], 255);
+	device->unmapStagingTexture(staging);
+
+	// the texture went back to its initial state on close
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, null_state_tracking)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+
+	BufferDesc bufferDesc;
+	bufferDesc.byteSize = 256;
+	bufferDesc.canHaveUAVs = true;
+	bufferDesc.initialState = ResourceStates::ShaderResource;
+	bufferDesc.keepInitialState = true;
+	BufferHandle buffer = device->createBuffer(bufferDesc);
+	bufferDesc.initialState = ResourceStates::ConstantBuffer;
+	BufferHandle constants = device->createBuffer(bufferDesc);
+
+	BindingLayoutDesc layoutDesc;
+	layoutDesc.visibility = ShaderType::Compute;
+	layoutDesc.bindings = { BindingLayoutItem::RawBuffer_UAV(0), BindingLayoutItem::ConstantBuffer(0) };
+	BindingLayoutHandle layout = device->createBindingLayout(layoutDesc);
+
+	BindingSetDesc setDesc;
+	setDesc.bindings = { BindingSetItem::RawBuffer_UAV(0, buffer), BindingSetItem::ConstantBuffer(0, constants) };
+	BindingSetHandle bindingSet = device->createBindingSet(setDesc, layout);
+	EXPECT_EQ(callback.errors, 0);
+
+	ComputePipelineDesc pipelineDesc;
+	pipelineDesc.bindingLayouts = { layout };
+	ComputePipelineHandle pipeline = device->createComputePipeline(pipelineDesc);
+
+	CommandListHandle cmd = device->createCommandList();
+	null::CommandList* nullCmd = static_cast<null::CommandList*>(cmd.Get());
+
+	cmd->open();
+	cmd->setPermanentBufferState(constants, ResourceStates::ConstantBuffer);
+	ComputeState state;
+	state.pipeline = pipeline;
+	state.bindings = { bindingSet };
+	cmd->setComputeState(state);
+	cmd->dispatch(1);
+	EXPECT_EQ(cmd->getBufferState(buffer), ResourceStates::UnorderedAccess);
+	// same binding set, the UAV gets a barrier between the dispatches
+	cmd->setComputeState(state);
+	cmd->dispatch(1);
+	cmd->close();
+
+	const null::CommandListStatistics& stats = nullCmd->getStatistics();
+	EXPECT_EQ(stats.dispatches, 2u);
+	// to UAV, and back to the initial state on close
+	EXPECT_EQ(stats.bufferBarriers, 2u);
+	EXPECT_EQ(stats.uavBarriers, 1u);
+	device->executeCommandLists(&cmd, 1);
+
+	// the permanent state holds across command lists without barriers
+	cmd->open();
+	cmd->setComputeState(state);
+	cmd->dispatch(1);
+	EXPECT_EQ(static_cast<null::Buffer*>(constants.Get())->permanentState, ResourceStates::ConstantBuffer);
+	cmd->close();
+	EXPECT_EQ(nullCmd->getStatistics().bufferBarriers, 2u);
+	device->executeCommandLists(&cmd, 1);
+	EXPECT_EQ(callback.errors, 0);
+
+	// a binding the layout does not declare
+	setDesc.bindings = { BindingSetItem::StructuredBuffer_SRV(3, buffer) };
+	device->createBindingSet(setDesc, layout);
+	EXPECT_EQ(callback.errors, 1);
+}
+
+TEST(RHI_TEST, null_queue_instances)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	deviceDesc.enableCopyQueue = false;
+	DeviceHandle device = null::createDevice(deviceDesc);
+
+	EXPECT_TRUE(device->queryFeatureSupport(Feature::ComputeQueue));
+	EXPECT_FALSE(device->queryFeatureSupport(Feature::CopyQueue));
+	EXPECT_TRUE(device->createCommandList(CommandListParameters().setQueueType(CommandQueue::Copy)) == nullptr);
+
+	CommandListHandle cmd = device->createCommandList(CommandListParameters().setQueueType(CommandQueue::Compute));
+	EventQueryHandle query = device->createEventQuery();
+	EXPECT_FALSE(device->pollEventQuery(query));
+
+	for (uint64_t i = 1; i <= 3; i++)
+	{
+		cmd->open();
+		cmd->close();
+		EXPECT_EQ(device->executeCommandLists(&cmd, 1, CommandQueue::Compute), i);
+	}
+	device->setEventQuery(query, CommandQueue::Compute);
+	EXPECT_TRUE(device->pollEventQuery(query));
+
+	null::Queue* queue = static_cast<null::Device*>(device.Get())->getQueue(CommandQueue::Compute);
+	EXPECT_EQ(queue->commandListsInFlight.size(), 3u);
+	device->runGarbageCollection();
+	EXPECT_TRUE(queue->commandListsInFlight.empty());
+	EXPECT_EQ(static_cast<null::Device*>(device.Get())->getQueue(CommandQueue::Graphics)->lastSubmittedInstance, 0u);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, DISABLED_bench_null_recording)
+{
+	using namespace redtea::device;
+	DeviceHandle device = null::createDevice(null::DeviceDesc());
+
+	BufferDesc bufferDesc;
+	bufferDesc.byteSize = 256;
+	bufferDesc.canHaveUAVs = true;
+	bufferDesc.initialState = ResourceStates::ShaderResource;
+	bufferDesc.keepInitialState = true;
+
+	BindingLayoutDesc layoutDesc;
+	layoutDesc.visibility = ShaderType::Compute;
+	layoutDesc.bindings = { BindingLayoutItem::RawBuffer_UAV(0), BindingLayoutItem::RawBuffer_SRV(0) };
+	BindingLayoutHandle layout = device->createBindingLayout(layoutDesc);
+
+	std::vector<BufferHandle> buffers;
+	std::vector<BindingSetHandle> bindingSets;
+	for (int i = 0; i < 64; i++)
+		buffers.push_back(device->createBuffer(bufferDesc));
+	for (int i = 0; i < 64; i++)
+	{
+		BindingSetDesc setDesc;
+		setDesc.bindings = { BindingSetItem::RawBuffer_UAV(0, buffers[i]), BindingSetItem::RawBuffer_SRV(0, buffers[(i + 1) % 64]) };
+		bindingSets.push_back(device->createBindingSet(setDesc, layout));
+	}
+
+	ComputePipelineDesc pipelineDesc;
+	pipelineDesc.bindingLayouts = { layout };
+	ComputePipelineHandle pipeline = device->createComputePipeline(pipelineDesc);
+	CommandListHandle cmd = device->createCommandList();
+
+	const int frames = 200;
+	const int dispatches = 1000;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		cmd->open();
+		for (int i = 0; i < dispatches; i++)
+		{
+			ComputeState state;
+			state.pipeline = pipeline;
+			state.bindings = { bindingSets[i % 64] };
+			cmd->setComputeState(state);
+			cmd->dispatch(1);
+		}
+		cmd->close();
+		device->executeCommandLists(&cmd, 1);
+		device->runGarbageCollection();
+	}
+	auto end = std::chrono::steady_clock::now();
+	const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	std::cout << "null backend: " << ns / (frames * dispatches) << " ns per setComputeState + dispatch" << std::endl;
+}
+
+TEST(RHI_TEST, null_raster_depth)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+	RasterTarget target = createRasterTarget(device, 16, 16, Format::RGBA8_UNORM);
+
+	// a near red triangle drawn before a far green one over the left half of the target
+	ShaderHandle vs = createArrayVertexShader(device, {
+		-1.f, -1.f, 0.25f, 1.f, 1.f, 0.f,
+		-1.f, 1.f, 0.25f, 1.f, 1.f, 0.f,
+		0.f, -1.f, 0.25f, 1.f, 1.f, 0.f,
+		-1.f, -1.f, 0.75f, 1.f, 0.f, 1.f,
+		-1.f, 1.f, 0.75f, 1.f, 0.f, 1.f,
+		0.f, 1.f, 0.75f, 1.f, 0.f, 1.f,
+	}, 2);
+	ShaderHandle ps = static_cast<null::Device*>(device.Get())->createPixelShader(
+		[](const null::ShaderContext&, const float*, const float* varyings, float* colors)
+		{
+			colors[0] = varyings[0];
+			colors[1] = varyings[1];
+			colors[2] = 0.f;
+			colors[3] = 1.f;
+			return true;
+		});
+
+	GraphicsPipelineDesc pipelineDesc;
+	pipelineDesc.VS = vs;
+	pipelineDesc.PS = ps;
+	GraphicsPipelineHandle pipeline = device->createGraphicsPipeline(pipelineDesc, target.framebuffer);
+
+	CommandListHandle cmd = device->createCommandList();
+	cmd->open();
+	cmd->clearTextureFloat(target.color, AllSubresources, Color(0.f));
+	cmd->clearDepthStencilTexture(target.depth, AllSubresources, true, 1.f, false, 0);
+	GraphicsState state;
+	state.setPipeline(pipeline).setFramebuffer(target.framebuffer).setViewport(ViewportState().addViewportAndScissorRect(Viewport(16.f, 16.f)));
+	cmd->setGraphicsState(state);
+	DrawArguments args;
+	args.vertexCount = 6;
+	cmd->draw(args);
+	cmd->close();
+	device->executeCommandLists(&cmd, 1);
+
+	typedef uint8_t Rgba[4];
+	// covered by both, the near triangle wins
+	EXPECT_EQ(target.texel<Rgba>(target.color, 1, 8)[0], 255);
+	EXPECT_EQ(target.texel<Rgba>(target.color, 1, 8)[1], 0);
+	EXPECT_FLOAT_EQ(target.texel<float>(target.depth, 1, 8), 0.25f);
+	// only the far triangle
+	EXPECT_EQ(target.texel<Rgba>(target.color, 6, 1)[1], 255);
+	EXPECT_FLOAT_EQ(target.texel<float>(target.depth, 6, 1), 0.75f);
+	// right half untouched
+	EXPECT_EQ(target.texel<Rgba>(target.color, 12, 8)[0], 0);
+	EXPECT_EQ(target.texel<Rgba>(target.color, 12, 8)[3], 0);
+	EXPECT_FLOAT_EQ(target.texel<float>(target.depth, 12, 8), 1.f);
+
+	const null::RasterizerStatistics& stats = static_cast<null::Device*>(device.Get())->getRasterizer()->getStatistics();
+	EXPECT_EQ(stats.triangles, 2u);
+	EXPECT_EQ(stats.culledTriangles, 0u);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, null_raster_shared_edges)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+	RasterTarget target = createRasterTarget(device, 37, 29, Format::R32_FLOAT);
+
+	// a fan of 12 triangles around a point off the pixel grid covers the whole target, every
+	// pixel has to be shaded exactly once by the shared edges
+	std::vector<float> vertices;
+	const float center[2] = { 0.13f, -0.07f };
+	for (int i = 0; i < 12; i++)
+	{
+		const float a0 = 6.2831853f * float(i) / 12.f;
+		const float a1 = 6.2831853f * float(i + 1) / 12.f;
+		const float points[3][2] = {
+			{ center[0], center[1] },
+			{ center[0] + 2.f * std::cos(a1), center[1] + 2.f * std::sin(a1) },
+			{ center[0] + 2.f * std::cos(a0), center[1] + 2.f * std::sin(a0) } };
+		for (const auto& point : points)
+			vertices.insert(vertices.end(), { point[0], point[1], 0.5f, 1.f });
+	}
+	ShaderHandle vs = createArrayVertexShader(device, vertices, 0);
+	ShaderHandle ps = static_cast<null::Device*>(device.Get())->createPixelShader(
+		[](const null::ShaderContext&, const float*, const float*, float* colors)
+		{
+			colors[0] = 1.f;
+			return true;
+		});
+
+	GraphicsPipelineDesc pipelineDesc;
+	pipelineDesc.VS = vs;
+	pipelineDesc.PS = ps;
+	pipelineDesc.renderState.depthStencilState.depthTestEnable = false;
+	pipelineDesc.renderState.blendState.targets[0].enableBlend().setSrcBlend(BlendFactor::One).setDestBlend(BlendFactor::One);
+	GraphicsPipelineHandle pipeline = device->createGraphicsPipeline(pipelineDesc, target.framebuffer);
+
+	CommandListHandle cmd = device->createCommandList();
+	cmd->open();
+	cmd->clearTextureFloat(target.color, AllSubresources, Color(0.f));
+	GraphicsState state;
+	state.setPipeline(pipeline).setFramebuffer(target.framebuffer).setViewport(ViewportState().addViewportAndScissorRect(Viewport(37.f, 29.f)));
+	cmd->setGraphicsState(state);
+	DrawArguments args;
+	args.vertexCount = uint32_t(vertices.size() / 4);
+	cmd->draw(args);
+	cmd->close();
+	device->executeCommandLists(&cmd, 1);
+
+	int wrong = 0;
+	for (uint32_t y = 0; y < 29; y++)
+		for (uint32_t x = 0; x < 37; x++)
+			wrong += target.texel<float>(target.color, x, y) == 1.f ? 0 : 1;
+	EXPECT_EQ(wrong, 0);
+
+	const null::RasterizerStatistics& stats = static_cast<null::Device*>(device.Get())->getRasterizer()->getStatistics();
+	EXPECT_EQ(stats.shadedPixels, 37u * 29u);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, null_raster_indexed)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+	RasterTarget target = createRasterTarget(device, 8, 8, Format::RG32_FLOAT);
+
+	// positions and u come from a vertex buffer, the offset comes from the push constants
+	const float vertexData[] = {
+		-1.f, -1.f, 0.f,
+		-1.f, 1.f, 0.f,
+		1.f, 1.f, 1.f,
+		1.f, -1.f, 1.f,
+	};
+	BufferDesc bufferDesc;
+	bufferDesc.byteSize = sizeof(vertexData);
+	bufferDesc.isVertexBuffer = true;
+	bufferDesc.initialState = ResourceStates::VertexBuffer;
+	bufferDesc.keepInitialState = true;
+	BufferHandle vertexBuffer = device->createBuffer(bufferDesc);
+
+	// the quad, then the same quad with the opposite winding which is culled
+	const uint16_t indices[] = { 0, 1, 2, 0, 2, 3, 0, 2, 1, 0, 3, 2 };
+	bufferDesc.byteSize = sizeof(indices);
+	bufferDesc.isVertexBuffer = false;
+	bufferDesc.isIndexBuffer = true;
+	bufferDesc.initialState = ResourceStates::IndexBuffer;
+	BufferHandle indexBuffer = device->createBuffer(bufferDesc);
+
+	VertexAttributeDesc attribute;
+	attribute.setFormat(Format::RGB32_FLOAT).setElementStride(sizeof(float) * 3);
+	InputLayoutHandle inputLayout = device->createInputLayout(&attribute, 1, nullptr);
+
+	ShaderHandle vs = static_cast<null::Device*>(device.Get())->createVertexShader(
+		[](const null::ShaderContext& context, uint32_t vertexIndex, uint32_t, float* position, float* varyings)
+		{
+			const float* vertex = reinterpret_cast<const float*>(context.getVertex(0, vertexIndex));
+			position[0] = vertex[0];
+			position[1] = vertex[1];
+			position[2] = 0.5f;
+			position[3] = 1.f;
+			varyings[0] = vertex[2];
+		}, 1);
+	ShaderHandle ps = static_cast<null::Device*>(device.Get())->createPixelShader(
+		[](const null::ShaderContext& context, const float*, const float* varyings, float* colors)
+		{
+			colors[0] = varyings[0];
+			colors[1] = *reinterpret_cast<const float*>(context.pushConstants);
+			return true;
+		});
+
+	GraphicsPipelineDesc pipelineDesc;
+	pipelineDesc.VS = vs;
+	pipelineDesc.PS = ps;
+	pipelineDesc.inputLayout = inputLayout;
+	pipelineDesc.renderState.depthStencilState.depthFunc = ComparisonFunc::Always;
+	GraphicsPipelineHandle pipeline = device->createGraphicsPipeline(pipelineDesc, target.framebuffer);
+
+	CommandListHandle cmd = device->createCommandList();
+	cmd->open();
+	cmd->writeBuffer(vertexBuffer, vertexData, sizeof(vertexData));
+	cmd->writeBuffer(indexBuffer, indices, sizeof(indices));
+	cmd->clearTextureFloat(target.color, AllSubresources, Color(-1.f));
+	cmd->clearDepthStencilTexture(target.depth, AllSubresources, true, 1.f, false, 0);
+
+	VertexBufferBinding vertexBinding;
+	vertexBinding.buffer = vertexBuffer;
+	vertexBinding.slot = 0;
+	vertexBinding.offset = 0;
+	IndexBufferBinding indexBinding;
+	indexBinding.buffer = indexBuffer;
+	indexBinding.format = Format::R16_UINT;
+	indexBinding.offset = 0;
+	GraphicsState state;
+	state.setPipeline(pipeline).setFramebuffer(target.framebuffer).addVertexBuffer(vertexBinding).setIndexBuffer(indexBinding);
+	cmd->setGraphicsState(state);
+	const float offset = 3.f;
+	cmd->setPushConstants(&offset, sizeof(offset));
+	DrawArguments args;
+	args.vertexCount = 12;
+	cmd->drawIndexed(args);
+	cmd->close();
+	device->executeCommandLists(&cmd, 1);
+
+	// u runs from 0 on the left to 1 on the right, sampled at pixel centers
+	for (uint32_t x = 0; x < 8; x++)
+	{
+		EXPECT_NEAR(target.texel<float>(target.color, x, 0), (float(x) + 0.5f) / 8.f, 1e-5f);
+		EXPECT_NEAR(target.texel<float>(target.color, x, 7), (float(x) + 0.5f) / 8.f, 1e-5f);
+	}
+	EXPECT_EQ((&target.texel<float>(target.color, 4, 4))[1], 3.f);
+	EXPECT_FLOAT_EQ(target.texel<float>(target.depth, 4, 4), 0.5f);
+
+	const null::RasterizerStatistics& stats = static_cast<null::Device*>(device.Get())->getRasterizer()->getStatistics();
+	EXPECT_EQ(stats.triangles, 4u);
+	EXPECT_EQ(stats.culledTriangles, 2u);
+	EXPECT_EQ(stats.shadedPixels, 64u);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, DISABLED_bench_soft_raster)
+{
+	using namespace redtea::device;
+
+	// a 1024x1024 RGBA8 + D32 target covered 4 times by a grid of small triangles
+	const int cells = 128;
+	const int layers = 4;
+	std::vector<float> vertices;
+	for (int layer = 0; layer < layers; layer++)
+	{
+		const float z = 0.9f - 0.2f * float(layer);
+		for (int cy = 0; cy < cells; cy++)
+		{
+			for (int cx = 0; cx < cells; cx++)
+			{
+				const float x0 = -1.f + 2.f * float(cx) / cells, x1 = -1.f + 2.f * float(cx + 1) / cells;
+				const float y0 = -1.f + 2.f * float(cy) / cells, y1 = -1.f + 2.f * float(cy + 1) / cells;
+				const float quad[6][2] = { { x0, y0 }, { x0, y1 }, { x1, y1 }, { x0, y0 }, { x1, y1 }, { x1, y0 } };
+				for (const auto& point : quad)
+					vertices.insert(vertices.end(), { point[0], point[1], z, 1.f, float(cx) / cells, float(cy) / cells });
+			}
+		}
+	}
+
+	for (int32_t workers : { 0, -1 })
+	{
+		null::DeviceDesc deviceDesc;
+		deviceDesc.rasterizerWorkerCount = workers;
+		DeviceHandle device = null::createDevice(deviceDesc);
+		RasterTarget target = createRasterTarget(device, 1024, 1024, Format::RGBA8_UNORM);
+
+		GraphicsPipelineDesc pipelineDesc;
+		pipelineDesc.VS = createArrayVertexShader(device, vertices, 2);
+		pipelineDesc.PS = static_cast<null::Device*>(device.Get())->createPixelShader(
+			[](const null::ShaderContext&, const float*, const float* varyings, float* colors)
+			{
+				colors[0] = varyings[0];
+				colors[1] = varyings[1];
+				colors[2] = 0.5f;
+				colors[3] = 1.f;
+				return true;
+			});
+		GraphicsPipelineHandle pipeline = device->createGraphicsPipeline(pipelineDesc, target.framebuffer);
+
+		GraphicsState state;
+		state.setPipeline(pipeline).setFramebuffer(target.framebuffer).setViewport(ViewportState().addViewportAndScissorRect(Viewport(1024.f, 1024.f)));
+		DrawArguments args;
+		args.vertexCount = uint32_t(vertices.size() / 6);
+		CommandListHandle cmd = device->createCommandList();
+
+		const int frames = 10;
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			cmd->open();
+			cmd->clearDepthStencilTexture(target.depth, AllSubresources, true, 1.f, false, 0);
+			cmd->setGraphicsState(state);
+			cmd->draw(args);
+			cmd->close();
+			device->executeCommandLists(&cmd, 1);
+		}
+		auto end = std::chrono::steady_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		std::cout << "soft raster, " << (workers < 0 ? "default" : "0") << " workers: " << ms / frames << " ms per frame of "
+			<< args.vertexCount / 3 << " triangles" << std::endl;
+	}
+}
+
+TEST(RHI_TEST, render_graph_aliasing)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+
+	TextureDesc desc;
+	desc.width = 16;
+	desc.height = 16;
+	desc.format = Format::RGBA8_UNORM;
+	desc.isRenderTarget = true;
+	desc.initialState = ResourceStates::ShaderResource;
+	desc.keepInitialState = true;
+	TextureHandle output = device->createTexture(desc);
+
+	RenderGraph graph(device);
+	CommandListHandle cmd = device->createCommandList();
+	ITexture* firstFrameTexture = nullptr;
+
+	for (int frame = 0; frame < 2; frame++)
+	{
+		// a -> b -> c -> output, a and c can share memory. Two passes nobody reads are culled.
+		RenderGraphTexture outputHandle = graph.importTexture(output, ResourceStates::ShaderResource);
+		RenderGraphTexture a, b, c, unused;
+		graph.addPass("clear", [&](RenderGraphBuilder& builder) {
+			a = builder.write(builder.createTexture(desc), ResourceStates::CopyDest);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->clearTextureFloat(context.getTexture(a), AllSubresources, Color(1.f, 0.f, 0.f, 1.f));
+		});
+		graph.addPass("copy a", [&](RenderGraphBuilder& builder) {
+			builder.read(a, ResourceStates::CopySource);
+			b = builder.write(builder.createTexture(desc), ResourceStates::CopyDest);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->copyTexture(context.getTexture(b), TextureSlice(), context.getTexture(a), TextureSlice());
+		});
+		const uint32_t debugPass = graph.addPass("debug", [&](RenderGraphBuilder& builder) {
+			builder.read(b);
+			unused = builder.write(builder.createTexture(desc));
+		}, nullptr);
+		const uint32_t debugConsumerPass = graph.addPass("debug consumer", [&](RenderGraphBuilder& builder) {
+			builder.read(unused);
+			builder.write(builder.createTexture(desc));
+		}, nullptr);
+		graph.addPass("copy b", [&](RenderGraphBuilder& builder) {
+			builder.read(b, ResourceStates::CopySource);
+			c = builder.write(builder.createTexture(desc), ResourceStates::CopyDest);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->copyTexture(context.getTexture(c), TextureSlice(), context.getTexture(b), TextureSlice());
+		});
+		graph.addPass("resolve", [&](RenderGraphBuilder& builder) {
+			builder.read(c, ResourceStates::CopySource);
+			builder.write(outputHandle, ResourceStates::CopyDest);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->copyTexture(context.getTexture(outputHandle), TextureSlice(), context.getTexture(c), TextureSlice());
+			if (!firstFrameTexture)
+				firstFrameTexture = context.getTexture(c);
+			else
+				EXPECT_EQ(firstFrameTexture, context.getTexture(c));
+		});
+		graph.compile();
+
+		cmd->open();
+		graph.execute(cmd);
+		cmd->close();
+		device->executeCommandLists(&cmd, 1);
+
+		const RenderGraphStatistics& stats = graph.getStatistics();
+		EXPECT_TRUE(graph.isPassCulled(debugPass));
+		EXPECT_TRUE(graph.isPassCulled(debugConsumerPass));
+		EXPECT_EQ(stats.culledPasses, 2u);
+		EXPECT_EQ(stats.transientTextures, 3u);
+		EXPECT_EQ(stats.heapBytes * 3, stats.transientBytes * 2);
+		EXPECT_EQ(stats.getSavedBytes(), stats.transientBytes / 3);
+		// a, b, c to their write and read states, output there and back
+		EXPECT_EQ(stats.barriers, 8u);
+		EXPECT_EQ(stats.barrierBatches, 5u);
+		EXPECT_EQ(static_cast<null::CommandList*>(cmd.Get())->getStatistics().textureBarriers, 8u);
+
+		graph.reset();
+	}
+
+	TextureSlice corner;
+	corner.x = 15;
+	corner.y = 15;
+	const uint8_t* texel = static_cast<null::Texture*>(output.Get())->getTexel(corner);
+	EXPECT_EQ(texel[0], 255);
+	EXPECT_EQ(texel[1], 0);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, render_graph_barriers)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+
+	BufferDesc desc;
+	desc.byteSize = 256;
+	desc.canHaveUAVs = true;
+	BufferHandle buffer = device->createBuffer(desc);
+
+	RenderGraph graph(device);
+	RenderGraphBuffer handle = graph.importBuffer(buffer, ResourceStates::Common);
+	for (int i = 0; i < 2; i++)
+		graph.addPass("simulate", [&](RenderGraphBuilder& builder) { builder.write(handle); }, nullptr);
+
+	// consecutive reads in different states need a single barrier to the combined state
+	graph.addPass("draw", [&](RenderGraphBuilder& builder) {
+		builder.read(handle);
+		builder.setSideEffects();
+	}, nullptr);
+	graph.addPass("readback", [&](RenderGraphBuilder& builder) {
+		builder.read(handle, ResourceStates::CopySource);
+		builder.setSideEffects();
+	}, nullptr);
+	graph.compile();
+
+	CommandListHandle cmd = device->createCommandList();
+	cmd->open();
+	graph.execute(cmd);
+	cmd->close();
+
+	const RenderGraphStatistics& stats = graph.getStatistics();
+	EXPECT_EQ(stats.culledPasses, 0u);
+	EXPECT_EQ(stats.barriers, 3u);
+	EXPECT_EQ(stats.uavBarriers, 1u);
+	EXPECT_EQ(stats.barrierBatches, 4u);
+
+	const null::CommandListStatistics& listStats = static_cast<null::CommandList*>(cmd.Get())->getStatistics();
+	EXPECT_EQ(listStats.bufferBarriers, 3u);
+	EXPECT_EQ(listStats.uavBarriers, 1u);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, render_graph_async_queues)
+{
+	using namespace redtea::device;
+
+	for (bool asyncQueues : { true, false })
+	{
+		CountingMessageCallback callback;
+		null::DeviceDesc deviceDesc;
+		deviceDesc.errorCB = &callback;
+		deviceDesc.enableComputeQueue = asyncQueues;
+		deviceDesc.enableCopyQueue = asyncQueues;
+		DeviceHandle device = null::createDevice(deviceDesc);
+
+		BufferDesc desc;
+		desc.byteSize = 16;
+		desc.canHaveUAVs = true;
+		BufferHandle output = device->createBuffer(desc);
+
+		RenderGraph graph(device);
+		RenderGraphBuffer outputHandle = graph.importBuffer(output, ResourceStates::Common);
+		RenderGraphBuffer shadow, particles, upload, hdr, exposure;
+
+		// shadows, particles and the upload overlap, lighting joins them. Exposure runs on the
+		// compute queue after lighting and tonemapping waits for it, the copy queue is covered by
+		// the earlier wait of lighting and needs no other one.
+		const uint32_t shadowPass = graph.addPass("shadow", [&](RenderGraphBuilder& builder) {
+			shadow = builder.write(builder.createBuffer(desc), ResourceStates::CopyDest);
+			builder.setCost(2.f);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->clearBufferUInt(context.getBuffer(shadow), 1);
+		});
+		const uint32_t particlesPass = graph.addPass("particles", [&](RenderGraphBuilder& builder) {
+			particles = builder.write(builder.createBuffer(desc), ResourceStates::UnorderedAccess);
+			builder.setQueue(CommandQueue::Compute);
+			builder.setCost(2.f);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->clearBufferUInt(context.getBuffer(particles), 2);
+		});
+		const uint32_t uploadPass = graph.addPass("upload", [&](RenderGraphBuilder& builder) {
+			upload = builder.write(builder.createBuffer(desc), ResourceStates::CopyDest);
+			builder.setQueue(CommandQueue::Copy);
+		}, [&](RenderGraphContext& context) {
+			const uint32_t values[4] = { 3, 3, 3, 3 };
+			context.getCommandList()->writeBuffer(context.getBuffer(upload), values, sizeof(values));
+		});
+		graph.addPass("lighting", [&](RenderGraphBuilder& builder) {
+			builder.read(shadow, ResourceStates::CopySource);
+			builder.read(particles, ResourceStates::CopySource);
+			builder.read(upload, ResourceStates::CopySource);
+			hdr = builder.write(builder.createBuffer(desc), ResourceStates::CopyDest);
+			builder.setCost(2.f);
+		}, [&](RenderGraphContext& context) {
+			ICommandList* commandList = context.getCommandList();
+			commandList->copyBuffer(context.getBuffer(hdr), 0, context.getBuffer(shadow), 0, 4);
+			commandList->copyBuffer(context.getBuffer(hdr), 4, context.getBuffer(particles), 0, 4);
+			commandList->copyBuffer(context.getBuffer(hdr), 8, context.getBuffer(upload), 0, 8);
+		});
+		const uint32_t exposurePass = graph.addPass("exposure", [&](RenderGraphBuilder& builder) {
+			builder.read(hdr, ResourceStates::CopySource);
+			exposure = builder.write(builder.createBuffer(desc), ResourceStates::CopyDest);
+			builder.setQueue(CommandQueue::Compute);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->copyBuffer(context.getBuffer(exposure), 0, context.getBuffer(hdr), 0, 16);
+		});
+		graph.addPass("tonemap", [&](RenderGraphBuilder& builder) {
+			builder.read(hdr, ResourceStates::CopySource);
+			builder.read(exposure, ResourceStates::CopySource);
+			builder.write(outputHandle, ResourceStates::CopyDest);
+		}, [&](RenderGraphContext& context) {
+			context.getCommandList()->copyBuffer(context.getBuffer(outputHandle), 0, context.getBuffer(exposure), 0, 16);
+		});
+		graph.compile();
+		graph.submit();
+
+		const RenderGraphStatistics& stats = graph.getStatistics();
+		const std::vector<RenderGraphSubmission>& submissions = graph.getSubmissions();
+		EXPECT_FLOAT_EQ(stats.serialCost, 9.f);
+		if (asyncQueues)
+		{
+			EXPECT_EQ(graph.getPassQueue(shadowPass), CommandQueue::Graphics);
+			EXPECT_EQ(graph.getPassQueue(particlesPass), CommandQueue::Compute);
+			EXPECT_EQ(graph.getPassQueue(uploadPass), CommandQueue::Copy);
+			EXPECT_EQ(graph.getPassQueue(exposurePass), CommandQueue::Compute);
+			EXPECT_EQ(stats.asyncPasses, 3u);
+
+			ASSERT_EQ(submissions.size(), 6u);
+			EXPECT_EQ(submissions[3].waits.size(), 2u);
+			EXPECT_EQ(VersionGetQueue(submissions[4].waits[0]), CommandQueue::Graphics);
+			EXPECT_EQ(VersionGetInstance(submissions[4].waits[0]), 3u);
+			EXPECT_EQ(submissions[5].waits.size(), 1u);
+			EXPECT_EQ(stats.crossQueueWaits, 4u);
+			// shadow, particles and upload side by side, then lighting, exposure and tonemap
+			EXPECT_FLOAT_EQ(stats.scheduledCost, 6.f);
+			EXPECT_FLOAT_EQ(stats.getExpectedOverlap(), 3.f);
+		}
+		else
+		{
+			EXPECT_EQ(stats.asyncPasses, 0u);
+			EXPECT_EQ(submissions.size(), 1u);
+			EXPECT_EQ(stats.crossQueueWaits, 0u);
+			EXPECT_FLOAT_EQ(stats.getExpectedOverlap(), 0.f);
+		}
+
+		const uint32_t* values = static_cast<const uint32_t*>(device->mapBuffer(output, CpuAccessMode::Read));
+		EXPECT_EQ(values[0], 1u);
+		EXPECT_EQ(values[1], 2u);
+		EXPECT_EQ(values[2], 3u);
+		EXPECT_EQ(values[3], 3u);
+		device->unmapBuffer(output);
+		EXPECT_EQ(callback.errors, 0);
+	}
+}
+
+TEST(RHI_TEST, render_graph_async_aliasing)
+{
+	using namespace redtea::device;
+
+	for (bool asyncQueues : { true, false })
+	{
+		for (bool ordered : { true, false })
+		{
+			CountingMessageCallback callback;
+			null::DeviceDesc deviceDesc;
+			deviceDesc.errorCB = &callback;
+			deviceDesc.enableComputeQueue = asyncQueues;
+			DeviceHandle device = null::createDevice(deviceDesc);
+
+			BufferDesc desc;
+			desc.byteSize = 16;
+			desc.canHaveUAVs = true;
+			BufferHandle bloomOutput = device->createBuffer(desc);
+			BufferHandle particlesOutput = device->createBuffer(desc);
+
+			RenderGraph graph(device);
+			RenderGraphBuffer bloomHandle = graph.importBuffer(bloomOutput, ResourceStates::Common);
+			RenderGraphBuffer particlesHandle = graph.importBuffer(particlesOutput, ResourceStates::Common);
+			RenderGraphBuffer bloom, particles;
+
+			// the lifetimes of bloom and particles don't overlap in pass order, but unless the
+			// particles wait for the bloom output the compute queue may run them next to each other
+			graph.addPass("bloom", [&](RenderGraphBuilder& builder) {
+				bloom = builder.write(builder.createBuffer(desc), ResourceStates::CopyDest);
+			}, [&](RenderGraphContext& context) {
+				context.getCommandList()->clearBufferUInt(context.getBuffer(bloom), 1);
+			});
+			graph.addPass("bloom resolve", [&](RenderGraphBuilder& builder) {
+				builder.read(bloom, ResourceStates::CopySource);
+				builder.write(bloomHandle, ResourceStates::CopyDest);
+			}, [&](RenderGraphContext& context) {
+				context.getCommandList()->copyBuffer(context.getBuffer(bloomHandle), 0, context.getBuffer(bloom), 0, 16);
+			});
+			const uint32_t particlesPass = graph.addPass("particles", [&](RenderGraphBuilder& builder) {
+				if (ordered)
+					builder.read(bloomHandle, ResourceStates::CopySource);
+				particles = builder.write(builder.createBuffer(desc), ResourceStates::CopyDest);
+				builder.setQueue(CommandQueue::Compute);
+			}, [&](RenderGraphContext& context) {
+				context.getCommandList()->clearBufferUInt(context.getBuffer(particles), 2);
+			});
+			graph.addPass("particles resolve", [&](RenderGraphBuilder& builder) {
+				builder.read(particles, ResourceStates::CopySource);
+				builder.write(particlesHandle, ResourceStates::CopyDest);
+				builder.setQueue(CommandQueue::Compute);
+			}, [&](RenderGraphContext& context) {
+				context.getCommandList()->copyBuffer(context.getBuffer(particlesHandle), 0, context.getBuffer(particles), 0, 16);
+			});
+			graph.compile();
+			graph.submit();
+
+			const RenderGraphStatistics& stats = graph.getStatistics();
+			EXPECT_EQ(graph.getPassQueue(particlesPass), asyncQueues ? CommandQueue::Compute : CommandQueue::Graphics);
+			EXPECT_EQ(stats.transientBuffers, 2u);
+			if (asyncQueues && !ordered)
+				EXPECT_EQ(stats.heapBytes, stats.transientBytes);
+			else
+				EXPECT_EQ(stats.heapBytes * 2, stats.transientBytes);
+
+			const uint32_t* values = static_cast<const uint32_t*>(device->mapBuffer(bloomOutput, CpuAccessMode::Read));
+			EXPECT_EQ(values[0], 1u);
+			device->unmapBuffer(bloomOutput);
+			values = static_cast<const uint32_t*>(device->mapBuffer(particlesOutput, CpuAccessMode::Read));
+			EXPECT_EQ(values[0], 2u);
+			device->unmapBuffer(particlesOutput);
+			EXPECT_EQ(callback.errors, 0);
+		}
+	}
+}
+
+TEST(RHI_TEST, DISABLED_bench_state_tracking)
+{
+	using namespace redtea::device;
+	DeviceHandle device = null::createDevice(null::DeviceDesc());
+
+	const int resourceCount = 4096;
+	TextureDesc textureDesc;
+	textureDesc.format = Format::RGBA8_UNORM;
+	textureDesc.isRenderTarget = true;
+	textureDesc.initialState = ResourceStates::ShaderResource;
+	textureDesc.keepInitialState = true;
+	BufferDesc bufferDesc;
+	bufferDesc.byteSize = 16;
+	bufferDesc.canHaveUAVs = true;
+	bufferDesc.initialState = ResourceStates::ShaderResource;
+	bufferDesc.keepInitialState = true;
+
+	std::vector<TextureHandle> textures;
+	std::vector<BufferHandle> buffers;
+	for (int i = 0; i < resourceCount; i++)
+	{
+		textures.push_back(device->createTexture(textureDesc));
+		buffers.push_back(device->createBuffer(bufferDesc));
+	}
+
+	// every resource goes to a write state and back, and back to its initial state on close
+	CommandListHandle cmd = device->createCommandList();
+	const int frames = 100;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		cmd->open();
+		for (int i = 0; i < resourceCount; i++)
+		{
+			cmd->setTextureState(textures[i], AllSubresources, ResourceStates::RenderTarget);
+			cmd->setBufferState(buffers[i], ResourceStates::UnorderedAccess);
+		}
+		cmd->commitBarriers();
+		for (int i = 0; i < resourceCount; i++)
+		{
+			cmd->setTextureState(textures[i], AllSubresources, ResourceStates::ShaderResource);
+			cmd->setBufferState(buffers[i], ResourceStates::CopySource);
+		}
+		cmd->commitBarriers();
+		cmd->close();
+		device->executeCommandLists(&cmd, 1);
+		device->runGarbageCollection();
+	}
+	auto end = std::chrono::steady_clock::now();
+	const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	std::cout << "state tracking: " << ns / (frames * resourceCount * 6.0) << " ns per barrier" << std::endl;
+}
+
+TEST(RHI_TEST, null_barrier_optimizer)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+
+	TextureDesc textureDesc;
+	textureDesc.width = 64;
+	textureDesc.height = 64;
+	textureDesc.mipLevels = 4;
+	textureDesc.format = Format::RGBA8_UNORM;
+	textureDesc.isRenderTarget = true;
+	textureDesc.isUAV = true;
+	textureDesc.initialState = ResourceStates::ShaderResource;
+	textureDesc.keepInitialState = true;
+	TextureHandle texture = device->createTexture(textureDesc);
+
+	BufferDesc bufferDesc;
+	bufferDesc.byteSize = 256;
+	bufferDesc.canHaveUAVs = true;
+	bufferDesc.initialState = ResourceStates::ShaderResource;
+	bufferDesc.keepInitialState = true;
+	BufferHandle buffer = device->createBuffer(bufferDesc);
+
+	CommandListHandle cmd = device->createCommandList();
+	const null::CommandListStatistics& stats = static_cast<null::CommandList*>(cmd.Get())->getStatistics();
+	cmd->open();
+
+	// SRV -> RT -> UAV is one barrier
+	cmd->setTextureState(texture, AllSubresources, ResourceStates::RenderTarget);
+	cmd->setTextureState(texture, AllSubresources, ResourceStates::UnorderedAccess);
+	cmd->commitBarriers();
+	EXPECT_EQ(stats.requestedBarriers, 2u);
+	EXPECT_EQ(stats.textureBarriers, 1u);
+
+	// every mip on its own, then the whole texture from per-mip tracking: one barrier each time
+	for (MipLevel mip = 0; mip < textureDesc.mipLevels; mip++)
+		cmd->setTextureState(texture, TextureSubresourceSet(mip, 1, 0, 1), ResourceStates::ShaderResource);
+	cmd->commitBarriers();
+	cmd->setTextureState(texture, AllSubresources, ResourceStates::CopySource);
+	cmd->commitBarriers();
+	EXPECT_EQ(stats.requestedBarriers, 10u);
+	EXPECT_EQ(stats.textureBarriers, 3u);
+	EXPECT_EQ(cmd->getTextureSubresourceState(texture, 0, 2), ResourceStates::CopySource);
+
+	// there and back again is nothing
+	cmd->setTextureState(texture, AllSubresources, ResourceStates::RenderTarget);
+	cmd->setTextureState(texture, AllSubresources, ResourceStates::CopySource);
+	cmd->commitBarriers();
+	EXPECT_EQ(stats.requestedBarriers, 12u);
+	EXPECT_EQ(stats.textureBarriers, 3u);
+
+	// the UAV barrier right after the transition to UAV is redundant
+	cmd->setBufferState(buffer, ResourceStates::UnorderedAccess);
+	cmd->setBufferState(buffer, ResourceStates::UnorderedAccess);
+	cmd->commitBarriers();
+	EXPECT_EQ(stats.requestedBarriers, 14u);
+	EXPECT_EQ(stats.bufferBarriers, 1u);
+	EXPECT_EQ(stats.uavBarriers, 0u);
+
+	// a split begun in one batch and ended in the next, and one that never leaves its batch
+	cmd->beginBufferStateTransition(buffer, ResourceStates::ShaderResource);
+	cmd->commitBarriers();
+	EXPECT_EQ(cmd->getBufferState(buffer), ResourceStates::UnorderedAccess);
+	cmd->setBufferState(buffer, ResourceStates::ShaderResource);
+	cmd->commitBarriers();
+	cmd->beginTextureStateTransition(texture, ResourceStates::ShaderResource);
+	cmd->setTextureState(texture, AllSubresources, ResourceStates::ShaderResource);
+	cmd->commitBarriers();
+	EXPECT_EQ(stats.requestedBarriers, 18u);
+	EXPECT_EQ(stats.splitBarriers, 1u);
+	EXPECT_EQ(stats.bufferBarriers, 2u);
+	EXPECT_EQ(stats.textureBarriers, 4u);
+
+	// a split nothing ends is ended on close, together with the transition back to the
+	// initial state it comes to nothing
+	cmd->beginBufferStateTransition(buffer, ResourceStates::CopySource);
+	cmd->close();
+	EXPECT_EQ(stats.requestedBarriers, 21u);
+	EXPECT_EQ(stats.splitBarriers, 1u);
+	EXPECT_EQ(stats.bufferBarriers, 2u);
+	EXPECT_EQ(stats.textureBarriers, 4u);
+	device->executeCommandLists(&cmd, 1);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, render_graph_split_barriers)
+{
+	using namespace redtea::device;
+
+	for (bool splitBarriers : { true, false })
+	{
+		CountingMessageCallback callback;
+		null::DeviceDesc deviceDesc;
+		deviceDesc.errorCB = &callback;
+		DeviceHandle device = null::createDevice(deviceDesc);
+
+		BufferDesc desc;
+		desc.byteSize = 256;
+		desc.canHaveUAVs = true;
+		BufferHandle simulation = device->createBuffer(desc);
+		BufferHandle particles = device->createBuffer(desc);
+
+		// the simulation results go to SRV while the particles are written
+		RenderGraph graph(device);
+		graph.setSplitBarriers(splitBarriers);
+		RenderGraphBuffer simulationHandle = graph.importBuffer(simulation, ResourceStates::Common);
+		RenderGraphBuffer particlesHandle = graph.importBuffer(particles, ResourceStates::Common);
+		graph.addPass("simulate", [&](RenderGraphBuilder& builder) { builder.write(simulationHandle); }, nullptr);
+		graph.addPass("particles", [&](RenderGraphBuilder& builder) { builder.write(particlesHandle); }, nullptr);
+		graph.addPass("draw", [&](RenderGraphBuilder& builder) {
+			builder.read(simulationHandle);
+			builder.setSideEffects();
+		}, nullptr);
+		graph.compile();
+
+		CommandListHandle cmd = device->createCommandList();
+		cmd->open();
+		graph.execute(cmd);
+		cmd->close();
+
+		const RenderGraphStatistics& stats = graph.getStatistics();
+		EXPECT_EQ(stats.barriers, 5u);
+		EXPECT_EQ(stats.splitBarriers, splitBarriers ? 1u : 0u);
+
+		const null::CommandListStatistics& listStats = static_cast<null::CommandList*>(cmd.Get())->getStatistics();
+		EXPECT_EQ(listStats.bufferBarriers, 5u);
+		EXPECT_EQ(listStats.splitBarriers, splitBarriers ? 1u : 0u);
+		EXPECT_EQ(callback.errors, 0);
+	}
+}
+
+namespace
+{
+	redtea::device::ShaderHandle createBytecodeShader(redtea::device::IDevice* device, redtea::device::ShaderType type, const std::string& bytecode)
+	{
+		return device->createShader(redtea::device::ShaderDesc(type), bytecode.data(), bytecode.size());
+	}
+
+	std::vector<char> readFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void writeFile(const std::string& path, const std::vector<char>& data)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), std::streamsize(data.size()));
+	}
+}
+
+TEST(RHI_TEST, pipeline_cache)
+{
+	using namespace redtea::device;
+	const std::string path = ::testing::TempDir() + "redtea_pipelines.cache";
+	std::remove(path.c_str());
+
+	// reference values of MurmurHash3 x64 128
+	const char* fox = "The quick brown fox jumps over the lazy dog";
+	EXPECT_EQ(hashBytes(fox, strlen(fox)).low, 0xe34bbc7bbc071b6cull);
+	EXPECT_EQ(hashBytes(fox, strlen(fox)).high, 0x7a433ca9c49a9347ull);
+	EXPECT_EQ(hashBytes("", 0), PipelineHash());
+
+	// every run creates its own device and shaders, only the file is kept
+	auto run = [&](PipelineCacheStatistics& stats, uint32_t& deviceCompiles, bool load, bool save)
+	{
+		CountingMessageCallback callback;
+		null::DeviceDesc deviceDesc;
+		deviceDesc.errorCB = &callback;
+		DeviceHandle device = null::createDevice(deviceDesc);
+		RasterTarget target = createRasterTarget(device, 16, 16, Format::RGBA8_UNORM);
+
+		PipelineCache cache(device);
+		EXPECT_EQ(cache.load(path.c_str()), load);
+
+		GraphicsPipelineDesc desc;
+		desc.VS = createBytecodeShader(device, ShaderType::Vertex, "vs");
+		desc.PS = createBytecodeShader(device, ShaderType::Pixel, "ps0");
+		GraphicsPipelineHandle first = cache.createGraphicsPipeline(desc, target.framebuffer);
+		EXPECT_EQ(cache.createGraphicsPipeline(desc, target.framebuffer), first);
+
+		// the same bytecode in other shader objects is the same pipeline
+		GraphicsPipelineDesc same;
+		same.VS = createBytecodeShader(device, ShaderType::Vertex, "vs");
+		same.PS = createBytecodeShader(device, ShaderType::Pixel, "ps0");
+		EXPECT_EQ(hashPipelineDesc(same, target.framebuffer->getFramebufferInfo()), hashPipelineDesc(desc, target.framebuffer->getFramebufferInfo()));
+		EXPECT_EQ(cache.createGraphicsPipeline(same, target.framebuffer), first);
+
+		GraphicsPipelineDesc otherShader = desc;
+		otherShader.PS = createBytecodeShader(device, ShaderType::Pixel, "ps1");
+		EXPECT_NE(cache.createGraphicsPipeline(otherShader, target.framebuffer), first);
+
+		GraphicsPipelineDesc otherState = desc;
+		otherState.renderState.rasterState.setCullNone();
+		EXPECT_NE(cache.createGraphicsPipeline(otherState, target.framebuffer), first);
+
+		FramebufferInfo otherFramebuffer = target.framebuffer->getFramebufferInfo();
+		otherFramebuffer.sampleCount = 4;
+		EXPECT_NE(hashPipelineDesc(desc, otherFramebuffer), hashPipelineDesc(desc, target.framebuffer->getFramebufferInfo()));
+
+		ComputePipelineDesc computeDesc;
+		computeDesc.CS = createBytecodeShader(device, ShaderType::Compute, "cs");
+		ComputePipelineHandle compute = cache.createComputePipeline(computeDesc);
+		EXPECT_TRUE(compute);
+		EXPECT_EQ(cache.createComputePipeline(computeDesc), compute);
+
+		if (save)
+		{
+			EXPECT_TRUE(cache.save(path.c_str()));
+		}
+
+		stats = cache.getStatistics();
+		deviceCompiles = static_cast<null::Device*>(device.Get())->getPipelineCompileCount();
+		EXPECT_EQ(callback.errors, 0);
+	};
+
+	PipelineCacheStatistics stats;
+	uint32_t deviceCompiles = 0;
+
+	// cold: nothing to load, every pipeline is compiled once
+	run(stats, deviceCompiles, false, true);
+	EXPECT_EQ(stats.hits, 3u);
+	EXPECT_EQ(stats.compiles, 4u);
+	EXPECT_EQ(stats.binaryHits, 0u);
+	EXPECT_EQ(stats.savedBinaries, 4u);
+	EXPECT_EQ(deviceCompiles, 4u);
+
+	// warm: every pipeline comes from its binary
+	run(stats, deviceCompiles, true, false);
+	EXPECT_EQ(stats.loadedBinaries, 4u);
+	EXPECT_EQ(stats.binaryHits, 4u);
+	EXPECT_EQ(stats.compiles, 0u);
+	EXPECT_EQ(deviceCompiles, 0u);
+
+	// a damaged binary is compiled again, the others are still used
+	std::vector<char> file = readFile(path);
+	ASSERT_GT(file.size(), 64u);
+	std::vector<char> damaged = file;
+	damaged[64] ^= 0x5a;
+	writeFile(path, damaged);
+	run(stats, deviceCompiles, true, true);
+	EXPECT_EQ(stats.corruptBinaries, 1u);
+	EXPECT_EQ(stats.binaryHits, 3u);
+	EXPECT_EQ(stats.compiles, 1u);
+	EXPECT_EQ(deviceCompiles, 1u);
+	EXPECT_EQ(stats.savedBinaries, 4u);
+
+	// the save replaced it with a good binary
+	run(stats, deviceCompiles, true, false);
+	EXPECT_EQ(stats.binaryHits, 4u);
+	EXPECT_EQ(stats.corruptBinaries, 0u);
+
+	// files of another version or cut short are not loaded
+	file = readFile(path);
+	damaged = file;
+	damaged[4] ^= 0x01;
+	writeFile(path, damaged);
+	run(stats, deviceCompiles, false, false);
+	EXPECT_EQ(stats.compiles, 4u);
+
+	damaged = file;
+	damaged.resize(damaged.size() - 1);
+	writeFile(path, damaged);
+	run(stats, deviceCompiles, false, false);
+	EXPECT_EQ(stats.compiles, 4u);
+
+	std::remove(path.c_str());
+}
+
+TEST(RHI_TEST, DISABLED_bench_pipeline_cache)
+{
+	using namespace redtea::device;
+	const std::string path = ::testing::TempDir() + "redtea_bench_pipelines.cache";
+	std::remove(path.c_str());
+
+	const int pipelineCount = 256;
+	auto startup = [&]()
+	{
+		null::DeviceDesc deviceDesc;
+		// close to what a driver takes for a small pipeline
+		deviceDesc.pipelineCompileMicroseconds = 2000;
+		DeviceHandle device = null::createDevice(deviceDesc);
+		RasterTarget target = createRasterTarget(device, 16, 16, Format::RGBA8_UNORM);
+
+		auto start = std::chrono::steady_clock::now();
+		PipelineCache cache(device);
+		cache.load(path.c_str());
+		ShaderHandle vs = createBytecodeShader(device, ShaderType::Vertex, std::string(4096, 'v'));
+		for (int i = 0; i < pipelineCount; i++)
+		{
+			GraphicsPipelineDesc desc;
+			desc.VS = vs;
+			desc.PS = createBytecodeShader(device, ShaderType::Pixel, std::string(4096, 'p') + std::to_string(i));
+			cache.createGraphicsPipeline(desc, target.framebuffer);
+		}
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		cache.save(path.c_str());
+		return ms;
+	};
+
+	const double cold = startup();
+	const double warm = startup();
+	std::remove(path.c_str());
+	std::cout << pipelineCount << " pipelines: cold " << cold << " ms, warm " << warm << " ms" << std::endl;
+}
+
+TEST(RHI_TEST, pipeline_compiler)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+	RasterTarget target = createRasterTarget(device, 16, 16, Format::RGBA8_UNORM);
+	PipelineCache cache(device);
+
+	// one triangle over the whole target, green with the fallback and red once compiled
+	ShaderHandle vs = createArrayVertexShader(device, {
+		-1.f, -1.f, 0.5f, 1.f,
+		-1.f, 3.f, 0.5f, 1.f,
+		3.f, -1.f, 0.5f, 1.f,
+	}, 0);
+	auto createColorShader = [&](float red, float green)
+	{
+		return static_cast<null::Device*>(device.Get())->createPixelShader(
+			[red, green](const null::ShaderContext&, const float*, const float*, float* colors)
+			{
+				colors[0] = red;
+				colors[1] = green;
+				colors[2] = 0.f;
+				colors[3] = 1.f;
+				return true;
+			});
+	};
+
+	GraphicsPipelineDesc fallbackDesc;
+	fallbackDesc.VS = vs;
+	fallbackDesc.PS = createColorShader(0.f, 1.f);
+	GraphicsPipelineHandle fallback = device->createGraphicsPipeline(fallbackDesc, target.framebuffer);
+
+	GraphicsPipelineDesc desc;
+	desc.VS = vs;
+	desc.PS = createColorShader(1.f, 0.f);
+
+	GraphicsPipelineDesc lowDesc = desc;
+	lowDesc.PS = createBytecodeShader(device, ShaderType::Pixel, "low");
+	GraphicsPipelineDesc highDesc = desc;
+	highDesc.PS = createBytecodeShader(device, ShaderType::Pixel, "high");
+
+	// without workers nothing compiles until asked to
+	PipelineCompiler compiler(cache, 0);
+	AsyncGraphicsPipelineHandle pipeline = compiler.createGraphicsPipelineAsync(desc, target.framebuffer, PipelineCompilePriority::Normal, fallback);
+	AsyncGraphicsPipelineHandle low = compiler.createGraphicsPipelineAsync(lowDesc, target.framebuffer, PipelineCompilePriority::Low);
+	AsyncGraphicsPipelineHandle high = compiler.createGraphicsPipelineAsync(highDesc, target.framebuffer, PipelineCompilePriority::High);
+	EXPECT_EQ(compiler.getStatistics().pending, 3u);
+
+	CommandListHandle cmd = device->createCommandList();
+	auto drawFrame = [&]()
+	{
+		cmd->open();
+		cmd->clearTextureFloat(target.color, AllSubresources, Color(0.f));
+		cmd->clearDepthStencilTexture(target.depth, AllSubresources, true, 1.f, false, 0);
+		GraphicsState state;
+		state.setPipeline(compiler.resolve(pipeline)).setFramebuffer(target.framebuffer).setViewport(ViewportState().addViewportAndScissorRect(Viewport(16.f, 16.f)));
+		if (state.pipeline)
+		{
+			cmd->setGraphicsState(state);
+			DrawArguments args;
+			args.vertexCount = 3;
+			cmd->draw(args);
+		}
+		cmd->close();
+		device->executeCommandLists(&cmd, 1);
+	};
+
+	typedef uint8_t Rgba[4];
+	drawFrame();
+	EXPECT_FALSE(pipeline->isReady());
+	EXPECT_EQ(target.texel<Rgba>(target.color, 8, 8)[1], 255);
+	EXPECT_EQ(compiler.resolve(low), nullptr);
+
+	// highest priority first, then in the order they were asked for
+	EXPECT_EQ(compiler.compilePending(1), 1u);
+	EXPECT_TRUE(high->isReady());
+	EXPECT_FALSE(pipeline->isReady());
+	compiler.setPriority(low, PipelineCompilePriority::High);
+	EXPECT_EQ(compiler.compilePending(1), 1u);
+	EXPECT_TRUE(low->isReady());
+	EXPECT_FALSE(pipeline->isReady());
+
+	EXPECT_NE(compiler.wait(pipeline), nullptr);
+	EXPECT_EQ(compiler.resolve(pipeline), pipeline->getPipeline());
+	drawFrame();
+	EXPECT_EQ(target.texel<Rgba>(target.color, 8, 8)[0], 255);
+	EXPECT_EQ(target.texel<Rgba>(target.color, 8, 8)[1], 0);
+
+	PipelineCompilerStatistics stats = compiler.getStatistics();
+	EXPECT_EQ(stats.pending, 0u);
+	EXPECT_EQ(stats.compiled, 3u);
+	EXPECT_EQ(stats.fallbackDraws, 1u);
+	EXPECT_EQ(stats.skippedDraws, 1u);
+	EXPECT_EQ(stats.getStallsAvoided(), 2u);
+	EXPECT_EQ(stats.stalls, 1u);
+
+	// workers compile in the background, through the cache
+	null::DeviceDesc slowDesc;
+	slowDesc.errorCB = &callback;
+	slowDesc.pipelineCompileMicroseconds = 1000;
+	DeviceHandle slowDevice = null::createDevice(slowDesc);
+	RasterTarget slowTarget = createRasterTarget(slowDevice, 16, 16, Format::RGBA8_UNORM);
+	PipelineCache slowCache(slowDevice);
+	{
+		PipelineCompiler workers(slowCache, 2);
+		std::vector<AsyncGraphicsPipelineHandle> pipelines;
+		for (int i = 0; i < 8; i++)
+		{
+			GraphicsPipelineDesc workerDesc;
+			workerDesc.VS = createBytecodeShader(slowDevice, ShaderType::Vertex, "vs");
+			workerDesc.PS = createBytecodeShader(slowDevice, ShaderType::Pixel, "ps" + std::to_string(i % 4));
+			pipelines.push_back(workers.createGraphicsPipelineAsync(workerDesc, slowTarget.framebuffer));
+		}
+		workers.waitForIdle();
+
+		for (const AsyncGraphicsPipelineHandle& async : pipelines)
+			EXPECT_NE(async->getPipeline(), nullptr);
+		EXPECT_EQ(pipelines[0]->getPipeline(), pipelines[4]->getPipeline());
+
+		stats = workers.getStatistics();
+		EXPECT_EQ(stats.pending, 0u);
+		EXPECT_EQ(stats.compiled, 8u);
+		EXPECT_GT(stats.getCompiledPerSecond(), 0.0);
+		EXPECT_EQ(static_cast<null::Device*>(slowDevice.Get())->getPipelineCompileCount(), 4u);
+	}
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, DISABLED_bench_async_pipelines)
+{
+	using namespace redtea::device;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.pipelineCompileMicroseconds = 2000;
+	DeviceHandle device = null::createDevice(deviceDesc);
+	RasterTarget target = createRasterTarget(device, 16, 16, Format::RGBA8_UNORM);
+	GraphicsPipelineDesc fallbackDesc;
+	fallbackDesc.VS = createBytecodeShader(device, ShaderType::Vertex, "vs");
+	fallbackDesc.PS = createBytecodeShader(device, ShaderType::Pixel, "fallback");
+	GraphicsPipelineHandle fallback = device->createGraphicsPipeline(fallbackDesc, target.framebuffer);
+
+	// a frame that needs pipelines it has never seen, the time the thread recording it spends on them
+	const int pipelineCount = 64;
+	auto createDesc = [&](const char* prefix, int i)
+	{
+		GraphicsPipelineDesc desc = fallbackDesc;
+		desc.PS = createBytecodeShader(device, ShaderType::Pixel, prefix + std::to_string(i));
+		return desc;
+	};
+
+	PipelineCache cache(device);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < pipelineCount; i++)
+		cache.createGraphicsPipeline(createDesc("sync", i), target.framebuffer);
+	const double syncMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	PipelineCompiler compiler(cache, 4);
+	std::vector<AsyncGraphicsPipelineHandle> pipelines;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < pipelineCount; i++)
+	{
+		pipelines.push_back(compiler.createGraphicsPipelineAsync(createDesc("async", i), target.framebuffer, PipelineCompilePriority::Normal, fallback));
+		compiler.resolve(pipelines.back());
+	}
+	const double asyncMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	compiler.waitForIdle();
+
+	const PipelineCompilerStatistics stats = compiler.getStatistics();
+	std::cout << pipelineCount << " new pipelines in a frame: recording thread blocked " << syncMs << " ms, with 4 workers "
+		<< asyncMs << " ms, " << stats.getStallsAvoided() << " stalls avoided, " << stats.getCompiledPerSecond() << " compiles per second" << std::endl;
+}
+
+TEST(RHI_TEST, binding_set_cache)
+{
+	using namespace redtea::device;
+	CountingMessageCallback callback;
+	null::DeviceDesc deviceDesc;
+	deviceDesc.errorCB = &callback;
+	DeviceHandle device = null::createDevice(deviceDesc);
+
+	BufferDesc bufferDesc;
+	bufferDesc.byteSize = 256;
+	bufferDesc.isConstantBuffer = true;
+	bufferDesc.initialState = ResourceStates::ConstantBuffer;
+	bufferDesc.keepInitialState = true;
+	std::vector<BufferHandle> buffers;
+	for (int i = 0; i < 4; i++)
+		buffers.push_back(device->createBuffer(bufferDesc));
+
+	BindingLayoutDesc layoutDesc;
+	layoutDesc.visibility = ShaderType::All;
+	layoutDesc.bindings = { BindingLayoutItem::ConstantBuffer(0) };
+	BindingLayoutHandle layout = device->createBindingLayout(layoutDesc);
+	BindingLayoutHandle otherLayout = device->createBindingLayout(layoutDesc);
+
+	auto createDesc = [&](int buffer)
+	{
+		BindingSetDesc desc;
+		desc.bindings = { BindingSetItem::ConstantBuffer(0, buffers[buffer]) };
+		return desc;
+	};
+
+	BindingSetCache cache(device, 3, 2, 2);
+	BindingSetHandle a = cache.getBindingSet(createDesc(0), layout);
+	EXPECT_EQ(cache.getBindingSet(createDesc(0), layout), a);
+	BindingSetHandle b = cache.getBindingSet(createDesc(1), layout);
+	EXPECT_NE(b, a);
+	EXPECT_NE(cache.getBindingSet(createDesc(0), otherLayout), a);
+	EXPECT_NE(cache.getBindingSet(createDesc(0).setTrackLiveness(false), layout), a);
+
+	// over capacity the least recently used goes, the sets handed out stay alive
+	BindingSetCacheStatistics stats = cache.getStatistics();
+	EXPECT_EQ(stats.hits, 1u);
+	EXPECT_EQ(stats.creates, 4u);
+	EXPECT_EQ(stats.evictions, 1u);
+	EXPECT_EQ(stats.sets, 3u);
+	EXPECT_EQ(cache.getBindingSet(createDesc(1), layout), b);
+	EXPECT_NE(cache.getBindingSet(createDesc(0), layout), a);
+	EXPECT_EQ(a->getDesc()->bindings[0].resourceHandle, buffers[0].Get());
+
+	// and the sets not used for maxFrameAge frames
+	cache.beginFrame();
+	BindingSetHandle c = cache.getBindingSet(createDesc(2), layout);
+	cache.beginFrame();
+	stats = cache.getStatistics();
+	EXPECT_EQ(stats.sets, 1u);
+	EXPECT_EQ(cache.getBindingSet(createDesc(2), layout), c);
+
+	// transient sets are shared while the frames that used them are in flight
+	BindingSetHandle transient = cache.getTransientBindingSet(createDesc(3), layout);
+	EXPECT_EQ(cache.getTransientBindingSet(createDesc(3), layout), transient);
+	cache.beginFrame();
+	EXPECT_EQ(cache.getTransientBindingSet(createDesc(3), layout), transient);
+	cache.beginFrame();
+	EXPECT_EQ(cache.getStatistics().transientSets, 1u);
+	cache.beginFrame();
+	EXPECT_EQ(cache.getStatistics().transientSets, 0u);
+	EXPECT_NE(cache.getTransientBindingSet(createDesc(3), layout), transient);
+
+	cache.clear();
+	stats = cache.getStatistics();
+	EXPECT_EQ(stats.sets, 0u);
+	EXPECT_EQ(stats.transientSets, 0u);
+	EXPECT_EQ(callback.errors, 0);
+}
+
+TEST(RHI_TEST, DISABLED_bench_binding_set_cache)
+{
+	using namespace redtea::device;
+	DeviceHandle device = null::createDevice(null::DeviceDesc());
+
+	BufferDesc bufferDesc;
+	bufferDesc.byteSize = 256;
+	bufferDesc.canHaveUAVs = true;
+	bufferDesc.initialState = ResourceStates::ShaderResource;
+	bufferDesc.keepInitialState = true;
+
+	BindingLayoutDesc layoutDesc;
+	layoutDesc.visibility = ShaderType::Compute;
+	layoutDesc.bindings = { BindingLayoutItem::RawBuffer_SRV(0), BindingLayoutItem::RawBuffer_SRV(1), BindingLayoutItem::RawBuffer_UAV(0) };
+	BindingLayoutHandle layout = device->createBindingLayout(layoutDesc);
+
+	std::vector<BufferHandle> buffers;
+	for (int i = 0; i < 64; i++)
+		buffers.push_back(device->createBuffer(bufferDesc));
+
+	ComputePipelineDesc pipelineDesc;
+	pipelineDesc.bindingLayouts = { layout };
+	ComputePipelineHandle pipeline = device->createComputePipeline(pipelineDesc);
+	CommandListHandle cmd = device->createCommandList();
+
+	// per draw material bindings out of 64 materials, created every draw or taken from the cache
+	const int frames = 50;
+	const int dispatches = 2000;
+	auto run = [&](BindingSetCache* cache)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			if (cache)
+				cache->beginFrame();
+			cmd->open();
+			for (int i = 0; i < dispatches; i++)
+			{
+				const int material = (i * 7) % 64;
+				BindingSetDesc setDesc;
+				setDesc.bindings = {
+					BindingSetItem::RawBuffer_SRV(0, buffers[material]),
+					BindingSetItem::RawBuffer_SRV(1, buffers[(material + 1) % 64]),
+					BindingSetItem::RawBuffer_UAV(0, buffers[(material + 2) % 64]) };
+
+				BindingSetHandle bindingSet = cache ? cache->getBindingSet(setDesc, layout) : device->createBindingSet(setDesc, layout);
+				ComputeState state;
+				state.pipeline = pipeline;
+				state.bindings = { bindingSet };
+				cmd->setComputeState(state);
+				cmd->dispatch(1);
+			}
+			cmd->close();
+			device->executeCommandLists(&cmd, 1);
+			device->runGarbageCollection();
+		}
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (frames * dispatches);
+	};
+
+	const double uncached = run(nullptr);
+	BindingSetCache cache(device);
+	const double cached = run(&cache);
+	const BindingSetCacheStatistics stats = cache.getStatistics();
+	std::cout << "binding sets: created every draw " << uncached << " ns per dispatch, cached " << cached << " ns per dispatch, "
+		<< stats.creates << " sets created for " << frames * dispatches << " draws" << std::endl;
+}
+
+TEST(RHI_TEST, bitmap_allocator)
+{
+	using namespace redtea::device;
+	const uint32_t invalid = BitmapAllocator::c_InvalidIndex;
+
+	// 79 words of slots and two summary levels above them
+	BitmapAllocator allocator(5000);
+	for (uint32_t i = 0; i < 5000; i++)
+		ASSERT_EQ(allocator.allocate(), i);
+	EXPECT_EQ(allocator.allocate(), invalid);
+
+	// the lowest free slot comes first
+	EXPECT_TRUE(allocator.release(4000));
+	EXPECT_TRUE(allocator.release(130));
+	EXPECT_FALSE(allocator.isAllocated(130));
+	EXPECT_EQ(allocator.allocate(), 130u);
+	EXPECT_EQ(allocator.allocate(), 4000u);
+	EXPECT_EQ(allocator.allocate(), invalid);
+	EXPECT_TRUE(allocator.isAllocated(130));
+
+	EXPECT_TRUE(allocator.release(7));
+	EXPECT_FALSE(allocator.release(7));
+	EXPECT_FALSE(allocator.release(5000));
+
+	// ranges across words, the free slot 7 is too short
+	EXPECT_TRUE(allocator.releaseRange(1000, 100));
+	EXPECT_EQ(allocator.allocateRange(101), invalid);
+	EXPECT_EQ(allocator.allocateRange(100), 1000u);
+	EXPECT_EQ(allocator.allocateRange(2), invalid);
+	EXPECT_FALSE(allocator.releaseRange(4990, 20));
+
+	allocator.grow(6000);
+	EXPECT_EQ(allocator.getCapacity(), 6000u);
+	EXPECT_TRUE(allocator.isAllocated(4999));
+	EXPECT_EQ(allocator.allocate(), 7u);
+	EXPECT_EQ(allocator.allocateRange(1000), 5000u);
+	EXPECT_EQ(allocator.allocate(), invalid);
+
+	BitSetAllocator queries(3, true);
+	EXPECT_EQ(queries.allocate(), 0);
+	EXPECT_EQ(queries.allocate(), 1);
+	EXPECT_EQ(queries.allocate(), 2);
+	EXPECT_EQ(queries.allocate(), -1);
+	queries.release(1);
+	EXPECT_EQ(queries.allocate(), 1);
+
+	// threads allocating and releasing single slots and ranges never get the same slot
+	const uint32_t capacity = 1 << 16;
+	BitmapAllocator shared(capacity);
+	std::vector<std::atomic<uint8_t>> owned(capacity);
+	for (auto& slot : owned)
+		slot.store(0);
+	std::atomic<uint32_t> duplicates{ 0 };
+	std::atomic<uint32_t> failures{ 0 };
+
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&, t]()
+		{
+			std::mt19937 random(t);
+			std::vector<std::pair<uint32_t, uint32_t>> ranges;
+			for (int i = 0; i < 20000; i++)
+			{
+				if (ranges.size() < 256 && random() % 3)
+				{
+					const uint32_t count = random() % 2 ? 1 : 1 + random() % 100;
+					const uint32_t first = count == 1 ? shared.allocate() : shared.allocateRange(count);
+					if (first == invalid)
+					{
+						failures++;
+						continue;
+					}
+					for (uint32_t slot = first; slot < first + count; slot++)
+						if (owned[slot].exchange(1))
+							duplicates++;
+					ranges.emplace_back(first, count);
+				}
+				else if (!ranges.empty())
+				{
+					const size_t index = random() % ranges.size();
+					const auto range = ranges[index];
+					ranges[index] = ranges.back();
+					ranges.pop_back();
+					for (uint32_t slot = range.first; slot < range.first + range.second; slot++)
+						owned[slot].store(0);
+					if (!shared.releaseRange(range.first, range.second))
+						failures++;
+				}
+			}
+			for (const auto& range : ranges)
+			{
+				for (uint32_t slot = range.first; slot < range.first + range.second; slot++)
+					owned[slot].store(0);
+				shared.releaseRange(range.first, range.second);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(duplicates.load(), 0u);
+	EXPECT_EQ(failures.load(), 0u);
+	// all free again and the summaries agree
+	EXPECT_EQ(shared.allocateRange(capacity), 0u);
+}
+
+TEST(RHI_TEST, DISABLED_bench_bitmap_allocator)
+{
+	using namespace redtea::device;
+	const uint32_t capacity = 1 << 20;
+	const uint32_t invalid = BitmapAllocator::c_InvalidIndex;
+
+	// the allocators this replaces: the modulo scan of BitSetAllocator and the range scan of StaticDescriptorHeap
+	struct LinearAllocator
+	{
+		std::vector<bool> allocated;
+		uint32_t next = 0;
+		std::mutex mutex;
+
+		uint32_t allocate()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			const uint32_t size = uint32_t(allocated.size());
+			for (uint32_t i = 0; i < size; i++)
+			{
+				const uint32_t index = (next + i) % size;
+				if (!allocated[index])
+				{
+					allocated[index] = true;
+					next = (index + 1) % size;
+					return index;
+				}
+			}
+			return ~0u;
+		}
+
+		uint32_t allocateRange(uint32_t count)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			uint32_t freeCount = 0;
+			for (uint32_t index = next; index < allocated.size(); index++)
+			{
+				freeCount = allocated[index] ? 0 : freeCount + 1;
+				if (freeCount >= count)
+				{
+					const uint32_t first = index - count + 1;
+					for (uint32_t i = first; i <= index; i++)
+						allocated[i] = true;
+					next = index + 1;
+					return first;
+				}
+			}
+			return ~0u;
+		}
+
+		void releaseRange(uint32_t first, uint32_t count)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (uint32_t i = first; i < first + count; i++)
+				allocated[i] = false;
+			next = std::min(next, first);
+		}
+	};
+
+	// fills the slots to 90% with ranges of 1 to maxCount, then releases a random range and allocates one per step
+	auto run = [&](auto& allocator, uint32_t maxCount, uint32_t& failures)
+	{
+		std::mt19937 random(1);
+		std::vector<std::pair<uint32_t, uint32_t>> ranges;
+		uint32_t used = 0;
+		while (used < capacity / 10 * 9)
+		{
+			const uint32_t count = 1 + random() % maxCount;
+			const uint32_t first = allocator.allocateRange(count);
+			ranges.emplace_back(first, count);
+			used += count;
+		}
+
+		const int steps = 20000;
+		failures = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < steps; i++)
+		{
+			const size_t index = random() % ranges.size();
+			allocator.releaseRange(ranges[index].first, ranges[index].second);
+
+			const uint32_t count = 1 + random() % maxCount;
+			const uint32_t first = count == 1 ? allocator.allocate() : allocator.allocateRange(count);
+			if (first == invalid)
+			{
+				failures++;
+				ranges[index] = ranges.back();
+				ranges.pop_back();
+				continue;
+			}
+			ranges[index] = std::make_pair(first, count);
+		}
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / steps;
+	};
+
+	for (uint32_t maxCount : { 1u, 32u })
+	{
+		uint32_t linearFailures = 0;
+		uint32_t bitmapFailures = 0;
+		LinearAllocator linear;
+		linear.allocated.resize(capacity);
+		const double linearNs = run(linear, maxCount, linearFailures);
+		BitmapAllocator bitmap(capacity);
+		const double bitmapNs = run(bitmap, maxCount, bitmapFailures);
+		std::cout << capacity << " slots 90% full, ranges of 1 to " << maxCount << ": linear scan " << linearNs << " ns, hierarchical bitmap "
+			<< bitmapNs << " ns per release and allocate (" << linearFailures << " and " << bitmapFailures << " failed)" << std::endl;
+	}
+}
@@ -1,6 +1,13 @@
 #include <gtest/gtest.h>
 #include "math/vector.h"
 #include "math/matrix.h"
+#include "math/fast_math.h"
+#include "math/packing.h"
+#include "math/aabb.h"
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <random>
 
 TEST(MATH_TEST, vector)
 {
@@ -56,4 +63,326 @@ TEST(MATH_TEST, matrix)
 	Mat4i identity;
 	Mat4i m3 = m1 * identity;
 	EXPECT_EQ(m1 == m3, true);
-}
\ No newline at end of file
+}
+
+TEST(MATH_TEST, aabb)
+{
+	using namespace redtea::math;
+	Aabb empty;
+	EXPECT_TRUE(empty.IsEmpty());
+	Aabb box({ 0.0f, 0.0f, 0.0f }, { 2.0f, 4.0f, 6.0f });
+	EXPECT_EQ(Union(empty, box).min, box.min);
+	EXPECT_EQ(box.Center(), Vector3f(1.0f, 2.0f, 3.0f));
+	EXPECT_EQ(box.HalfArea(), 2.0f * 4.0f + 4.0f * 6.0f + 6.0f * 2.0f);
+	EXPECT_TRUE(box.Overlaps(Aabb({ 2.0f, 4.0f, 6.0f }, { 3.0f, 5.0f, 7.0f })));
+	EXPECT_FALSE(box.Overlaps(Aabb({ 2.5f, 0.0f, 0.0f }, { 3.0f, 1.0f, 1.0f })));
+	EXPECT_TRUE(box.Contains(Aabb({ 1.0f, 1.0f, 1.0f }, { 2.0f, 2.0f, 2.0f })));
+	EXPECT_EQ(box.DistanceSquared({ 1.0f, 1.0f, 1.0f }), 0.0f);
+	EXPECT_EQ(box.DistanceSquared({ -1.0f, 6.0f, 3.0f }), 5.0f);
+
+	// rays along an axis divide by zero on the others
+	const Vector3f inv(1.0f, 1.0f / 0.0f, 1.0f / 0.0f);
+	EXPECT_EQ(box.Intersect({ -3.0f, 1.0f, 1.0f }, inv, 100.0f), 3.0f);
+	EXPECT_LT(box.Intersect({ -3.0f, 5.0f, 1.0f }, inv, 100.0f), 0.0f);
+	EXPECT_LT(box.Intersect({ -3.0f, 1.0f, 1.0f }, inv, 2.0f), 0.0f);
+	EXPECT_EQ(box.Intersect({ 1.0f, 1.0f, 1.0f }, inv, 100.0f), 0.0f);
+
+	Mat4f m;
+	m.data[0] = Vector4f(0.0f, 1.0f, 0.0f, 0.0f);
+	m.data[1] = Vector4f(-1.0f, 0.0f, 0.0f, 0.0f);
+	m.data[3] = Vector4f(10.0f, 0.0f, 0.0f, 1.0f);
+	Aabb moved = box.Transformed(m);
+	EXPECT_EQ(moved.min, Vector3f(6.0f, 0.0f, 0.0f));
+	EXPECT_EQ(moved.max, Vector3f(10.0f, 2.0f, 6.0f));
+}
+
+TEST(MATH_TEST, fast_math)
+{
+	using namespace redtea::math;
+	const size_t count = 4096;
+	std::vector<float> x(count), y(count), out(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		x[i] = -100.0f + 200.0f * float(i) / count;
+		y[i] = 0.01f + 50.0f * float(i) / count;
+	}
+
+	double sinMedium = 0, sinFast = 0, expMedium = 0, logMedium = 0, rsqrtFast = 0, atanMedium = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		sinMedium = std::max(sinMedium, std::fabs(fast::sin(x[i]) - std::sin(double(x[i]))));
+		sinFast = std::max(sinFast, std::fabs(fast::sin<Precision::Fast>(x[i]) - std::sin(double(x[i]))));
+		double e = std::exp(double(x[i]) * 0.5);
+		expMedium = std::max(expMedium, std::fabs(fast::exp(x[i] * 0.5f) - e) / e);
+		logMedium = std::max(logMedium, std::fabs(fast::log(y[i]) - std::log(double(y[i]))));
+		double r = 1.0 / std::sqrt(double(y[i]));
+		rsqrtFast = std::max(rsqrtFast, std::fabs(fast::rsqrt<Precision::Fast>(y[i]) - r) / r);
+		atanMedium = std::max(atanMedium, std::fabs(fast::atan2(x[i], y[i] - 25.0f) - std::atan2(double(x[i]), double(y[i] - 25.0f))));
+	}
+	EXPECT_LT(sinMedium, 1e-6);
+	EXPECT_LT(sinFast, 2e-6);
+	EXPECT_LT(expMedium, 1e-6);
+	EXPECT_LT(logMedium, 1e-6);
+	EXPECT_LT(rsqrtFast, 2e-3);
+	EXPECT_LT(atanMedium, 1e-6);
+	EXPECT_EQ(fast::atan2(0.0f, 0.0f), 0.0f);
+
+	// batched versions keep the scalar bounds, including the non multiple of 4 tail
+	fast::cos(x.data(), out.data(), count - 3);
+	double cosBatch = 0;
+	for (size_t i = 0; i < count - 3; i++)
+	{
+		cosBatch = std::max(cosBatch, std::fabs(out[i] - std::cos(double(x[i]))));
+	}
+	EXPECT_LT(cosBatch, 1e-6);
+
+	std::vector<float> vx(x), vy(y), vz(count, 1.0f);
+	fast::normalize<Precision::Fast>(vx.data(), vy.data(), vz.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		float l = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+		EXPECT_NEAR(l, 1.0f, 4e-3f);
+	}
+
+	Vector3f v = { 3, 0, 4 };
+	Vector3f n = fast::normalize(v);
+	EXPECT_NEAR(n.x, 0.6f, 1e-5f);
+	EXPECT_NEAR(n.z, 0.8f, 1e-5f);
+}
+
+TEST(MATH_TEST, DISABLED_bench_fast_math)
+{
+	using namespace redtea::math;
+	const size_t count = 1 << 20;
+	const int repeat = 20;
+	std::vector<float> in(count + repeat), out(count);
+	for (size_t i = 0; i < in.size(); i++)
+	{
+		in[i] = -50.0f + 100.0f * float(i) / count;
+	}
+
+	// every pass reads a shifted window so the compiler cannot fold the passes together
+	auto bench = [&](const char* name, auto&& f) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeat; r++)
+		{
+			f(in.data() + r);
+		}
+		std::chrono::duration<double, std::nano> time = std::chrono::high_resolution_clock::now() - start;
+		std::cout << name << ": " << time.count() / (double(repeat) * count) << " ns/element" << std::endl;
+	};
+
+	bench("std::sin", [&](const float* p) { for (size_t i = 0; i < count; i++) out[i] = std::sin(p[i]); });
+	bench("fast::sin<Medium> batched", [&](const float* p) { fast::sin(p, out.data(), count); });
+	bench("fast::sin<Fast> batched", [&](const float* p) { fast::sin<Precision::Fast>(p, out.data(), count); });
+	bench("std::exp", [&](const float* p) { for (size_t i = 0; i < count; i++) out[i] = std::exp(p[i]); });
+	bench("fast::exp<Medium> batched", [&](const float* p) { fast::exp(p, out.data(), count); });
+	bench("std::atan2", [&](const float* p) { for (size_t i = 0; i < count; i++) out[i] = std::atan2(p[i], 1.0f); });
+	bench("fast::atan2<Medium>", [&](const float* p) { for (size_t i = 0; i < count; i++) out[i] = fast::atan2(p[i], 1.0f); });
+	bench("1/std::sqrt", [&](const float* p) { for (size_t i = 0; i < count; i++) out[i] = 1.0f / std::sqrt(std::fabs(p[i])); });
+	bench("fast::rsqrt<Fast> batched", [&](const float* p) { fast::rsqrt<Precision::Fast>(p, out.data(), count); });
+}
+
+TEST(MATH_TEST, packing)
+{
+	using namespace redtea::math;
+	// odd count so the scalar tail runs as well
+	const size_t count = 4099;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	// every half round trips, batched and scalar agree bit for bit
+	std::vector<uint16_t> halves(65536), halvesBack(65536);
+	std::vector<float> halfFloats(65536);
+	for (size_t i = 0; i < halves.size(); i++)
+	{
+		halves[i] = uint16_t(i);
+	}
+	packing::halfToFloat(halves.data(), halfFloats.data(), halves.size());
+	packing::floatToHalf(halfFloats.data(), halvesBack.data(), halves.size());
+	for (size_t i = 0; i < halves.size(); i++)
+	{
+		EXPECT_EQ(packing::floatToHalf(packing::halfToFloat(halves[i])), halvesBack[i]);
+		if (std::isnan(halfFloats[i]))
+		{
+			EXPECT_TRUE(std::isnan(packing::halfToFloat(halvesBack[i])));
+			continue;
+		}
+		EXPECT_EQ(halfFloats[i], packing::halfToFloat(halves[i]));
+		EXPECT_EQ(halves[i], halvesBack[i]);
+	}
+	EXPECT_EQ(packing::floatToHalf(1e6f), 0x7c00);
+	EXPECT_EQ(packing::floatToHalf(-1e-9f), 0x8000);
+	EXPECT_EQ(packing::floatToHalf(1.0f + 1.0f / 2048.0f), 0x3c00);	// tie rounds to even
+
+	std::vector<float> values(count), back(count);
+	std::vector<uint16_t> u16(count);
+	std::vector<int16_t> s16(count);
+	std::vector<uint8_t> u8(count);
+	std::vector<int8_t> s8(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = dist(rng) * 70000.0f;
+	}
+	packing::floatToHalf(values.data(), u16.data(), count);
+	packing::halfToFloat(u16.data(), back.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		EXPECT_EQ(u16[i], packing::floatToHalf(values[i]));
+		if (std::fabs(values[i]) < 65520.0f)
+		{
+			EXPECT_LE(std::fabs(back[i] - values[i]), std::fabs(values[i]) / 2048.0f);
+		}
+		else
+		{
+			EXPECT_TRUE(std::isinf(back[i]));
+		}
+	}
+
+	// a bit outside [-1, 1] to cover clamping
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = dist(rng) * 1.1f;
+	}
+	auto checkNorm = [&](float lo, float step) {
+		for (size_t i = 0; i < count; i++)
+		{
+			const float clamped = std::fmin(std::fmax(values[i], lo), 1.0f);
+			EXPECT_LE(std::fabs(back[i] - clamped), step * 0.5f + 1e-6f);
+		}
+	};
+	packing::floatToSnorm16(values.data(), s16.data(), count);
+	packing::snorm16ToFloat(s16.data(), back.data(), count);
+	checkNorm(-1.0f, 1.0f / 32767.0f);
+	for (size_t i = 0; i < count; i++)
+	{
+		EXPECT_EQ(s16[i], packing::floatToSnorm16(values[i]));
+	}
+	packing::floatToUnorm16(values.data(), u16.data(), count);
+	packing::unorm16ToFloat(u16.data(), back.data(), count);
+	checkNorm(0.0f, 1.0f / 65535.0f);
+	packing::floatToSnorm8(values.data(), s8.data(), count);
+	packing::snorm8ToFloat(s8.data(), back.data(), count);
+	checkNorm(-1.0f, 1.0f / 127.0f);
+	packing::floatToUnorm8(values.data(), u8.data(), count);
+	packing::unorm8ToFloat(u8.data(), back.data(), count);
+	checkNorm(0.0f, 1.0f / 255.0f);
+	for (size_t i = 0; i < count; i++)
+	{
+		EXPECT_EQ(u8[i], packing::floatToUnorm8(values[i]));
+		EXPECT_EQ(s8[i], packing::floatToSnorm8(values[i]));
+	}
+
+	// octahedral normals, including the poles and the equator
+	std::vector<float> x(count), y(count), z(count), w(count);
+	std::vector<float> bx(count), by(count), bz(count), bw(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		x[i] = dist(rng);
+		y[i] = dist(rng);
+		z[i] = i % 7 == 0 ? 0.0f : dist(rng);
+	}
+	x[0] = 0.0f; y[0] = 0.0f; z[0] = -1.0f;
+	x[1] = 0.0f; y[1] = 0.0f; z[1] = 1.0f;
+	fast::normalize<Precision::Exact>(x.data(), y.data(), z.data(), count);
+	std::vector<int16_t> oct(2 * count);
+	packing::encodeOctahedral(x.data(), y.data(), z.data(), oct.data(), count);
+	packing::decodeOctahedral(oct.data(), bx.data(), by.data(), bz.data(), count);
+	float maxAngle = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		// acos loses too much near 1, measure through the cross product instead
+		const double cx = double(y[i]) * bz[i] - double(z[i]) * by[i];
+		const double cy = double(z[i]) * bx[i] - double(x[i]) * bz[i];
+		const double cz = double(x[i]) * by[i] - double(y[i]) * bx[i];
+		maxAngle = std::fmax(maxAngle, float(std::asin(std::sqrt(cx * cx + cy * cy + cz * cz)) * 57.2957795));
+	}
+	EXPECT_LT(maxAngle, 0.006f);
+
+	// smallest-three quaternions, q and -q are the same rotation
+	for (size_t i = 0; i < count; i++)
+	{
+		float q[4] = { dist(rng), dist(rng), dist(rng), dist(rng) };
+		const float inv = 1.0f / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		x[i] = q[0] * inv; y[i] = q[1] * inv; z[i] = q[2] * inv; w[i] = q[3] * inv;
+	}
+	std::vector<uint32_t> packed(count);
+	packing::packQuaternion(x.data(), y.data(), z.data(), w.data(), packed.data(), count);
+	packing::unpackQuaternion(packed.data(), bx.data(), by.data(), bz.data(), bw.data(), count);
+	float maxError = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		// a single element goes through the scalar path
+		uint32_t single;
+		packing::packQuaternion(&x[i], &y[i], &z[i], &w[i], &single, 1);
+		EXPECT_EQ(single, packed[i]);
+		const float s = x[i] * bx[i] + y[i] * by[i] + z[i] * bz[i] + w[i] * bw[i] < 0.0f ? -1.0f : 1.0f;
+		maxError = std::fmax(maxError, std::fabs(x[i] - s * bx[i]));
+		maxError = std::fmax(maxError, std::fabs(y[i] - s * by[i]));
+		maxError = std::fmax(maxError, std::fabs(z[i] - s * bz[i]));
+		maxError = std::fmax(maxError, std::fabs(w[i] - s * bw[i]));
+	}
+	EXPECT_LT(maxError, 2e-3f);
+
+	// 10:10:10:2
+	for (size_t i = 0; i < count; i++)
+	{
+		x[i] = dist(rng) * 0.6f + 0.5f;
+		y[i] = dist(rng) * 0.5f + 0.5f;
+		z[i] = dist(rng) * 0.5f + 0.5f;
+		w[i] = float(i % 4) / 3.0f;
+	}
+	packing::packUnorm1010102(x.data(), y.data(), z.data(), w.data(), packed.data(), count);
+	packing::unpackUnorm1010102(packed.data(), bx.data(), by.data(), bz.data(), bw.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		EXPECT_LE(std::fabs(std::fmin(std::fmax(x[i], 0.0f), 1.0f) - bx[i]), 0.5f / 1023.0f + 1e-6f);
+		EXPECT_LE(std::fabs(y[i] - by[i]), 0.5f / 1023.0f + 1e-6f);
+		EXPECT_LE(std::fabs(z[i] - bz[i]), 0.5f / 1023.0f + 1e-6f);
+		EXPECT_EQ(bw[i], w[i]);
+	}
+}
+
+TEST(MATH_TEST, DISABLED_bench_packing)
+{
+	using namespace redtea::math;
+	const size_t count = 1 << 22;
+	const int repeat = 20;
+	std::vector<float> x(count + repeat), y(count + repeat), z(count + repeat), w(count + repeat);
+	for (size_t i = 0; i < x.size(); i++)
+	{
+		x[i] = std::sin(float(i));
+		y[i] = std::cos(float(i));
+		z[i] = std::sin(float(i) * 0.37f);
+		w[i] = std::cos(float(i) * 0.37f);
+	}
+	fast::normalize<Precision::Exact>(x.data(), y.data(), z.data(), x.size());
+	std::vector<uint16_t> u16(count);
+	std::vector<int16_t> s16(2 * count);
+	std::vector<uint8_t> u8(count);
+	std::vector<uint32_t> u32(count);
+	std::vector<float> out(count), out1(count), out2(count), out3(count);
+
+	// throughput counts the bytes read and written by one pass
+	auto bench = [&](const char* name, size_t bytesPerElement, auto&& f) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeat; r++)
+		{
+			f(size_t(r));
+		}
+		std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+		std::cout << name << ": " << double(bytesPerElement) * count * repeat / time.count() / 1e9 << " GB/s" << std::endl;
+	};
+
+	bench("floatToHalf", 6, [&](size_t r) { packing::floatToHalf(x.data() + r, u16.data(), count); });
+	bench("floatToHalf scalar", 6, [&](size_t r) { for (size_t i = 0; i < count; i++) u16[i] = packing::floatToHalf(x[i + r]); });
+	bench("halfToFloat", 6, [&](size_t r) { packing::halfToFloat(u16.data() + (r & 1), out.data(), count - 1); });
+	bench("floatToUnorm8", 5, [&](size_t r) { packing::floatToUnorm8(x.data() + r, u8.data(), count); });
+	bench("floatToSnorm16", 6, [&](size_t r) { packing::floatToSnorm16(x.data() + r, s16.data(), count); });
+	bench("encodeOctahedral", 16, [&](size_t r) { packing::encodeOctahedral(x.data() + r, y.data() + r, z.data() + r, s16.data(), count); });
+	bench("decodeOctahedral", 16, [&](size_t r) { packing::decodeOctahedral(s16.data() + 2 * (r & 1), out.data(), out1.data(), out2.data(), count - 1); });
+	bench("packQuaternion", 20, [&](size_t r) { packing::packQuaternion(x.data() + r, y.data() + r, z.data() + r, w.data() + r, u32.data(), count); });
+	bench("unpackQuaternion", 20, [&](size_t r) { packing::unpackQuaternion(u32.data() + (r & 1), out.data(), out1.data(), out2.data(), out3.data(), count - 1); });
+	bench("packUnorm1010102", 20, [&](size_t r) { packing::packUnorm1010102(x.data() + r, y.data() + r, z.data() + r, w.data() + r, u32.data(), count); });
+	bench("unpackUnorm1010102", 20, [&](size_t r) { packing::unpackUnorm1010102(u32.data() + (r & 1), out.data(), out1.data(), out2.data(), out3.data(), count - 1); });
+}